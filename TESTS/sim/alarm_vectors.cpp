@@ -0,0 +1,44 @@
+#include "sim_test.h"
+#include "CounterIn.h"
+#include "EncoderAlarm.h"
+#include "sim_stimulus.h"
+using namespace mbed;
+// The library leaves every priority at the default; alarm handlers come
+// from the compare vector where the timer has one of its own (TIM1, TIM8)
+EncoderIn e1(PE_9, PE_11);      // TIM1
+EncoderIn e3(PB_4, PB_5);       // TIM3
+CounterIn c8(PC_7);             // TIM8
+CounterIn c2(PA_15);            // TIM2
+static const uint64_t WRAP = 65536, PAST = 100;
+int from_e1 = -2, from_e3 = -2, from_c8[4] = {-2, -2, -2, -2}, n8;
+static void f_e1() { from_e1 = sim_nvic_current(); }
+static void f_e3() { from_e3 = sim_nvic_current(); }
+static void f_c8() { if (n8 < 4) from_c8[n8] = sim_nvic_current(); n8++; }
+static const char *prio(IRQn_Type irq) { return sim_nvic_priority(irq) == 0xFF ? "default" : "0"; }
+int main() {
+    printf("TIM1 up %s, cc %s\n", prio(TIM1_UP_TIM10_IRQn), prio(TIM1_CC_IRQn));
+    printf("TIM8 up %s, cc %s\n", prio(TIM8_UP_TIM13_IRQn), prio(TIM8_CC_IRQn));
+    printf("TIM2 %s, TIM3 %s\n", prio(TIM2_IRQn), prio(TIM3_IRQn));
+    const IRQn_Type irqs[] = {TIM1_UP_TIM10_IRQn, TIM1_CC_IRQn, TIM8_UP_TIM13_IRQn, TIM8_CC_IRQn, TIM2_IRQn, TIM3_IRQn};
+    for (unsigned i = 0; i < sizeof(irqs) / sizeof(irqs[0]); i++) CHECK(sim_nvic_priority(irqs[i]) == 0xFF);
+    sim_stimulus_t s1, s3, s8;
+    e1.start(); e3.start(); c8.start(); c2.start();
+    e1.alarm1(callback(f_e1), 70000);
+    e3.alarm1(callback(f_e3), 300);
+    // Every 65536 counts, so each one is armed by the wrap just before it
+    c8.alarm1(callback(f_c8), WRAP, WRAP);
+    sim_stimulus_quadrature(&s1, PE_9, PE_11, 600000, 70100);
+    sim_stimulus_quadrature(&s3, PB_4, PB_5, 600000, 400);
+    sim_stimulus_pulse(&s8, PC_7, 200000, 50, 3 * WRAP + PAST);
+    sim_run(SIM_MS(1100));
+    CHECK(from_e1 == TIM1_CC_IRQn && from_e3 == TIM3_IRQn);
+    CHECK(n8 == 3 && c8.read64() == 3 * WRAP + PAST);
+    for (int i = 0; i < n8; i++) CHECK(from_c8[i] == TIM8_CC_IRQn);
+    printf("e1 alarm from TIM1 cc: %d\n", from_e1 == TIM1_CC_IRQn);
+    printf("e3 alarm from TIM3: %d\n", from_e3 == TIM3_IRQn);
+    printf("c8 alarms %d, from TIM8 cc: %d %d %d\n", n8, from_c8[0] == TIM8_CC_IRQn, from_c8[1] == TIM8_CC_IRQn, from_c8[2] == TIM8_CC_IRQn);
+    printf("c8 count=%llu\n", (unsigned long long)c8.read64());
+    // No entry stamp unless configured, and the DWT is left alone
+    CHECK((CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) == 0 && e1.irq_cycles() == 0);
+    printf("DWT enabled: %d, e1 stamp %u\n", (CoreDebug->DEMCR & CoreDebug_DEMCR_TRCENA_Msk) != 0, e1.irq_cycles());
+}
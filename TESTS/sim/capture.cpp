@@ -0,0 +1,46 @@
+#include "sim_test.h"
+#include "CaptureIn.h"
+#include "sim_stimulus.h"
+using namespace mbed;
+static const uint32_t LEN3 = 64, LEN2 = 10;
+static const uint32_t HZ3 = 300000, HZ2 = 100000;
+static const uint32_t TIMER_HZ = 2 * SIM_PCLK1_HZ;      // TIM3 and TIM2
+static const uint32_t RUN_MS = 10, WRAP3 = 65536;
+uint32_t buf3[LEN3], buf2[LEN2];
+CaptureIn cap3(PC_6, buf3, LEN3);
+CaptureIn cap2(PA_15, buf2, LEN2);
+int halves3, bad3, halves2, bad2; uint32_t last3; int have3;
+uint32_t last2; int have2; uint32_t n2;
+static void got3(const uint32_t *t, uint32_t n) {
+    halves3++;
+    for (uint32_t i = 0; i < n; i++) { if (have3 && cap3.ticks(last3, t[i]) != TIMER_HZ / HZ3) bad3++; last3 = t[i]; have3 = 1; }
+}
+static void got2(const uint32_t *t, uint32_t n) {
+    halves2++; n2 += n;
+    for (uint32_t i = 0; i < n; i++) { if (have2 && cap2.ticks(last2, t[i]) != TIMER_HZ / HZ2) bad2++; last2 = t[i]; have2 = 1; }
+}
+int main() {
+    sim_stimulus_t s3, s2;
+    cap3.attach(got3); cap2.attach(got2);
+    cap3.start(); cap2.start();
+    sim_stimulus_pulse(&s3, PC_6, HZ3, 50, 0);
+    sim_stimulus_pulse(&s2, PA_15, HZ2, 50, 0);
+    sim_run(SIM_MS(RUN_MS));
+    // A DMA interrupt every half buffer; TIM3 only interrupts to wrap
+    const uint32_t n3 = HZ3 / 1000 * RUN_MS;
+    CHECK(cap3.clock_hz() == TIMER_HZ && bad3 == 0);
+    CHECK(halves3 == (int)(n3 / (LEN3 / 2)) && cap3.index() == n3 % LEN3);
+    CHECK(sim_nvic_count(DMA1_Stream4_IRQn) == (uint32_t)halves3);
+    CHECK(sim_nvic_count(TIM3_IRQn) == (uint64_t)TIMER_HZ / 1000 * RUN_MS / WRAP3);
+    CHECK(n2 == HZ2 / 1000 * RUN_MS && halves2 == (int)(n2 / (LEN2 / 2)) && bad2 == 0);
+    CHECK(cap2.index() == n2 % LEN2 && sim_nvic_count(DMA1_Stream5_IRQn) == (uint32_t)halves2);
+    printf("clk=%u halves3=%d bad3=%d idx=%u dma_irqs=%u tim3_irqs=%u\n", cap3.clock_hz(), halves3, bad3, cap3.index(), sim_nvic_count(DMA1_Stream4_IRQn), sim_nvic_count(TIM3_IRQn));
+    printf("halves2=%d n2=%u bad2=%d idx=%u dma_irqs=%u\n", halves2, n2, bad2, cap2.index(), sim_nvic_count(DMA1_Stream5_IRQn));
+    cap3.stop();
+    int h = halves3; sim_run(SIM_MS(1));
+    CHECK(halves3 == h && cap3.read64() == (uint64_t)TIMER_HZ / 1000 * RUN_MS);
+    printf("after stop halves3 %d->%d; t64=%llu\n", h, halves3, (unsigned long long)cap3.read64());
+    have3 = 0; cap3.start(); sim_run(SIM_MS(1));
+    CHECK(halves3 == h + (int)(HZ3 / 1000 / (LEN3 / 2)) && cap3.index() == HZ3 / 1000 % LEN3 && bad3 == 0);
+    printf("restart halves3=%d bad3=%d idx=%u\n", halves3, bad3, cap3.index());
+}
@@ -0,0 +1,40 @@
+#include "sim_test.h"
+#include "CounterIn.h"
+#include "sim_stimulus.h"
+using namespace mbed;
+CounterIn c3(PC_6, CNT_CASCADE_1);
+CounterIn c8(PC_7, CNT_CASCADE_4);
+static const uint32_t HZ3 = 150000, HZ8 = 100000;
+static const int READS = 10000, READ_US = 97;
+static const uint32_t LOW_TOP = 0xFFF0;        // 16 counts short of a low wrap
+int main() {
+    sim_stimulus_t s3, s8;
+    c3.start(); c8.start();
+    sim_stimulus_pulse(&s3, PC_6, HZ3, 50, 0);
+    sim_stimulus_pulse(&s8, PC_7, HZ8, 50, 0);
+    uint32_t last3 = 0; int bad = 0;
+    for (int k = 0; k < READS; k++) {
+        sim_run(SIM_US(READ_US));
+        uint32_t r = c3.read(); uint64_t r64 = c3.read64();
+        if (r < last3 || r != (uint32_t)r64 || r + 1 < (uint32_t)((sim_stimulus_edges(&s3) + 1) / 2) || r > (uint32_t)((sim_stimulus_edges(&s3) + 1) / 2)) { if (bad < 5) printf("k=%d r=%u r64=%llu edges=%llu\n", k, r, (unsigned long long)r64, (unsigned long long)sim_stimulus_edges(&s3)); bad++; }
+        last3 = r;
+    }
+    // Nothing wraps in a second: a cascade takes no interrupts until it does
+    CHECK(bad == 0);
+    CHECK(c3.read() == (uint64_t)HZ3 * READS * READ_US / 1000000);
+    CHECK(c8.read() == (uint64_t)HZ8 * READS * READ_US / 1000000);
+    CHECK(sim_nvic_count(TIM1_UP_TIM10_IRQn) == 0 && sim_nvic_count(TIM4_IRQn) == 0);
+    CHECK(sim_nvic_count(TIM3_IRQn) == 0 && sim_nvic_count(TIM8_UP_TIM13_IRQn) == 0);
+    printf("c3=%u c8=%u bad=%d irq1=%u irq4=%u irq3=%u irq8=%u\n", c3.read(), c8.read(), bad,
+        sim_nvic_count(TIM1_UP_TIM10_IRQn), sim_nvic_count(TIM4_IRQn), sim_nvic_count(TIM3_IRQn), sim_nvic_count(TIM8_UP_TIM13_IRQn));
+    TIM4->CNT = 0xFFFF; TIM8->CNT = LOW_TOP;
+    uint64_t before = c8.read64();
+    sim_run(SIM_MS(1));
+    const uint64_t wrapped = 0x100000000ULL + HZ8 / 1000 - (0x10000 - LOW_TOP);
+    CHECK(before == 0xFFFF0000ULL + LOW_TOP && c8.read64() == wrapped);
+    CHECK(c8.read() == (uint32_t)wrapped && sim_nvic_count(TIM4_IRQn) == 1);
+    printf("wrap before=%llx after=%llx read=%x irq4=%u\n", (unsigned long long)before, (unsigned long long)c8.read64(), c8.read(), sim_nvic_count(TIM4_IRQn));
+    c8.reset();
+    CHECK(c8.read() == 0 && c8.read64() == 0);
+    printf("after reset %u %llu\n", c8.read(), (unsigned long long)c8.read64());
+}
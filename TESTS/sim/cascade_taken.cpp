@@ -0,0 +1,13 @@
+#include "sim_test.h"
+#include "CounterIn.h"
+#include "SnapshotSampler.h"
+using namespace mbed;
+// The high half of a cascade is a timer of its own, and TIM4 is also the
+// sampler's default
+CounterIn c8(PC_7, CNT_CASCADE_4);
+uint32_t samples[2 * 10];
+int main() {
+    printf("cascaded into TIM4\n");
+    SnapshotSampler sampler(samples, 10);
+    printf("sampler on TIM4 too\n");
+}
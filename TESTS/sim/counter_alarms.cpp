@@ -0,0 +1,57 @@
+#include "sim_test.h"
+#include "CounterIn.h"
+using namespace mbed;
+CounterIn c3(PC_6), c2(PA_15), c8(PC_7);
+static const uint64_t PERIOD = 1000, ONCE = 65600, PULSES = 100500, WRAP = 65536;
+static const uint64_t LATE = 500, RESET_PERIOD = 300, REARM = 500, C2_PULSES = 5200;
+static const int C8_CALLS = 3;
+int n1, n2, n8, bad; uint64_t at1[200]; uint64_t at2;
+static void f1(){ if (n1 < 200) at1[n1] = c3.read64(); n1++; }
+static void f2(){ at2 = c3.read64(); n2++; }
+static void f8(){ n8++; if (n8 == C8_CALLS) c8.alarm1(NULL, 0); }
+static void fc(){ n2++; c2.alarm2(callback(fc), c2.read64() + REARM); }   // re-arm from handler
+int main(){
+  c3.start(); c2.start(); c8.start();
+  c3.alarm1(callback(f1), PERIOD, PERIOD);
+  c3.alarm2(callback(f2), ONCE);
+  sim_stimulus_t p3, p2, p8;
+  uint32_t i0 = sim_nvic_count(TIM3_IRQn);
+  sim_stimulus_pulse(&p3, PC_6, 100000, 50, PULSES);
+  sim_run(SIM_MS(1100));
+  for (int i = 0; i < n1 && i < 200; i++) if (at1[i] != (uint64_t)(i + 1) * PERIOD) bad++;
+  // One interrupt per call and per wrap, nothing in between
+  uint32_t irqs = sim_nvic_count(TIM3_IRQn) - i0;
+  CHECK(n1 == (int)(PULSES / PERIOD) && bad == 0);
+  CHECK(n2 == 1 && at2 == ONCE);
+  CHECK(c3.read64() == PULSES);
+  CHECK(irqs == n1 + n2 + PULSES / WRAP);
+  printf("c3: n1=%d bad=%d n2=%d at2=%llu irqs=%u count=%llu\n", n1, bad, n2, (unsigned long long)at2, irqs, (unsigned long long)c3.read64());
+  // periodic started in the past: one call, then on the grid
+  n1 = 0; c3.alarm1(callback(f1), LATE, PERIOD);
+  CHECK(n1 == 1 && at1[0] == PULSES);
+  printf("past: n1=%d at=%llu\n", n1, (unsigned long long)at1[0]);
+  sim_stimulus_pulse(&p3, PC_6, 100000, 50, PERIOD);
+  sim_run(SIM_MS(20));
+  CHECK(n1 == 2 && at1[1] == (PULSES / PERIOD + 1) * PERIOD + LATE);
+  printf("then: n1=%d at=%llu\n", n1, (unsigned long long)at1[1]);
+  // reset: alarms are counts
+  c3.reset(); c3.alarm1(callback(f1), RESET_PERIOD, RESET_PERIOD); n1 = 0;
+  sim_stimulus_pulse(&p3, PC_6, 100000, 50, 1000); sim_run(SIM_MS(20));
+  CHECK(n1 == (int)(1000 / RESET_PERIOD));
+  for (int i = 0; i < n1; i++) CHECK(at1[i] == (i + 1) * RESET_PERIOD);
+  printf("after reset: n1=%d at=%llu,%llu,%llu\n", n1, (unsigned long long)at1[0], (unsigned long long)at1[1], (unsigned long long)at1[2]);
+  c3.alarm1(NULL, 0); n1 = 0;
+  sim_stimulus_pulse(&p3, PC_6, 100000, 50, 1000); sim_run(SIM_MS(20));
+  CHECK(n1 == 0);
+  printf("removed: n1=%d\n", n1);
+  // TIM2 32-bit, re-arm from the handler
+  n2 = 0; c2.alarm2(callback(fc), REARM);
+  sim_stimulus_pulse(&p2, PA_15, 100000, 50, C2_PULSES); sim_run(SIM_MS(60));
+  CHECK(n2 == (int)(C2_PULSES / REARM) && c2.read64() == C2_PULSES);
+  printf("c2 rearm: n2=%d count=%llu\n", n2, (unsigned long long)c2.read64());
+  // TIM8 remove from handler
+  c8.alarm1(callback(f8), 10, 10);
+  sim_stimulus_pulse(&p8, PC_7, 100000, 50, 100); sim_run(SIM_MS(2));
+  CHECK(n8 == C8_CALLS && sim_nvic_count(TIM8_CC_IRQn) == (uint32_t)C8_CALLS);
+  printf("c8: n8=%d cc=%u\n", n8, sim_nvic_count(TIM8_CC_IRQn));
+}
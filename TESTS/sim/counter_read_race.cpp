@@ -0,0 +1,104 @@
+#include "sim_test.h"
+#include "counterin_api.h"
+#include "encoderin_api.h"
+// read64 from an interrupt above the update vector: first with the vector
+// held off across real wraps, then caught halfway through it. The simulator
+// runs a vector to completion, so the second part takes the update ISR's
+// steps one at a time and reads after each.
+static const uint32_t PULSE_HZ = 200000;        // 5 us a count
+static const uint32_t EDGE_HZ = 600000;
+static const uint64_t WRAP = 65536;             // TIM8 and TIM3 are 16-bit
+static const uint64_t WRAP_US = WRAP * 1000000 / PULSE_HZ;
+static const int READS = 400;                   // 0.5 us or so apart
+static const uint32_t PAST = 10;                // counts past the wrap
+counterin_t counter;                            // TIM8
+encoderin_t encoder;                            // TIM3
+
+// Which overflow slot a seq picks, as in counterin_api.c/encoderin_api.c
+static uint8_t slot(uint32_t seq) { return ((seq + 1) >> 1) & 1; }
+
+static void race() {
+  sim_stimulus_t s;
+  uint64_t last = 0;
+  counterin_start(&counter);
+  sim_stimulus_pulse(&s, PC_7, PULSE_HZ, 50, 0);
+  for (uint64_t w = 1; w <= 3; w++) {
+    sim_run_until(SIM_US(WRAP_US * w - 100));
+    for (int i = 0; i < READS; i++) {
+      sim_run(SIM_HCLK_HZ / 2000000 + (i % 7));
+      __disable_irq();
+      uint64_t c = counterin_read64(&counter);
+      __enable_irq();
+      CHECK(i == 0 || (c >= last && c <= last + 1));
+      last = c;
+    }
+    CHECK(last > WRAP * w);
+  }
+  sim_stimulus_stop(&s);
+}
+
+static void counter_preempted() {
+  sim_stimulus_t s;
+  TIM_HandleTypeDef *htim = &counter.handle;
+  uint64_t to_wrap = WRAP - counterin_read(&counter);
+
+  NVIC_DisableIRQ(TIM8_UP_TIM13_IRQn);
+  sim_stimulus_pulse(&s, PC_7, PULSE_HZ, 50, to_wrap + PAST);
+  sim_run(SIM_US((to_wrap + PAST + 1) * 1000000 / PULSE_HZ));
+  CHECK(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) != RESET);
+  CHECK(counterin_read(&counter) < PAST + 1);
+
+  uint32_t seq = counter.seq;
+  const uint64_t expect = counter.overflow[slot(seq)] + WRAP + counterin_read(&counter);
+  CHECK(counterin_read64(&counter) == expect);
+  counter.overflow[slot(seq + 2)] = counter.overflow[slot(seq)] + WRAP;
+  CHECK(counterin_read64(&counter) == expect);
+  counter.seq = seq + 1;
+  CHECK(counterin_read64(&counter) == expect);
+  __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
+  CHECK(counterin_read64(&counter) == expect);
+  counter.seq = seq + 2;
+  CHECK(counterin_read64(&counter) == expect);
+  NVIC_EnableIRQ(TIM8_UP_TIM13_IRQn);
+}
+
+// Down through zero, so the wrap is an underflow
+static void encoder_preempted() {
+  sim_stimulus_t s;
+  TIM_HandleTypeDef *htim = &encoder.handle;
+  const int64_t start = 100;
+
+  encoderin_start(&encoder);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, EDGE_HZ, start);
+  sim_run(SIM_MS(1));
+  CHECK(encoderin_read64(&encoder) == start);
+
+  NVIC_DisableIRQ(TIM3_IRQn);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, EDGE_HZ, -(start + PAST));
+  sim_run(SIM_MS(1));
+  CHECK(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) != RESET);
+  CHECK(encoderin_read(&encoder) == WRAP - PAST);
+
+  const int64_t expect = -(int64_t)PAST;
+  uint32_t seq = encoder.seq;
+  CHECK(encoder.overflow[slot(seq)] - (int64_t)WRAP + encoderin_read(&encoder) == expect);
+  CHECK(encoderin_read64(&encoder) == expect);
+  encoder.overflow[slot(seq + 2)] = encoder.overflow[slot(seq)] - (int64_t)WRAP;
+  CHECK(encoderin_read64(&encoder) == expect);
+  encoder.seq = seq + 1;
+  CHECK(encoderin_read64(&encoder) == expect);
+  __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
+  CHECK(encoderin_read64(&encoder) == expect);
+  encoder.seq = seq + 2;
+  CHECK(encoderin_read64(&encoder) == expect);
+  NVIC_EnableIRQ(TIM3_IRQn);
+}
+
+int main() {
+  counterin_init(&counter, PC_7);
+  encoderin_init(&encoder, PB_4, PB_5);
+  race();
+  counter_preempted();
+  encoder_preempted();
+  printf("ok\n");
+}
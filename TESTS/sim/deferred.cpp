@@ -0,0 +1,64 @@
+#include "sim_test.h"
+#include "EncoderAlarm.h"
+#include "TriggeredEvent.h"
+using namespace mbed;
+EncoderIn enc(PB_6, PB_7);
+EncoderAlarm al(enc);
+TriggeredTimeout tt(PA_15);
+TriggeredEvent ev(tt);
+static const uint32_t SIZE = 8, ALARMS = 3, PASSES = 6;
+DeferredEvent events[SIZE];
+DeferredQueue q(events, SIZE);
+int in_main, in_isr, a1, a2, a3, t1, e1, notes;
+static void f1(){ a1++; in_isr += !in_main; }
+static void f2(){ a2++; }
+static void f3(){ a3++; }
+static void ft(){ t1++; in_isr += !in_main; }
+static void fe(){ e1++; }
+static void note(){ notes++; }
+static void show(const DeferredEvent &e){ printf("  ev id=%s event=%u count=%lld\n", e.id==(uintptr_t)&enc?"enc":e.id==(uintptr_t)&al?"alarm":e.id==(uintptr_t)&tt?"tt":"ev", e.event, (long long)e.count); }
+int main(){
+  enc.start();
+  enc.defer(&q); tt.defer(&q); q.attach(callback(note));
+  enc.alarm1(callback(f1), 100); enc.alarm2(callback(f2), 200); al.attach(callback(f3), 300);
+  sim_stimulus_t s;
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 100000, 350);
+  sim_run(SIM_MS(5));
+  // Nothing runs in the interrupt; the note comes once, when the queue fills from empty
+  CHECK(a1 == 0 && a2 == 0 && a3 == 0 && q.pending() == ALARMS && notes == 1);
+  printf("after move: a1=%d a2=%d a3=%d pending=%u notes=%d\n", a1, a2, a3, q.pending(), notes);
+  DeferredEvent e;
+  in_main=1; while (q.pop(e)) { show(e); e.handler(e); } in_main=0;
+  CHECK(a1 == 1 && a2 == 1 && a3 == 1 && in_isr == 0);
+  printf("ran: a1=%d a2=%d a3=%d in_isr=%d\n", a1, a2, a3, in_isr);
+  // batch: dispatch with max
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 100000, -350);
+  sim_run(SIM_MS(5));
+  in_main=1;
+  uint32_t ran = q.dispatch(2);
+  CHECK(ran == 2 && q.pending() == 1 && notes == 2);
+  printf("back: pending=%u notes=%d ran=%u ", q.pending(), notes, ran);
+  ran = q.dispatch();
+  CHECK(ran == 1 && q.pending() == 0);
+  printf("then %u left %u\n", ran, q.pending()); in_main=0;
+  // overflow: 6 passes of 3 alarms = 18 events into 8
+  for (uint32_t k=0;k<PASSES/2;k++){ sim_stimulus_quadrature(&s, PB_6, PB_7, 100000, 350); sim_run(SIM_MS(5)); sim_stimulus_quadrature(&s, PB_6, PB_7, 100000, -350); sim_run(SIM_MS(5)); }
+  CHECK(q.pending() == SIZE && q.dropped() == PASSES * ALARMS - SIZE && notes == 3);
+  printf("overflow: pending=%u dropped=%u notes=%d\n", q.pending(), q.dropped(), notes);
+  in_main=1; q.dispatch(); in_main=0;
+  // triggered timeout and event
+  tt.attach_us(callback(ft), 100); ev.attach_us(callback(fe), 40);
+  sim_gpio_write(PA_15, 1); sim_run(SIM_US(10)); sim_gpio_write(PA_15, 0); sim_run(SIM_US(150));
+  tt.attach_us(Callback<void()>(), 100);
+  CHECK(t1 == 0 && e1 == 0 && q.pending() == 3);
+  printf("tt: t1=%d e1=%d pending=%u\n", t1, e1, q.pending());
+  in_main=1; while (q.pop(e)) { show(e); e.handler(e); } in_main=0;
+  // The timeout was detached before its event ran
+  CHECK(t1 == 0 && e1 == 2 && in_isr == 0 && notes == 4);
+  printf("tt ran: t1=%d e1=%d in_isr=%d notes=%d\n", t1, e1, in_isr, notes);
+  // undefer: direct again
+  enc.defer(NULL); a1=0;
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 100000, 350); sim_run(SIM_MS(5));
+  CHECK(a1 == 1 && in_isr == 1 && q.pending() == 0);
+  printf("direct: a1=%d in_isr=%d pending=%u\n", a1, in_isr, q.pending());
+}
@@ -0,0 +1,41 @@
+#include "sim_test.h"
+#include "SnapshotSampler.h"
+#include "RateMeter.h"
+#include "sim_stimulus.h"
+#include <cmath>
+using namespace mbed;
+// Three registers on TIM4 take DMA1 streams 0, 3 and 6, and a rate meter
+// needs stream 6 too: one at a time is fine, both at once is an error
+EncoderIn x(PB_4, PB_5), y(PE_9, PE_11);
+CounterIn c(PC_7);
+static const uint32_t SAMPLE_HZ = 10000, BLOCK = 10, RUN_MS = 10;
+static const uint32_t METER_HZ = 20, PULSE_HZ = 1000;
+uint32_t samples[2 * 3 * BLOCK];
+SnapshotSampler sampler(samples, BLOCK);
+RateMeter meter(c, RATE_5);
+int blocks;
+static void got(const uint32_t *b, uint32_t n) { blocks++; }
+int main() {
+    sim_stimulus_t s;
+    x.start(); y.start(); c.start();
+    sampler.add(x); sampler.add(y); sampler.add(c);
+    sampler.attach(got);
+    sim_stimulus_pulse(&s, PC_7, PULSE_HZ, 50, 0);
+    sampler.start(SAMPLE_HZ);
+    sim_run(SIM_MS(RUN_MS));
+    CHECK(blocks == (int)(SAMPLE_HZ / 1000 * RUN_MS / BLOCK));
+    sampler.stop();
+    printf("sampler blocks=%d\n", blocks);
+    meter.start(METER_HZ);
+    sim_run(SIM_MS(500));
+    meter.stop();
+    CHECK(fabs(meter.read() - PULSE_HZ) <= PULSE_HZ * 1e-4);
+    printf("meter f=%f\n", meter.read());
+    blocks = 0;
+    sampler.start(SAMPLE_HZ);
+    sim_run(SIM_MS(RUN_MS));
+    CHECK(blocks == (int)(SAMPLE_HZ / 1000 * RUN_MS / BLOCK));
+    printf("sampler again blocks=%d\n", blocks);
+    meter.start(METER_HZ);
+    printf("meter started with the sampler running\n");
+}
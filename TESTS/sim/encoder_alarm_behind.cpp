@@ -0,0 +1,38 @@
+#include "sim_test.h"
+#include "EncoderAlarm.h"
+using namespace mbed;
+EncoderIn enc(PB_6, PB_7);
+EncoderAlarm far(enc), late(enc);
+struct Rec { int n; int64_t pos[16]; char who[16]; } rec;
+static void hit(char who) { if (rec.n < 16) { rec.pos[rec.n] = enc.read64(); rec.who[rec.n++] = who; } }
+static void f1() { hit('1'); }
+static void fl() { hit('L'); }
+static void ff() { hit('F'); }
+static void dump(const char *t) { printf("%s: n=%d", t, rec.n); for (int i = 0; i < rec.n; i++) printf(" %c@%lld", rec.who[i], (long long)rec.pos[i]); printf(" pos=%lld\n", (long long)enc.read64()); rec.n = 0; }
+int main() {
+  sim_stimulus_t s;
+  enc.start();
+  // no alarms at all while it moves 0 -> 1000, then one behind it
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 600000, 1000); sim_run(SIM_MS(10));
+  enc.alarm1(callback(f1), 500);
+  sim_run(SIM_MS(1));
+  CHECK(rec.n == 0 && enc.read64() == 1000);
+  dump("alarm1 behind, no list");
+  // with an alarm far ahead that nothing reaches, 1000 -> 1200, then one behind
+  far.attach(callback(ff), 5000);
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 600000, 200); sim_run(SIM_MS(5));
+  late.attach(callback(fl), 1100);
+  sim_run(SIM_MS(1));
+  CHECK(rec.n == 0 && enc.read64() == 1200);
+  dump("late behind, far ahead");
+  // moving an alarm behind the encoder does not fire it either
+  late.move(1150);
+  sim_run(SIM_MS(1));
+  CHECK(rec.n == 0 && late.position() == 1150);
+  dump("moved behind");
+  // coming back down fires them, in the order passed
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 600000, -800); sim_run(SIM_MS(10));
+  CHECK(rec.n == 2 && enc.read64() == 400);
+  CHECK(rec.who[0] == 'L' && rec.pos[0] == 1150 && rec.who[1] == '1' && rec.pos[1] == 500);
+  dump("back to 400");
+}
@@ -0,0 +1,44 @@
+#include "sim_test.h"
+#include "EncoderAlarm.h"
+using namespace mbed;
+EncoderIn enc(PB_6, PB_7);
+struct Rec { int n; int64_t pos[64]; int id[64]; } rec;
+#define NA 40
+static const int64_t STEP = 5000, OFFSET = 7, FIRST = -10;   // alarm i at (FIRST + i) * STEP + OFFSET
+static const int64_t FORWARD = 150000, BACK = -200000, A1 = 100;
+static int64_t at(int i) { return (FIRST + i) * STEP + OFFSET; }
+EncoderAlarm *al[NA];
+struct Cb { int i; void f(){ rec.pos[rec.n]=enc.read64(); rec.id[rec.n++]=i; } } cbs[NA];
+int a1=0,a2=0; static void f1(){a1++;} static void f2(){a2++;}
+int main(){
+  enc.start();
+  for(int i=0;i<NA;i++){ cbs[i].i=i; al[i]=new EncoderAlarm(enc); al[i]->attach(callback(&cbs[i], &Cb::f), at(i)); }
+  enc.alarm1(callback(f1), A1); enc.alarm2(callback(f2), (uint32_t)-100);
+  sim_stimulus_t s;
+  // forward 150000 counts = 900000 edges
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 600000, FORWARD);
+  sim_run(SIM_MS(1600));
+  // Each alarm passed fires once, where it is, in order
+  CHECK(enc.read64() == FORWARD && rec.n == NA + FIRST && a1 == 1 && a2 == 0);
+  for(int i=0;i<rec.n;i++) CHECK(rec.id[i] == i - FIRST && rec.pos[i] == at(rec.id[i]));
+  printf("pos=%lld fired=%d a1=%d a2=%d\n",(long long)enc.read64(), rec.n, a1, a2);
+  for(int i=0;i<rec.n;i++) printf("%d@%lld ", rec.id[i], (long long)rec.pos[i]);
+  printf("\n");
+  rec.n=0;
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 600000, BACK);
+  sim_run(SIM_MS(2100));
+  // Back down past all of them and past alarm2 at -100
+  CHECK(enc.read64() == FORWARD + BACK && rec.n == NA && a1 == 2 && a2 == 1);
+  for(int i=0;i<rec.n;i++) CHECK(rec.id[i] == NA - 1 - i && rec.pos[i] == at(rec.id[i]));
+  printf("pos=%lld fired=%d a1=%d a2=%d\n",(long long)enc.read64(), rec.n, a1, a2);
+  for(int i=0;i<rec.n;i++) printf("%d@%lld ", rec.id[i], (long long)rec.pos[i]);
+  printf("\n");
+  printf("irqs=%u\n", sim_nvic_count(TIM4_IRQn));
+  // dither around alarm at 100: ±1 counts
+  rec.n=0; a1=0;
+  enc.reset(); enc.alarm2(NULL, 0);
+  for (int k=0;k<5;k++){ sim_stimulus_quadrature(&s, PB_6, PB_7, 100000, 101); sim_run(SIM_MS(8)); sim_stimulus_quadrature(&s, PB_6, PB_7, 100000, -2); sim_run(SIM_MS(1)); sim_stimulus_quadrature(&s, PB_6, PB_7, 100000, -99); sim_run(SIM_MS(8));}
+  // Through 100 twice a round
+  CHECK(a1 == 2 * 5 && enc.read64() == 0 && a2 == 1);
+  printf("dither a1=%d pos=%lld a2=%d\n", a1, (long long)enc.read64(), a2);
+}
@@ -0,0 +1,35 @@
+#include "sim_test.h"
+#include "EncoderIn.h"
+#include "CountLatch.h"
+using namespace mbed;
+static const int64_t SHORT = 1000, SHORT_BACK = -1500;       // TIM3 and TIM4
+static const int64_t LONG = 20000, LONG_BACK = -25000;       // TIM2 and TIM5
+// X2 counts half the edges X4 does
+static void check(EncoderIn &x4, EncoderIn &x2, int64_t edges) {
+    CHECK(x4.read() == edges && x4.read64() == edges);
+    CHECK(x2.read() == edges / 2 && x2.read64() == edges / 2);
+}
+int main() {
+    encoderin_config_t x2 = {15, ENC_X2};
+    EncoderIn a(PB_4, PB_5);            // TIM3 x4
+    EncoderIn b(PB_6, PB_7, x2);        // TIM4 x2
+    EncoderIn c(PA_15, PB_3);           // TIM2 32-bit x4
+    EncoderIn d(PA_0, PA_1, x2);        // TIM5 32-bit x2
+    sim_stimulus_t s1, s2, s3, s4;
+    a.start(); b.start(); c.start(); d.start();
+    sim_stimulus_quadrature(&s1, PB_4, PB_5, 100000, SHORT);
+    sim_stimulus_quadrature(&s2, PB_6, PB_7, 100000, SHORT);
+    sim_stimulus_quadrature(&s3, PA_15, PB_3, 100000, LONG);
+    sim_stimulus_quadrature(&s4, PA_0, PA_1, 100000, LONG);
+    sim_run(SIM_MS(300));
+    check(a, b, SHORT); check(c, d, LONG);
+    printf("fwd a=%d/%ld b=%d/%ld c=%d/%ld d=%d/%ld\n", a.read(), (long)a.read64(), b.read(), (long)b.read64(), c.read(), (long)c.read64(), d.read(), (long)d.read64());
+    sim_stimulus_quadrature(&s1, PB_4, PB_5, 100000, SHORT_BACK);
+    sim_stimulus_quadrature(&s2, PB_6, PB_7, 100000, SHORT_BACK);
+    sim_stimulus_quadrature(&s3, PA_15, PB_3, 100000, LONG_BACK);
+    sim_stimulus_quadrature(&s4, PA_0, PA_1, 100000, LONG_BACK);
+    sim_run(SIM_MS(600));
+    check(a, b, SHORT + SHORT_BACK); check(c, d, LONG + LONG_BACK);
+    printf("rev a=%d/%ld b=%d/%ld c=%d/%ld d=%d/%ld\n", a.read(), (long)a.read64(), b.read(), (long)b.read64(), c.read(), (long)c.read64(), d.read(), (long)d.read64());
+    return 0;
+}
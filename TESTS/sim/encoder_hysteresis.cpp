@@ -0,0 +1,32 @@
+#include "sim_test.h"
+#include "EncoderAlarm.h"
+using namespace mbed;
+EncoderIn enc(PB_6, PB_7);
+EncoderAlarm al(enc);
+int n=0; static void f(){n++;}
+sim_stimulus_t s;
+static const int DITHER = 200;
+static const uint32_t DITHER_US = DITHER * 2 * (5 + 50);   // as go() runs it
+static void go(int64_t e){ sim_stimulus_quadrature(&s, PB_6, PB_7, 200000, e); sim_run(SIM_US( (e<0?-e:e)*5 + 50)); }
+static void run(const char *name, enc_alarm_direction d, uint32_t h, uint32_t iv, int calls){
+  enc.reset(); n=0; al.min_interval_us(iv); al.attach(callback(f), 100, d, h);
+  uint32_t i0 = sim_nvic_count(TIM4_IRQn);
+  go(100);                     // 0 -> 100
+  for(int k=0;k<DITHER;k++){ go(-1); go(1); }   // dither 99/100
+  go(50);                     // -> 150
+  go(-50);                     // -> 100
+  go(-100);                    // -> 0
+  CHECK(enc.read64() == 0);
+  if (iv) CHECK(n >= (int)(DITHER_US / iv) - 1 && n <= (int)(DITHER_US / iv) + 2);
+  else CHECK(n == calls);
+  printf("%-14s calls=%d irqs=%u pos=%lld\n", name, n, sim_nvic_count(TIM4_IRQn)-i0, (long long)enc.read64());
+}
+int main(){
+  enc.start();
+  // Up to 100, back to it for every dither and once from 150
+  run("plain", ENC_ALARM_BOTH, 0, 0, 1 + DITHER + 1);
+  run("hyst20", ENC_ALARM_BOTH, 20, 0, 2);
+  run("up", ENC_ALARM_UP, 0, 0, 1 + DITHER);
+  run("up+hyst20", ENC_ALARM_UP, 20, 0, 1);
+  run("interval1ms", ENC_ALARM_BOTH, 0, 1000, 0);
+}
@@ -0,0 +1,65 @@
+#include "sim_test.h"
+#include "EncoderIn.h"
+#include "CountLatch.h"
+using namespace mbed;
+EncoderIn enc(PB_4, PB_5);      // TIM3, index on PD_2
+EncoderIn e1(PE_9, PE_11);      // TIM1, index on PE_7, re-home every index
+sim_stimulus_t s, s1;
+// 100 lines, index high for one count at count 40 of each turn (x4: 400 counts/turn)
+static const int64_t CPR = 400, INDEX_AT = 40, SLIP = 5, E1_ZERO = 3;
+static int64_t pos;             // stimulus position in counts
+// turns() floors, so the angle is always 0..CPR-1
+static void check_turns(EncoderIn &e, int64_t abs) {
+    uint32_t ang; int64_t t = e.turns(&ang);
+    int64_t turns = abs >= 0 ? abs / CPR : -((-abs + CPR - 1) / CPR);
+    CHECK(e.absolute() == abs && t == turns && ang == abs - turns * CPR);
+}
+static void step(PinName a, PinName b, PinName z, int64_t &p, int dir, int64_t zero) {
+    p += dir;
+    int ph = (int)(((p % 4) + 4) % 4);
+    static const int A[4] = {0,1,1,0}, B[4] = {0,0,1,1};
+    sim_gpio_write(a, A[ph]); sim_gpio_write(b, B[ph]);
+    int64_t m = (((p - zero) % CPR) + CPR) % CPR;
+    sim_gpio_write(z, m == INDEX_AT);
+    sim_run(SIM_US(10));
+}
+int main() {
+    enc.start(); e1.start();
+    enc.index(PD_2, CPR);
+    e1.index(PE_7);
+    int64_t p1 = 0;
+    printf("homed=%d abs=%ld\n", enc.homed(), (long)enc.absolute());
+    for (int i = 0; i < 30; i++) { step(PB_4, PB_5, PD_2, pos, 1, 0); step(PE_9, PE_11, PE_7, p1, 1, 0); }
+    CHECK(!enc.homed() && enc.read64() == 30 && enc.absolute() == 30);
+    printf("before: homed=%d read64=%ld abs=%ld\n", enc.homed(), (long)enc.read64(), (long)enc.absolute());
+    for (int i = 0; i < 20; i++) { step(PB_4, PB_5, PD_2, pos, 1, 0); step(PE_9, PE_11, PE_7, p1, 1, 0); }
+    CHECK(enc.homed() && enc.read64() == pos);
+    check_turns(enc, pos - INDEX_AT);
+    CHECK(e1.absolute() == p1 - INDEX_AT);
+    uint32_t ang; int64_t t = enc.turns(&ang);
+    printf("after: homed=%d read64=%ld abs=%ld turns=%ld angle=%u e1 abs=%ld\n", enc.homed(), (long)enc.read64(), (long)enc.absolute(), (long)t, ang, (long)e1.absolute());
+    for (int i = 0; i < 20000; i++) step(PB_4, PB_5, PD_2, pos, 1, 0);   // 250 turns, through wraps
+    check_turns(enc, pos - INDEX_AT);
+    CHECK(enc.read64() == pos && enc.slips() == 0);
+    t = enc.turns(&ang);
+    printf("fwd: read64=%ld abs=%ld turns=%ld angle=%u slips=%u\n", (long)enc.read64(), (long)enc.absolute(), (long)t, ang, enc.slips());
+    for (int i = 0; i < 26000; i++) step(PB_4, PB_5, PD_2, pos, -1, 0);
+    check_turns(enc, pos - INDEX_AT);
+    CHECK(enc.read64() == pos && enc.slips() == 0);
+    t = enc.turns(&ang);
+    printf("rev: read64=%ld abs=%ld turns=%ld angle=%u slips=%u\n", (long)enc.read64(), (long)enc.absolute(), (long)t, ang, enc.slips());
+    // dither over the index
+    for (int k = 0; k < 200; k++) { step(PB_4, PB_5, PD_2, pos, (k & 1) ? -1 : 1, 0); }
+    // lose 5 counts: move the stimulus index zero
+    for (int i = 0; i < 2000; i++) step(PB_4, PB_5, PD_2, pos, 1, SLIP);
+    check_turns(enc, pos - INDEX_AT - SLIP);
+    CHECK(enc.slips() == 1);
+    t = enc.turns(&ang);
+    printf("slip: abs=%ld (expect %ld) turns=%ld angle=%u slips=%u\n", (long)enc.absolute(), (long)(pos - INDEX_AT - SLIP), (long)t, ang, enc.slips());
+    // e1 re-homes each index
+    for (int i = 0; i < 1000; i++) step(PE_9, PE_11, PE_7, p1, 1, E1_ZERO);
+    CHECK(e1.absolute() == ((p1 - INDEX_AT - E1_ZERO) % CPR + CPR) % CPR);
+    printf("e1: read64=%ld abs=%ld (expect %ld)\n", (long)e1.read64(), (long)e1.absolute(), (long)(((p1 - INDEX_AT - E1_ZERO) % CPR + CPR) % CPR));
+    CountLatch latch;
+    latch.add(enc);
+}
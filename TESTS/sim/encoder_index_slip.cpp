@@ -0,0 +1,32 @@
+#define protected public
+#include "sim_test.h"
+#include "EncoderIn.h"
+using namespace mbed;
+EncoderIn enc(PB_4, PB_5);
+static const int64_t CPR = 400, INDEX_AT = 40, SLIP = 5;
+static int64_t pos;
+static void step(int dir, int64_t zero) {
+    pos += dir;
+    int ph = (int)(((pos % 4) + 4) % 4);
+    static const int A[4] = {0,1,1,0}, B[4] = {0,0,1,1};
+    sim_gpio_write(PB_4, A[ph]); sim_gpio_write(PB_5, B[ph]);
+    int64_t m = (((pos - zero) % CPR) + CPR) % CPR;
+    sim_gpio_write(PD_2, m == INDEX_AT);
+    sim_run(SIM_US(10));
+}
+// The first index after the slip moves home by SLIP and counts one slip;
+// coming back over the indexes does not count it again
+static bool slipped;
+static void show(int64_t zero) {
+    slipped = slipped || (zero && pos >= 3 * CPR + INDEX_AT + SLIP);
+    const int64_t home = slipped ? INDEX_AT + SLIP : INDEX_AT;
+    CHECK(enc._encoder.index_home == home && enc.absolute() == pos - home && enc.slips() == (slipped ? 1u : 0u));
+    printf("pos=%ld home=%ld abs=%ld ccr=%lu slips=%u\n", (long)pos, (long)enc._encoder.index_home, (long)enc.absolute(), (unsigned long)TIM3->CCR1, enc.slips());
+}
+int main() {
+    enc.start();
+    enc.index(PD_2, CPR);
+    for (int i = 0; i < 1000; i++) { step(1, 0); if (i % 100 == 99) show(0); }
+    for (int i = 0; i < 1000; i++) { step(1, SLIP); if (i % 100 == 99) show(SLIP); }
+    for (int i = 0; i < 1000; i++) { step(-1, SLIP); if (i % 100 == 99) show(SLIP); }
+}
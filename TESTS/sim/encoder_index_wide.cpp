@@ -0,0 +1,40 @@
+#define protected public
+#include "sim_test.h"
+#include "EncoderIn.h"
+using namespace mbed;
+// An ungated index is high for a whole quadrature cycle, 4 counts in X4, so
+// crossing it the other way captures on its far edge
+EncoderIn enc(PB_4, PB_5);
+static const int64_t CPR = 400, INDEX_AT = 40, WIDE = 4, SLIP = 2;
+static int64_t pos;
+static void step(int dir, int64_t zero) {
+    pos += dir;
+    int ph = (int)(((pos % 4) + 4) % 4);
+    static const int A[4] = {0,1,1,0}, B[4] = {0,0,1,1};
+    sim_gpio_write(PB_4, A[ph]); sim_gpio_write(PB_5, B[ph]);
+    int64_t m = (((pos - zero) % CPR) + CPR) % CPR;
+    sim_gpio_write(PD_2, m >= INDEX_AT && m < INDEX_AT + WIDE);
+    sim_run(SIM_US(10));
+}
+static void show() { printf("pos=%ld home=%ld abs=%ld ccr=%lu slips=%u\n", (long)pos, (long)enc._encoder.index_home, (long)enc.absolute(), (unsigned long)TIM3->CCR1, enc.slips()); }
+static void go(int dir, int n, int64_t zero, uint32_t slips) {
+    for (int i = 0; i < n; i++) step(dir, zero);
+    const int64_t home = INDEX_AT + (slips ? SLIP : 0);
+    CHECK(enc._encoder.index_home == home && enc.absolute() == pos - home && enc.slips() == slips);
+    show();
+}
+int main() {
+    enc.start();
+    enc.index(PD_2, CPR);
+    go(1, 1000, 0, 0);
+    // back and forth over the index, turning on it and well clear of it
+    go(-1, 600, 0, 0);
+    go(1, 442, 0, 0);
+    go(-1, 2, 0, 0);
+    go(1, 200, 0, 0);
+    go(-1, 700, 0, 0);
+    // the index moves 2 counts on: a slip, crossed either way
+    go(1, 600, SLIP, 1);
+    go(-1, 600, SLIP, 1);
+    go(1, 600, SLIP, 1);
+}
@@ -0,0 +1,38 @@
+#include "sim_test.h"
+#include "EncoderIn.h"
+#include "timers.h"
+#include <new>
+using namespace mbed;
+// EncoderIn keeps its timer for good, so hand it back before the next run
+// sets the same timer up again
+struct Encoder : EncoderIn {
+  Encoder(PinName a, PinName b, encoderin_config_t c) : EncoderIn(a, b, c) {}
+  void release() { timer_release(&_encoder.handle); }
+};
+static char buf[8][sizeof(Encoder)] __attribute__((aligned(8))); static int k;
+static Encoder *e;
+static uint32_t at, entry, n;
+static void f(){ at = DWT->CYCCNT; entry = e->irq_cycles(); n++; }
+// The input filter holds the edge back, in clocks of the timer's own bus
+static void run(PinName a, PinName b, uint8_t filt, const char* name, sim_time_t tick){
+  sim_reset();
+  CoreDebug->DEMCR |= CoreDebug_DEMCR_TRCENA_Msk;
+  DWT->CTRL |= DWT_CTRL_CYCCNTENA_Msk;
+  encoderin_config_t c = {filt, ENC_X4};
+  Encoder &enc = *new (buf[k++]) Encoder(a, b, c); e=&enc;
+  enc.start(); n=0;
+  enc.alarm1(callback(f), 100);
+  sim_stimulus_t s;
+  uint32_t t0 = (uint32_t)sim_now();
+  sim_stimulus_quadrature(&s, a, b, 100000, 150);
+  sim_run(SIM_MS(3));
+  uint32_t edge = t0 + 100 * (SIM_HCLK_HZ/100000);
+  printf("%s filter %u: n=%u edge->entry %d cycles, entry->callback %u cycles\n", name, filt, n, (int)(entry - edge), at - entry);
+  CHECK(n == 1 && entry - edge == (filt ? FILTER_15 : 1) * tick);
+  enc.release();
+}
+int main(){
+  run(PE_9, PE_11, 15, "TIM1", TICK_APB2); run(PE_9, PE_11, 0, "TIM1", TICK_APB2);
+  run(PB_6, PB_7, 15, "TIM4", TICK_APB1); run(PB_6, PB_7, 0, "TIM4", TICK_APB1);
+  run(PA_0, PA_1, 15, "TIM5", TICK_APB1); run(PA_0, PA_1, 0, "TIM5", TICK_APB1);
+}
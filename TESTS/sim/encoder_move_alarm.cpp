@@ -0,0 +1,20 @@
+#include "sim_test.h"
+#include "EncoderAlarm.h"
+using namespace mbed;
+EncoderIn enc(PB_6, PB_7);
+EncoderAlarm step(enc), other1(enc), other2(enc);
+static const int64_t STRIDE = 10, END = 5000;
+int n=0; int64_t last[2000];
+static void nop(){}
+static void f(){ last[n++] = enc.read64(); step.move(step.position() + STRIDE); }
+int main(){
+  enc.start();
+  other1.attach(callback(nop), 55); other2.attach(callback(nop), 3000);
+  step.attach(callback(f), STRIDE, ENC_ALARM_UP);
+  sim_stimulus_t s;
+  sim_stimulus_quadrature(&s, PB_6, PB_7, 600000, END);
+  sim_run(SIM_MS(60));
+  int ok=1; for(int i=0;i<n;i++) if(last[i]!=STRIDE*(i+1)) { ok=0; printf("bad %d %lld\n", i, (long long)last[i]); break; }
+  CHECK(n == END / STRIDE && ok && enc.read64() == END && step.position() == END + STRIDE);
+  printf("n=%d ok=%d pos=%lld step=%lld irqs=%u\n", n, ok, (long long)enc.read64(), (long long)step.position(), sim_nvic_count(TIM4_IRQn));
+}
@@ -0,0 +1,17 @@
+#include "sim_test.h"
+#include "EncoderIn.h"
+using namespace mbed;
+EncoderIn e3(PB_4, PB_5);
+EncoderIn e4(PB_6, PB_7);
+static const int64_t AT3 = 50, AT4 = 100, MOVE3 = 600, MOVE4 = 1200;
+int a3=0,a4=0; static void f3(){a3++;} static void f4(){a4++;}
+int main(){
+  e3.start(); e4.start();
+  e3.alarm1(callback(f3), AT3); e4.alarm1(callback(f4), AT4);
+  sim_stimulus_t s3,s4;
+  sim_stimulus_quadrature(&s3, PB_4, PB_5, 100000, MOVE3);
+  sim_stimulus_quadrature(&s4, PB_6, PB_7, 50000, MOVE4);
+  sim_run(SIM_MS(40));
+  CHECK(e3.read() == MOVE3 && e4.read() == MOVE4 && a3 == 1 && a4 == 1);
+  printf("e3=%d e4=%d a3=%d a4=%d\n", e3.read(), e4.read(), a3, a4);
+}
@@ -0,0 +1,101 @@
+#include "sim_test.h"
+#include "EncoderOut.h"
+#include "EncoderAlarm.h"
+using namespace mbed;
+EncoderIn enc(PB_4, PB_5);      // TIM3, 16-bit
+EncoderOut cam(enc, PB_0);      // CH3
+EncoderOut las(enc, PC_9, true);// CH4, active low
+EncoderIn enc2(PA_15, PB_3);    // TIM2, 32-bit
+EncoderOut o2(enc2, PA_2);      // TIM2 CH3
+struct Ed { int n; int64_t pos[64]; int lvl[64]; } ed, ed2, ed3;
+static void watch(void *ctx, int pin, int level, sim_time_t when) {
+  Ed *e=(Ed*)ctx; EncoderIn *q = (e==&ed3)? &enc2 : &enc;
+  if (e->n<64){ e->pos[e->n]=q->read64(); e->lvl[e->n++]=level; }
+}
+// n edges at the positions given, alternating from the level given
+static void expect(Ed &e, int level, const int64_t *at, int n) {
+  CHECK(e.n == n);
+  for (int i = 0; i < n; i++) CHECK(e.pos[i] == at[i] && e.lvl[i] == (level ^ (i & 1)));
+}
+static void dump(const char*t, Ed&e){ printf("%s:", t); for(int i=0;i<e.n;i++) printf(" %d@%lld", e.lvl[i], (long long)e.pos[i]); printf("\n"); e.n=0; }
+int done=0; static void fdone(){ done++; }
+const uint32_t frames[] = {1000, 1010, 1500, 1510, 2000, 2010, 2010};
+const uint32_t ring[] = {100, 200, 300, 400};
+static const int64_t WRAP = 65536, WIDTH_UP = 5, WIDTH_DOWN = -8;
+static const int64_t AT_SET[] = {300}, AT_LAS[] = {0, 400};
+static const int64_t AT_FRAMES[] = {1000, 1010, 1500, 1510, 2000, 2010};
+static const int64_t AT_UP[] = {1200, 1200 + WIDTH_UP}, AT_DOWN[] = {900, 900 + WIDTH_DOWN};
+static const int64_t AT_RING[] = {100, 200, 300, 400, WRAP + 100, WRAP + 200, WRAP + 300, WRAP + 400,
+                                  2 * WRAP + 100, 2 * WRAP + 200, 2 * WRAP + 300, 2 * WRAP + 400};
+static const int64_t AT_TIM2[] = {50};
+uint32_t big[] = {0x12345678u, 0x12345680u, 0x12345690u};
+int main(){
+  sim_gpio_watch(PB_0, watch, &ed);
+  sim_gpio_watch(PC_9, watch, &ed2);
+  sim_gpio_watch(PA_2, watch, &ed3);
+  printf("init levels cam=%d las=%d\n", sim_gpio_read(PB_0), sim_gpio_read(PC_9));
+  enc.start(); enc2.start();
+  sim_stimulus_t s;
+  // single compare set at 300, reset on las at 400 after forcing active
+  cam.compare(300, ENC_OUT_SET);
+  las = 1; las.compare(400, ENC_OUT_RESET);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, 600000, 500); sim_run(SIM_MS(5));
+  expect(ed, 1, AT_SET, 1); expect(ed2, 0, AT_LAS, 2);
+  dump("cam set@300", ed); dump("las", ed2);
+  // table of frames, with done callback
+  cam.write(0); ed.n=0;
+  cam.attach(callback(fdone));
+  cam.table(frames, 7);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, 600000, 2500); sim_run(SIM_MS(20));
+  // The last entry only ends the table
+  expect(ed, 1, AT_FRAMES, 6); CHECK(done == 1 && enc.read64() == 3000);
+  dump("frames", ed); printf("done=%d pos=%lld\n", done, (long long)enc.read64());
+  // come back through the table: nothing should happen (frozen)
+  sim_stimulus_quadrature(&s, PB_4, PB_5, 600000, -2000); sim_run(SIM_MS(20));
+  expect(ed, 1, NULL, 0);
+  dump("back", ed);
+  // pulse forward at 1200 width 5, and again going down (negative width)
+  done=0;
+  cam.pulse(AT_UP[0], WIDTH_UP);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, 600000, 1000); sim_run(SIM_MS(10));
+  expect(ed, 1, AT_UP, 2); CHECK(done == 1);
+  dump("pulse up", ed); printf("done=%d\n", done);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, 600000, -1000); sim_run(SIM_MS(10));
+  expect(ed, 1, NULL, 0);
+  dump("back over pulse", ed);
+  cam.pulse(AT_DOWN[0], WIDTH_DOWN);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, 600000, -500); sim_run(SIM_MS(10));
+  expect(ed, 1, AT_DOWN, 2); CHECK(done == 2 && enc.read64() == 500);
+  dump("pulse down", ed); printf("done=%d pos=%lld\n", done, (long long)enc.read64());
+  // ring, repeating toggle, go across 2 wraps of a 16-bit timer (131072 counts)
+  done=0; enc.reset();
+  cam.write(0); ed.n=0;
+  cam.table(ring, 4, ENC_OUT_TOGGLE, true);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, 600000, 2 * WRAP + 500); sim_run(SIM_MS(500));
+  // Once round the table every wrap, the function called each lap
+  expect(ed, 1, AT_RING, 12); CHECK(done == 3);
+  dump("ring", ed); printf("done=%d\n", done);
+  // 32-bit table
+  o2.table(big, 3, ENC_OUT_TOGGLE);
+  // jump enc2 near: use reset? count from 0 is too far; use compare at int64 beyond 32 bits instead
+  o2.compare(((int64_t)1<<32) + 50, ENC_OUT_TOGGLE);
+  sim_stimulus_quadrature(&s, PA_15, PB_3, 600000, 100); sim_run(SIM_MS(5));
+  expect(ed3, 1, AT_TIM2, 1);
+  dump("tim2 compare@50 (low bits)", ed3);
+  // defer through a queue
+  static DeferredEvent events[8];
+  static DeferredQueue queue(events, 8);
+  DeferredQueue *q = &queue;
+  enc.defer(q); done=0;
+  const int64_t at[] = {enc.read64() + 10, enc.read64() + 13};
+  cam.pulse(at[0], at[1] - at[0]);
+  sim_stimulus_quadrature(&s, PB_4, PB_5, 600000, 20); sim_run(SIM_MS(2));
+  CHECK(q->pending() == 1 && done == 0);
+  printf("deferred pending=%u done=%d\n", q->pending(), done); q->dispatch(); printf("after dispatch done=%d\n", done);
+  CHECK(done == 1); expect(ed, 1, at, 2);
+  dump("deferred pulse", ed);
+  // alarms refused: expect error
+  EncoderAlarm al(enc);
+  al.attach(callback(fdone), 5);
+  printf("not reached\n");
+}
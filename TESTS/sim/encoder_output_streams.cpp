@@ -0,0 +1,30 @@
+#include "sim_test.h"
+#include "EncoderOut.h"
+using namespace mbed;
+// TIM3 CH3 and TIM2 CH4 tables both go through DMA1 stream 7
+EncoderIn enc3(PB_4, PB_5);
+EncoderOut out3(enc3, PB_0);        // TIM3 CH3
+EncoderIn enc2(PA_15, PB_3);
+EncoderOut out2(enc2, PA_3);        // TIM2 CH4
+const uint32_t table[] = {100, 200, 300};
+static const int TOGGLES = 3 - 1;       // the last entry only ends the table
+int edges3, edges2;
+static void watch(void *ctx, int pin, int level, sim_time_t when) { (*(int*)ctx)++; }
+int main() {
+    sim_stimulus_t s3, s2;
+    sim_gpio_watch(PB_0, watch, &edges3);
+    sim_gpio_watch(PA_3, watch, &edges2);
+    enc3.start(); enc2.start();
+    out3.table(table, 3, ENC_OUT_TOGGLE);
+    sim_stimulus_quadrature(&s3, PB_4, PB_5, 600000, 400); sim_run(SIM_MS(5));
+    CHECK(edges3 == TOGGLES);
+    printf("tim3 table edges=%d\n", edges3);
+    // done with it, but the stream is only let go by write()
+    out3.write(0);
+    out2.table(table, 3, ENC_OUT_TOGGLE);
+    sim_stimulus_quadrature(&s2, PA_15, PB_3, 600000, 400); sim_run(SIM_MS(5));
+    CHECK(edges2 == TOGGLES);
+    printf("tim2 table edges=%d\n", edges2);
+    out3.table(table, 3, ENC_OUT_TOGGLE);
+    printf("not reached\n");
+}
@@ -0,0 +1,19 @@
+#include "sim_test.h"
+#include "EncoderOut.h"
+using namespace mbed;
+EncoderIn enc(PE_9, PE_11);
+EncoderOut a(enc, PE_13);
+EncoderOut b(enc, PA_11);
+static const int64_t A_AT = 100, B_AT = 102, WIDTH = 4;
+int n=0;
+static void w(void*, int pin, int level, sim_time_t){
+  const int64_t at = pin == PE_13 ? A_AT : B_AT;
+  CHECK(enc.read64() == (level ? at : at + WIDTH)); n++;
+  printf("pin%d=%d@%lld\n", pin==PE_13?3:4, level, (long long)enc.read64()); }
+int main(){
+  sim_gpio_watch(PE_13, w, 0); sim_gpio_watch(PA_11, w, 0);
+  enc.start();
+  a.pulse(A_AT, WIDTH); b.pulse(B_AT, WIDTH);
+  sim_stimulus_t s; sim_stimulus_quadrature(&s, PE_9, PE_11, 600000, 200); sim_run(SIM_MS(5));
+  CHECK(n == 4);
+}
@@ -0,0 +1,12 @@
+#include "sim_test.h"
+#include "EncoderIn.h"
+#include "TriggeredTimeout.h"
+using namespace mbed;
+// PA_0 is TIM5 channel 1 for an encoder and for a triggered timeout, and
+// TIM5 can only be one of them
+TriggeredTimeout tt5(PA_0);
+int main() {
+    printf("timeout on TIM5\n");
+    EncoderIn qei(PA_0, PA_1);
+    printf("encoder on TIM5 too\n");
+}
@@ -0,0 +1,40 @@
+#include "sim_test.h"
+#include "FrequencyMeter.h"
+#include "sim_stimulus.h"
+#include <cmath>
+using namespace mbed;
+CounterIn c(PC_6);
+FrequencyMeter meter(c);
+static const uint32_t SAMPLE_HZ = 100;
+static const uint64_t WINDOW_NS = 1000000000 / SAMPLE_HZ;
+static const double HZ = 123457, SLOW_HZ = 50000;
+int calls; uint32_t lastc;
+static void got(uint32_t n) { calls++; lastc = n; }
+int main() {
+    sim_stimulus_t s;
+    c.start();
+    meter.attach(got);
+    sim_stimulus_pulse(&s, PC_6, HZ, 50, 0);
+    meter.start(SAMPLE_HZ);
+    // A whole number of ticks of a 16-bit reference timer
+    CHECK_NEAR(meter.window_ns(), WINDOW_NS, WINDOW_NS / 65536 + 1);
+    printf("window_ns=%llu\n", (unsigned long long)meter.window_ns());
+    sim_run(SIM_MS(5));
+    CHECK(calls == 0 && meter.read() == 0);
+    printf("after 5ms calls=%d f=%f\n", calls, meter.read());
+    sim_run(SIM_MS(100));
+    // No estimate until a window has closed, then one count is SAMPLE_HZ
+    CHECK(calls == (int)(105 * SAMPLE_HZ / 1000) - 1 && lastc == meter.count());
+    CHECK_NEAR(meter.count(), HZ * meter.window_ns() / 1e9, 1);
+    CHECK(fabs(meter.read() - HZ) <= SAMPLE_HZ);
+    printf("calls=%d count=%u f=%f last=%u\n", calls, meter.count(), meter.read(), lastc);
+    sim_stimulus_stop(&s);
+    sim_stimulus_pulse(&s, PC_6, SLOW_HZ, 50, 0);
+    sim_run(SIM_MS(30));
+    CHECK_NEAR(meter.count(), SLOW_HZ / SAMPLE_HZ, 1);
+    CHECK(fabs(meter.read() - SLOW_HZ) <= SAMPLE_HZ);
+    printf("50k: count=%u f=%f\n", meter.count(), meter.read());
+    meter.stop(); int cc = calls; sim_run(SIM_MS(30));
+    CHECK(calls == cc && sim_nvic_count(TIM3_IRQn) == 0);
+    printf("stopped calls+%d irq3=%u\n", calls - cc, sim_nvic_count(TIM3_IRQn));
+}
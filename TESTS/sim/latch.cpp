@@ -0,0 +1,44 @@
+#include "sim_test.h"
+#include "CountLatch.h"
+#include "sim_stimulus.h"
+using namespace mbed;
+// A pin latch is taken at the edge, 30 ns before the counters are read, so
+// an edge in between leaves one of them a count out
+EncoderIn x(PB_4, PB_5), y(PE_9, PE_11), z(PB_6, PB_7);
+CountLatch latch(PD_2);
+int main() {
+    sim_stimulus_t sx, sy, sz;
+    x.start(); y.start(); z.start();
+    int a0 = latch.add(x), a1 = latch.add(y), a2 = latch.add(z); CHECK(a0 == 0 && a1 == 1 && a2 == 2); printf("add %d %d %d\n", a0, a1, a2);
+    sim_stimulus_quadrature(&sx, PB_4, PB_5, 200000, 0);
+    sim_stimulus_quadrature(&sy, PE_9, PE_11, 150000, -100000000);
+    sim_stimulus_quadrature(&sz, PB_6, PB_7, 100000, 0);
+    int64_t p[3]; int far = 0;
+    CHECK(!latch.read(p));
+    printf("empty read %d\n", latch.read(p));
+    int bad = 0;
+    for (int k = 0; k < 200; k++) {
+        sim_run(SIM_US(37));
+        int64_t rx = x.read64(), ry = y.read64(), rz = z.read64();
+        latch.trigger();
+        sim_run(SIM_US(60));
+        if (!latch.read(p) || p[0] != rx || p[1] != ry || p[2] != rz) { if (bad < 5) printf("k=%d %ld/%ld %ld/%ld %ld/%ld\n", k, p[0], rx, p[1], ry, p[2], rz); bad++; }
+        if (latch.read(p)) bad += 100;
+    }
+    CHECK(bad == 0);
+    printf("sw bad=%d last %ld %ld %ld\n", bad, p[0], p[1], p[2]);
+    bad = 0;
+    for (int k = 0; k < 200; k++) {
+        sim_run(SIM_US(41));
+        sim_gpio_write(PD_2, 1);
+        sim_run(SIM_NS(30));
+        int64_t rx = x.read64(), ry = y.read64(), rz = z.read64();
+        sim_run(SIM_US(60));
+        sim_gpio_write(PD_2, 0);
+        if (!latch.read(p) || p[0] != rx || p[1] != ry || p[2] != rz) { if (bad < 5) printf("k=%d %ld/%ld %ld/%ld %ld/%ld\n", k, p[0], rx, p[1], ry, p[2], rz); bad++; }
+        const int64_t r[3] = {rx, ry, rz};
+        for (int i = 0; i < 3; i++) far += p[i] < r[i] - 1 || p[i] > r[i] + 1;
+    }
+    CHECK(far == 0);
+    printf("pin bad=%d last %ld %ld %ld\n", bad, p[0], p[1], p[2]);
+}
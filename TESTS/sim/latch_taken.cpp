@@ -0,0 +1,12 @@
+#include "sim_test.h"
+#include "CountLatch.h"
+using namespace mbed;
+// An encoder at the head of one latch pulses TRGO from CC1, so a second
+// latch cannot have it
+EncoderIn x(PB_4, PB_5);
+CountLatch first, second;
+int main() {
+    x.start();
+    printf("first add %d\n", first.add(x));
+    printf("second add %d\n", second.add(x));
+}
@@ -0,0 +1,29 @@
+#include "sim_test.h"
+#include "CounterIn.h"
+#include "EncoderIn.h"
+using namespace mbed;
+CounterIn counter(PC_7);
+EncoderIn enc(PB_6, PB_7);
+static const uint64_t PULSES = 150000;          // over two TIM8 wraps
+static const int64_t FORWARD = 1200000, BACK = -1800000;
+static const int64_t WRAP = 65536;
+int main(){
+  sim_stimulus_t s1, s2;
+  counter.start(); enc.start();
+  sim_stimulus_pulse(&s1, PC_7, 200000, 50, PULSES);
+  sim_stimulus_quadrature(&s2, PB_6, PB_7, 240000, FORWARD);
+  uint64_t last=0; int mono=1; int64_t minp=0;
+  for (int i=0;i<5100;i++){ sim_run(SIM_US(997)); uint64_t c=counter.read64(); if(c<last) mono=0; last=c; }
+  CHECK(counter.read64() == PULSES && counter.read() == PULSES % WRAP && mono);
+  CHECK(enc.read64() == FORWARD && enc.read() == (int16_t)(FORWARD % WRAP));
+  printf("count64=%llu raw=%u mono=%d\n",(unsigned long long)counter.read64(), counter.read(), mono);
+  printf("pos64=%lld raw=%d\n",(long long)enc.read64(), enc.read());
+  sim_stimulus_quadrature(&s2, PB_6, PB_7, 240000, BACK);
+  for (int i=0;i<7600;i++){ sim_run(SIM_US(1003)); int64_t p=enc.read64(); if(p<minp)minp=p; }
+  CHECK(enc.read64() == FORWARD + BACK && minp == FORWARD + BACK);
+  CHECK(enc.read() == (int16_t)((FORWARD + BACK) % WRAP));
+  printf("pos64=%lld raw=%d min=%lld\n",(long long)enc.read64(), enc.read(), (long long)minp);
+  counter.reset(); enc.reset();
+  CHECK(counter.read64() == 0 && enc.read64() == 0);
+  printf("after reset %llu %lld\n",(unsigned long long)counter.read64(),(long long)enc.read64());
+}
@@ -0,0 +1,81 @@
+#include "sim_test.h"
+#include "RateMeter.h"
+#include "sim_stimulus.h"
+#include <cmath>
+using namespace mbed;
+CounterIn c(PC_6);
+CounterIn c8(PC_7);
+RateMeter meter(c);
+RateMeter meter8(c8, RATE_5);
+static const uint32_t SAMPLE_HZ = 10, SAMPLE8_HZ = 20;
+static const uint32_t UP_HZ = 20000, DOWN_HZ = 10000;   // start() defaults
+static const double MIN_HZ = 0.1;
+static const double COUNT_HZ = SAMPLE_HZ;               // one edge a window
+static const double TIMED = 1e-4;                       // a few reference ticks
+static const double SLOW_S = 4;                         // one edge every 4 s
+int calls; float lastf;
+static uint32_t ms;                                     // run since start()
+static void got(float f) { calls++; lastf = f; }
+static void run(uint32_t t) { sim_run(SIM_MS(t)); ms += t; }
+static void show(const char *what, RateMeter &m) { printf("%-12s f=%f %s irq4=%u irq5=%u\n", what, m.read(), m.counting() ? "count" : "period", sim_nvic_count(TIM4_IRQn), sim_nvic_count(TIM5_IRQn)); }
+static void counted(RateMeter &m, double hz) { CHECK(m.counting() && fabs(m.read() - hz) <= COUNT_HZ); }
+static void timed(RateMeter &m, double hz) { CHECK(!m.counting() && fabs(m.read() - hz) <= hz * TIMED); }
+int main() {
+    sim_stimulus_t s, s8;
+    c.start(); c8.start();
+    meter.attach(got);
+    printf("start\n"); fflush(stdout); printf("window_ns=%llu\n", (unsigned long long)meter.window_ns()); fflush(stdout);
+    sim_stimulus_pulse(&s, PC_6, 123457, 50, 0);
+    meter.start(SAMPLE_HZ);
+    run(350); show("123457", meter);
+    counted(meter, 123457);
+    CHECK(sim_nvic_count(TIM4_IRQn) == 350 * SAMPLE_HZ / 1000);  // windows only
+    sim_stimulus_stop(&s);
+    sim_stimulus_pulse(&s, PC_6, 1234, 50, 0);
+    run(500); show("1234.5", meter);
+    timed(meter, 1234);
+    sim_stimulus_stop(&s);
+    sim_stimulus_pulse(&s, PC_6, 7, 50, 0);
+    run(1000); show("7.3", meter);
+    timed(meter, 7);
+    sim_stimulus_stop(&s);
+    for (int i = 0; i < 3; i++) { sim_gpio_write(PC_6, 1); run(SLOW_S * 1000 / 2); sim_gpio_write(PC_6, 0); run(SLOW_S * 1000 / 2); }
+    show("0.25", meter);
+    timed(meter, 1 / SLOW_S);
+    // No edge: one edge over the time since the last, then 0 after 1 / min_hz
+    run(1000); show("0.25 +1s", meter);
+    CHECK(meter.read() >= 1 / (SLOW_S + 1) && meter.read() < 1 / (SLOW_S + 1 - 1.0 / SAMPLE_HZ));
+    run(6000); show("0.25 +7s", meter);
+    CHECK(meter.read() == 0);
+    sim_gpio_write(PC_6, 1); run(150); show("edge after 11s", meter); sim_gpio_write(PC_6, 0);
+    timed(meter, 1 / (SLOW_S + 7));
+    CHECK(SLOW_S + 7 > 1 / MIN_HZ);
+    // Up takes more than UP_HZ, down less than DOWN_HZ
+    sim_stimulus_pulse(&s, PC_6, 15000, 50, 0);
+    run(500); show("15000 (hyst)", meter);
+    timed(meter, 15000);
+    sim_stimulus_stop(&s);
+    sim_stimulus_pulse(&s, PC_6, 25000, 50, 0);
+    run(500); show("25000", meter);
+    counted(meter, 25000);
+    sim_stimulus_stop(&s);
+    uint32_t i4 = sim_nvic_count(TIM4_IRQn);
+    sim_stimulus_pulse(&s, PC_6, 15000, 50, 0);
+    run(500); show("15000 (hyst)", meter);
+    counted(meter, 15000);
+    CHECK(sim_nvic_count(TIM4_IRQn) - i4 == 500 * SAMPLE_HZ / 1000);
+    CHECK(15000 > DOWN_HZ && 15000 < UP_HZ);
+    sim_stimulus_stop(&s);
+    run(500); show("stopped .5s", meter);
+    CHECK(!meter.counting() && meter.read() >= 1 / 0.5 && meter.read() <= 1 / (0.5 - 1.0 / SAMPLE_HZ) * (1 + TIMED));
+    run(11000); show("stopped 11s", meter);
+    CHECK(meter.read() == 0);
+    printf("calls=%d last=%f count=%u\n", calls, lastf, c.read());
+    // Every window but the first has an estimate
+    CHECK(calls == (int)(ms * SAMPLE_HZ / 1000) - 1 && lastf == 0);
+    meter.stop();   // both rate meters latch through DMA1 stream 6
+    sim_stimulus_pulse(&s8, PC_7, 333, 50, 0);
+    meter8.start(SAMPLE8_HZ);
+    sim_run(SIM_MS(500)); show("tim8 333.3", meter8);
+    timed(meter8, 333);
+}
@@ -0,0 +1,13 @@
+#include "sim_test.h"
+#include "RateMeter.h"
+#include "SnapshotSampler.h"
+using namespace mbed;
+// TIM4 is the default reference timer of a sampler and of a rate meter
+CounterIn c(PC_7);
+uint32_t samples[2 * 10];
+SnapshotSampler sampler(samples, 10);
+int main() {
+    printf("sampler on TIM4\n");
+    RateMeter meter(c);
+    printf("rate meter on TIM4 too\n");
+}
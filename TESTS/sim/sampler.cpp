@@ -0,0 +1,48 @@
+#include "sim_test.h"
+#include "SnapshotSampler.h"
+#include "sim_stimulus.h"
+using namespace mbed;
+EncoderIn x(PB_4, PB_5), y(PE_9, PE_11);
+CounterIn c(PC_7);
+static const uint32_t BLOCK = 100, SAMPLE_HZ = 20000;
+static const int X_HZ = 200000, Y_HZ = -100000, C_HZ = 200000;   // counts a second
+uint32_t samples[2 * 3 * BLOCK];
+SnapshotSampler sampler(samples, BLOCK);
+int blocks, bad; uint32_t lx, ly, lc; int have; const uint32_t *lastblock;
+static void control(const uint32_t *b, uint32_t n) {
+    blocks++;
+    if (b == lastblock) bad += 1000;
+    lastblock = b;
+    for (uint32_t i = 0; i < n; i++) {
+        if (have) {
+            int dx = (int16_t)(b[i] - lx), dy = (int16_t)(b[n + i] - ly), dc = (int16_t)(b[2*n + i] - lc);
+            if (dx != X_HZ / (int)SAMPLE_HZ || dy != Y_HZ / (int)SAMPLE_HZ || dc != C_HZ / (int)SAMPLE_HZ) { if (bad < 5) printf("i=%u dx=%d dy=%d dc=%d\n", i, dx, dy, dc); bad++; }
+        }
+        lx = b[i]; ly = b[n + i]; lc = b[2*n + i]; have = 1;
+    }
+}
+int main() {
+    sim_stimulus_t sx, sy, sc;
+    x.start(); y.start(); c.start();
+    int ax = sampler.add(x); int ay = sampler.add(y); int ac = sampler.add(c); CHECK(ax == 0 && ay == 1 && ac == 2); printf("add %d %d %d\n", ax, ay, ac);
+    sampler.attach(control);
+    sim_stimulus_quadrature(&sx, PB_4, PB_5, X_HZ, 0);
+    sim_stimulus_quadrature(&sy, PE_9, PE_11, -Y_HZ, -100000000);
+    sim_stimulus_pulse(&sc, PC_7, C_HZ, 50, 0);
+    sim_run(SIM_US(3));
+    sampler.start(SAMPLE_HZ);
+    CHECK(sampler.period_ns() == 1000000000 / SAMPLE_HZ);
+    printf("period_ns=%llu\n", (unsigned long long)sampler.period_ns());
+    sim_run(SIM_MS(100));
+    // One DMA stream moves all three, a block every BLOCK samples
+    CHECK(blocks == (int)(SAMPLE_HZ / 10 / BLOCK) && bad == 0);
+    CHECK(sim_nvic_count(DMA1_Stream6_IRQn) == (uint32_t)blocks);
+    CHECK(sim_nvic_count(DMA1_Stream0_IRQn) == 0 && sim_nvic_count(DMA1_Stream3_IRQn) == 0);
+    printf("blocks=%d bad=%d irqs S6=%u S0=%u S3=%u\n", blocks, bad, sim_nvic_count(DMA1_Stream6_IRQn), sim_nvic_count(DMA1_Stream0_IRQn), sim_nvic_count(DMA1_Stream3_IRQn));
+    sampler.stop(); int b = blocks; sim_run(SIM_MS(10));
+    CHECK(blocks == b);
+    printf("after stop %d\n", blocks - b);
+    have = 0; sampler.start(SAMPLE_HZ); sim_run(SIM_MS(10));
+    CHECK(blocks - b == (int)(SAMPLE_HZ / 100 / BLOCK) && bad == 0);
+    printf("restart blocks=%d bad=%d\n", blocks - b, bad);
+}
@@ -0,0 +1,17 @@
+#include "sim_test.h"
+#include "SnapshotSampler.h"
+#include "TriggeredTimeout.h"
+using namespace mbed;
+// A sampler holds its timer until it is destroyed, and then a triggered
+// timeout can have it, but not while the timeout is there
+uint32_t samples[2 * 10];
+int main() {
+    {
+        SnapshotSampler sampler(samples, 10, SMP_5);
+        printf("sampler on TIM5\n");
+    }
+    TriggeredTimeout tt5(PA_0);
+    printf("timeout on TIM5 after it\n");
+    SnapshotSampler again(samples, 10, SMP_5);
+    printf("sampler on TIM5 again\n");
+}
@@ -0,0 +1,19 @@
+#include "sim_test.h"
+#include "CounterIn.h"
+using namespace mbed;
+// One of each of the original drivers, as the README uses them
+CounterIn counter(PC_7);      // TIM8 ch2
+static const uint32_t PULSES = 1000;
+void enc_test(); void tt_test();
+int main() {
+    sim_stimulus_t s1;
+    counter.start();
+    sim_stimulus_pulse(&s1, PC_7, 100000, 50, PULSES);
+    sim_run(SIM_MS(20));
+    CHECK(sim_stimulus_edges(&s1) == 2 * PULSES);
+    CHECK(counter.read() == PULSES);
+    printf("counter=%u edges=%llu\n", counter.read(), (unsigned long long)sim_stimulus_edges(&s1));
+    sim_stimulus_stop(&s1);
+    enc_test();
+    tt_test();
+}
@@ -0,0 +1,24 @@
+#include "sim_test.h"
+#include "EncoderIn.h"
+using namespace mbed;
+EncoderIn enc(PB_4, PB_5);    // TIM3
+static const int32_t ALARM = 100, OUT = 1200, BACK = -600;
+int alarms;
+static void on_alarm() { alarms++; }
+void enc_test() {
+    sim_stimulus_t s2;
+    enc.start();
+    enc.alarm1(callback(on_alarm), ALARM);
+    sim_stimulus_quadrature(&s2, PB_4, PB_5, 200000, OUT);
+    sim_run(SIM_MS(10));
+    CHECK(enc.read() == OUT);
+    CHECK(alarms == 1);
+    printf("enc=%d alarms=%d\n", enc.read(), alarms);
+    // Back, but not as far as the alarm
+    sim_stimulus_quadrature(&s2, PB_4, PB_5, 200000, BACK);
+    sim_run(SIM_MS(10));
+    CHECK(enc.read() == OUT + BACK);
+    CHECK(alarms == 1);
+    printf("enc=%d alarms=%d\n", enc.read(), alarms);
+    sim_stimulus_stop(&s2);
+}
@@ -0,0 +1,22 @@
+#include "sim_test.h"
+#include "TriggeredTimeout.h"
+using namespace mbed;
+TriggeredTimeout tt(PA_15);   // TIM2
+static const uint32_t DELAY_US = 50, RUN_US = 200;
+int fires; sim_time_t fire_at;
+sim_time_t first; static void on_fire() { fires++; fire_at = sim_now(); if (fires==1) first = fire_at; }
+void tt_test() {
+    tt.attach_us(callback(on_fire), DELAY_US);
+    CHECK(fires == 0);
+    printf("fires after attach=%d\n", fires);
+    sim_gpio_write(PA_15, 1);
+    sim_run(SIM_US(10));
+    sim_gpio_write(PA_15, 0);
+    sim_time_t tf = sim_now();
+    sim_run(SIM_US(RUN_US));
+    // From the edge through the filter, then again every delay
+    sim_time_t filter = FILTER_15 * TICK_APB1;
+    CHECK(first - tf == filter + SIM_US(DELAY_US));
+    CHECK(fires == (int)((SIM_US(RUN_US) - filter) / SIM_US(DELAY_US)));
+    printf("fires=%d first_us=%.3f\n", fires, (double)(first - tf) / 180.0);
+}
@@ -0,0 +1,20 @@
+// harness-only Timeout on top of sim sources
+#ifndef STUB_TIMEOUT_H
+#define STUB_TIMEOUT_H
+#include "platform/Callback.h"
+#include "sim_tim.h"
+namespace mbed {
+class Timeout {
+    struct Src { sim_source_t s; Timeout *t; } _src;
+    sim_time_t _when; bool _on;
+    Callback<void()> _f;
+    static sim_time_t nx(sim_source_t *s) { Timeout *t = ((Src*)s)->t; return t->_on ? t->_when : SIM_TIME_NEVER; }
+    static void fi(sim_source_t *s) { Timeout *t = ((Src*)s)->t; t->_on = false; sim_source_remove(&t->_src.s); t->_f.call(); }
+public:
+    Timeout() : _on(false) { _src.t = this; _src.s.next = nx; _src.s.fire = fi; }
+    ~Timeout() { detach(); }
+    void attach_us(Callback<void()> f, uint64_t us) { detach(); _f = f; _when = sim_now() + SIM_US(us); _on = true; sim_source_add(&_src.s); }
+    void detach() { if (_on) { _on = false; sim_source_remove(&_src.s); } }
+};
+}
+#endif
@@ -0,0 +1,5 @@
+#ifndef MBED_ASSERT_H
+#define MBED_ASSERT_H
+#include <assert.h>
+#define MBED_ASSERT(x) assert(x)
+#endif
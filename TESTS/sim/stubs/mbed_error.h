@@ -0,0 +1,11 @@
+#ifndef MBED_ERROR_H
+#define MBED_ERROR_H
+#include "mbed_assert.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+void error(const char *fmt, ...);
+#ifdef __cplusplus
+}
+#endif
+#endif
@@ -0,0 +1,16 @@
+#ifndef MBED_PINMAP_H
+#define MBED_PINMAP_H
+#include "PinNames.h"
+#ifdef __cplusplus
+extern "C" {
+#endif
+typedef struct { PinName pin; int peripheral; int function; } PinMap;
+void pin_function(PinName pin, int function);
+void pin_mode(PinName pin, PinMode mode);
+uint32_t pinmap_peripheral(PinName pin, const PinMap *map);
+uint32_t pinmap_function(PinName pin, const PinMap *map);
+void pinmap_pinout(PinName pin, const PinMap *map);
+#ifdef __cplusplus
+}
+#endif
+#endif
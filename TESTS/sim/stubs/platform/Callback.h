@@ -0,0 +1,21 @@
+#ifndef MBED_CALLBACK_H
+#define MBED_CALLBACK_H
+#include <functional>
+namespace mbed {
+template <typename F> class Callback;
+template <typename R, typename... A> class Callback<R(A...)> {
+public:
+    Callback() {}
+    Callback(R (*f)(A...)) : _f(f) {}
+    template <typename T> Callback(T *obj, R (T::*m)(A...)) : _f([obj, m](A... a) { return (obj->*m)(a...); }) {}
+    void attach(const Callback &c) { _f = c._f; }
+    R call(A... a) const { return _f(a...); }
+    R operator()(A... a) const { return _f(a...); }
+    explicit operator bool() const { return (bool)_f; }
+private:
+    std::function<R(A...)> _f;
+};
+template <typename R, typename... A> Callback<R(A...)> callback(R (*f)(A...)) { return Callback<R(A...)>(f); }
+template <typename T, typename R, typename... A> Callback<R(A...)> callback(T *o, R (T::*m)(A...)) { return Callback<R(A...)>(o, m); }
+}
+#endif
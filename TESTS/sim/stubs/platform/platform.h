@@ -0,0 +1,8 @@
+#ifndef MBED_PLATFORM_H
+#define MBED_PLATFORM_H
+#include <stddef.h>
+#include <stdint.h>
+#include <stdio.h>
+#include "device.h"
+#include "PinNames.h"
+#endif
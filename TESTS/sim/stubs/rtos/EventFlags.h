@@ -0,0 +1,28 @@
+// sim stand-in: waiting runs the simulation until a flag is set
+#ifndef RTOS_EVENTFLAGS_H
+#define RTOS_EVENTFLAGS_H
+#include <stdint.h>
+#include "sim_tim.h"
+#define osWaitForever 0xFFFFFFFFU
+#define osFlagsError 0x80000000U
+#define osFlagsErrorTimeout 0xFFFFFFFEU
+namespace rtos {
+class EventFlags {
+public:
+    EventFlags() : _f(0) {}
+    uint32_t set(uint32_t f) { _f |= f; return _f; }
+    uint32_t clear(uint32_t f = 0x7fffffff) { uint32_t o = _f; _f &= ~f; return o; }
+    uint32_t get() const { return _f; }
+    uint32_t wait_any(uint32_t f, uint32_t ms = osWaitForever, bool clr = true) {
+        sim_time_t end = sim_now() + (ms == osWaitForever ? SIM_MS(100000) : SIM_MS(ms));
+        while (!(_f & f)) {
+            if (sim_now() >= end) return osFlagsErrorTimeout;
+            sim_run(SIM_US(1));
+        }
+        uint32_t r = _f & f; if (clr) _f &= ~f; return r;
+    }
+private:
+    volatile uint32_t _f;
+};
+}
+#endif
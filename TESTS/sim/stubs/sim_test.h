@@ -0,0 +1,18 @@
+/* Common include of the simulator regression programs */
+#ifndef SIM_TEST_H
+#define SIM_TEST_H
+#include "platform/platform.h"
+#include "platform/Callback.h"
+#include "sim_stimulus.h"
+#include <cstdio>
+#include <cstdlib>
+#define CHECK(c) do { if (!(c)) { printf("FAIL %s:%d %s\n", __FILE__, __LINE__, #c); exit(1);} } while(0)
+#define CHECK_NEAR(a, b, tol) CHECK(llabs((long long)(a) - (long long)(b)) <= (long long)(tol))
+
+/* A timer clock in HCLK cycles: TIM2-5 run at 90 MHz, TIM1 and TIM8 at 180 */
+static const sim_time_t TICK_APB1 = SIM_HCLK_HZ / (2 * SIM_PCLK1_HZ);
+static const sim_time_t TICK_APB2 = SIM_HCLK_HZ / (2 * SIM_PCLK2_HZ);
+/* The default input filter (15) takes 8 samples at a 32nd of the timer
+ * clock, so an edge gets through this many timer clocks late */
+static const sim_time_t FILTER_15 = 8 * 32;
+#endif
@@ -0,0 +1,71 @@
+/* Host versions of the mbed platform functions the drivers call */
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdarg.h>
+#include "cmsis.h"
+#include "pinmap.h"
+
+/* Fatal like mbed's, but with a plain exit so a program that checks for an
+ * error can still be compared with its expected output. stdout first, so
+ * the report comes after what the program printed before it. */
+void error(const char *fmt, ...)
+{
+    va_list ap;
+
+    fflush(stdout);
+    va_start(ap, fmt);
+    vfprintf(stderr, fmt, ap);
+    va_end(ap);
+    exit(1);
+}
+
+static uint32_t crit_depth;
+static uint32_t crit_primask;
+
+void core_util_critical_section_enter(void)
+{
+    uint32_t primask = __get_PRIMASK();
+
+    __disable_irq();
+    if (crit_depth++ == 0)
+        crit_primask = primask;
+}
+
+void core_util_critical_section_exit(void)
+{
+    if (--crit_depth == 0 && !crit_primask)
+        __enable_irq();
+}
+
+static const PinMap *pinmap_find(PinName pin, const PinMap *map)
+{
+    for (; map->pin != NC; map++) {
+        if (map->pin == pin)
+            return map;
+    }
+    return NULL;
+}
+
+uint32_t pinmap_peripheral(PinName pin, const PinMap *map)
+{
+    const PinMap *m = pinmap_find(pin, map);
+
+    return m ? (uint32_t)m->peripheral : (uint32_t)NC;
+}
+
+uint32_t pinmap_function(PinName pin, const PinMap *map)
+{
+    const PinMap *m = pinmap_find(pin, map);
+
+    return m ? (uint32_t)m->function : (uint32_t)NC;
+}
+
+void pinmap_pinout(PinName pin, const PinMap *map)
+{
+    const PinMap *m = pinmap_find(pin, map);
+
+    if (!m)
+        error("pinmap not found for peripheral\n");
+    pin_function(pin, m->function);
+    pin_mode(pin, PullNone);
+}
@@ -0,0 +1,48 @@
+#include "sim_test.h"
+#include "TriggeredEvent.h"
+using namespace mbed;
+// A one-pulse gate with a valve and a sample on the same edge, then the
+// same events repeating every period of an interrupting timeout
+TriggeredTimeout seq(PA_15, PB_3);
+TriggeredEvent valve(seq, PB_10);
+TriggeredEvent sample(seq);
+static const uint32_t GATE_US = 50, GATE_WIDTH_US = 950, VALVE_US = 100, SAMPLE_US = 400;
+static const uint32_t PERIOD_US = 200, LAST_US = 50, RUN_US = 1000;
+sim_time_t t0; sim_time_t st[8]; int sn; int dn; sim_time_t dt[8];
+sim_time_t gate_at[2], valve_at[2];
+static void take() { if (sn < 8) st[sn++] = sim_now(); }
+static void last() { if (dn < 8) dt[dn++] = sim_now(); }
+static void watch(void *ctx, int pin, int level, sim_time_t when) {
+    if (pin == PB_3) gate_at[level] = when - t0; else valve_at[level] = when - t0;
+    printf("  pin %s lv=%d at %.3f us\n", (const char*)ctx, level, (when - t0)/180.0);
+}
+// Times are from the edge as it gets through the filter
+static void trig() { sim_gpio_write(PA_15, 1); sim_run(SIM_US(10)); sim_gpio_write(PA_15, 0); t0 = sim_now() + FILTER_15 * TICK_APB1; }
+int main() {
+    sim_gpio_watch(PB_3, watch, (void*)"gate");
+    sim_gpio_watch(PB_10, watch, (void*)"valve");
+    seq.pulse_us(GATE_US, GATE_WIDTH_US);
+    valve.set_us(VALVE_US);
+    sample.attach_us(callback(take), SAMPLE_US);
+    CHECK(valve.delay_ns() == VALVE_US * 1000ULL && sample.delay_ns() == SAMPLE_US * 1000ULL);
+    printf("delays %llu %llu\n", (unsigned long long)valve.delay_ns(), (unsigned long long)sample.delay_ns());
+    for (int i = 0; i < 2; i++) {
+        trig(); sim_run(SIM_US(1500));
+        CHECK(gate_at[1] == SIM_US(GATE_US) && gate_at[0] == SIM_US(GATE_US + GATE_WIDTH_US));
+        CHECK(valve_at[1] == SIM_US(VALVE_US) && valve_at[0] == SIM_US(GATE_US + GATE_WIDTH_US));
+        CHECK(sn == i + 1 && st[sn-1] - t0 == SIM_US(SAMPLE_US));
+        // Only the sample interrupts
+        CHECK(sim_nvic_count(TIM2_IRQn) == (uint32_t)(i + 1));
+        printf("edge %d: samples=%d at %.3f irqs=%u\n", i, sn, (st[sn-1]-t0)/180.0, sim_nvic_count(TIM2_IRQn));
+    }
+    // IRQ mode: events repeat each period
+    sn = dn = 0;
+    seq.attach_us(callback(take), PERIOD_US);
+    sample.attach_us(callback(last), LAST_US);
+    trig(); sim_run(SIM_US(RUN_US));
+    sim_time_t ran = sim_now() - t0;
+    CHECK(sn == (int)(ran / SIM_US(PERIOD_US)));
+    CHECK(dn == (int)((ran - SIM_US(LAST_US)) / SIM_US(PERIOD_US)) + 1);
+    CHECK(dt[0] - t0 == SIM_US(LAST_US) && st[0] - t0 == SIM_US(PERIOD_US));
+    printf("irq mode: period fires=%d events=%d\n", sn, dn);
+}
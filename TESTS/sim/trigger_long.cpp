@@ -0,0 +1,32 @@
+#include "sim_test.h"
+#include "TriggeredEvent.h"
+using namespace mbed;
+TriggeredTimeout tt(PA_15, PA_2);   // TIM2, pulse on CH3
+TriggeredEvent ev(tt);
+static void nop() {}
+static const uint64_t TIMER_HZ = SIM_PCLK1_HZ * 2;
+static const uint64_t S = 1000000000ULL;
+// Programmed delays read back within half a tick of what was asked, where
+// the tick is that of the smallest prescaler that fits span in 32 bits
+static void check(const char *what, uint64_t asked, uint64_t got, uint64_t span) {
+  uint64_t psc = (span / S * TIMER_HZ >> 32) + 1;
+  int64_t err = (int64_t)(got - asked);
+  CHECK_NEAR(got, asked, (psc * S + 2 * TIMER_HZ - 1) / (2 * TIMER_HZ));
+  printf("%s: asked %llu ns, got %llu ns, off %lld ns\n", what, (unsigned long long)asked, (unsigned long long)got, (long long)err);
+}
+int main() {
+  static const uint64_t s[] = {1, 200, 300, 3600, 86400, 172800};
+  for (unsigned i = 0; i < sizeof(s) / sizeof(s[0]); i++) {
+    uint64_t ns = s[i] * S;
+    tt.attach_ns(callback(nop), ns);
+    check("delay", ns, tt.delay_ns(), ns);
+  }
+  // An event shares the timeout's prescaler
+  tt.attach_ns(callback(nop), 3600 * S);
+  ev.attach_ns(callback(nop), 3000 * S);
+  check("event", 3000 * S, ev.delay_ns(), 3600 * S);
+  // The pulse ends at delay + width
+  tt.pulse_ns(300 * S, 60 * S);
+  check("pulse delay", 300 * S, tt.delay_ns(), 360 * S);
+  check("pulse width", 60 * S, tt.width_ns(), 360 * S);
+}
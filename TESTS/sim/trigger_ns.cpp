@@ -0,0 +1,29 @@
+#include "sim_test.h"
+#include "TriggeredTimeout.h"
+using namespace mbed;
+// attach_ns() from a few ticks to beyond the 32-bit range: the delay is
+// kept to the nearest tick of whatever prescaler it needs, and the first
+// call comes that long after the edge gets through the input filter
+TriggeredTimeout tt5(PA_0);   // TIM5
+static const uint64_t TIMER_HZ = SIM_PCLK1_HZ * 2;
+int f5; sim_time_t f5_at;
+static void on5() { f5++; if (f5==1) f5_at = sim_now(); }
+void tt5_test(uint64_t ns) {
+    f5 = 0;
+    tt5.attach_ns(callback(on5), ns);
+    // The smallest prescaler that fits the delay in 32 bits
+    uint64_t ticks = ns * TIMER_HZ / 1000000000ULL;
+    uint64_t psc = (ticks >> 32) + 1;
+    uint64_t prog = tt5.delay_ns();
+    CHECK_NEAR(prog, ns, (psc * 1000000000ULL + 2 * TIMER_HZ - 1) / (2 * TIMER_HZ));
+    sim_gpio_write(PA_0, 1); sim_run(SIM_US(10)); sim_gpio_write(PA_0, 0);
+    sim_time_t tf = sim_now();
+    sim_run_until(tf + SIM_NS(ns) + SIM_MS(1));
+    CHECK(f5 >= 1);
+    CHECK_NEAR(f5_at - tf, FILTER_15 * TICK_APB1 + SIM_NS(prog), psc * TICK_APB1);
+    printf("ns=%llu prog=%llu\n", (unsigned long long)ns, (unsigned long long)prog);
+    tt5.attach_ns(NULL, ns);
+}
+int main() {
+    tt5_test(123456); tt5_test(20); tt5_test(90000000000ULL); tt5_test(1000);
+}
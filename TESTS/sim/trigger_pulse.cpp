@@ -0,0 +1,51 @@
+#include "sim_test.h"
+#include "TriggeredTimeout.h"
+using namespace mbed;
+// Hardware pulses on every edge without an interrupt, a single pulse that
+// takes one to disarm, and back to an interrupt with the output left idle
+TriggeredTimeout strobe(PA_0, PA_2);   // TIM5, out ch3
+static const uint64_t TIMER_HZ = SIM_PCLK1_HZ * 2;
+static const uint64_t HALF_TICK_NS = (1000000000ULL + 2 * TIMER_HZ - 1) / (2 * TIMER_HZ);
+static const uint64_t DELAY_NS = 250000, WIDTH_NS = 10000, SHORT_DELAY_NS = 100, SHORT_WIDTH_NS = 50;
+static const int TRIGS = 3;
+sim_time_t edges[64]; int nedge; int lv[64];
+static void watch(void *, int, int level, sim_time_t when) { if (nedge < 64) { lv[nedge] = level; edges[nedge++] = when; } }
+static void trig(sim_time_t *t) {
+    sim_gpio_write(PA_0, 1); sim_run(SIM_US(10)); sim_gpio_write(PA_0, 0); *t = sim_now();
+}
+static void nop() {}
+int main() {
+    sim_gpio_watch(PA_2, watch, 0);
+    IRQn_Type irq = TIM5_IRQn;
+    const sim_time_t filter = FILTER_15 * TICK_APB1;
+    strobe.pulse_ns(DELAY_NS, WIDTH_NS);
+    CHECK(strobe.delay_ns() == DELAY_NS && strobe.width_ns() == WIDTH_NS && sim_gpio_read(PA_2) == 0);
+    printf("delay=%llu width=%llu level=%d\n", (unsigned long long)strobe.delay_ns(), (unsigned long long)strobe.width_ns(), sim_gpio_read(PA_2));
+    sim_time_t t[TRIGS];
+    for (int i = 0; i < TRIGS; i++) { trig(&t[i]); sim_run(SIM_US(400)); }
+    CHECK(nedge == 2 * TRIGS);
+    for (int i = 0; i < nedge; i++) {
+        CHECK(lv[i] == !(i & 1));
+        CHECK(edges[i] - t[i/2] == filter + SIM_NS(DELAY_NS + (i & 1) * WIDTH_NS));
+        printf("edge %d lv=%d at %.3f us after trig%d\n", i, lv[i], (edges[i] - t[i/2]) / 180.0, i/2);
+    }
+    CHECK(sim_nvic_count(irq) == 0);
+    printf("irqs=%u\n", sim_nvic_count(irq));
+    // One pulse only, a few ticks each way
+    nedge = 0;
+    strobe.pulse_ns(SHORT_DELAY_NS, SHORT_WIDTH_NS, false);
+    CHECK_NEAR(strobe.delay_ns(), SHORT_DELAY_NS, HALF_TICK_NS);
+    CHECK_NEAR(strobe.width_ns(), SHORT_WIDTH_NS, HALF_TICK_NS);
+    printf("delay=%llu width=%llu\n", (unsigned long long)strobe.delay_ns(), (unsigned long long)strobe.width_ns());
+    for (int i = 0; i < TRIGS; i++) { trig(&t[i]); sim_run(SIM_US(100)); }
+    CHECK(nedge == 2);
+    CHECK_NEAR(edges[1] - edges[0], SIM_NS(strobe.width_ns()), TICK_APB1);
+    for (int i = 0; i < nedge; i++) printf("edge %d lv=%d at %.3f ns after trig\n", i, lv[i], (edges[i] - t[0]) / 0.18);
+    CHECK(sim_nvic_count(irq) == 1);
+    printf("irqs=%u\n", sim_nvic_count(irq));
+    // Interrupting again, the output stays idle
+    strobe.attach_us(callback(nop), 50);
+    nedge = 0; trig(&t[0]); sim_run(SIM_US(200));
+    CHECK(nedge == 0 && sim_gpio_read(PA_2) == 0);
+    printf("attach: edges=%d level=%d irqs=%u\n", nedge, sim_gpio_read(PA_2), sim_nvic_count(irq));
+}
@@ -0,0 +1,13 @@
+#include "sim_test.h"
+#include "TriggeredTimeout.h"
+#include "CounterIn.h"
+using namespace mbed;
+// PA_15 is TIM2 for a counter and for a triggered timeout alike, and TIM2
+// can only be one of them
+TriggeredTimeout tt5(PA_0);     // TIM5
+CounterIn c2(PA_15);            // TIM2
+int main() {
+    printf("counter on TIM2, timeout on TIM5\n");
+    TriggeredTimeout tt2(PA_15);
+    printf("timeout on TIM2 too\n");
+}
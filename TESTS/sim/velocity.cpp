@@ -0,0 +1,62 @@
+#include "sim_test.h"
+#include "VelocityMeter.h"
+#include <cmath>
+using namespace mbed;
+EncoderIn enc(PB_4, PB_5);   // TIM3 x4
+VelocityMeter vm(enc);       // TIM4
+static const uint32_t SAMPLE_HZ = 1000;
+static const double FAST = 300000, FAST_REV = -123457;
+static const double TIMED = 1e-5;            // a few reference ticks
+static const uint32_t CRAWL_US = 27027, CRAWL_REV_US = 5000, MID_US = 333;
+int calls;
+static void near(double hz) { CHECK(fabs(vm.read() - hz) <= fabs(hz) * TIMED); }
+static void cb(float) { calls++; }
+static int64_t pos;
+static void step(int dir, uint32_t us) {
+    pos += dir;
+    int ph = (int)(((pos % 4) + 4) % 4);
+    static const int A[4] = {0,1,1,0}, B[4] = {0,0,1,1};
+    sim_gpio_write(PB_4, A[ph]); sim_gpio_write(PB_5, B[ph]);
+    sim_run(SIM_US(us));
+}
+int main() {
+    sim_stimulus_t s;
+    enc.start();
+    vm.attach(callback(cb));
+    vm.start(SAMPLE_HZ);
+    CHECK(vm.window_ns() == 1000000000 / SAMPLE_HZ);
+    printf("window_ns=%lu\n", (unsigned long)vm.window_ns());
+    sim_stimulus_quadrature(&s, PB_4, PB_5, FAST, 2000000);
+    sim_run(SIM_MS(50));
+    near(FAST);
+    printf("fast %.2f\n", vm.read());
+    sim_stimulus_quadrature(&s, PB_4, PB_5, -FAST_REV, -2000000);
+    sim_run(SIM_MS(50));
+    near(FAST_REV);
+    printf("fast rev %.2f\n", vm.read());
+    sim_stimulus_stop(&s);
+    sim_run(SIM_MS(5));
+    // Falls off once the edges stop, an estimate every window
+    const float stopped = vm.read();
+    CHECK(stopped < 0 && stopped > FAST_REV && calls == (int)(105 * SAMPLE_HZ / 1000));
+    printf("stopped %.2f calls=%d\n", vm.read(), calls);
+    sim_run(SIM_MS(3000));
+    CHECK(vm.read() <= 0 && vm.read() > stopped);
+    printf("stopped long %.2f\n", vm.read());
+    // crawl: 37 counts/s -> one count every 27027us
+    for (int i = 0; i < 80; i++) step(1, CRAWL_US);
+    near(1e6 / CRAWL_US);
+    printf("crawl %.3f (37.000)\n", vm.read());
+    for (int i = 0; i < 40; i++) step(-1, CRAWL_REV_US);
+    near(-1e6 / CRAWL_REV_US);
+    printf("crawl rev %.3f (-200)\n", vm.read());
+    // 3000 counts/s: several edges per window
+    for (int i = 0; i < 600; i++) step(1, MID_US);
+    near(1e6 / MID_US);
+    const float mid = vm.read();
+    printf("mid %.2f (3003)\n", vm.read());
+    sim_run(SIM_MS(20));
+    CHECK(vm.read() > 0 && vm.read() < mid);
+    printf("after stop %.2f\n", vm.read());
+    return 0;
+}
@@ -0,0 +1,14 @@
+#include "sim_test.h"
+#include "VelocityMeter.h"
+#include "RateMeter.h"
+using namespace mbed;
+// TIM5 is a reference timer for a rate meter and for a velocity meter, one
+// at a time
+EncoderIn enc(PB_4, PB_5);      // TIM3
+CounterIn c(PC_7);              // TIM8
+RateMeter meter(c, RATE_5);
+int main() {
+    printf("rate meter on TIM5\n");
+    VelocityMeter vm(enc, VEL_5);
+    printf("velocity meter on TIM5 too\n");
+}
@@ -0,0 +1,24 @@
+#include "sim_test.h"
+#include "VelocityMeter.h"
+#include <cmath>
+using namespace mbed;
+encoderin_config_t x2 = {15, ENC_X2};
+EncoderIn enc(PB_6, PB_7, x2);   // TIM4 x2
+VelocityMeter vm(enc, VEL_5);
+static const double FAST = -54321, SLOW = 7;   // edges a second
+static const double TIMED = 1e-5;
+// X2 counts half the edges
+static void near(double hz) { CHECK(fabs(vm.read() - hz / 2) <= fabs(hz / 2) * TIMED); }
+int main() {
+    sim_stimulus_t s;
+    enc.start();
+    vm.start(200, 0.5f);
+    sim_stimulus_quadrature(&s, PB_6, PB_7, -FAST, -200000);
+    sim_run(SIM_MS(100));
+    near(FAST);
+    printf("x2 %.2f (-27160.5)\n", vm.read());
+    sim_stimulus_quadrature(&s, PB_6, PB_7, SLOW, 200000);
+    sim_run(SIM_MS(3000));
+    near(SLOW);
+    printf("x2 slow %.3f (3.5)\n", vm.read());
+}
@@ -0,0 +1,74 @@
+#define MBED_CONF_RTOS_PRESENT 1
+#include "sim_test.h"
+#include "CounterIn.h"
+#include "EncoderIn.h"
+#include "TriggeredTimeout.h"
+using namespace mbed;
+CounterIn c3(PC_6), c8(PC_7);
+EncoderIn enc(PB_6, PB_7);
+TriggeredTimeout tt(PA_15);
+static const uint64_t HZ = 100000, WRAP = 65536;
+static const uint64_t FIRST = 70000, TOO_MANY = 200000, MORE = 1234;
+static const int64_t AHEAD = 3000, PASSED = -500;
+static const uint32_t DELAY_US = 100;
+static const sim_time_t EDGE = SIM_HCLK_HZ / HZ;
+int main(){
+  c3.start(); c8.start(); enc.start();
+  sim_stimulus_t p3, p8, q;
+  sim_stimulus_pulse(&p3, PC_6, HZ, 50, 0);       // forever
+  sim_stimulus_pulse(&p8, PC_7, HZ, 50, 0);
+  sim_time_t t = sim_now();
+  bool ok = c3.wait_for_count(FIRST);
+  // Woken by the alarm at the count, after the wraps on the way
+  CHECK(ok && c3.read64() == FIRST && sim_nvic_count(TIM3_IRQn) == FIRST / WRAP + 1);
+  CHECK_NEAR(sim_now() - t, FIRST * EDGE, EDGE);
+  printf("c3 70000: ok=%d count=%llu after %.3f ms irqs=%u\n", ok, (unsigned long long)c3.read64(), (sim_now()-t)/180000.0, sim_nvic_count(TIM3_IRQn));
+  ok = c3.wait_for_count(TOO_MANY, 100);
+  CHECK(!ok && c3.read64() == FIRST + HZ / 10);
+  printf("c3 200000 in 100ms: ok=%d count=%llu\n", ok, (unsigned long long)c3.read64());
+  ok = c3.wait_for_count(5);
+  CHECK(ok);
+  printf("c3 already: ok=%d\n", ok);
+  t = sim_now(); uint32_t before = sim_nvic_count(TIM8_CC_IRQn);
+  const uint64_t want = c8.read64() + MORE;
+  ok = c8.wait_for_count(want);
+  CHECK(ok && c8.read64() == want && sim_nvic_count(TIM8_CC_IRQn) - before == 1);
+  CHECK_NEAR(sim_now() - t, MORE * EDGE, EDGE);
+  printf("c8 +1234: ok=%d late=%lld cc_irqs=%u after %.3f ms\n", ok, (long long)(c8.read64() - 0), sim_nvic_count(TIM8_CC_IRQn) - before, (sim_now()-t)/180000.0);
+  c3.reset(); ok = c3.wait_for_count(100);
+  CHECK(ok && c3.read64() == 100);
+  printf("c3 after reset: ok=%d count=%llu\n", ok, (unsigned long long)c3.read64());
+  sim_stimulus_stop(&p3); sim_stimulus_stop(&p8);
+  sim_stimulus_quadrature(&q, PB_6, PB_7, 100000, 5000);
+  ok = enc.wait_until_position(AHEAD);
+  CHECK(ok && enc.read64() == AHEAD);
+  printf("enc 3000: ok=%d pos=%lld\n", ok, (long long)enc.read64());
+  ok = enc.wait_until_position(-10, 20);
+  CHECK(!ok && enc.read64() == 5000);
+  printf("enc -10 in 20ms: ok=%d pos=%lld\n", ok, (long long)enc.read64());
+  sim_stimulus_quadrature(&q, PB_6, PB_7, 100000, -6000);
+  ok = enc.wait_until_position(-10);
+  CHECK(ok && enc.read64() == -10);
+  printf("enc -10: ok=%d pos=%lld\n", ok, (long long)enc.read64());
+  ok = enc.wait_until_position(enc.read64());
+  CHECK(ok);
+  printf("enc here: ok=%d\n", ok);
+  sim_run(SIM_MS(100));
+  // -500 was passed on the way down to -1000: it has to come back to it
+  ok = enc.wait_until_position(PASSED, 20);
+  CHECK(!ok && enc.read64() == -1000);
+  printf("enc -500 passed, stopped, 20ms: ok=%d pos=%lld\n", ok, (long long)enc.read64());
+  sim_stimulus_quadrature(&q, PB_6, PB_7, 100000, 1000);
+  ok = enc.wait_until_position(PASSED);
+  CHECK(ok && enc.read64() == PASSED);
+  printf("enc -500 on the way back: ok=%d pos=%lld\n", ok, (long long)enc.read64());
+  tt.attach_us(Callback<void()>(), DELAY_US);
+  ok = tt.wait(5);
+  CHECK(!ok);
+  printf("tt no edge: ok=%d\n", ok);
+  sim_gpio_write(PA_15, 1); sim_run(SIM_US(10)); sim_gpio_write(PA_15, 0); t = sim_now();
+  ok = tt.wait(5);
+  // From the falling edge through the filter; the simulated wait polls every microsecond
+  CHECK(ok && sim_now() - t >= SIM_US(DELAY_US) + FILTER_15 * TICK_APB1 && sim_now() - t < SIM_US(DELAY_US + 1) + FILTER_15 * TICK_APB1);
+  printf("tt edge: ok=%d after %.3f us\n", ok, (sim_now()-t)/180.0);
+}
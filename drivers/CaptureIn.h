@@ -0,0 +1,171 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef CAPTUREIN_H
+#define CAPTUREIN_H
+
+#include "platform/platform.h"
+
+#if DEVICE_CAPTUREIN
+#include "hal/capturein_api.h"
+#include "platform/Callback.h"
+#include "platform/critical.h"
+
+namespace mbed {
+/** \addtogroup drivers */
+/** @{*/
+
+/** An input that timestamps every edge, using a timer and DMA
+ *
+ * Takes the same pins as CounterIn. Each edge latches the timer into a
+ * capture register and the DMA copies it to the next word of a circular
+ * buffer, so a pulse train at hundreds of kHz costs two interrupts per
+ * buffer instead of one per edge. The attached function gets each half of
+ * the buffer as soon as it has filled, while the other half is being written.
+ *
+ * Timestamps are raw timer values at clock_hz(). Use ticks() for the time
+ * between two of them, it handles the wrap of the counter.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "CaptureIn.h"
+ *
+ * uint32_t edges[256];
+ * CaptureIn capture(PA_15, edges, 256);
+ * volatile uint32_t period;
+ *
+ * void got_edges(const uint32_t *t, uint32_t n) {
+ *		period = capture.ticks(t[0], t[n - 1]) / (n - 1);
+ * }
+ *
+ * int main() {
+ *		capture.attach(&got_edges);
+ *		capture.start();
+ *		while(1) {
+ *			printf("Period: %f us\r\n", period * 1e6f / capture.clock_hz());
+ *		}
+ * }
+ * @endcode
+ *
+ */
+class CaptureIn {
+
+public:
+
+	/** Set up a pin to timestamp its edges
+	 *
+	 * @param pin Pin from the CounterIn pin map, rising edges unless the map says inverted
+	 * @param buffer Where the DMA writes the timestamps, must outlive the object
+	 * @param length Buffer length in words (2 to 65535), an even number keeps the halves equal
+	 */
+    CaptureIn(PinName pin, uint32_t *buffer, uint32_t length) {
+        core_util_critical_section_enter();
+        capturein_init(&_capture, pin, buffer, length);
+        capturein_set_irq(&_capture, &CaptureIn::_irq_handler, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+    ~CaptureIn() {
+        stop();
+    }
+
+	/** Attach a function to be called each time half of the buffer has filled
+	 *
+	 * Called from the DMA interrupt with the half just written. It has
+	 * until the DMA wraps back into that half to use it.
+	 *
+	 * @param func function taking the timestamps and their number
+	 */
+    void attach(Callback<void(const uint32_t*, uint32_t)> func) {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop calling the attached function, capture carries on
+	 */
+    void detach() {
+        core_util_critical_section_enter();
+        _function = Callback<void(const uint32_t*, uint32_t)>();
+        core_util_critical_section_exit();
+    }
+
+	/** Starts timestamping, from the start of the buffer
+	 */
+    void start() {
+        core_util_critical_section_enter();
+        capturein_start(&_capture);
+        core_util_critical_section_exit();
+    }
+
+	/** Stops timestamping
+	 */
+    void stop() {
+        core_util_critical_section_enter();
+        capturein_stop(&_capture);
+        core_util_critical_section_exit();
+    }
+
+	/** Index of the buffer word the next edge goes to
+	 */
+    uint32_t index() {
+        return capturein_index(&_capture);
+    }
+
+	/** Frequency of the timer the timestamps are counted in
+	 */
+    uint32_t clock_hz() {
+        return _capture.clock;
+    }
+
+	/** Timer ticks from one timestamp to a later one
+	 *
+	 * Correct as long as they are less than one counter wrap apart: 47s on
+	 * the 32-bit TIM2, 728us on TIM3 and 364us on TIM8.
+	 */
+    uint32_t ticks(uint32_t from, uint32_t to) {
+        return (to - from) & _capture.counter.handle.Init.Period;
+    }
+
+	/** The current time, in the same ticks, extended to 64 bits
+	 */
+    uint64_t read64() {
+        return capturein_read64(&_capture);
+    }
+
+    static void _irq_handler(uintptr_t id, capturein_event event) {
+        CaptureIn *capture = (CaptureIn*)id;
+        uint32_t first = capture->_capture.length - capture->_capture.length / 2;
+
+        if (!capture->_function) {
+            return;
+        }
+        if (event == CAP_HALF) {
+            capture->_function.call(capture->_capture.buffer, first);
+        } else {
+            capture->_function.call(capture->_capture.buffer + first, capture->_capture.length - first);
+        }
+    }
+
+protected:
+    capturein_t _capture;
+    Callback<void(const uint32_t*, uint32_t)> _function;
+};
+
+} // namespace mbed
+
+#endif
+
+#endif
+
+/** @}*/
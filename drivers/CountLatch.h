@@ -0,0 +1,190 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COUNTLATCH_H
+#define COUNTLATCH_H
+
+#include "platform/platform.h"
+
+#if DEVICE_COUNTLATCH
+
+#include "hal/countlatch_api.h"
+#include "platform/critical.h"
+
+#if DEVICE_ENCODERIN
+#include "EncoderIn.h"
+#endif
+
+#if DEVICE_COUNTERIN
+#include "CounterIn.h"
+#endif
+
+namespace mbed {
+
+/** Latches several encoders and counters at the same instant, in hardware
+ *
+ * Reading one axis after another gives positions from different moments.
+ * Here one trigger, from software or a pin, makes every member's timer
+ * capture its count on the same edge, through the timers' internal trigger
+ * links, and read() hands them back together extended to 64 bits.
+ *
+ * The first member added is the master that receives the trigger. Any
+ * EncoderIn can be the master or follow one; a CounterIn can only be the
+ * master, its timer's trigger input is already taken by what it counts.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "CountLatch.h"
+ *
+ * EncoderIn x(PB_4, PB_5), y(PE_9, PE_11), z(PB_6, PB_7);
+ * CountLatch latch;
+ *
+ * int main() {
+ *		int64_t xyz[3];
+ *		x.start();
+ *		y.start();
+ *		z.start();
+ *		latch.add(x);
+ *		latch.add(y);
+ *		latch.add(z);
+ *		while(1) {
+ *			latch.trigger();
+ *			latch.read(xyz);
+ *			printf("%lld %lld %lld\r\n", xyz[0], xyz[1], xyz[2]);
+ *		}
+ * }
+ * @endcode
+ */
+class CountLatch {
+
+public:
+
+	/** Create an empty group
+	 *
+	 * @param trigger Pin whose rising edges latch the group, on the first
+	 *        member's timer (see PinMap_LATCH), or NC for trigger() only
+	 */
+    CountLatch(PinName trigger = NC) {
+        core_util_critical_section_enter();
+        countlatch_init(&_latch, trigger);
+        core_util_critical_section_exit();
+        for (int i = 0; i < LATCH_MEMBERS; i++) {
+#if DEVICE_ENCODERIN
+            _encoders[i] = NULL;
+#endif
+#if DEVICE_COUNTERIN
+            _counters[i] = NULL;
+#endif
+        }
+    }
+
+#if DEVICE_ENCODERIN
+	/** Latch an encoder with the group
+	 *
+	 * Takes the encoder's channel 1 capture, counting is not affected.
+	 *
+	 * @returns index of its position in read(), or -1 if all LATCH_MEMBERS are used
+	 */
+    int add(EncoderIn &encoder) {
+        core_util_critical_section_enter();
+        int index = countlatch_add_encoder(&_latch, &encoder._encoder.handle);
+        if (index >= 0) {
+            _encoders[index] = &encoder;
+        }
+        core_util_critical_section_exit();
+        return index;
+    }
+#endif
+
+#if DEVICE_COUNTERIN
+	/** Latch a counter with the group, as its first member
+	 *
+	 * @returns 0, or -1 if the group is full
+	 */
+    int add(CounterIn &counter) {
+        core_util_critical_section_enter();
+        int index = countlatch_add_counter(&_latch, &counter._counter.handle, counter._counter.channel);
+        if (index >= 0) {
+            _counters[index] = &counter;
+        }
+        core_util_critical_section_exit();
+        return index;
+    }
+#endif
+
+	/** Latch every member now
+	 */
+    void trigger() {
+        countlatch_trigger(&_latch);
+    }
+
+	/** Read the positions from the last latch
+	 *
+	 * The latched counts are extended to 64 bits against the current ones,
+	 * so read within half a counter wrap of the latch.
+	 *
+	 * @param positions one per member, in the order they were added
+	 * @returns true if the group latched since the last read, otherwise
+	 *          false and positions is left alone
+	 */
+    bool read(int64_t *positions) {
+        uint32_t counts[LATCH_MEMBERS];
+
+        core_util_critical_section_enter();
+        int latched = countlatch_read(&_latch, counts);
+        core_util_critical_section_exit();
+
+        if (!latched) {
+            return false;
+        }
+        for (uint8_t i = 0; i < _latch.members; i++) {
+#if DEVICE_ENCODERIN
+            if (_encoders[i]) {
+                positions[i] = _extend(_encoders[i]->read64(), counts[i], _latch.member[i]->Init.Period);
+            }
+#endif
+#if DEVICE_COUNTERIN
+            if (_counters[i]) {
+                positions[i] = _extend(_counters[i]->read64(), counts[i], _latch.member[i]->Init.Period);
+            }
+#endif
+        }
+        return true;
+    }
+
+protected:
+    // Count now, moved back by the distance from the latched CNT to the
+    // current one, which is under half a wrap
+    static int64_t _extend(int64_t now, uint32_t latched, uint32_t period) {
+        int64_t delta = (latched - (uint32_t)now) & period;
+
+        if (delta > period / 2) {
+            delta -= (int64_t)period + 1;
+        }
+        return now + delta;
+    }
+
+    countlatch_t _latch;
+#if DEVICE_ENCODERIN
+    EncoderIn *_encoders[LATCH_MEMBERS];
+#endif
+#if DEVICE_COUNTERIN
+    CounterIn *_counters[LATCH_MEMBERS];
+#endif
+}; //class CountLatch
+
+} // namespace mbed
+
+#endif //DEVICE_COUNTLATCH
+
+#endif //COUNTLATCH_H
@@ -17,7 +17,11 @@
 
 #if DEVICE_COUNTERIN
 #include "hal/counterin_api.h"
+#include "platform/Callback.h"
 #include "platform/critical.h"
+#if MBED_CONF_RTOS_PRESENT
+#include "rtos/EventFlags.h"
+#endif
 
 namespace mbed {
 /** \addtogroup drivers */
@@ -40,6 +44,22 @@ namespace mbed {
  * }
  * @endcode
  *
+ * Or be called every 1000 pulses instead of polling:
+ * @code
+ * CounterIn flow(PC_6);
+ *
+ * void batch() {
+ *		//another litre
+ * }
+ *
+ * int main() {
+ *		flow.alarm1(&batch, 1000, 1000);
+ *		flow.start();
+ *		while(1) {
+ *			//Loop forever
+ *		}
+ * }
+ * @endcode
  */
 class CounterIn {
 
@@ -55,37 +75,148 @@ public:
         core_util_critical_section_exit();
     }
 
+	/** Initializes a HW timer with its own filter, edges and clock mode
+	 *
+	 * The defaults above take up to 176kHz on TIM2/TIM3 and twice that on
+	 * TIM8; a lighter filter, or ETR with its prescaler, goes to tens of
+	 * MHz. See counterin_config_t for the figures. With an ETR prescaler
+	 * the count is one per 2, 4 or 8 edges.
+	 *
+	 * @param pin Pin from PinMap_CNT, or PinMap_CNT_ETR with CNT_CLOCK_ETR
+	 * @param config clock mode, filter, edges and ETR prescaler
+	 */
+    CounterIn(PinName pin, const counterin_config_t &config) {
+        core_util_critical_section_enter();
+        counterin_init_config(&_counter, pin, &config);
+        core_util_critical_section_exit();
+    }
+
+	/** Initializes a 16-bit HW timer with a second one as its high half
+	 *
+	 * The second timer counts the first one's wraps through the timers'
+	 * internal trigger link, so read() is a full 32-bit count without any
+	 * interrupts, on the pins of TIM3 and TIM8 too.
+	 *
+	 * @param pin Pin to connect an external clock source (pulse train), on CNT_3 or CNT_8
+	 * @param high CNT_CASCADE_4 (after CNT_3 or CNT_8) or CNT_CASCADE_1 (after CNT_3)
+	 */
+    CounterIn(PinName pin, CNTCascade high) {
+        core_util_critical_section_enter();
+        counterin_init_cascade(&_counter, pin, high, NULL);
+        core_util_critical_section_exit();
+    }
+
+	/** Initializes a cascaded pair with its own filter, edges and clock mode
+	 *
+	 * @param pin as for CounterIn(PinName, const counterin_config_t &), on CNT_3 or CNT_8
+	 * @param high CNT_CASCADE_4 (after CNT_3 or CNT_8) or CNT_CASCADE_1 (after CNT_3)
+	 * @param config clock mode, filter, edges and ETR prescaler
+	 */
+    CounterIn(PinName pin, CNTCascade high, const counterin_config_t &config) {
+        core_util_critical_section_enter();
+        counterin_init_cascade(&_counter, pin, high, &config);
+        core_util_critical_section_exit();
+    }
+
 	/** Read the current count of the HW timer
 	 *
 	 * @returns
 	 *	An unsigned integer, with size depending on whether a 16-bit or 32-bit timer
-	 *	was used
+	 *	was used, 32 bits when cascaded
 	 */
     uint32_t read() {
-        core_util_critical_section_enter();
-        uint32_t val = counterin_read(&_counter);
-        core_util_critical_section_exit();
-        return val;
+        // One register load, or a lock-free read of both halves when cascaded
+        return counterin_read(&_counter);
+    }
+
+	/** Read the count extended to 64 bits
+	 *
+	 * The timer's update interrupt carries every wrap into a software
+	 * count, so this only needs polling as often as the application likes.
+	 * Lock-free, so it can be called from ISRs without masking interrupts.
+	 *
+	 * @returns
+	 *	Edges counted since start or the last reset
+	 */
+    uint64_t read64() {
+        return counterin_read64(&_counter);
     }
 
+	/** Starts the HW timer counting
+	 */
 	void start() {
-		core_util_critical_section_enter();
+		// Only touches CR1, which no ISR writes
 		counterin_start(&_counter);
-		core_util_critical_section_exit();
 	}
 
+	/** Resets the count, including the extended part
+	 */
 	void reset() {
+		// Rewrites the 64-bit count, which ISR readers must not see torn
 		core_util_critical_section_enter();
 		counterin_reset(&_counter);
 		core_util_critical_section_exit();
 	}
 
+	/** Stops the HW timer counting
+	 */
 	void stop() {
-		core_util_critical_section_enter();
 		counterin_stop(&_counter);
-		core_util_critical_section_exit();	
 	}
 
+	/** Attach a function to be called when the count gets to a value
+	 *
+	 * With a period the function is called again every period counts
+	 * after that, so a batch of pulses costs one interrupt. Counts are
+	 * read64() counts, which start again from 0 on a reset(), so the
+	 * alarm is then that much further away; set it again if it should be
+	 * counted from the reset. Not on a cascaded counter.
+	 *
+	 * @param func pointer to the function to be called, or NULL to remove the alarm
+	 * @param count read64() count of the first call
+	 * @param period counts between calls after that, 0 to call once
+	 */
+    void alarm1(Callback<void()> func, uint64_t count, uint32_t period = 0) {
+        _set_alarm(&_alarm1_event, _alarm1, func, count, period, &CounterIn::_alarm1_irq);
+    }
+
+	/** Attach a second function to be called when the count gets to a value
+	 *
+	 * @param func pointer to the function to be called, or NULL to remove the alarm
+	 * @param count read64() count of the first call
+	 * @param period counts between calls after that, 0 to call once
+	 */
+    void alarm2(Callback<void()> func, uint64_t count, uint32_t period = 0) {
+        _set_alarm(&_alarm2_event, _alarm2, func, count, period, &CounterIn::_alarm2_irq);
+    }
+
+#if MBED_CONF_RTOS_PRESENT
+	/** Sleep the calling thread until the count gets to a value
+	 *
+	 * Uses an alarm, so the compare interrupt wakes it and until then
+	 * there are only the wrap interrupts. One waiting thread per counter;
+	 * not on a cascaded counter.
+	 *
+	 * @param count read64() count to wait for
+	 * @param millisec longest wait, osWaitForever for no limit
+	 * @returns
+	 *	true once the count is there, false on a timeout
+	 */
+	bool wait_for_count(uint64_t count, uint32_t millisec = osWaitForever) {
+		core_util_critical_section_enter();
+		_flags.clear(WAIT_FLAG);
+		counterin_insert_alarm(&_counter, &_wait_event, count, 0, &CounterIn::_wait_irq, (uintptr_t)this);
+		core_util_critical_section_exit();
+
+		uint32_t flags = _flags.wait_any(WAIT_FLAG, millisec);
+
+		core_util_critical_section_enter();
+		counterin_remove_alarm(&_counter, &_wait_event);
+		core_util_critical_section_exit();
+		return (flags & osFlagsError) == 0;
+	}
+#endif
+
 
     /** An operator shorthand for read()
      */
@@ -94,7 +225,45 @@ public:
         return read();
     }
 protected:
+    friend class SnapshotSampler;
+    friend class CountLatch;
+    friend class FrequencyMeter;
+    friend class RateMeter;
+
+    void _set_alarm(counterin_alarm_t *event, Callback<void()> &function, Callback<void()> func, uint64_t count, uint32_t period, cnt_irq_handler handler) {
+        core_util_critical_section_enter();
+        if (func) {
+            function.attach(func);
+            counterin_insert_alarm(&_counter, event, count, period, handler, (uintptr_t)this);
+        } else {
+            counterin_remove_alarm(&_counter, event);
+        }
+        core_util_critical_section_exit();
+    }
+
+    static void _alarm1_irq(uintptr_t id) {
+        ((CounterIn*)id)->_alarm1.call();
+    }
+
+    static void _alarm2_irq(uintptr_t id) {
+        ((CounterIn*)id)->_alarm2.call();
+    }
+
     counterin_t _counter;
+    counterin_alarm_t _alarm1_event;
+    counterin_alarm_t _alarm2_event;
+    Callback<void()> _alarm1;
+    Callback<void()> _alarm2;
+#if MBED_CONF_RTOS_PRESENT
+    static const uint32_t WAIT_FLAG = 1;
+
+    static void _wait_irq(uintptr_t id) {
+        ((CounterIn*)id)->_flags.set(WAIT_FLAG);
+    }
+
+    counterin_alarm_t _wait_event;
+    rtos::EventFlags _flags;
+#endif
 };
 
 } // namespace mbed
@@ -0,0 +1,197 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef DEFERREDQUEUE_H
+#define DEFERREDQUEUE_H
+
+#include "platform/platform.h"
+#include "platform/Callback.h"
+#include "mbed_assert.h"
+#include "cmsis.h"
+
+namespace mbed {
+
+/** \addtogroup drivers */
+/** @{*/
+
+/** One interrupt, as queued by a driver for its function to run later
+ */
+struct DeferredEvent {
+    void (*handler)(const DeferredEvent &event);    // what dispatch() calls
+    uintptr_t id;        // the driver, for handler
+    uint32_t event;     // which of the driver's events, e.g. 1 or 2 for alarm1/alarm2
+    int64_t count;      // count or position read in the interrupt, 0 if the driver has none
+    uint32_t cycles;    // DWT->CYCCNT when it was queued, if the application has it running
+};
+
+/** A queue that takes driver callbacks out of interrupt context
+ *
+ * A driver given a queue with its defer() no longer calls its functions
+ * from the interrupt. The interrupt pushes a DeferredEvent instead, the
+ * same short time however long the function takes, and dispatch()
+ * runs the functions later, in batches, from wherever it is called: the
+ * main loop, a worker thread or an event loop.
+ *
+ * The queue is a ring with one writer and one reader, and neither side
+ * masks interrupts. Every driver pushing onto one queue has to interrupt
+ * at the same NVIC priority (the default), so none can preempt another
+ * mid-push; drivers at different priorities need a queue each. Only one
+ * thread may pop or dispatch. A full queue drops the event and counts it
+ * in dropped(). The events are stored in an array the caller provides.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "EncoderIn.h"
+ *
+ * EncoderIn qei(PB_4, PB_5);
+ * DeferredEvent events[32];
+ * DeferredQueue queue(events, 32);
+ *
+ * void at_limit() {
+ *		printf("Limit\r\n");		// too slow for an interrupt
+ * }
+ *
+ * int main() {
+ *		qei.defer(&queue);
+ *		qei.alarm1(&at_limit, 12000);
+ *		qei.start();
+ *		while(1) {
+ *			queue.dispatch();
+ *			__WFI();
+ *		}
+ * }
+ * @endcode
+ */
+class DeferredQueue {
+
+public:
+
+	/** Create a queue
+	 *
+	 * @param events Where the queued events are kept, must outlive the object
+	 * @param size Events it holds, a power of two
+	 */
+    DeferredQueue(DeferredEvent *events, uint32_t size) : _events(events), _size(size), _head(0), _tail(0), _dropped(0) {
+        MBED_ASSERT(size != 0 && (size & (size - 1)) == 0);
+    }
+
+	/** Attach a function to be called when the queue stops being empty
+	 *
+	 * It is called from the interrupt that pushed the first event of a
+	 * batch, and not again until dispatch() or pop() has emptied the
+	 * queue, so it is the place to wake the thread that dispatches: set
+	 * an event flag, release a semaphore or post to an event loop.
+	 *
+	 * @param func function to call, or NULL for none
+	 */
+    void attach(Callback<void()> func) {
+        _notify.attach(func);
+    }
+
+	/** Queue an event, from the interrupt
+	 *
+	 * @returns
+	 *	false if the queue was full and the event was dropped
+	 */
+    bool push(void (*handler)(const DeferredEvent &event), uintptr_t id, uint32_t event, int64_t count) {
+        uint32_t head = _head;
+
+        if (head - _tail == _size) {
+            _dropped++;
+            return false;
+        }
+        DeferredEvent &slot = _events[head & (_size - 1)];
+        slot.handler = handler;
+        slot.id = id;
+        slot.event = event;
+        slot.count = count;
+        slot.cycles = DWT->CYCCNT;
+        // The event has to be in place before the reader can see it
+        __DMB();
+        _head = head + 1;
+        __DMB();
+        // If the reader hasn't taken the one before yet it will find this
+        // one too, as _head was already moved on
+        if (head == _tail && _notify) {
+            _notify.call();
+        }
+        return true;
+    }
+
+	/** Take the oldest event off the queue, from the thread
+	 *
+	 * @param event set to the event taken
+	 * @returns
+	 *	false if the queue was empty
+	 */
+    bool pop(DeferredEvent &event) {
+        uint32_t tail = _tail;
+
+        if (tail == _head) {
+            return false;
+        }
+        __DMB();
+        event = _events[tail & (_size - 1)];
+        // Done with the slot before the writer can reuse it
+        __DMB();
+        _tail = tail + 1;
+        return true;
+    }
+
+	/** Run the functions of the queued events, oldest first
+	 *
+	 * @param max most events to run, 0 to run until the queue is empty
+	 * @returns
+	 *	Events run
+	 */
+    uint32_t dispatch(uint32_t max = 0) {
+        DeferredEvent event;
+        uint32_t run = 0;
+
+        while ((max == 0 || run < max) && pop(event)) {
+            event.handler(event);
+            run++;
+        }
+        return run;
+    }
+
+	/** Events waiting to be dispatched
+	 */
+    uint32_t pending() {
+        return _head - _tail;
+    }
+
+	/** Events dropped because the queue was full
+	 */
+    uint32_t dropped() {
+        return _dropped;
+    }
+
+private:
+    // Not copyable, the drivers point at it
+    DeferredQueue(const DeferredQueue&);
+    DeferredQueue& operator=(const DeferredQueue&);
+
+    DeferredEvent *_events;
+    uint32_t _size;
+    volatile uint32_t _head;    // written only by push
+    volatile uint32_t _tail;    // written only by pop
+    volatile uint32_t _dropped;
+    Callback<void()> _notify;
+};
+
+} // namespace mbed
+
+/** @}*/
+
+#endif
@@ -0,0 +1,169 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ENCODERALARM_H
+#define ENCODERALARM_H
+
+#include "platform/platform.h"
+
+#if DEVICE_ENCODERIN
+
+#include "EncoderIn.h"
+#include "drivers/Timeout.h"
+#include "platform/Callback.h"
+#include "platform/critical.h"
+
+namespace mbed {
+
+/** A position alarm on an EncoderIn
+ *
+ * An encoder keeps all of its alarms sorted by position and points its two
+ * compare channels at the nearest one ahead and the nearest one behind, so
+ * there is no limit on how many alarms one encoder can have.
+ *
+ * A noisy shaft sitting on an alarm's position would fire it on every
+ * crossing. Three things bound that, per alarm: a direction, so only
+ * crossings while counting up (or down) fire it; a hysteresis band it has
+ * to leave before it fires again; and a minimum interval between two calls,
+ * during which it does not even interrupt.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "EncoderAlarm.h"
+ *
+ * EncoderIn qei(PB_4, PB_5);
+ * EncoderAlarm open_limit(qei);
+ * EncoderAlarm close_limit(qei);
+ *
+ * void stop_motor() {
+ *		//stop
+ * }
+ *
+ * int main() {
+ *		qei.start();
+ *		open_limit.attach(&stop_motor, 12000);
+ *		close_limit.attach(&stop_motor, -500, ENC_ALARM_DOWN, 50);
+ *		while(1) {
+ *			//Loop forever
+ *		}
+ * }
+ * @endcode
+ */
+class EncoderAlarm {
+
+public:
+
+	/** Create an alarm on an encoder, not yet attached
+	 *
+	 * @param encoder EncoderIn whose position to watch
+	 */
+    EncoderAlarm(EncoderIn &encoder) : _encoder(encoder), _event(), _interval_us(0) {
+    }
+
+    ~EncoderAlarm() {
+        detach();
+    }
+
+	/** Attach a function to be called every time the encoder moves onto a position
+	 *
+	 * @param func pointer to the function to be called
+	 * @param position position, as returned by EncoderIn::read64(), at which to trigger
+	 * @param direction ENC_ALARM_UP or ENC_ALARM_DOWN to only trigger while counting that way
+	 * @param hysteresis counts the encoder must move away before the alarm can trigger again
+	 */
+    void attach(Callback<void()> func, int64_t position, enc_alarm_direction direction = ENC_ALARM_BOTH, uint32_t hysteresis = 0) {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        _holdoff.detach();
+        encoderin_insert_alarm(&_encoder._encoder, &_event, position, direction, hysteresis, &EncoderAlarm::_irq_handler, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop calling the attached function
+	 */
+    void detach() {
+        core_util_critical_section_enter();
+        _holdoff.detach();
+        encoderin_remove_alarm(&_encoder._encoder, &_event);
+        core_util_critical_section_exit();
+    }
+
+	/** Move an attached alarm, keeping its function, direction and hysteresis
+	 *
+	 * Only rewrites the compare registers, so it is cheap enough to re-arm
+	 * the alarm from its own function. Does nothing if not attached.
+	 *
+	 * @param position new position at which to trigger
+	 */
+    void move(int64_t position) {
+        core_util_critical_section_enter();
+        encoderin_move_alarm(&_encoder._encoder, &_event, position);
+        core_util_critical_section_exit();
+    }
+
+	/** Set the minimum time between two calls
+	 *
+	 * After each call the alarm is taken off the compare channels for this
+	 * long, so it cannot interrupt at all in the meantime.
+	 *
+	 * @param us interval in microseconds, 0 for none
+	 */
+    void min_interval_us(uint32_t us) {
+        core_util_critical_section_enter();
+        _interval_us = us;
+        core_util_critical_section_exit();
+    }
+
+	/** Return the position the alarm is set to
+	 */
+    int64_t position() {
+        return _event.position;
+    }
+
+    static void _irq_handler(uintptr_t id) {
+        EncoderAlarm *alarm = (EncoderAlarm*)id;
+
+        if (alarm->_interval_us) {
+            encoderin_hold_alarm(&alarm->_encoder._encoder, &alarm->_event);
+            alarm->_holdoff.attach_us(callback(alarm, &EncoderAlarm::_release), alarm->_interval_us);
+        }
+        if (alarm->_encoder._queue) {
+            alarm->_encoder._queue->push(&EncoderAlarm::_deferred, id, 0, encoderin_read64(&alarm->_encoder._encoder));
+        } else {
+            alarm->_function.call();
+        }
+    }
+
+    static void _deferred(const DeferredEvent &event) {
+        ((EncoderAlarm*)event.id)->_function.call();
+    }
+
+protected:
+    void _release() {
+        core_util_critical_section_enter();
+        encoderin_release_alarm(&_encoder._encoder, &_event);
+        core_util_critical_section_exit();
+    }
+
+    EncoderIn &_encoder;
+    encoderin_alarm_t _event;
+    Callback<void()> _function;
+    Timeout _holdoff;
+    uint32_t _interval_us;
+}; //class EncoderAlarm
+
+} // namespace mbed
+
+#endif //DEVICE_ENCODERIN
+
+#endif //ENCODERALARM_H
@@ -19,11 +19,13 @@
 
 #include "hal/encoderin_api.h"
 #include "platform/critical.h"
+#include "DeferredQueue.h"
+#if MBED_CONF_RTOS_PRESENT
+#include "rtos/EventFlags.h"
+#endif
 
 namespace mbed {
 
-static void donothing() {}
-
 /** A Hardware Timer implementation of an Encoder
  * 
  * Example
@@ -46,39 +48,152 @@ class EncoderIn {
 public:
 	
 	/** Create an Encoder with two Inputs
+	 *
+	 * Counts every edge of both channels, four per cycle. On ENC_2 and
+	 * ENC_5 the timer is 32 bits wide.
 	 *
 	 * @param chA Encoder Channel A Pin to connect to
 	 * @param chB Encoder Channel B Pin to connect to
 	 */
-	EncoderIn(PinName chA, PinName chB) {
+	EncoderIn(PinName chA, PinName chB) : _alarm1_event(), _alarm2_event(), _queue(NULL)
+#if MBED_CONF_RTOS_PRESENT
+		, _wait_event()
+#endif
+	{
 		core_util_critical_section_enter();
-        encoderin_init(&_encoder, chA, chB, &EncoderIn::_irq_handler, (uint32_t)this);
+        encoderin_init(&_encoder, chA, chB);
+        core_util_critical_section_exit();
+	}
+
+	/** Create an Encoder with its own input filter and decoding
+	 *
+	 * @param chA Encoder Channel A Pin to connect to
+	 * @param chB Encoder Channel B Pin to connect to
+	 * @param config input settings, see encoderin_config_t
+	 */
+	EncoderIn(PinName chA, PinName chB, const encoderin_config_t &config) : _alarm1_event(), _alarm2_event(), _queue(NULL)
+#if MBED_CONF_RTOS_PRESENT
+		, _wait_event()
+#endif
+	{
+		core_util_critical_section_enter();
+        encoderin_init_config(&_encoder, chA, chB, &config);
         core_util_critical_section_exit();
 	}
 
 	/** Return the current Position of the encoder in ticks
 	 *
 	 * @returns
-	 *	An integer whose size depends on the timer
+	 *	The timer's count, sign-extended from 16 bits on a 16-bit timer
 	 */
 	int32_t read() {
-		core_util_critical_section_enter();
-        int32_t val = (int16_t)encoderin_read(&_encoder);
-        core_util_critical_section_exit();
-        return val;
+        // A single register load, nothing to protect
+        uint32_t count = encoderin_read(&_encoder);
+        return (_encoder.handle.Init.Period == 0xFFFF) ? (int16_t)count : (int32_t)count;
     }
 
+	/** Return the position of the encoder extended to 64 bits
+	 *
+	 * Overflows and underflows of the timer are carried into a software
+	 * count by its update interrupt, so this does not wrap in practice.
+	 * Lock-free, so it can be called from ISRs without masking interrupts.
+	 *
+	 * @returns
+	 *	Position in ticks since start or the last reset
+	 */
+	int64_t read64() {
+		return encoderin_read64(&_encoder);
+	}
+
+	/** Home on an index (Z) pulse, captured by the timer
+	 *
+	 * The first index makes absolute() 0 there, exactly where its edge
+	 * came in, with no pin interrupt in between. Given the counts in a
+	 * turn, turns() counts them from there and every later index checks
+	 * that no count was lost, moving home back onto it if one was. With 0
+	 * every index homes again.
+	 *
+	 * The index takes the timer's channel 1 capture, so the encoder cannot
+	 * also be in a CountLatch or measured by a VelocityMeter.
+	 *
+	 * @param pin the timer's ETR pin, see PinMap_ENC_IDX
+	 * @param counts_per_turn counts between two indexes, 4 per line at ENC_X4
+	 */
+	void index(PinName pin, uint32_t counts_per_turn = 0) {
+		core_util_critical_section_enter();
+		encoderin_index(&_encoder, pin, counts_per_turn);
+		core_util_critical_section_exit();
+	}
+
+	/** Whether an index has come in since index() or reset()
+	 */
+	bool homed() {
+		return _encoder.homed;
+	}
+
+	/** Position from the index, or read64() until it has come in
+	 */
+	int64_t absolute() {
+		return encoderin_read_absolute(&_encoder);
+	}
+
+	/** Whole turns from the index, rounding down, 0 without counts_per_turn
+	 *
+	 * @param angle if not NULL, set to the counts into this turn
+	 */
+	int64_t turns(uint32_t *angle = NULL) {
+		int64_t position = absolute();
+		int64_t turn = _encoder.turn;
+
+		if (turn == 0) {
+			if (angle) {
+				*angle = 0;
+			}
+			return 0;
+		}
+		int64_t turns = position / turn;
+		if (position % turn < 0) {
+			turns--;
+		}
+		if (angle) {
+			*angle = (uint32_t)(position - turns * turn);
+		}
+		return turns;
+	}
+
+	/** Times an index was found more than a count from where the turns
+	 * put it, each one meaning counts were lost or gained
+	 */
+	uint32_t slips() {
+		return _encoder.index_slips;
+	}
+
+	/** The cycle counter as the encoder's interrupt was last entered
+	 *
+	 * Only stamped when built with MBED_CONF_ENCODERIN_IRQ_TIMESTAMP=1,
+	 * and only meaningful once the application has enabled DWT->CYCCNT;
+	 * otherwise 0. Read DWT->CYCCNT first thing in an alarm callback; the
+	 * difference is what it took to get from the vector to the callback.
+	 * Stamping DWT->CYCCNT just before driving the encoder pin gives the
+	 * edge to the vector the same way.
+	 */
+	uint32_t irq_cycles() {
+		return _encoder.irq_cycles;
+	}
+
 	/** Starts the HW timer counting
 	 */
 	void start() {
-		core_util_critical_section_enter();
+		// Only touches CR1/CCER, which no ISR writes
 		encoderin_start(&_encoder);
-		core_util_critical_section_exit();
 	}
 
 	/** Resets the HW timer counter
+	 *
+	 * With an index, it homes again on the next one.
 	 */
 	void reset() {
+		// Rewrites the 64-bit position, which ISR readers must not see torn
 		core_util_critical_section_enter();
 		encoderin_reset(&_encoder);
 		core_util_critical_section_exit();
@@ -87,54 +202,141 @@ public:
 	/** Stops the HW timer counting
 	 */
 	void stop() {
-		core_util_critical_section_enter();
 		encoderin_stop(&_encoder);
-		core_util_critical_section_exit();	
 	}
 
+#if MBED_CONF_RTOS_PRESENT
+	/** Sleep the calling thread until the encoder moves onto a position
+	 *
+	 * Uses an alarm, so the thread is woken by the compare interrupt and
+	 * there is nothing to poll. It returns straight away if the encoder is
+	 * already there. One waiting thread per encoder.
+	 *
+	 * @param position read64() position to wait for, from either side
+	 * @param millisec longest wait, osWaitForever for no limit
+	 * @returns
+	 *	true once the encoder got there, false on a timeout
+	 */
+	bool wait_until_position(int64_t position, uint32_t millisec = osWaitForever) {
+		core_util_critical_section_enter();
+		if (encoderin_read64(&_encoder) == position) {
+			core_util_critical_section_exit();
+			return true;
+		}
+		_flags.clear(WAIT_FLAG);
+		encoderin_insert_alarm(&_encoder, &_wait_event, position, ENC_ALARM_BOTH, 0, &EncoderIn::_wait_irq, (uintptr_t)this);
+		core_util_critical_section_exit();
+
+		uint32_t flags = _flags.wait_any(WAIT_FLAG, millisec);
+
+		core_util_critical_section_enter();
+		encoderin_remove_alarm(&_encoder, &_wait_event);
+		core_util_critical_section_exit();
+		return (flags & osFlagsError) == 0;
+	}
+#endif
+
 	/** Attach a function to be called when the Encoder has reached a certain position
 	 *
-	 * @param func pointer to the function to be called
-	 * @param interval the location at which to trigger
+	 * The function is called every time the position moves onto the given
+	 * one, from either direction. Any number of EncoderAlarms can be used
+	 * on top of this one and alarm2.
+	 *
+	 * The location is a read64() position, taken as a signed 32-bit
+	 * number. It used to be the raw compare value, so on a 16-bit timer
+	 * 65036 was 500 counts below zero; now it is 65036 counts above.
+	 *
+	 * @param func pointer to the function to be called, or NULL to remove the alarm
+	 * @param interval the read64() position at which to trigger
 	 */
     void alarm1(Callback<void()> func, uint32_t interval) {
         core_util_critical_section_enter();
         if (func) {
             _alarm1.attach(func);
-            encoderin_set_irq(&_encoder, IRQ_ALARM1, interval);
-        }        
-        else {
-            _alarm1.attach(donothing);
-            encoderin_set_irq(&_encoder, IRQ_ALARM1, interval);
+            encoderin_insert_alarm(&_encoder, &_alarm1_event, (int32_t)interval, ENC_ALARM_BOTH, 0, &EncoderIn::_alarm1_irq, (uintptr_t)this);
+        } else {
+            encoderin_remove_alarm(&_encoder, &_alarm1_event);
         }
         core_util_critical_section_exit();
     }
 
 	/** Attach a function to be called by the Encoder has reached a certain position
 	 *
-	 * @param func pointer to the function to be called
-	 * @param interval the location at which to trigger
+	 * Like alarm1, a read64() position rather than a raw compare value.
+	 *
+	 * @param func pointer to the function to be called, or NULL to remove the alarm
+	 * @param interval the read64() position at which to trigger
 	 */
     void alarm2(Callback<void()> func, uint32_t interval) {
         core_util_critical_section_enter();
         if (func) {
             _alarm2.attach(func);
-            encoderin_set_irq(&_encoder, IRQ_ALARM2, interval);
+            encoderin_insert_alarm(&_encoder, &_alarm2_event, (int32_t)interval, ENC_ALARM_BOTH, 0, &EncoderIn::_alarm2_irq, (uintptr_t)this);
         } else {
-            _alarm2.attach(donothing);
-            encoderin_set_irq(&_encoder, IRQ_ALARM1, interval);
-        }       
+            encoderin_remove_alarm(&_encoder, &_alarm2_event);
+        }
+        core_util_critical_section_exit();
+    }
+
+	/** Move alarm1 without re-attaching its function
+	 *
+	 * @param interval the location at which to trigger
+	 */
+    void move_alarm1(uint32_t interval) {
+        core_util_critical_section_enter();
+        encoderin_move_alarm(&_encoder, &_alarm1_event, (int32_t)interval);
+        core_util_critical_section_exit();
+    }
+
+	/** Move alarm2 without re-attaching its function
+	 *
+	 * @param interval the location at which to trigger
+	 */
+    void move_alarm2(uint32_t interval) {
+        core_util_critical_section_enter();
+        encoderin_move_alarm(&_encoder, &_alarm2_event, (int32_t)interval);
         core_util_critical_section_exit();
     }
 
-    static void _irq_handler(uint32_t id, enc_irq_event event) {
+	/** Run the alarm functions from a queue instead of the interrupt
+	 *
+	 * Covers alarm1, alarm2 and this encoder's EncoderAlarms and
+	 * EncoderOuts. Each queues its number (1 and 2 for alarm1 and alarm2,
+	 * 0 for an EncoderAlarm, the channel, 3 or 4, for an EncoderOut) and
+	 * the position at the interrupt.
+	 *
+	 * @param queue queue to push onto, or NULL to call them from the interrupt
+	 */
+	void defer(DeferredQueue *queue) {
+		_queue = queue;
+	}
+
+    static void _alarm1_irq(uintptr_t id) {
         EncoderIn *handler = (EncoderIn*)id;
-        switch (event) {
-            case IRQ_ALARM1: handler->_alarm1.call(); break;
-            case IRQ_ALARM2: handler->_alarm2.call(); break;
+        if (handler->_queue) {
+            handler->_queue->push(&EncoderIn::_alarm1_deferred, id, 1, encoderin_read64(&handler->_encoder));
+        } else {
+            handler->_alarm1.call();
         }
     }
 
+    static void _alarm2_irq(uintptr_t id) {
+        EncoderIn *handler = (EncoderIn*)id;
+        if (handler->_queue) {
+            handler->_queue->push(&EncoderIn::_alarm2_deferred, id, 2, encoderin_read64(&handler->_encoder));
+        } else {
+            handler->_alarm2.call();
+        }
+    }
+
+    static void _alarm1_deferred(const DeferredEvent &event) {
+        ((EncoderIn*)event.id)->_alarm1.call();
+    }
+
+    static void _alarm2_deferred(const DeferredEvent &event) {
+        ((EncoderIn*)event.id)->_alarm2.call();
+    }
+
     void enable_irq() {
         core_util_critical_section_enter();
         encoderin_irq_enable(&_encoder);
@@ -148,9 +350,28 @@ public:
     }
 
 protected:
+    friend class EncoderAlarm;
+    friend class EncoderOut;
+    friend class SnapshotSampler;
+    friend class CountLatch;
+    friend class VelocityMeter;
+
 	encoderin_t _encoder;
+    encoderin_alarm_t _alarm1_event;
+    encoderin_alarm_t _alarm2_event;
     Callback<void()> _alarm1;
     Callback<void()> _alarm2;
+    DeferredQueue *_queue;
+#if MBED_CONF_RTOS_PRESENT
+    static const uint32_t WAIT_FLAG = 1;
+
+    static void _wait_irq(uintptr_t id) {
+        ((EncoderIn*)id)->_flags.set(WAIT_FLAG);
+    }
+
+    encoderin_alarm_t _wait_event;
+    rtos::EventFlags _flags;
+#endif
 }; //class EncoderIn
 
 } // namespace mbed
@@ -0,0 +1,183 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef ENCODEROUT_H
+#define ENCODEROUT_H
+
+#include "platform/platform.h"
+
+#if DEVICE_ENCODERIN
+
+#include "EncoderIn.h"
+#include "platform/Callback.h"
+#include "platform/critical.h"
+
+namespace mbed {
+
+/** A pin driven by an EncoderIn's position, in hardware
+ *
+ * The output is one of the encoder timer's compare channels, so it changes
+ * on the count that matches, with no interrupt and no jitter from one: the
+ * way to fire a camera or a laser at a position. It can set, reset or
+ * toggle at one position, give a pulse a number of counts long, or go
+ * through a table of positions, with the DMA loading the next one on each
+ * match.
+ *
+ * Outputs take CC3 and CC4, the channels the alarms run on: an encoder has
+ * either EncoderAlarms and alarm1/alarm2, or up to two EncoderOuts.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "EncoderOut.h"
+ *
+ * EncoderIn qei(PB_4, PB_5);
+ * EncoderOut camera(qei, PB_0);
+ *
+ * // 10 count frames at 1000, 1500 and 2000; the last entry ends the table
+ * const uint32_t frames[] = {1000, 1010, 1500, 1510, 2000, 2010, 2010};
+ *
+ * int main() {
+ *		qei.start();
+ *		camera.table(frames, 7);
+ *		while(1) {
+ *			//Loop forever
+ *		}
+ * }
+ * @endcode
+ */
+class EncoderOut {
+
+public:
+
+	/** Create an output on an encoder, inactive
+	 *
+	 * @param encoder EncoderIn whose position drives it
+	 * @param output pin from PinMap_ENC_OUT on the encoder's timer
+	 * @param active_low true for an active low output
+	 */
+    EncoderOut(EncoderIn &encoder, PinName output, bool active_low = false) : _encoder(encoder) {
+        core_util_critical_section_enter();
+        _channel = encoderin_output_init(&_encoder._encoder, output, active_low);
+        core_util_critical_section_exit();
+    }
+
+    ~EncoderOut() {
+        core_util_critical_section_enter();
+        encoderin_output_free(&_encoder._encoder, _channel);
+        core_util_critical_section_exit();
+    }
+
+	/** Act on the output every time the encoder moves onto a position
+	 *
+	 * On a 16-bit timer it also acts every 65536 counts from there.
+	 *
+	 * @param position position, as returned by EncoderIn::read64()
+	 * @param mode ENC_OUT_SET, ENC_OUT_RESET or ENC_OUT_TOGGLE
+	 */
+    void compare(int64_t position, enc_out_mode mode = ENC_OUT_SET) {
+        core_util_critical_section_enter();
+        encoderin_output_compare(&_encoder._encoder, _channel, position, mode);
+        core_util_critical_section_exit();
+    }
+
+	/** One pulse, from a position to width counts further on
+	 *
+	 * Positive widths are for counting up and negative ones for counting
+	 * down. The attached function is called once the pulse is over.
+	 *
+	 * @param position position, as returned by EncoderIn::read64(), of the start
+	 * @param width counts to the end, not 0
+	 */
+    void pulse(int64_t position, int32_t width) {
+        core_util_critical_section_enter();
+        encoderin_output_pulse(&_encoder._encoder, _channel, position, width,
+                               _function ? &EncoderOut::_irq_handler : NULL, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+	/** Act on the output at each position of a table in turn
+	 *
+	 * Without repeat the last entry only ends the table, see
+	 * encoderin_output_table(). The attached function is called each time
+	 * the last entry is loaded.
+	 *
+	 * @param positions hardware counts, as returned by EncoderIn::read(); read by the DMA as it goes
+	 * @param length entries
+	 * @param mode ENC_OUT_SET, ENC_OUT_RESET or ENC_OUT_TOGGLE
+	 * @param repeat true to go round the table for ever
+	 */
+    void table(const uint32_t *positions, uint16_t length, enc_out_mode mode = ENC_OUT_TOGGLE, bool repeat = false) {
+        core_util_critical_section_enter();
+        encoderin_output_table(&_encoder._encoder, _channel, positions, length, mode, repeat,
+                               _function ? &EncoderOut::_irq_handler : NULL, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+	/** Attach a function to be called at the end of a table or pulse
+	 *
+	 * Set before table() or pulse(); it goes through the encoder's
+	 * DeferredQueue if it has one.
+	 *
+	 * @param func pointer to the function to be called, or NULL for none
+	 */
+    void attach(Callback<void()> func) {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop comparing and hold the output
+	 *
+	 * @param value 1 for active, 0 for inactive
+	 */
+    void write(int value) {
+        core_util_critical_section_enter();
+        encoderin_output_write(&_encoder._encoder, _channel, value);
+        core_util_critical_section_exit();
+    }
+
+    /** An operator shorthand for write()
+     */
+    EncoderOut& operator= (int value) {
+        write(value);
+        return *this;
+    }
+
+    static void _irq_handler(uintptr_t id) {
+        EncoderOut *output = (EncoderOut*)id;
+        if (output->_encoder._queue) {
+            output->_encoder._queue->push(&EncoderOut::_deferred, id, output->_channel,
+                                          encoderin_read64(&output->_encoder._encoder));
+        } else {
+            output->_function.call();
+        }
+    }
+
+    static void _deferred(const DeferredEvent &deferred) {
+        EncoderOut *output = (EncoderOut*)deferred.id;
+        if (output->_function) {
+            output->_function.call();
+        }
+    }
+
+protected:
+    EncoderIn &_encoder;
+    uint8_t _channel;
+    Callback<void()> _function;
+}; //class EncoderOut
+
+} // namespace mbed
+
+#endif //DEVICE_ENCODERIN
+
+#endif //ENCODEROUT_H
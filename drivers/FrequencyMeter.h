@@ -0,0 +1,161 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef FREQUENCYMETER_H
+#define FREQUENCYMETER_H
+
+#include "platform/platform.h"
+
+#if DEVICE_COUNTERIN && DEVICE_SNAPSHOTSAMPLER
+
+#include "CounterIn.h"
+#include "SnapshotSampler.h"
+#include "platform/Callback.h"
+#include "platform/critical.h"
+
+namespace mbed {
+
+/** Measures the frequency on a CounterIn over fixed windows timed in hardware
+ *
+ * A reference timer marks the end of every window and the DMA copies the
+ * counter's CNT at that instant, so the windows are exactly the same length
+ * and back to back, and no edge is lost or counted twice between them. The
+ * edges in a window are the difference of two such samples; the CPU only
+ * takes one interrupt per window to work it out.
+ *
+ * The counter keeps running, so read() and read64() still work. At most
+ * one counter wrap fits in a window: 65535 edges on TIM3/TIM8 (including
+ * cascaded ones, whose low half is sampled), so pick the window to match.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "FrequencyMeter.h"
+ *
+ * CounterIn counter(PA_15);
+ * FrequencyMeter meter(counter);
+ *
+ * int main() {
+ *		counter.start();
+ *		meter.start(10);
+ *		while(1) {
+ *			printf("Frequency: %f Hz\r\n", meter.read());
+ *		}
+ * }
+ * @endcode
+ */
+class FrequencyMeter {
+
+public:
+
+	/** Set up a reference timer for a counter, not yet running
+	 *
+	 * @param counter CounterIn whose edges are measured
+	 * @param timer SMP_4 or SMP_5, a timer no other driver is using
+	 */
+    FrequencyMeter(CounterIn &counter, SMPName timer = SMP_4) :
+        _counter(counter), _sampler(_samples, 1, timer), _count(0), _valid(0) {
+        _sampler.add(counter);
+        _sampler.attach(callback(this, &FrequencyMeter::_window));
+    }
+
+	/** Attach a function to be called at the end of every window
+	 *
+	 * Called from the DMA interrupt with the count in the window, see count().
+	 *
+	 * @param func function taking the edge count
+	 */
+    void attach(Callback<void(uint32_t)> func) {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop calling the attached function, measuring carries on
+	 */
+    void detach() {
+        core_util_critical_section_enter();
+        _function = Callback<void(uint32_t)>();
+        core_util_critical_section_exit();
+    }
+
+	/** Start measuring
+	 *
+	 * @param hz windows per second, rounded to what the timer can do; the
+	 *        first result comes at the end of the second window
+	 */
+    void start(uint32_t hz) {
+        core_util_critical_section_enter();
+        _valid = 0;
+        _sampler.start(hz);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop measuring, the last result stays
+	 */
+    void stop() {
+        _sampler.stop();
+    }
+
+	/** Counts in the last complete window, one per edge unless the counter
+	 * uses the ETR prescaler
+	 */
+    uint32_t count() {
+        return _count;
+    }
+
+	/** Frequency over the last complete window, in Hz
+	 */
+    float read() {
+        return (float)((double)_count * _counter._counter.prescaler * 1e9 / (double)_sampler.period_ns());
+    }
+
+	/** Length of a window as actually programmed
+	 */
+    uint64_t window_ns() {
+        return _sampler.period_ns();
+    }
+
+    /** An operator shorthand for read()
+     */
+    operator float() {
+        return read();
+    }
+
+protected:
+    void _window(const uint32_t *block, uint32_t length) {
+        uint32_t sample = block[0];
+
+        if (_valid) {
+            _count = (sample - _last) & _counter._counter.handle.Init.Period;
+            if (_function) {
+                _function.call(_count);
+            }
+        }
+        _last = sample;
+        _valid = 1;
+    }
+
+    CounterIn &_counter;
+    uint32_t _samples[2];
+    SnapshotSampler _sampler;
+    volatile uint32_t _count;
+    uint32_t _last;
+    uint8_t _valid;
+    Callback<void(uint32_t)> _function;
+}; //class FrequencyMeter
+
+} // namespace mbed
+
+#endif
+
+#endif //FREQUENCYMETER_H
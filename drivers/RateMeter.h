@@ -0,0 +1,163 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef RATEMETER_H
+#define RATEMETER_H
+
+#include "platform/platform.h"
+
+#if DEVICE_COUNTERIN && DEVICE_RATEMETER
+
+#include "CounterIn.h"
+#include "hal/ratemeter_api.h"
+#include "platform/Callback.h"
+#include "platform/critical.h"
+
+namespace mbed {
+
+/** Measures the rate on a CounterIn from 0.1 Hz up, counting or timing its edges
+ *
+ * Fast signals are counted over fixed windows, exactly as FrequencyMeter
+ * does. Below a threshold it switches to timing the edges themselves: each
+ * one captures the reference timer through the internal trigger links, and
+ * every window the rate is the edges since the last timed one over the time
+ * between them, so a slow signal is resolved to one reference tick instead
+ * of one edge. Only slow signals interrupt per edge, at most up_hz times a
+ * second; going back to counting takes a rate above up_hz, which leaves
+ * room between the two thresholds so it does not flip back and forth.
+ *
+ * A new estimate is out at the end of every window. A window without an
+ * edge caps the rate at one edge over the time since the last one, so it
+ * falls off as soon as the signal stops, and reads 0 once no edge has come
+ * for 1 / min_hz.
+ *
+ * The counter keeps counting. Its CC1 capture and trigger output are used,
+ * so it cannot also be a CountLatch master or cascaded. Counting is bounded
+ * by one counter wrap per window, as for FrequencyMeter.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "RateMeter.h"
+ *
+ * CounterIn counter(PC_6);
+ * RateMeter meter(counter);
+ *
+ * int main() {
+ *		counter.start();
+ *		meter.start(10);
+ *		while(1) {
+ *			printf("%f Hz, %s\r\n", meter.read(), meter.counting() ? "counted" : "timed");
+ *		}
+ * }
+ * @endcode
+ */
+class RateMeter {
+
+public:
+
+	/** Set up a reference timer for a counter, not yet running
+	 *
+	 * @param counter CounterIn whose rate is measured, not cascaded
+	 * @param timer RATE_4 or RATE_5, a timer no other driver is using
+	 */
+    RateMeter(CounterIn &counter, RATEName timer = RATE_4) {
+        core_util_critical_section_enter();
+        ratemeter_init(&_meter, timer, &counter._counter.handle, counter._counter.channel);
+        ratemeter_set_irq(&_meter, &RateMeter::_irq_handler, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+	/** Attach a function to be called with every new estimate
+	 *
+	 * Called from the reference timer's interrupt with the rate in Hz.
+	 *
+	 * @param func function taking the rate
+	 */
+    void attach(Callback<void(float)> func) {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop calling the attached function, measuring carries on
+	 */
+    void detach() {
+        core_util_critical_section_enter();
+        _function = Callback<void(float)>();
+        core_util_critical_section_exit();
+    }
+
+	/** Start measuring, counting at first
+	 *
+	 * @param hz windows per second, so the latency of an estimate; rounded
+	 *        to what the timer can do
+	 * @param up_hz rate above which to count, also the most edge interrupts
+	 *        per second
+	 * @param down_hz rate below which to time edges, under up_hz
+	 * @param min_hz slowest rate to wait for before reading 0
+	 */
+    void start(uint32_t hz, uint32_t up_hz = 20000, uint32_t down_hz = 10000, float min_hz = 0.1f) {
+        core_util_critical_section_enter();
+        ratemeter_start(&_meter, hz, up_hz, down_hz, min_hz);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop measuring, the last estimate stays
+	 */
+    void stop() {
+        core_util_critical_section_enter();
+        ratemeter_stop(&_meter);
+        core_util_critical_section_exit();
+    }
+
+	/** The latest estimate, in Hz
+	 */
+    float read() {
+        return _meter.hz;
+    }
+
+	/** Whether the latest estimate was counted rather than timed
+	 */
+    bool counting() {
+        return _meter.mode == RATE_COUNT;
+    }
+
+	/** Length of a window as actually programmed
+	 */
+    uint64_t window_ns() {
+        return ratemeter_get_window_ns(&_meter);
+    }
+
+    /** An operator shorthand for read()
+     */
+    operator float() {
+        return read();
+    }
+
+    static void _irq_handler(uintptr_t id) {
+        RateMeter *handler = (RateMeter*)id;
+        if (handler->_function) {
+            handler->_function.call(handler->_meter.hz);
+        }
+    }
+
+protected:
+    ratemeter_t _meter;
+    Callback<void(float)> _function;
+}; //class RateMeter
+
+} // namespace mbed
+
+#endif
+
+#endif //RATEMETER_H
@@ -0,0 +1,188 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SNAPSHOTSAMPLER_H
+#define SNAPSHOTSAMPLER_H
+
+#include "platform/platform.h"
+
+#if DEVICE_SNAPSHOTSAMPLER
+
+#include "hal/snapshotsampler_api.h"
+#include "platform/Callback.h"
+#include "platform/critical.h"
+
+#if DEVICE_ENCODERIN
+#include "EncoderIn.h"
+#endif
+
+#if DEVICE_COUNTERIN
+#include "CounterIn.h"
+#endif
+
+namespace mbed {
+
+/** Samples encoder and counter positions at a fixed rate, in hardware
+ *
+ * A spare timer's update makes the DMA copy the CNT register of every added
+ * EncoderIn or CounterIn into a buffer, so the samples are exactly one
+ * period apart whatever the CPU is doing, and cost it nothing. The attached
+ * function is called with each block of samples while the next one fills.
+ *
+ * Samples are the raw 16-bit (32-bit on TIM2) counter values. The
+ * difference of two consecutive samples, cast to int16_t (int32_t on TIM2),
+ * is the movement in between, as long as it is under half a wrap.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "SnapshotSampler.h"
+ *
+ * EncoderIn x(PB_4, PB_5), y(PE_9, PE_11);
+ * uint32_t samples[2 * 2 * 100];
+ * SnapshotSampler sampler(samples, 100);
+ *
+ * void control(const uint32_t *block, uint32_t length) {
+ *		// block[i] is x, block[length + i] is y, 50us apart
+ * }
+ *
+ * int main() {
+ *		x.start();
+ *		y.start();
+ *		sampler.add(x);
+ *		sampler.add(y);
+ *		sampler.attach(&control);
+ *		sampler.start(20000);
+ *		while(1) {
+ *			//Loop forever
+ *		}
+ * }
+ * @endcode
+ */
+class SnapshotSampler {
+
+public:
+
+	/** Set up a sampling timer, not yet running
+	 *
+	 * @param buffer 2 * length words for every source that will be added
+	 * @param length samples per source in each block
+	 * @param timer SMP_4 or SMP_5, a timer no other driver is using
+	 */
+    SnapshotSampler(uint32_t *buffer, uint32_t length, SMPName timer = SMP_4) {
+        core_util_critical_section_enter();
+        snapshotsampler_init(&_sampler, timer, buffer, length);
+        snapshotsampler_set_irq(&_sampler, &SnapshotSampler::_irq_handler, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+    ~SnapshotSampler() {
+        core_util_critical_section_enter();
+        snapshotsampler_free(&_sampler);
+        core_util_critical_section_exit();
+    }
+
+#if DEVICE_ENCODERIN
+	/** Sample an encoder's position, before start()
+	 *
+	 * @returns index of its samples within a block, or -1 if all SMP_SOURCES are used
+	 */
+    int add(EncoderIn &encoder) {
+        return add(&encoder._encoder.handle.Instance->CNT);
+    }
+#endif
+
+#if DEVICE_COUNTERIN
+	/** Sample a counter's count, before start()
+	 *
+	 * @returns index of its samples within a block, or -1 if all SMP_SOURCES are used
+	 */
+    int add(CounterIn &counter) {
+        return add(&counter._counter.handle.Instance->CNT);
+    }
+#endif
+
+	/** Sample any 32-bit peripheral register, before start()
+	 *
+	 * @returns index of its samples within a block, or -1 if all SMP_SOURCES are used
+	 */
+    int add(volatile uint32_t *reg) {
+        core_util_critical_section_enter();
+        int index = snapshotsampler_add(&_sampler, reg);
+        core_util_critical_section_exit();
+        return index;
+    }
+
+	/** Attach a function to be called with each block of samples
+	 *
+	 * Called from the DMA interrupt. The block holds 'length' samples of
+	 * the first source added, then 'length' of the second, and so on, and
+	 * stays untouched for one block time.
+	 *
+	 * @param func function taking the block and the samples per source
+	 */
+    void attach(Callback<void(const uint32_t*, uint32_t)> func) {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop calling the attached function, sampling carries on
+	 */
+    void detach() {
+        core_util_critical_section_enter();
+        _function = Callback<void(const uint32_t*, uint32_t)>();
+        core_util_critical_section_exit();
+    }
+
+	/** Start sampling, from the start of the buffer
+	 *
+	 * @param hz samples per second, rounded to what the timer can do
+	 */
+    void start(uint32_t hz) {
+        core_util_critical_section_enter();
+        snapshotsampler_start(&_sampler, hz);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop sampling
+	 */
+    void stop() {
+        core_util_critical_section_enter();
+        snapshotsampler_stop(&_sampler);
+        core_util_critical_section_exit();
+    }
+
+	/** Time between two samples as actually programmed
+	 */
+    uint64_t period_ns() {
+        return snapshotsampler_get_period_ns(&_sampler);
+    }
+
+    static void _irq_handler(uintptr_t id, const uint32_t *block) {
+        SnapshotSampler *sampler = (SnapshotSampler*)id;
+
+        if (sampler->_function) {
+            sampler->_function.call(block, sampler->_sampler.length);
+        }
+    }
+
+protected:
+    snapshotsampler_t _sampler;
+    Callback<void(const uint32_t*, uint32_t)> _function;
+}; //class SnapshotSampler
+
+} // namespace mbed
+
+#endif //DEVICE_SNAPSHOTSAMPLER
+
+#endif //SNAPSHOTSAMPLER_H
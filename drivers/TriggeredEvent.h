@@ -0,0 +1,177 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef TRIGGEREDEVENT_H
+#define TRIGGEREDEVENT_H
+
+#include "platform/platform.h"
+
+#if DEVICE_TRIGGEREDTIMEOUT
+
+#include "TriggeredTimeout.h"
+#include "platform/Callback.h"
+#include "platform/critical.h"
+
+namespace mbed {
+
+/** An extra delayed event after the trigger edge of a TriggeredTimeout
+ *
+ * Each event takes one of the compare channels of the TriggeredTimeout's
+ * timer, so one timer gives the TriggeredTimeout's own delay plus up to
+ * three events (two if it also drives a pulse output). An event calls a
+ * function, drives a pin, or both.
+ *
+ * Events are measured from the same edge as the TriggeredTimeout and run
+ * once per period of it, so the TriggeredTimeout's delay has to be the
+ * longest one; an event set past it never happens. With attach() the
+ * period keeps repeating after the first edge; in pulse mode there is one
+ * period, and so one run of every event, per edge.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "TriggeredEvent.h"
+ *
+ * TriggeredTimeout sequence(PA_15, PB_3);	// gate on PB_3
+ * TriggeredEvent valve(sequence, PB_10);	// valve on PB_10
+ * TriggeredEvent sample(sequence);		// interrupt only
+ *
+ * void take_sample() {
+ *		//middle stage
+ * }
+ *
+ * int main() {
+ *		sequence.pulse_us(50, 950);		// gate from 50us to 1ms after each edge
+ *		valve.set_us(100);			// valve from 100us to 1ms
+ *		sample.attach_us(&take_sample, 400);
+ *		while(1) {
+ *			//Loop forever
+ *		}
+ * }
+ * @endcode
+ */
+class TriggeredEvent {
+
+public:
+
+	/** Create an event that only calls a function
+	 *
+	 * @param timeout TriggeredTimeout whose trigger and period to share
+	 */
+    TriggeredEvent(TriggeredTimeout &timeout) : _timeout(timeout) {
+        core_util_critical_section_enter();
+        _channel = trigger_event_init(&_timeout._tt, NC, 0);
+        core_util_critical_section_exit();
+    }
+
+	/** Create an event that drives a pin
+	 *
+	 * The pin goes active at the event and back inactive at the end of the
+	 * TriggeredTimeout's period.
+	 *
+	 * @param timeout TriggeredTimeout whose trigger and period to share
+	 * @param output pin on a free channel of the same timer
+	 * @param active_low true for an active low output
+	 */
+    TriggeredEvent(TriggeredTimeout &timeout, PinName output, bool active_low = false) : _timeout(timeout) {
+        core_util_critical_section_enter();
+        _channel = trigger_event_init(&_timeout._tt, output, active_low);
+        core_util_critical_section_exit();
+    }
+
+    ~TriggeredEvent() {
+        core_util_critical_section_enter();
+        trigger_event_free(&_timeout._tt, _channel);
+        core_util_critical_section_exit();
+    }
+
+    void attach(Callback<void()> func, float seconds)
+    {
+        attach_ns(func, (uint64_t)(seconds * 1000000000.0));
+    }
+
+    void attach_us(Callback<void()> func, int us)
+    {
+        attach_ns(func, (uint64_t)us * 1000);
+    }
+
+	/** Set the event a number of nanoseconds after each trigger edge
+	 *
+	 * @param func pointer to the function to be called
+	 * @param ns delay from the trigger edge, in nanoseconds
+	 */
+    void attach_ns(Callback<void()> func, uint64_t ns)
+    {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        trigger_set_event_ns(&_timeout._tt, _channel, ns,
+                             func ? &TriggeredEvent::_irq_handler : NULL, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+	/** Drive the output a number of microseconds after each trigger edge, without calling anything
+	 */
+    void set_us(int us)
+    {
+        set_ns((uint64_t)us * 1000);
+    }
+
+	/** Drive the output a number of nanoseconds after each trigger edge, without calling anything
+	 */
+    void set_ns(uint64_t ns)
+    {
+        attach_ns(Callback<void()>(), ns);
+    }
+
+	/** Stop the event
+	 */
+    void detach()
+    {
+        core_util_critical_section_enter();
+        trigger_clear_event(&_timeout._tt, _channel);
+        core_util_critical_section_exit();
+    }
+
+	/** Return the delay actually programmed, in nanoseconds
+	 */
+    uint64_t delay_ns()
+    {
+        return trigger_get_event_ns(&_timeout._tt, _channel);
+    }
+
+    static void _irq_handler(uintptr_t id) {
+        TriggeredEvent *event = (TriggeredEvent*)id;
+        if (event->_timeout._queue) {
+            event->_timeout._queue->push(&TriggeredEvent::_deferred, id, event->_channel, 0);
+        } else {
+            event->_function.call();
+        }
+    }
+
+    static void _deferred(const DeferredEvent &deferred) {
+        TriggeredEvent *event = (TriggeredEvent*)deferred.id;
+        if (event->_function) {
+            event->_function.call();
+        }
+    }
+
+protected:
+    TriggeredTimeout &_timeout;
+    uint8_t _channel;
+    Callback<void()> _function;
+}; //class TriggeredEvent
+
+} // namespace mbed
+
+#endif //DEVICE_TRIGGEREDTIMEOUT
+
+#endif //TRIGGEREDEVENT_H
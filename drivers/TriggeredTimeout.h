@@ -19,11 +19,13 @@
 #if DEVICE_TRIGGEREDTIMEOUT
 #include "hal/triggeredtimeout_api.h"
 #include "platform/critical.h"
+#include "DeferredQueue.h"
+#if MBED_CONF_RTOS_PRESENT
+#include "rtos/EventFlags.h"
+#endif
 
 namespace mbed {
 
-static void donothing() {}
-
 /** \addtogroup drivers */
 /** @{*/
 
@@ -48,41 +50,174 @@ static void donothing() {}
  *		}
  * }
  * @endcode
+ *
+ * With an output pin the timer can also raise a pulse a set time after
+ * each edge on its own, with no interrupt in between:
+ * @code
+ * TriggeredTimeout strobe(PA_15, PB_10);
+ *
+ * int main() {
+ *		strobe.pulse_us(250, 10);	// 10us pulse, 250us after each edge
+ *		while(1) {
+ *			//Loop forever
+ *		}
+ * }
+ * @endcode
  */
 class TriggeredTimeout {
 
 public:
 
-    TriggeredTimeout(PinName pin) {
+    TriggeredTimeout(PinName pin) : _queue(NULL), _waiting(false) {
+        core_util_critical_section_enter();
+        triggeredtimeout_init(&_tt, pin, &TriggeredTimeout::_irq_handler, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+    /** Create a TriggeredTimeout that can also drive a pulse output
+     *
+     *  @param pin trigger input
+     *  @param output pin on another channel of the same timer
+     *  @param active_low true for low pulses on a high idle level
+     */
+    TriggeredTimeout(PinName pin, PinName output, bool active_low = false) : _queue(NULL), _waiting(false) {
         core_util_critical_section_enter();
-        triggeredtimeout_init(&_tt, pin, &TriggeredTimeout::_irq_handler, (uint32_t)this);
+        triggeredtimeout_init(&_tt, pin, &TriggeredTimeout::_irq_handler, (uintptr_t)this);
+        trigger_pulse_init(&_tt, output, active_low);
         core_util_critical_section_exit();
     }
 
     void attach(Callback<void()> func, float seconds)
     {
-        attach_us(func, seconds * 1000000.0f);
+        attach_ns(func, (uint64_t)(seconds * 1000000000.0));
     }
 
     void attach_ms(Callback<void()> func, int ms)
     {
-       attach_us(func, ms * 1000); 
+        attach_ns(func, (uint64_t)ms * 1000000);
     }
 
     void attach_us(Callback<void()> func, int us)
     {
-        if(func) {
-            _function.attach(func);
-            trigger_set_irq(&_tt, us);
-        } else {
-            _function.attach(donothing);
-            trigger_set_irq(&_tt, us);
-        }
+        attach_ns(func, (uint64_t)us * 1000);
     }
 
-    static void _irq_handler(uint32_t id) {
+    /** Attach a function to be called a number of nanoseconds after each trigger edge
+     *
+     *  The delay is rounded to the nearest timer tick, 11.1ns with a 90MHz
+     *  timer clock, up to about 47s. Re-attaching only rewrites the timer's
+     *  count registers.
+     *
+     *  @param func pointer to the function to be called, NULL to stop calling
+     *  @param ns delay from the trigger edge, in nanoseconds
+     */
+    void attach_ns(Callback<void()> func, uint64_t ns)
+    {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        trigger_set_irq_ns(&_tt, ns);
+        core_util_critical_section_exit();
+    }
+
+    /** Return the delay actually programmed, in nanoseconds
+     *
+     *  In pulse mode, this is the delay to the start of the pulse.
+     */
+    uint64_t delay_ns()
+    {
+        return trigger_get_delay_ns(&_tt);
+    }
+
+    /** Pulse the output a number of microseconds after each trigger edge
+     *
+     *  The pulse is generated entirely by the timer, so its jitter against
+     *  the filtered edge is one timer tick and no interrupt is taken.
+     *  Replaces any attached function; attach() switches back.
+     *
+     *  @param delay_us from the trigger edge to the start of the pulse
+     *  @param width_us pulse length
+     *  @param repeat false to pulse on the next edge only
+     */
+    void pulse_us(int delay_us, int width_us, bool repeat = true)
+    {
+        pulse_ns((uint64_t)delay_us * 1000, (uint64_t)width_us * 1000, repeat);
+    }
+
+    /** Pulse the output a number of nanoseconds after each trigger edge
+     *
+     *  @param delay_ns from the trigger edge to the start of the pulse
+     *  @param width_ns pulse length
+     *  @param repeat false to pulse on the next edge only
+     */
+    void pulse_ns(uint64_t delay_ns, uint64_t width_ns, bool repeat = true)
+    {
+        core_util_critical_section_enter();
+        _function = Callback<void()>();
+        trigger_set_pulse_ns(&_tt, delay_ns, width_ns, repeat ? TRG_MODE_PULSE : TRG_MODE_PULSE_ONCE);
+        core_util_critical_section_exit();
+    }
+
+    /** Return the pulse width actually programmed, in nanoseconds
+     */
+    uint64_t width_ns()
+    {
+        return trigger_get_width_ns(&_tt);
+    }
+
+    /** Run the attached function from a queue instead of the interrupt
+     *
+     *  Covers this timer's TriggeredEvents too. The timeout queues event
+     *  0 and each TriggeredEvent its compare channel, all with a count of 0.
+     *
+     *  @param queue queue to push onto, or NULL to call it from the interrupt
+     */
+    void defer(DeferredQueue *queue)
+    {
+        _queue = queue;
+    }
+
+#if MBED_CONF_RTOS_PRESENT
+    /** Sleep the calling thread until the delay after the next trigger edge
+     *
+     *  Woken by the same interrupt that calls the attached function, so it
+     *  needs attach() (a NULL function will do) and not pulse mode. One
+     *  waiting thread per timeout.
+     *
+     *  @param millisec longest wait, osWaitForever for no limit
+     *  @returns true once the delay has run out, false on a timeout
+     */
+    bool wait(uint32_t millisec = osWaitForever)
+    {
+        _waiting = true;
+        _flags.clear(WAIT_FLAG);
+        uint32_t flags = _flags.wait_any(WAIT_FLAG, millisec);
+        _waiting = false;
+        return (flags & osFlagsError) == 0;
+    }
+#endif
+
+    static void _irq_handler(uintptr_t id) {
         TriggeredTimeout *handler = (TriggeredTimeout*)id;
-        handler->_function.call();
+#if MBED_CONF_RTOS_PRESENT
+        if (handler->_waiting) {
+            handler->_flags.set(WAIT_FLAG);
+        }
+#endif
+        if (handler->_function) {
+            if (handler->_queue) {
+                handler->_queue->push(&TriggeredTimeout::_deferred, id, 0, 0);
+            } else {
+                handler->_function.call();
+            }
+        }
+    }
+
+    static void _deferred(const DeferredEvent &event) {
+        TriggeredTimeout *handler = (TriggeredTimeout*)event.id;
+        // Might have been detached since
+        if (handler->_function) {
+            handler->_function.call();
+        }
     }
 
     void enable_irq() {
@@ -98,9 +233,18 @@ public:
     }
 
 protected:
+    friend class TriggeredEvent;
+
     triggeredtimeout_t _tt;
 
     Callback<void()> _function;
+    DeferredQueue *_queue;
+    volatile bool _waiting;
+#if MBED_CONF_RTOS_PRESENT
+    static const uint32_t WAIT_FLAG = 1;
+
+    rtos::EventFlags _flags;
+#endif
 };
 
 } // namespace mbed
@@ -0,0 +1,154 @@
+/* Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef VELOCITYMETER_H
+#define VELOCITYMETER_H
+
+#include "platform/platform.h"
+
+#if DEVICE_ENCODERIN && DEVICE_VELOCITYMETER
+
+#include "EncoderIn.h"
+#include "hal/velocitymeter_api.h"
+#include "platform/Callback.h"
+#include "platform/critical.h"
+
+namespace mbed {
+
+/** Measures the speed of an EncoderIn, from a crawl to full speed
+ *
+ * Every rising edge of channel A latches the encoder's position, and
+ * through the internal trigger links the time on a reference timer, all
+ * in hardware. At the end of each window the speed is the counts between
+ * the last edge and the last one before it over the time between them, so
+ * at speed it is the counts in about a window, and at a crawl the one
+ * cycle in however many windows it took, both timed to a reference tick.
+ * One interrupt per window, however fast the encoder goes.
+ *
+ * A window without an edge caps the speed at one cycle over the time
+ * since the last edge, so it falls off as soon as the shaft stops, and
+ * reads 0 once no edge has come for a cycle at min_speed.
+ *
+ * The encoder keeps counting. Its CC1 capture and trigger output are used,
+ * so it cannot also have an index or be in a CountLatch.
+ *
+ * Example
+ * @code
+ * #include "mbed.h"
+ * #include "VelocityMeter.h"
+ *
+ * EncoderIn qei(PB_4, PB_5);
+ * VelocityMeter speed(qei);
+ *
+ * int main() {
+ *		qei.start();
+ *		speed.start(1000);
+ *		while(1) {
+ *			printf("%f counts/s\r\n", speed.read());
+ *		}
+ * }
+ * @endcode
+ */
+class VelocityMeter {
+
+public:
+
+	/** Set up a reference timer for an encoder, not yet running
+	 *
+	 * @param encoder EncoderIn whose speed is measured
+	 * @param timer VEL_4 (for ENC_1/2/3) or VEL_5 (for ENC_2/3/4), a timer
+	 *        no other driver is using
+	 */
+    VelocityMeter(EncoderIn &encoder, VELName timer = VEL_4) {
+        core_util_critical_section_enter();
+        velocitymeter_init(&_meter, timer, &encoder._encoder.handle);
+        velocitymeter_set_irq(&_meter, &VelocityMeter::_irq_handler, (uintptr_t)this);
+        core_util_critical_section_exit();
+    }
+
+	/** Attach a function to be called with every new estimate
+	 *
+	 * Called from the reference timer's interrupt with the speed in
+	 * counts per second.
+	 *
+	 * @param func function taking the speed
+	 */
+    void attach(Callback<void(float)> func) {
+        core_util_critical_section_enter();
+        _function.attach(func);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop calling the attached function, measuring carries on
+	 */
+    void detach() {
+        core_util_critical_section_enter();
+        _function = Callback<void(float)>();
+        core_util_critical_section_exit();
+    }
+
+	/** Start measuring
+	 *
+	 * @param hz windows per second, so the latency of an estimate; rounded
+	 *        to what the timer can do
+	 * @param min_speed slowest speed to wait for before reading 0, in
+	 *        counts per second
+	 */
+    void start(uint32_t hz, float min_speed = 1.0f) {
+        core_util_critical_section_enter();
+        velocitymeter_start(&_meter, hz, min_speed);
+        core_util_critical_section_exit();
+    }
+
+	/** Stop measuring, the last estimate stays
+	 */
+    void stop() {
+        core_util_critical_section_enter();
+        velocitymeter_stop(&_meter);
+        core_util_critical_section_exit();
+    }
+
+	/** The latest estimate, in counts per second, negative counting down
+	 */
+    float read() {
+        return _meter.speed;
+    }
+
+	/** Length of a window as actually programmed
+	 */
+    uint64_t window_ns() {
+        return velocitymeter_get_window_ns(&_meter);
+    }
+
+    /** An operator shorthand for read()
+     */
+    operator float() {
+        return read();
+    }
+
+    static void _irq_handler(uintptr_t id) {
+        VelocityMeter *handler = (VelocityMeter*)id;
+        if (handler->_function) {
+            handler->_function.call(handler->_meter.speed);
+        }
+    }
+
+protected:
+    velocitymeter_t _meter;
+    Callback<void(float)> _function;
+}; //class VelocityMeter
+
+} // namespace mbed
+
+#endif
+
+#endif //VELOCITYMETER_H
@@ -0,0 +1,92 @@
+/** \addtogroup hal */
+/** @{*/
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MERE_CAPTUREIN_API_H
+#define MERE_CAPTUREIN_API_H
+
+#include "device.h"
+#include "counterin_api.h"
+
+#if DEVICE_CAPTUREIN
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Capture runs on the same pins and timers as the counter (PinMap_CNT), with
+ * the timer on its internal clock and the pin's channel in capture mode */
+
+typedef enum {
+    CAP_HALF = 0,           // first half of the buffer filled
+    CAP_FULL                // second half filled, DMA wrapped to the start
+} capturein_event;
+
+typedef void (*cap_irq_handler)(uintptr_t id, capturein_event event);
+
+struct capturein_s {
+    counterin_t counter;        // pin, timer and the extended time base
+    DMA_HandleTypeDef dma;
+    uint32_t *buffer;
+    uint32_t length;
+    uint32_t clock;             // timer clock in Hz, one timestamp tick
+    cap_irq_handler handler;
+    uintptr_t id;
+};
+
+typedef struct capturein_s capturein_t;
+
+/** Set up a pin to timestamp its edges into a circular buffer
+ *
+ * Every active edge latches the free-running timer into CCRx and the DMA
+ * moves it to the next word of the buffer, so the CPU is only interrupted
+ * each time half the buffer has filled.
+ *
+ * The DMA stream is taken from here on: DMA1 stream 5 for TIM2, DMA1 stream
+ * 4 for TIM3 and DMA2 stream 3 for TIM8.
+ *
+ * @param obj capture object
+ * @param pin pin from PinMap_CNT, its inverted flag selects the falling edge
+ * @param buffer timestamps, raw counter values (16 bits on TIM3/TIM8)
+ * @param length buffer length in words, 2 to 65535
+ */
+void capturein_init(capturein_t* obj, PinName pin, uint32_t* buffer, uint32_t length);
+
+/** Set the function called with CAP_HALF/CAP_FULL, from the DMA interrupt */
+void capturein_set_irq(capturein_t* obj, cap_irq_handler handler, uintptr_t id);
+
+/** Start timestamping from the start of the buffer */
+void capturein_start(capturein_t* obj);
+
+void capturein_stop(capturein_t* obj);
+
+/** Index of the buffer word the next edge will be written to */
+uint32_t capturein_index(capturein_t* obj);
+
+/** Current time in timer ticks, extended to 64 bits like counterin_read64 */
+uint64_t capturein_read64(capturein_t* obj);
+
+/**@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
+
+/** @}*/
@@ -27,12 +27,37 @@
 extern "C" {
 #endif
 
+typedef void (*cnt_irq_handler)(uintptr_t id);
+
+/** A count alarm, kept by the counter in a list sorted by count
+ *
+ * The alarm fires once the count reaches it. With a period it then moves
+ * that many counts on and fires again, otherwise it leaves the list. A
+ * periodic alarm that finds itself more than a period behind the count
+ * fires once and skips to the next multiple of the period ahead. The
+ * storage belongs to the caller and must stay valid until it is removed.
+ */
+typedef struct counterin_alarm_s {
+    uint64_t count;                 // read64 count of the next call
+    uint32_t period;                // counts between calls, 0 to call once
+    cnt_irq_handler handler;
+    uintptr_t id;
+    struct counterin_alarm_s *next;
+} counterin_alarm_t;
+
 typedef enum {
     CNT_2 = (int)TIM2_BASE,
     CNT_3 = (int)TIM3_BASE,
     CNT_8 = (int)TIM8_BASE
 } CNTName;
 
+/* Timers that can take the high half of a 16-bit counter, counting its
+ * update events through an ITR: TIM1 follows TIM3, TIM4 follows TIM3 or TIM8 */
+typedef enum {
+    CNT_CASCADE_1 = (int)TIM1_BASE,
+    CNT_CASCADE_4 = (int)TIM4_BASE
+} CNTCascade;
+
 const PinMap PinMap_CNT[] = {
     {PA_15, CNT_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 1, 0)},
 	{PC_6, CNT_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 1, 0)},
@@ -40,25 +65,159 @@ const PinMap PinMap_CNT[] = {
 	{NC, NC, 0}
 };
 
+/* ETR inputs of the same timers, for external clock mode 2. PA_5 and PA_15
+ * are TIM2_CH1 as well, PA_0 is TIM8_ETR only here. */
+const PinMap PinMap_CNT_ETR[] = {
+    {PA_0,  CNT_8, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF3_TIM8, 0, 0)},
+    {PA_5,  CNT_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 0, 0)},
+    {PA_15, CNT_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 0, 0)},
+    {PD_2,  CNT_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 0, 0)},
+    {NC, NC, 0}
+};
+
+/* How the pin clocks the counter
+ *
+ * Every edge has to get through the input filter, which needs N samples in
+ * a row at the same level: so both levels of the pulse train must last
+ * N / fSAMPLING, and at 50% duty the rate is at most fSAMPLING / 2N. Without
+ * a filter an edge still takes the resynchronisation to the timer clock,
+ * which caps it at fCK_INT / 4. fCK_INT is 90MHz for TIM2/TIM3 and 180MHz
+ * for TIM8 on a 180MHz F429, so the ceilings are:
+ *
+ *   filter  fSAMPLING  N   max rate       at 90MHz   at 180MHz
+ *     0     fCK_INT    1   fCK_INT / 4    22.5MHz    45MHz
+ *     1     fCK_INT    2   fCK_INT / 4    22.5MHz    45MHz
+ *     2     fCK_INT    4   fCK_INT / 8    11.2MHz    22.5MHz
+ *     3     fCK_INT    8   fCK_INT / 16   5.6MHz     11.2MHz
+ *     4     fCK_INT/2  6   fCK_INT / 24   3.7MHz     7.5MHz
+ *     5     fCK_INT/2  8   fCK_INT / 32   2.8MHz     5.6MHz
+ *     6     fCK_INT/4  6   fCK_INT / 48   1.9MHz     3.7MHz
+ *     7     fCK_INT/4  8   fCK_INT / 64   1.4MHz     2.8MHz
+ *     8     fCK_INT/8  6   fCK_INT / 96   937kHz     1.9MHz
+ *     9     fCK_INT/8  8   fCK_INT / 128  703kHz     1.4MHz
+ *    10     fCK_INT/16 5   fCK_INT / 160  562kHz     1.1MHz
+ *    11     fCK_INT/16 6   fCK_INT / 192  469kHz     937kHz
+ *    12     fCK_INT/16 8   fCK_INT / 256  352kHz     703kHz
+ *    13     fCK_INT/32 5   fCK_INT / 320  281kHz     562kHz
+ *    14     fCK_INT/32 6   fCK_INT / 384  234kHz     469kHz
+ *    15     fCK_INT/32 8   fCK_INT / 512  176kHz     352kHz
+ *
+ * Counting both edges on TI takes the same pulse train at the same ceiling
+ * and counts twice per pulse. On ETR the prescaler divides before the
+ * filter and the resynchronisation, so each of those ceilings goes up by
+ * the prescaler: x8 takes filter 3 to 45MHz on TIM2. Past about 50MHz the
+ * pin itself is the limit rather than the timer. */
+typedef enum {
+    CNT_CLOCK_TI = 0,       // external clock mode 1, a PinMap_CNT channel pin
+    CNT_CLOCK_ETR           // external clock mode 2, a PinMap_CNT_ETR pin
+} CNTClock;
+
+typedef enum {
+    CNT_EDGE_PIN = 0,       // rising, or falling if the pin map says inverted
+    CNT_EDGE_RISING,
+    CNT_EDGE_FALLING,
+    CNT_EDGE_BOTH           // CNT_CLOCK_TI only, two counts per pulse
+} CNTEdge;
+
+typedef enum {
+    CNT_ETR_DIV1 = 0,       // CNT_CLOCK_ETR only, one count per 1/2/4/8 edges
+    CNT_ETR_DIV2,
+    CNT_ETR_DIV4,
+    CNT_ETR_DIV8
+} CNTPrescaler;
+
+typedef struct {
+    CNTClock clock;
+    uint8_t filter;         // 0-15, see above
+    CNTEdge edge;
+    CNTPrescaler prescaler;
+} counterin_config_t;
+
+/* What counterin_init uses */
+#define COUNTERIN_CONFIG_DEFAULT    {CNT_CLOCK_TI, 15, CNT_EDGE_PIN, CNT_ETR_DIV1}
+
 struct counterin_s {
     CNTName cnt;
     PinName pin;
-    uint8_t channel;
+    uint8_t channel;            // 1 or 2, 0 when clocked from ETR
     uint8_t inverted;
+    uint8_t prescaler;          // edges per count
+    TIM_HandleTypeDef handle;
+    TIM_HandleTypeDef high;     // high half when cascaded, Instance NULL otherwise
+    volatile uint64_t overflow[2];  // counts carried out of CNT by update events, the one seq picks
+    volatile uint32_t seq;          // see counterin_read64
+    counterin_alarm_t *alarms;  // sorted by count, lowest first
+    uint8_t alarm_busy;         // handlers are being called
 };
 
 typedef struct counterin_s counterin_t;
 
 void counterin_init(counterin_t* obj, PinName pin);
 
+/** Count with a given filter, edge and clock mode
+ *
+ * @param obj counter object
+ * @param pin pin from PinMap_CNT, or PinMap_CNT_ETR with CNT_CLOCK_ETR
+ * @param config clock mode, filter, edges and ETR prescaler
+ */
+void counterin_init_config(counterin_t* obj, PinName pin, const counterin_config_t* config);
+
+/** Count on a 16-bit timer with a second one as its high half
+ *
+ * The counter's update event goes out on TRGO and clocks the high timer
+ * through its ITR input, so the count is 32 bits in hardware and the low
+ * timer never interrupts. Only the high timer's wraps, one every 2^32
+ * edges, go through the update interrupt for read64.
+ *
+ * @param obj counter object
+ * @param pin pin on CNT_3 or CNT_8, PinMap_CNT or PinMap_CNT_ETR
+ * @param high timer for the high half, one no other driver is using
+ * @param config as for counterin_init_config, NULL for the default
+ */
+void counterin_init_cascade(counterin_t* obj, PinName pin, CNTCascade high, const counterin_config_t* config);
+
 void counterin_start(counterin_t* obj);
 
 void counterin_reset(counterin_t* obj);
 
 void counterin_stop(counterin_t* obj);
 
+/** Read the count, both halves together when cascaded */
 uint32_t counterin_read(counterin_t* obj);
 
+/** Read the count extended past the width of the timer
+ *
+ * Every counter wrap is accumulated by the update interrupt. A wrap that
+ * is still pending is accounted for here. Lock-free and safe at any
+ * priority, including from an interrupt that preempts the update interrupt
+ * halfway through: that one writes the new total into the overflow slot
+ * readers are not using, then makes seq odd to switch them over to it while
+ * the flag it has counted is still up, and even again once it is cleared.
+ * The library leaves the NVIC priorities to the application.
+ */
+uint64_t counterin_read64(counterin_t* obj);
+
+/** Add an alarm, or move it if it is already in the list
+ *
+ * Counts only go up, so channel 3 compares against the lowest alarm alone,
+ * once that one is within the timer's current wrap: any number of alarms
+ * costs the wraps on the way plus one interrupt per call. An alarm already
+ * reached is called from here. Not on a cascaded counter. Call with
+ * interrupts masked.
+ *
+ * @param obj counter object
+ * @param alarm caller's storage for the alarm
+ * @param count read64 count of the first call
+ * @param period counts between calls after that, 0 to call once
+ * @param handler called from the timer interrupt, or from here
+ * @param id passed to handler
+ */
+void counterin_insert_alarm(counterin_t* obj, counterin_alarm_t* alarm, uint64_t count, uint32_t period, cnt_irq_handler handler, uintptr_t id);
+
+/** Take an alarm out of the list, if it is still there. Call with
+ * interrupts masked. */
+void counterin_remove_alarm(counterin_t* obj, counterin_alarm_t* alarm);
+
 /**@}*/
 
 #ifdef __cplusplus
@@ -0,0 +1,113 @@
+/** \addtogroup hal */
+/** @{*/
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef COUNTLATCH_API_H
+#define COUNTLATCH_API_H
+
+#include "device.h"
+#include "pinmap.h"
+
+#if DEVICE_COUNTLATCH
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Timers latched together, the first one added being the master */
+#define LATCH_MEMBERS       4
+
+/* External trigger pins, each on the timer of the first member. Channel 0
+ * is the timer's ETR, for an encoder; 1 or 2 is the counter channel that
+ * CounterIn does not count on. */
+const PinMap PinMap_LATCH[] = {
+    {PE_7,  (int)TIM1_BASE, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 0, 0)},
+    {PA_12, (int)TIM1_BASE, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 0, 0)},
+    {PA_1,  (int)TIM2_BASE, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 2, 0)},
+    {PB_3,  (int)TIM2_BASE, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 2, 0)},
+    {PD_2,  (int)TIM3_BASE, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 0, 0)},
+    {PA_7,  (int)TIM3_BASE, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 2, 0)},
+    {PE_0,  (int)TIM4_BASE, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 0, 0)},
+    {PC_6,  (int)TIM8_BASE, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF3_TIM8, 1, 0)},
+    {NC, NC, 0}
+};
+
+struct countlatch_s {
+    PinName pin;                                // external trigger, NC for software only
+    TIM_HandleTypeDef *member[LATCH_MEMBERS];   // member[0] is the master
+    uint8_t members;
+};
+
+typedef struct countlatch_s countlatch_t;
+
+/** Set up a group of counters latched by one trigger
+ *
+ * The first member added is the master: the trigger captures its CNT into
+ * CCR1, and the resulting CC1 pulse on its TRGO makes every other member
+ * capture its own CNT into CCR1 through its ITR input. The slaves latch a
+ * couple of timer clocks after the master, all on the same edge.
+ *
+ * @param obj latch object
+ * @param trigger pin from PinMap_LATCH on the first member's timer, rising
+ *        edges, unfiltered; NC to latch from software only
+ */
+void countlatch_init(countlatch_t* obj, PinName trigger);
+
+/** Add an encoder timer
+ *
+ * Its CC1 is switched to capture on TRC, the encoder keeps counting TI1FP1
+ * and TI2FP2. Any encoder can be the master; as a slave its timer needs an
+ * ITR from the master's, which all of ENC_1/3/4 have from one another and
+ * from CNT_2. Not an encoder with an index, which has CC1 already.
+ *
+ * @returns index of its count in countlatch_read, or -1 if the group is full
+ */
+int countlatch_add_encoder(countlatch_t* obj, TIM_HandleTypeDef* handle);
+
+/** Add a counter timer, as the first member only
+ *
+ * A counter's trigger input already carries the pulses it counts, so it
+ * cannot follow an ITR. As the master, its CC1 latches on the channel it
+ * does not count on.
+ *
+ * @param channel the channel the counter counts on, 1 or 2; not 0, an ETR
+ *        counter has no channel input left to latch with
+ * @returns index of its count in countlatch_read, or -1 if the group is full
+ */
+int countlatch_add_counter(countlatch_t* obj, TIM_HandleTypeDef* handle, uint8_t channel);
+
+/** Latch every member now */
+void countlatch_trigger(countlatch_t* obj);
+
+/** Read back the last latch
+ *
+ * @param counts one raw CNT value per member, in the order they were added
+ * @returns 1 if the members latched since the last read, else 0 and counts
+ *          is left alone
+ */
+int countlatch_read(countlatch_t* obj, uint32_t* counts);
+
+/**@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
+
+/** @}*/
@@ -10,43 +10,168 @@
 extern "C" {
 #endif
 
+/* Define as 1 (e.g. in the macros of mbed_app.json) to have the encoder
+ * vectors stamp DWT->CYCCNT as they are entered, see irq_cycles. Enabling
+ * the cycle counter is up to the application. */
+#ifndef MBED_CONF_ENCODERIN_IRQ_TIMESTAMP
+#define MBED_CONF_ENCODERIN_IRQ_TIMESTAMP 0
+#endif
+
+typedef void (*enc_alarm_handler)(uintptr_t id);
+
 typedef enum {
-    IRQ_ALARM1,
-    IRQ_ALARM2
-} enc_irq_event;
+    ENC_ALARM_BOTH,                 // moving onto it from either side
+    ENC_ALARM_UP,                   // only while counting up
+    ENC_ALARM_DOWN                  // only while counting down
+} enc_alarm_direction;
 
-typedef void (*enc_irq_handler)(uint32_t id, enc_irq_event event);
+/** A position alarm, kept by the encoder in a list sorted by position
+ *
+ * The alarm fires when the position moves onto it in the qualifying
+ * direction. It then disarms until the position is at least hysteresis
+ * counts away (one count if 0), and does nothing at all while held. The
+ * storage belongs to the caller and must stay valid until it is removed.
+ */
+typedef struct encoderin_alarm_s {
+    int64_t position;
+    uint32_t hysteresis;
+    uint8_t direction;              // enc_alarm_direction
+    uint8_t armed;
+    uint8_t held;
+    enc_alarm_handler handler;
+    uintptr_t id;
+    uint32_t pass;                  // dispatch pass it last fired in
+    struct encoderin_alarm_s *next;
+} encoderin_alarm_t;
 
 //upon MBED adoption, add to PeripheralNames.h
 typedef enum {
     ENC_1 = (int)TIM1_BASE,
+    ENC_2 = (int)TIM2_BASE,         // 32-bit
     ENC_3 = (int)TIM3_BASE,
-    ENC_4 = (int)TIM4_BASE
+    ENC_4 = (int)TIM4_BASE,
+    ENC_5 = (int)TIM5_BASE          // 32-bit
 } ENCName;
 
 //Upon MBED adoption, add to PeripheralPins.c
 const PinMap PinMap_ENC_CHA[] = {
 	{PE_9, ENC_1, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 1, 0)},
+	{PA_15, ENC_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 1, 0)},
+	{PA_5, ENC_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 1, 0)},
 	{PB_4, ENC_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 1, 0)},
-	{PB_6, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 1, 0)}
+	{PB_6, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 1, 0)},
+	{PA_0, ENC_5, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM5, 1, 0)},
+	{NC, NC, 0}
 };
 
 const PinMap PinMap_ENC_CHB[] = {
 	{PE_11, ENC_1, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 1, 0)},
+	{PB_3, ENC_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 1, 0)},
 	{PB_5, ENC_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 1, 0)},
-	{PB_7, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 1, 0)}
+	{PB_7, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 1, 0)},
+	{PA_1, ENC_5, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM5, 1, 0)},
+	{NC, NC, 0}
+};
+
+/* Index (Z) pins, on the timer's ETR. TIM2's ETR shares its pins with
+ * CH1 and TIM5 has none, so only ENC_1/3/4 take an index. */
+const PinMap PinMap_ENC_IDX[] = {
+	{PE_7, ENC_1, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 0, 0)},
+	{PA_12, ENC_1, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 0, 0)},
+	{PD_2, ENC_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 0, 0)},
+	{PE_0, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 0, 0)},
+	{NC, NC, 0}
+};
+
+/* Position compare outputs, on CH3 and CH4. TIM2 and TIM5 share PA_2 and
+ * PA_3, so the encoder's timer picks the entry. */
+const PinMap PinMap_ENC_OUT[] = {
+	{PE_13, ENC_1, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 3, 0)},
+	{PA_10, ENC_1, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 3, 0)},
+	{PE_14, ENC_1, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 4, 0)},
+	{PA_11, ENC_1, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM1, 4, 0)},
+	{PA_2, ENC_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 3, 0)},
+	{PB_10, ENC_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 3, 0)},
+	{PA_3, ENC_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 4, 0)},
+	{PB_11, ENC_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 4, 0)},
+	{PB_0, ENC_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 3, 0)},
+	{PC_8, ENC_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 3, 0)},
+	{PB_1, ENC_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 4, 0)},
+	{PC_9, ENC_3, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM3, 4, 0)},
+	{PB_8, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 3, 0)},
+	{PD_14, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 3, 0)},
+	{PB_9, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 4, 0)},
+	{PD_15, ENC_4, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM4, 4, 0)},
+	{PA_2, ENC_5, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM5, 3, 0)},
+	{PA_3, ENC_5, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM5, 4, 0)},
+	{NC, NC, 0}
 };
 
+/* What a position output does when the count gets to its compare value */
+typedef enum {
+    ENC_OUT_SET = TIM_OCMODE_ACTIVE,        // goes active
+    ENC_OUT_RESET = TIM_OCMODE_INACTIVE,    // goes inactive
+    ENC_OUT_TOGGLE = TIM_OCMODE_TOGGLE      // changes level
+} enc_out_mode;
+
+/* Counts per cycle of the encoder
+ *
+ * There is no x1 mode in the timers. ENC_X2 divided by 2, rounding down,
+ * is the x1 position. */
+typedef enum {
+    ENC_X2 = TIM_ENCODERMODE_TI1,   // both edges of channel A
+    ENC_X4 = TIM_ENCODERMODE_TI12   // both edges of both channels
+} ENCDecoding;
+
+/* Input settings, shared by both channels
+ *
+ * Each channel goes through the same filter as a CounterIn input and has
+ * the same ceiling per channel, see the table in counterin_api.h: with
+ * the default 15 that is 176kHz on TIM2-5 (fCK_INT 90MHz) and 352kHz
+ * on TIM1 (180MHz), per channel. In ENC_X4 the count rate is four times
+ * the cycle rate; the counter itself keeps up with fCK_INT. */
+typedef struct {
+    uint8_t filter;         // 0-15, IC1F/IC2F
+    ENCDecoding decoding;
+} encoderin_config_t;
+
+/* What encoderin_init uses */
+#define ENCODERIN_CONFIG_DEFAULT    {15, ENC_X4}
+
 //upon MBED adoption, add to common_objects.h
 struct encoderin_s {
     ENCName enc;
     PinName pinA;
 	PinName pinB;
+    TIM_HandleTypeDef handle;
+    encoderin_alarm_t *alarms;      // sorted by position, lowest first
+    int64_t alarm_position;         // where the alarms were last checked
+    uint32_t alarm_pass;
+    uint8_t alarm_masked;
+    uint8_t alarm_busy;             // handlers are being called
+    volatile int64_t overflow[2];   // position carried out of CNT by update events, the one seq picks
+    volatile uint32_t seq;          // see encoderin_read64
+    volatile uint32_t index_seq;    // bumped each time index_home changes
+    PinName pinZ;               // index, NC if none
+    uint32_t turn;              // counts per turn, 0 to home on every index
+    volatile int64_t index_home;    // read64 position of the index, 0 until homed
+    volatile uint8_t homed;
+    uint8_t index_down;             // home was captured counting down
+    volatile uint32_t index_slips;  // times the index was off where it should be
+    volatile uint32_t irq_cycles;   // DWT->CYCCNT as the compare vector was entered, 0 unless MBED_CONF_ENCODERIN_IRQ_TIMESTAMP
+    uint8_t outputs;                // bit n set when CCn drives a pin
+    DMA_HandleTypeDef out_dma[2];   // position tables of CC3 and CC4
+    uint32_t out_pulse[2][3];       // the table behind encoderin_output_pulse
+    enc_alarm_handler out_handler[2];
+    uintptr_t out_id[2];
 };
 
 typedef struct encoderin_s encoderin_t;
 
-void encoderin_init( encoderin_t* obj, PinName pinA, PinName pinB, enc_irq_handler handler, uint32_t id );
+void encoderin_init( encoderin_t* obj, PinName pinA, PinName pinB );
+
+/** Decode with given input settings */
+void encoderin_init_config( encoderin_t* obj, PinName pinA, PinName pinB, const encoderin_config_t* config );
 
 void encoderin_start( encoderin_t* obj );
 
@@ -56,7 +181,144 @@ void encoderin_stop( encoderin_t* obj );
 
 uint32_t encoderin_read( encoderin_t* obj );
 
-void encoderin_set_irq( encoderin_t* obj, enc_irq_event alarm, uint32_t interval );
+/** Read the position extended past the width of the timer
+ *
+ * Overflows and underflows are accumulated by the update interrupt. A wrap
+ * that is still pending is accounted for here. Lock-free and safe at any
+ * priority, including from an interrupt that preempts the update interrupt
+ * halfway through: that one writes the new position into the overflow slot
+ * readers are not using, then makes seq odd to switch them over to it while
+ * the flag it has counted is still up, and even again once it is cleared.
+ * The library leaves the NVIC priorities to the application.
+ */
+int64_t encoderin_read64( encoderin_t* obj );
+
+/** Capture the position on an index (Z) pulse
+ *
+ * The index comes in on the timer's ETR, through the channels' filter, and
+ * its rising edge captures CNT into CCR1 through TRC: the position is exact
+ * however late the interrupt gets to it. The first index homes the encoder,
+ * making encoderin_read_absolute 0 there.
+ *
+ * With counts_per_turn, later indexes are only checked against a whole
+ * number of turns from home. Crossed the way home was, the capture is the
+ * same edge of the index and has to be within a count of it. Crossed the
+ * other way it is the other edge, which can be up to one quadrature cycle
+ * (4 counts in ENC_X4, 2 in ENC_X2) further on, as wide as an ungated
+ * index gets. Anything else moves home onto it and counts a slip. With 0
+ * every index homes again, as a slave reset would.
+ *
+ * Takes CC1, so the encoder cannot also be in a CountLatch or measured by
+ * a VelocityMeter. Call with interrupts masked.
+ *
+ * @param pinZ pin from PinMap_ENC_IDX on the encoder's timer
+ */
+void encoderin_index( encoderin_t* obj, PinName pinZ, uint32_t counts_per_turn );
+
+/** Position from the index, encoderin_read64 until the first one
+ *
+ * Lock-free, under the same conditions as encoderin_read64.
+ */
+int64_t encoderin_read_absolute( encoderin_t* obj );
+
+/** Add an alarm, or move it if it is already in the list
+ *
+ * CC3 and CC4 are kept on the nearest alarms ahead of and behind the
+ * current position, so any number of alarms costs one interrupt per alarm
+ * passed. Only movement from here on fires it, not a crossing from before
+ * it was added. Not while the encoder has position outputs. Call with
+ * interrupts masked.
+ */
+void encoderin_insert_alarm( encoderin_t* obj, encoderin_alarm_t* alarm, int64_t position, enc_alarm_direction direction, uint32_t hysteresis, enc_alarm_handler handler, uintptr_t id );
+
+/** Move an alarm that is already in the list, keeping its direction,
+ * hysteresis and handler
+ *
+ * Meant for re-arming from the alarm's own handler: only the compare
+ * registers are touched, and from a handler even that waits until all
+ * handlers have run. Call with interrupts masked.
+ */
+void encoderin_move_alarm( encoderin_t* obj, encoderin_alarm_t* alarm, int64_t position );
+
+/** Take an alarm out of the list. Call with interrupts masked. */
+void encoderin_remove_alarm( encoderin_t* obj, encoderin_alarm_t* alarm );
+
+/** Stop an alarm from firing or interrupting until it is released, for
+ * rate limiting it in time. Call with interrupts masked. */
+void encoderin_hold_alarm( encoderin_t* obj, encoderin_alarm_t* alarm );
+
+void encoderin_release_alarm( encoderin_t* obj, encoderin_alarm_t* alarm );
+
+/** Drive a pin from a compare channel, at exact positions
+ *
+ * The pin changes in the timer itself the moment the count gets to the
+ * compare value, with no interrupt in between. Outputs are on CC3 and CC4,
+ * which are also what the alarms run on: an encoder has either alarms or
+ * up to two outputs. The output starts inactive.
+ *
+ * @param pin pin from PinMap_ENC_OUT on the encoder's timer
+ * @param active_low nonzero for an active low output
+ * @return the channel taken, 3 or 4
+ */
+uint8_t encoderin_output_init( encoderin_t* obj, PinName pin, uint8_t active_low );
+
+/** Give a channel taken by encoderin_output_init() back, leaving the pin inactive */
+void encoderin_output_free( encoderin_t* obj, uint8_t channel );
+
+/** Stop comparing and hold the output active (nonzero) or inactive */
+void encoderin_output_write( encoderin_t* obj, uint8_t channel, int value );
+
+/** Act on the output every time the count gets to a position
+ *
+ * Only the low bits of the position fit in CCR, so on a 16-bit timer it
+ * also acts a whole number of wraps away. The count has to move onto the
+ * position: being on it already does not count.
+ *
+ * @param position read64() position
+ */
+void encoderin_output_compare( encoderin_t* obj, uint8_t channel, int64_t position, enc_out_mode mode );
+
+/** Act on the output at each position of a table in turn
+ *
+ * Each match requests a DMA transfer that loads the next entry into CCR,
+ * so the table goes by at any speed without the CPU. Entries are
+ * hardware counts, as read() returns them, and each has to differ from
+ * the one before. Without repeat the table ends when its last entry is
+ * loaded, at the match on the one before: the last entry only marks the
+ * end and the output keeps the level that match left it at. With repeat
+ * it goes round for ever. The table is read by the DMA as it goes and
+ * must stay valid until the output is stopped.
+ *
+ * The DMA streams are, from the request mapping tables of RM0090: TIM1
+ * CC3/CC4 DMA2 stream 6/4, TIM2 DMA1 stream 1/7, TIM3 DMA1 stream 7/2,
+ * TIM4 CC3 DMA1 stream 7 and TIM5 DMA1 stream 0/1. TIM4 CC4 has none.
+ * The stream is taken until the output is written, compared or freed,
+ * even after a table without repeat has ended, and a table on a stream
+ * that is already taken is an error. So of TIM2 CC4, TIM3 CC3 and TIM4
+ * CC3 only one runs a table at a time, and the same goes for TIM2 CC3
+ * and TIM5 CC4.
+ *
+ * @param positions hardware counts
+ * @param length entries, at least 2 without repeat
+ * @param repeat nonzero to start over after the last entry
+ * @param handler called from the DMA interrupt each time the last entry is loaded, NULL for none
+ * @param id passed to handler
+ */
+void encoderin_output_table( encoderin_t* obj, uint8_t channel, const uint32_t* positions, uint16_t length, enc_out_mode mode, uint8_t repeat, enc_alarm_handler handler, uintptr_t id );
+
+/** One pulse on the output, from a position to width counts further on
+ *
+ * A table of two toggles: both edges are in hardware. The pulse is in the
+ * direction of travel, positive width counting up and negative counting
+ * down. A shaft turning back inside the pulse leaves it active until it
+ * gets to the far end.
+ *
+ * @param position read64() position of the start of the pulse
+ * @param width counts to the end of the pulse, not 0
+ * @param handler called from the DMA interrupt once the pulse is over, NULL for none
+ * @param id passed to handler
+ */
+void encoderin_output_pulse( encoderin_t* obj, uint8_t channel, int64_t position, int32_t width, enc_alarm_handler handler, uintptr_t id );
 
 void encoderin_irq_enable( encoderin_t* obj );
 
@@ -0,0 +1,118 @@
+/** \addtogroup hal */
+/** @{*/
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef RATEMETER_API_H
+#define RATEMETER_API_H
+
+#include "device.h"
+
+#if DEVICE_RATEMETER
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The reference timer: it times the windows and, in period mode,
+ * timestamps the counter's edges. Not usable by another driver meanwhile. */
+typedef enum {
+    RATE_4 = (int)TIM4_BASE,
+    RATE_5 = (int)TIM5_BASE
+} RATEName;
+
+typedef enum {
+    RATE_COUNT = 0,         // edges per window, DMA latched
+    RATE_PERIOD             // edges over the time between the first and last
+} rate_mode;
+
+typedef void (*rate_irq_handler)(uintptr_t id);
+
+struct ratemeter_s {
+    RATEName rate;
+    TIM_HandleTypeDef handle;
+    DMA_HandleTypeDef dma;
+    TIM_TypeDef *counter;
+    uint32_t counter_period;        // counter ARR, its wrap mask
+    uint32_t divider;               // edges per count, the ETR prescaler
+    uint32_t clock;                 // reference timer clock in Hz
+    uint32_t prescaler;             // PSC + 1
+    uint32_t window;                // reference ticks per window, ARR + 1
+    uint32_t up;                    // edges per window above which to count
+    uint32_t down;                  // edges per window below which to time them
+    uint32_t timeout;               // windows without an edge before reading 0
+    uint8_t mode;                   // rate_mode
+    uint8_t running;
+    uint8_t ref_valid;
+    volatile uint32_t latched;      // counter CNT at the end of the window, by DMA
+    uint32_t last_cnt;
+    uint64_t windows;               // windows since start
+    uint64_t ref_time;              // reference ticks at the last timed edge
+    uint32_t ref_edge;              // counter CNT at that edge
+    uint64_t edge_time;             // the same for the newest edge
+    uint32_t edge;
+    uint32_t idle;                  // windows since an edge
+    volatile float hz;
+    rate_irq_handler handler;
+    uintptr_t id;
+};
+
+typedef struct ratemeter_s ratemeter_t;
+
+/** Set up a reference timer to measure the rate of a counter timer
+ *
+ * The counter keeps counting its pin as before. Its CC1 now also captures
+ * on every count, and the resulting compare pulse goes out on TRGO to the
+ * reference timer's ITR, where it captures the time into CC3.
+ *
+ * @param obj rate meter object
+ * @param rate reference timer
+ * @param counter the counter's timer handle, not cascaded
+ * @param channel the channel the counter counts on, 1 or 2, 0 for ETR
+ */
+void ratemeter_init(ratemeter_t* obj, RATEName rate, TIM_HandleTypeDef* counter, uint8_t channel);
+
+/** Set the function called from the reference timer's interrupt after
+ * each window's estimate */
+void ratemeter_set_irq(ratemeter_t* obj, rate_irq_handler handler, uintptr_t id);
+
+/** Start measuring, in count mode
+ *
+ * The count is latched through DMA1 stream 6, taken until ratemeter_stop.
+ * Both reference timers need it, so only one rate meter runs at a time.
+ *
+ * @param hz windows per second
+ * @param up_hz rate above which to count edges per window
+ * @param down_hz rate below which to time edges, under up_hz
+ * @param min_hz rate under which the estimate drops to 0
+ */
+void ratemeter_start(ratemeter_t* obj, uint32_t hz, uint32_t up_hz, uint32_t down_hz, float min_hz);
+
+void ratemeter_stop(ratemeter_t* obj);
+
+/** Time of one window as actually programmed */
+uint64_t ratemeter_get_window_ns(ratemeter_t* obj);
+
+/**@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
+
+/** @}*/
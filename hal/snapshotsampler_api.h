@@ -0,0 +1,115 @@
+/** \addtogroup hal */
+/** @{*/
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SNAPSHOTSAMPLER_API_H
+#define SNAPSHOTSAMPLER_API_H
+
+#include "device.h"
+
+#if DEVICE_SNAPSHOTSAMPLER
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The timer that sets the sample rate. It needs no pins, but it cannot be
+ * used by another driver at the same time (TIM4 is ENC_4, TIM5 is TRG_5);
+ * snapshotsampler_init stops with an error naming the one that has it */
+typedef enum {
+    SMP_4 = (int)TIM4_BASE,
+    SMP_5 = (int)TIM5_BASE
+} SMPName;
+
+/* Registers copied on each sample, one DMA stream each */
+#define SMP_SOURCES         4
+
+typedef void (*smp_irq_handler)(uintptr_t id, const uint32_t *block);
+
+struct snapshotsampler_s {
+    SMPName smp;
+    TIM_HandleTypeDef handle;
+    DMA_HandleTypeDef dma[SMP_SOURCES];
+    uint32_t source[SMP_SOURCES];   // addresses of the sampled registers
+    uint8_t sources;
+    uint8_t running;
+    uint32_t *buffer;
+    uint32_t length;                // samples per register per block
+    uint32_t clock;                 // timer clock in Hz
+    uint32_t prescaler;             // PSC + 1
+    uint32_t period;                // ARR
+    smp_irq_handler handler;
+    uintptr_t id;
+};
+
+typedef struct snapshotsampler_s snapshotsampler_t;
+
+/** Set up a timer to sample registers at a fixed rate
+ *
+ * Each update of the timer makes the DMA copy every added register, so the
+ * samples carry the timer's timing and none of the CPU's. Blocks of
+ * 'length' samples alternate between the two halves of the buffer.
+ *
+ * @param obj sampler object
+ * @param smp sampling timer
+ * @param buffer 2 * SMP_SOURCES * length words, or 2 * sources * length
+ *        if fewer registers will be added
+ * @param length samples per register in each block, 1 to 65535
+ */
+void snapshotsampler_init(snapshotsampler_t* obj, SMPName smp, uint32_t* buffer, uint32_t length);
+
+/** Add a register to sample, before snapshotsampler_start
+ *
+ * @returns index of the register within a block, or -1 if all are used
+ */
+int snapshotsampler_add(snapshotsampler_t* obj, volatile uint32_t* reg);
+
+/** Set the function called from the DMA interrupt with each full block
+ *
+ * A block holds 'length' samples of register 0, then of register 1, and so on.
+ */
+void snapshotsampler_set_irq(snapshotsampler_t* obj, smp_irq_handler handler, uintptr_t id);
+
+/** Start sampling at the nearest rate the timer can do
+ *
+ * Each added register takes a DMA1 stream until snapshotsampler_stop, in
+ * order: 0, 3, 6, 7 on TIM4 and 1, 2, 4, 6 on TIM5. Starting on a stream a
+ * capture, rate meter, position table or the other sampler already has is
+ * an error.
+ *
+ * @param hz samples per second
+ */
+void snapshotsampler_start(snapshotsampler_t* obj, uint32_t hz);
+
+void snapshotsampler_stop(snapshotsampler_t* obj);
+
+/** Stop and give the timer back for another driver */
+void snapshotsampler_free(snapshotsampler_t* obj);
+
+/** Time between two samples as actually programmed */
+uint64_t snapshotsampler_get_period_ns(snapshotsampler_t* obj);
+
+/**@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
+
+/** @}*/
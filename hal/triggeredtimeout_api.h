@@ -27,7 +27,7 @@
 extern "C" {
 #endif
 
-typedef void (*trg_irq_handler)(uint32_t id);
+typedef void (*trg_irq_handler)(uintptr_t id);
 
 typedef enum {
 	TRG_2 = (int)TIM2_BASE,
@@ -36,23 +36,130 @@ typedef enum {
 
 const PinMap PinMap_TRG[] = {
     {PA_15, TRG_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 1, 0)},
+    {PA_0,  TRG_5, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM5, 1, 0)},
 	{NC, NC, 0}
 };
 
+/* Pulse outputs, on the channels not used by the trigger inputs above */
+const PinMap PinMap_TRG_OUT[] = {
+    {PA_1,  TRG_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 2, 0)},
+    {PB_3,  TRG_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 2, 0)},
+    {PA_2,  TRG_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 3, 0)},
+    {PB_10, TRG_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 3, 0)},
+    {PA_3,  TRG_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 4, 0)},
+    {PB_11, TRG_2, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF1_TIM2, 4, 0)},
+    {PA_1,  TRG_5, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM5, 2, 0)},
+    {PA_2,  TRG_5, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM5, 3, 0)},
+    {PA_3,  TRG_5, STM_PIN_DATA_EXT(STM_MODE_AF_PP, GPIO_NOPULL, GPIO_AF2_TIM5, 4, 0)},
+	{NC, NC, 0}
+};
+
+typedef enum {
+    TRG_MODE_IRQ = 0,       // interrupt every period after the trigger
+    TRG_MODE_PULSE,         // one output pulse on every trigger
+    TRG_MODE_PULSE_ONCE     // one output pulse on the next trigger only
+} trg_mode;
+
 struct triggeredtimeout_s {
     TRGName trg;
     PinName pin;
-    uint32_t prescaler;
-    uint32_t period;
+    uint32_t clock;         // timer kernel clock in Hz, read once at init
+    uint32_t prescaler;     // PSC + 1
+    uint32_t period;        // ARR, in prescaled ticks
+    uint32_t compare;       // CCR of the pulse output
+    trg_mode mode;
     uint8_t channel;
+    uint8_t out_channel;    // 0 when there is no pulse output
+    uint8_t used;           // bit n set when channel n is taken
+    uint8_t outputs;        // bit n set when event channel n drives a pin
+    TIM_HandleTypeDef handle;
+    trg_irq_handler handler;
+    uintptr_t id;
+    uint64_t event_ticks[4];    // event delays in timer clocks, by channel - 1
+    trg_irq_handler event_handler[4];
+    uintptr_t event_id[4];
 };
 
 typedef struct triggeredtimeout_s triggeredtimeout_t;
 
-void triggeredtimeout_init(triggeredtimeout_t* obj, PinName pin, trg_irq_handler handler, uint32_t id);
+void triggeredtimeout_init(triggeredtimeout_t* obj, PinName pin, trg_irq_handler handler, uintptr_t id);
 
+/** Set the delay from the trigger edge to the interrupt, in microseconds */
 void trigger_set_irq(triggeredtimeout_t* obj, uint32_t interval);
 
+/** Set the delay from the trigger edge to the interrupt, in nanoseconds
+ *
+ * The prescaler and 32-bit reload are solved for the finest resolution that
+ * fits: one timer clock (11.1ns at 90MHz) up to about 47s, coarser beyond
+ * that. Only the timer's PSC/ARR/CNT registers are written.
+ */
+void trigger_set_irq_ns(triggeredtimeout_t* obj, uint64_t ns);
+
+/** The delay actually programmed, after rounding to timer ticks
+ *
+ * In pulse mode this is the delay to the start of the pulse.
+ */
+uint64_t trigger_get_delay_ns(triggeredtimeout_t* obj);
+
+/** Route a timer channel to a pin for hardware delayed pulses
+ *
+ * The output stays at its inactive level until trigger_set_pulse_ns().
+ *
+ * @param pin a pin from PinMap_TRG_OUT on the same timer as the trigger
+ * @param active_low nonzero for a low pulse on a high idle level
+ */
+void trigger_pulse_init(triggeredtimeout_t* obj, PinName pin, uint8_t active_low);
+
+/** Generate a pulse on the output after each trigger edge, without interrupts
+ *
+ * The timer runs in one-pulse mode with the output in PWM mode 2: the
+ * trigger starts the counter, the compare match starts the pulse and the
+ * overflow ends it and stops the counter again. Edges during a pulse are
+ * ignored. Delay and width share one prescaler, solved for their sum.
+ *
+ * @param delay_ns from the trigger edge to the start of the pulse, at least one tick
+ * @param width_ns pulse length, at least one tick
+ * @param mode TRG_MODE_PULSE to repeat on every trigger, TRG_MODE_PULSE_ONCE
+ *        to disarm after one pulse (from the update interrupt, after the pulse)
+ */
+void trigger_set_pulse_ns(triggeredtimeout_t* obj, uint64_t delay_ns, uint64_t width_ns, trg_mode mode);
+
+/** The pulse width actually programmed, after rounding to timer ticks */
+uint64_t trigger_get_width_ns(triggeredtimeout_t* obj);
+
+/** Take a compare channel for an extra delayed event after each trigger
+ *
+ * Events share the timer, and so the period set by trigger_set_irq_ns() or
+ * trigger_set_pulse_ns(): an event runs once per period, and one set later
+ * than the end of the period never runs. The trigger input and the pulse
+ * output each hold a channel, which leaves up to three events.
+ *
+ * @param pin NC for an interrupt-only event on any free channel, or a pin
+ *        from PinMap_TRG_OUT to drive it active from the event to the end
+ *        of the period
+ * @param active_low nonzero for an active low output
+ * @return the channel taken
+ */
+uint8_t trigger_event_init(triggeredtimeout_t* obj, PinName pin, uint8_t active_low);
+
+/** Give a channel taken by trigger_event_init() back */
+void trigger_event_free(triggeredtimeout_t* obj, uint8_t channel);
+
+/** Set the delay of an event from the trigger edge
+ *
+ * @param channel as returned by trigger_event_init()
+ * @param ns delay from the trigger edge, at least one tick
+ * @param handler called from the timer interrupt at the event, NULL for none
+ * @param id passed to handler
+ */
+void trigger_set_event_ns(triggeredtimeout_t* obj, uint8_t channel, uint64_t ns, trg_irq_handler handler, uintptr_t id);
+
+/** Stop an event, leaving its channel taken and its output inactive */
+void trigger_clear_event(triggeredtimeout_t* obj, uint8_t channel);
+
+/** The event delay actually programmed, after rounding to timer ticks */
+uint64_t trigger_get_event_ns(triggeredtimeout_t* obj, uint8_t channel);
+
 void trigger_irq_enable(triggeredtimeout_t* obj );
 
 void trigger_irq_disable( triggeredtimeout_t* obj );
@@ -0,0 +1,106 @@
+/** \addtogroup hal */
+/** @{*/
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef VELOCITYMETER_API_H
+#define VELOCITYMETER_API_H
+
+#include "device.h"
+
+#if DEVICE_VELOCITYMETER
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The reference timer: it times the windows and timestamps the encoder's
+ * edges. Not usable by another driver meanwhile. */
+typedef enum {
+    VEL_4 = (int)TIM4_BASE,         // for ENC_1/2/3
+    VEL_5 = (int)TIM5_BASE          // for ENC_2/3/4
+} VELName;
+
+typedef void (*vel_irq_handler)(uintptr_t id);
+
+struct velocitymeter_s {
+    VELName vel;
+    TIM_HandleTypeDef handle;
+    TIM_TypeDef *encoder;
+    uint32_t encoder_period;        // encoder ARR, its wrap mask
+    uint32_t cycle;                 // counts per cycle of channel A
+    uint32_t clock;                 // reference timer clock in Hz
+    uint32_t prescaler;             // PSC + 1
+    uint32_t window;                // reference ticks per window, ARR + 1
+    uint32_t timeout;               // windows without an edge before reading 0
+    uint8_t running;
+    uint8_t ref_valid;
+    uint64_t windows;               // windows since start
+    uint64_t ref_time;              // reference ticks at the last timed edge
+    uint32_t ref_edge;              // encoder CNT at that edge
+    uint32_t idle;                  // windows since an edge
+    volatile float speed;           // counts per second, signed
+    vel_irq_handler handler;
+    uintptr_t id;
+};
+
+typedef struct velocitymeter_s velocitymeter_t;
+
+/** Set up a reference timer to measure the speed of an encoder
+ *
+ * The encoder keeps counting as before. Its CC1 now also captures the
+ * position on every rising edge of channel A, and the resulting compare
+ * pulse goes out on TRGO to the reference timer's ITR, where it captures
+ * the time into CC3. Nothing interrupts per edge.
+ *
+ * @param obj velocity meter object
+ * @param vel reference timer, with an ITR from the encoder's timer
+ * @param encoder the encoder's timer handle, without an index and not in a
+ *        CountLatch
+ */
+void velocitymeter_init(velocitymeter_t* obj, VELName vel, TIM_HandleTypeDef* encoder);
+
+/** Set the function called from the reference timer's interrupt after
+ * each window's estimate */
+void velocitymeter_set_irq(velocitymeter_t* obj, vel_irq_handler handler, uintptr_t id);
+
+/** Start measuring
+ *
+ * Every window, the speed is the counts between the last timed edge and
+ * the one before it over the time between them (the M/T method): however
+ * many edges the window had, the time is exact to a reference tick.
+ *
+ * @param hz windows per second
+ * @param min_speed speed in counts per second under which the estimate
+ *        drops to 0
+ */
+void velocitymeter_start(velocitymeter_t* obj, uint32_t hz, float min_speed);
+
+void velocitymeter_stop(velocitymeter_t* obj);
+
+/** Time of one window as actually programmed */
+uint64_t velocitymeter_get_window_ns(velocitymeter_t* obj);
+
+/**@}*/
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
+
+#endif
+
+/** @}*/
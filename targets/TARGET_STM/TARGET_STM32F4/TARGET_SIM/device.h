@@ -0,0 +1,35 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef MBED_DEVICE_H
+#define MBED_DEVICE_H
+
+//=======================================
+#define DEVICE_ID_LENGTH       24
+
+// Drivers provided by this repository. On silicon these come from
+// mbed_app.json, the simulator always builds all of them.
+#define DEVICE_COUNTERIN       1
+#define DEVICE_ENCODERIN       1
+#define DEVICE_TRIGGEREDTIMEOUT 1
+#define DEVICE_CAPTUREIN       1
+#define DEVICE_SNAPSHOTSAMPLER 1
+#define DEVICE_COUNTLATCH      1
+#define DEVICE_RATEMETER       1
+#define DEVICE_VELOCITYMETER   1
+
+#include "objects.h"
+
+#endif
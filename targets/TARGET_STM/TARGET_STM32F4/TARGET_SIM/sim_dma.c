@@ -0,0 +1,300 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Model of the two DMA controllers, as far as the timers use them.
+ *
+ * Like the timers, the stream registers are read lazily: a stream latches
+ * PAR/M0AR/NDTR when EN is first seen set, and LIFCR/HIFCR writes are
+ * applied by sim_dma_sync(). Timer DMA requests (sim_dma_request) are served
+ * on the spot, one data item each, so a transfer has the timestamp of the
+ * event that requested it.
+ *
+ * Modelled: the request mapping of every timer, peripheral-to-memory and
+ * memory-to-peripheral in direct mode, PINC/MINC, circular and double buffer
+ * mode, half and full transfer flags and the NVIC line of each stream, and
+ * the side effect of a DMA read of a capture register (clearing CCxIF).
+ *
+ * Not modelled: FIFO mode and bursts, flow control, stream priorities and
+ * arbitration latency, memory-to-memory transfers and the error flags.
+ */
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+
+#include "sim_tim.h"
+
+#define SIM_DMA_STREAMS     16
+
+#define DMA_ISR_MASK        (DMA_LISR_FEIF0 | DMA_LISR_DMEIF0 | DMA_LISR_TEIF0 | DMA_LISR_HTIF0 | DMA_LISR_TCIF0)
+
+typedef struct {
+    DMA_Stream_TypeDef *regs;
+    DMA_TypeDef *dma;
+    IRQn_Type irq;
+    uint8_t shift;          // position of the stream's flags in xISR/xIFCR
+    uint8_t high;           // flags in HISR/HIFCR
+
+    uint8_t running;
+    uint8_t flags;
+    uint32_t length;        // NDTR when the stream was enabled
+} sim_dma_stream_t;
+
+/* One line of the "DMA1/DMA2 request mapping" tables of RM0090, timers only.
+ * events is in TIM_SR flag positions */
+typedef struct {
+    uint8_t stream;         // 0-7 DMA1, 8-15 DMA2
+    uint8_t channel;
+    TIM_TypeDef *tim;
+    uint32_t events;
+} sim_dma_route_t;
+
+#define TIM_SR_CC(ch)       (TIM_SR_CC1IF << ((ch) - 1))
+
+static const sim_dma_route_t sim_dma_routes[] = {
+    // DMA1 channel 2: TIM4
+    { 0, 2, TIM4, TIM_SR_CC(1) },
+    { 3, 2, TIM4, TIM_SR_CC(2) },
+    { 6, 2, TIM4, TIM_SR_UIF },
+    { 7, 2, TIM4, TIM_SR_CC(3) },
+    // DMA1 channel 3: TIM2
+    { 1, 3, TIM2, TIM_SR_UIF | TIM_SR_CC(3) },
+    { 5, 3, TIM2, TIM_SR_CC(1) },
+    { 6, 3, TIM2, TIM_SR_CC(2) | TIM_SR_CC(4) },
+    { 7, 3, TIM2, TIM_SR_UIF | TIM_SR_CC(4) },
+    // DMA1 channel 5: TIM3
+    { 2, 5, TIM3, TIM_SR_CC(4) | TIM_SR_UIF },
+    { 4, 5, TIM3, TIM_SR_CC(1) | TIM_SR_TIF },
+    { 5, 5, TIM3, TIM_SR_CC(2) },
+    { 7, 5, TIM3, TIM_SR_CC(3) },
+    // DMA1 channel 6: TIM5
+    { 0, 6, TIM5, TIM_SR_CC(3) | TIM_SR_UIF },
+    { 1, 6, TIM5, TIM_SR_CC(4) | TIM_SR_TIF },
+    { 2, 6, TIM5, TIM_SR_CC(1) },
+    { 3, 6, TIM5, TIM_SR_CC(4) | TIM_SR_TIF },
+    { 4, 6, TIM5, TIM_SR_CC(2) },
+    { 6, 6, TIM5, TIM_SR_UIF },
+    // DMA2 channel 0/6: TIM1
+    { 8 + 1, 6, TIM1, TIM_SR_CC(1) },
+    { 8 + 2, 6, TIM1, TIM_SR_CC(2) },
+    { 8 + 3, 6, TIM1, TIM_SR_CC(1) },
+    { 8 + 4, 6, TIM1, TIM_SR_CC(4) | TIM_SR_TIF | TIM_SR_COMIF },
+    { 8 + 5, 6, TIM1, TIM_SR_UIF },
+    { 8 + 6, 6, TIM1, TIM_SR_CC(3) },
+    { 8 + 0, 6, TIM1, TIM_SR_TIF },
+    { 8 + 6, 0, TIM1, TIM_SR_CC(1) | TIM_SR_CC(2) | TIM_SR_CC(3) },
+    // DMA2 channel 0/7: TIM8
+    { 8 + 1, 7, TIM8, TIM_SR_UIF },
+    { 8 + 2, 7, TIM8, TIM_SR_CC(1) },
+    { 8 + 3, 7, TIM8, TIM_SR_CC(2) },
+    { 8 + 4, 7, TIM8, TIM_SR_CC(3) },
+    { 8 + 7, 7, TIM8, TIM_SR_CC(4) | TIM_SR_TIF | TIM_SR_COMIF },
+    { 8 + 2, 0, TIM8, TIM_SR_CC(1) | TIM_SR_CC(2) | TIM_SR_CC(3) },
+};
+
+static sim_dma_stream_t sim_dma_streams[SIM_DMA_STREAMS];
+
+static const IRQn_Type sim_dma_irqs[SIM_DMA_STREAMS] = {
+    DMA1_Stream0_IRQn, DMA1_Stream1_IRQn, DMA1_Stream2_IRQn, DMA1_Stream3_IRQn,
+    DMA1_Stream4_IRQn, DMA1_Stream5_IRQn, DMA1_Stream6_IRQn, DMA1_Stream7_IRQn,
+    DMA2_Stream0_IRQn, DMA2_Stream1_IRQn, DMA2_Stream2_IRQn, DMA2_Stream3_IRQn,
+    DMA2_Stream4_IRQn, DMA2_Stream5_IRQn, DMA2_Stream6_IRQn, DMA2_Stream7_IRQn
+};
+
+static const uint8_t sim_dma_shift[4] = { 0, 6, 16, 22 };
+
+void sim_dma_reset(void)
+{
+    memset((void *)DMA1_BASE, 0, 0x400);
+    memset((void *)DMA2_BASE, 0, 0x400);
+
+    for (int i = 0; i < SIM_DMA_STREAMS; i++) {
+        sim_dma_stream_t *s = &sim_dma_streams[i];
+        uint32_t base = (i < 8) ? DMA1_BASE : DMA2_BASE;
+
+        memset(s, 0, sizeof(*s));
+        s->dma = (DMA_TypeDef *)(uintptr_t)base;
+        s->regs = (DMA_Stream_TypeDef *)(uintptr_t)(base + 0x10 + 0x18 * (i & 7));
+        s->irq = sim_dma_irqs[i];
+        s->shift = sim_dma_shift[i & 3];
+        s->high = (i & 7) >= 4;
+    }
+}
+
+/* The address registers are 32 bits, as on the chip. On a 64-bit host that
+ * reaches the mapped peripherals and the program's static data, which the
+ * non-PIE link keeps in the low 2 GB, and nothing else: a buffer on the
+ * stack or the heap has already lost its top half on its way in. */
+static int dma_address_ok(uint32_t address)
+{
+    extern char __executable_start, end;
+
+    if (sizeof(void *) == sizeof(uint32_t)) {
+        return 1;
+    }
+    if (address >= PERIPH_BASE && address < PERIPH_BASE + SIM_PERIPH_SIZE) {
+        return 1;
+    }
+    return address >= (uintptr_t)&__executable_start && address < (uintptr_t)&end;
+}
+
+static void dma_check_address(int i, const char *reg, uint32_t address)
+{
+    if (!dma_address_ok(address)) {
+        fprintf(stderr, "sim: DMA%d stream %d %s 0x%08x is neither a peripheral nor static data; "
+                "on a 64-bit host DMA buffers have to be globals\n", 1 + i / 8, i % 8, reg, address);
+        abort();
+    }
+}
+
+/* Pick up register writes made since the last step */
+void sim_dma_sync(void)
+{
+    uint32_t isr[2][2] = { { 0, 0 }, { 0, 0 } };
+
+    for (int i = 0; i < SIM_DMA_STREAMS; i++) {
+        sim_dma_stream_t *s = &sim_dma_streams[i];
+        uint32_t ifcr = s->high ? s->dma->HIFCR : s->dma->LIFCR;
+        uint32_t cr = s->regs->CR;
+
+        s->flags &= ~((ifcr >> s->shift) & DMA_ISR_MASK);
+
+        if ((cr & DMA_SxCR_EN) && !s->running) {
+            if ((cr & DMA_SxCR_DIR) == DMA_MEMORY_TO_MEMORY || s->regs->NDTR == 0) {
+                fprintf(stderr, "sim: unsupported DMA stream setup %d\n", i);
+                abort();
+            }
+            dma_check_address(i, "PAR", s->regs->PAR);
+            dma_check_address(i, "M0AR", s->regs->M0AR);
+            if (cr & DMA_SxCR_DBM) {
+                dma_check_address(i, "M1AR", s->regs->M1AR);
+            }
+            s->running = 1;
+            s->length = s->regs->NDTR & 0xFFFF;
+        } else if (!(cr & DMA_SxCR_EN)) {
+            s->running = 0;
+        }
+        isr[i >> 3][s->high] |= (uint32_t)s->flags << s->shift;
+    }
+    DMA1->LIFCR = 0;
+    DMA1->HIFCR = 0;
+    DMA2->LIFCR = 0;
+    DMA2->HIFCR = 0;
+    DMA1->LISR = isr[0][0];
+    DMA1->HISR = isr[0][1];
+    DMA2->LISR = isr[1][0];
+    DMA2->HISR = isr[1][1];
+}
+
+static void dma_set_flags(sim_dma_stream_t *s, uint8_t flags)
+{
+    __IO uint32_t *isr = s->high ? &s->dma->HISR : &s->dma->LISR;
+
+    s->flags |= flags;
+    *isr |= (uint32_t)flags << s->shift;
+}
+
+static void dma_transfer(sim_dma_stream_t *s)
+{
+    DMA_Stream_TypeDef *regs = s->regs;
+    uint32_t cr = regs->CR;
+    uint32_t size = 1U << ((cr & DMA_SxCR_PSIZE) >> DMA_SxCR_PSIZE_Pos);
+    uint32_t done = s->length - (regs->NDTR & 0xFFFF);
+    uint32_t mar = (cr & DMA_SxCR_CT) ? regs->M1AR : regs->M0AR;
+    uint32_t par = regs->PAR;
+
+    if (cr & DMA_SxCR_PINC) {
+        par += done * size;
+    }
+    if (cr & DMA_SxCR_MINC) {
+        mar += done * size;
+    }
+
+    if ((cr & DMA_SxCR_DIR) == DMA_PERIPH_TO_MEMORY) {
+        memcpy((void *)(uintptr_t)mar, (void *)(uintptr_t)par, size);
+        sim_tim_bus_read(par);
+    } else {
+        memcpy((void *)(uintptr_t)par, (void *)(uintptr_t)mar, size);
+    }
+
+    regs->NDTR = (regs->NDTR - 1) & 0xFFFF;
+    if (regs->NDTR == s->length / 2) {
+        dma_set_flags(s, DMA_LISR_HTIF0);
+    }
+    if (regs->NDTR == 0) {
+        dma_set_flags(s, DMA_LISR_TCIF0);
+        if (cr & DMA_SxCR_DBM) {
+            regs->CR ^= DMA_SxCR_CT;
+            regs->NDTR = s->length;
+        } else if (cr & DMA_SxCR_CIRC) {
+            regs->NDTR = s->length;
+        } else {
+            regs->CR &= ~DMA_SxCR_EN;
+            s->running = 0;
+        }
+    }
+}
+
+void sim_dma_request(TIM_TypeDef *tim, uint32_t events)
+{
+    sim_dma_sync();
+
+    for (unsigned i = 0; i < sizeof(sim_dma_routes) / sizeof(sim_dma_routes[0]); i++) {
+        const sim_dma_route_t *route = &sim_dma_routes[i];
+        sim_dma_stream_t *s = &sim_dma_streams[route->stream];
+
+        if (route->tim != tim || !(route->events & events) || !s->running) {
+            continue;
+        }
+        if (((s->regs->CR & DMA_SxCR_CHSEL) >> DMA_SxCR_CHSEL_Pos) != route->channel) {
+            continue;
+        }
+        dma_transfer(s);
+    }
+}
+
+/* Streams whose interrupt line is asserted, one bit per stream */
+uint32_t sim_dma_lines(void)
+{
+    uint32_t lines = 0;
+
+    for (int i = 0; i < SIM_DMA_STREAMS; i++) {
+        sim_dma_stream_t *s = &sim_dma_streams[i];
+        uint32_t cr = s->regs->CR;
+        uint8_t enabled = 0;
+
+        if (cr & DMA_SxCR_TCIE) {
+            enabled |= DMA_LISR_TCIF0;
+        }
+        if (cr & DMA_SxCR_HTIE) {
+            enabled |= DMA_LISR_HTIF0;
+        }
+        if (cr & DMA_SxCR_TEIE) {
+            enabled |= DMA_LISR_TEIF0;
+        }
+        if (cr & DMA_SxCR_DMEIE) {
+            enabled |= DMA_LISR_DMEIF0;
+        }
+        if (s->flags & enabled) {
+            lines |= 1U << i;
+        }
+    }
+    return lines;
+}
+
+IRQn_Type sim_dma_irq(int stream)
+{
+    return sim_dma_streams[stream].irq;
+}
@@ -0,0 +1,174 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Pin levels and the alternate function wiring between pins and timer
+ * channels. pin_function() is what pinmap_pinout() calls, so a driver that
+ * muxes a pin to a timer gets that pin's edges on the matching TIx/ETR input,
+ * and a timer output enabled on a channel drives every pin muxed to it.
+ */
+#include <string.h>
+
+#include "pinmap.h"
+#include "mbed_error.h"
+#include "sim_tim.h"
+
+#define SIM_PIN_COUNT   (SIM_PORT_COUNT * 16)
+
+/* Timer rows of the alternate function mapping table in the STM32F429
+ * datasheet */
+typedef struct {
+    PinName pin;
+    uint8_t afnum;
+    TIM_TypeDef *tim;
+    uint8_t channel;    // 1-4, 0 for ETR only
+    uint8_t etr;        // pin also feeds TIMx_ETR
+} sim_af_t;
+
+static const sim_af_t sim_af_map[] = {
+    {PA_8,  1, TIM1, 1, 0}, {PA_9,  1, TIM1, 2, 0}, {PA_10, 1, TIM1, 3, 0}, {PA_11, 1, TIM1, 4, 0},
+    {PA_12, 1, TIM1, 0, 1}, {PE_7,  1, TIM1, 0, 1}, {PE_9,  1, TIM1, 1, 0}, {PE_11, 1, TIM1, 2, 0},
+    {PE_13, 1, TIM1, 3, 0}, {PE_14, 1, TIM1, 4, 0},
+
+    {PA_0,  1, TIM2, 1, 1}, {PA_1,  1, TIM2, 2, 0}, {PA_2,  1, TIM2, 3, 0}, {PA_3,  1, TIM2, 4, 0},
+    {PA_5,  1, TIM2, 1, 1}, {PA_15, 1, TIM2, 1, 1}, {PB_3,  1, TIM2, 2, 0}, {PB_10, 1, TIM2, 3, 0},
+    {PB_11, 1, TIM2, 4, 0},
+
+    {PA_6,  2, TIM3, 1, 0}, {PA_7,  2, TIM3, 2, 0}, {PB_0,  2, TIM3, 3, 0}, {PB_1,  2, TIM3, 4, 0},
+    {PB_4,  2, TIM3, 1, 0}, {PB_5,  2, TIM3, 2, 0}, {PC_6,  2, TIM3, 1, 0}, {PC_7,  2, TIM3, 2, 0},
+    {PC_8,  2, TIM3, 3, 0}, {PC_9,  2, TIM3, 4, 0}, {PD_2,  2, TIM3, 0, 1},
+
+    {PB_6,  2, TIM4, 1, 0}, {PB_7,  2, TIM4, 2, 0}, {PB_8,  2, TIM4, 3, 0}, {PB_9,  2, TIM4, 4, 0},
+    {PD_12, 2, TIM4, 1, 0}, {PD_13, 2, TIM4, 2, 0}, {PD_14, 2, TIM4, 3, 0}, {PD_15, 2, TIM4, 4, 0},
+    {PE_0,  2, TIM4, 0, 1},
+
+    {PA_0,  2, TIM5, 1, 0}, {PA_1,  2, TIM5, 2, 0}, {PA_2,  2, TIM5, 3, 0}, {PA_3,  2, TIM5, 4, 0},
+    {PH_10, 2, TIM5, 1, 0}, {PH_11, 2, TIM5, 2, 0}, {PH_12, 2, TIM5, 3, 0},
+
+    {PC_6,  3, TIM8, 1, 0}, {PC_7,  3, TIM8, 2, 0}, {PC_8,  3, TIM8, 3, 0}, {PC_9,  3, TIM8, 4, 0},
+    {PA_0,  3, TIM8, 0, 1},
+
+    {NC,    0, NULL, 0, 0}
+};
+
+typedef struct {
+    uint8_t level;
+    uint8_t mode;
+    const sim_af_t *af;
+    sim_gpio_watch_t watch;
+    void *watch_ctx;
+} sim_pin_t;
+
+static sim_pin_t sim_pins[SIM_PIN_COUNT];
+
+static sim_pin_t *sim_pin(int pin)
+{
+    MBED_ASSERT(pin >= 0 && pin < SIM_PIN_COUNT);
+    return &sim_pins[pin];
+}
+
+void sim_gpio_reset(void)
+{
+    memset(sim_pins, 0, sizeof(sim_pins));
+}
+
+void pin_function(PinName pin, int data)
+{
+    sim_pin_t *p = sim_pin(pin);
+    const sim_af_t *af;
+
+    p->mode = STM_PIN_MODE(data);
+    p->af = NULL;
+    if (p->mode != STM_MODE_AF_PP && p->mode != STM_MODE_AF_OD) {
+        return;
+    }
+
+    for (af = sim_af_map; af->pin != NC; af++) {
+        if (af->pin == pin && af->afnum == STM_PIN_AFNUM(data)) {
+            p->af = af;
+            break;
+        }
+    }
+    if (p->af == NULL) {
+        error("sim: pin 0x%02x has no timer on AF%d\n", pin, STM_PIN_AFNUM(data));
+    }
+
+    // Hand the current level to the peripheral so it starts in sync
+    if (p->af->channel) {
+        sim_tim_input(p->af->tim, (sim_tim_line)(p->af->channel - 1), p->level);
+    }
+    if (p->af->etr) {
+        sim_tim_input(p->af->tim, SIM_TIM_ETR, p->level);
+    }
+}
+
+void pin_mode(PinName pin, PinMode mode)
+{
+    (void)pin;
+    (void)mode;
+}
+
+static void sim_pin_set(int pin, int level)
+{
+    sim_pin_t *p = sim_pin(pin);
+
+    level = level != 0;
+    if (p->level == level) {
+        return;
+    }
+    p->level = level;
+
+    if (p->af) {
+        if (p->af->channel) {
+            sim_tim_input(p->af->tim, (sim_tim_line)(p->af->channel - 1), level);
+        }
+        if (p->af->etr) {
+            sim_tim_input(p->af->tim, SIM_TIM_ETR, level);
+        }
+    }
+    if (p->watch) {
+        p->watch(p->watch_ctx, pin, level, sim_now());
+    }
+}
+
+/** Drive a pin from outside the chip */
+void sim_gpio_write(int pin, int level)
+{
+    sim_pin_set(pin, level);
+}
+
+int sim_gpio_read(int pin)
+{
+    return sim_pin(pin)->level;
+}
+
+/** Get called back on every edge of a pin, whoever drives it */
+void sim_gpio_watch(int pin, sim_gpio_watch_t watch, void *ctx)
+{
+    sim_pin_t *p = sim_pin(pin);
+
+    p->watch = watch;
+    p->watch_ctx = ctx;
+}
+
+void sim_gpio_tim_output(TIM_TypeDef *tim, int channel, int level)
+{
+    for (int pin = 0; pin < SIM_PIN_COUNT; pin++) {
+        const sim_af_t *af = sim_pins[pin].af;
+        if (af && af->tim == tim && af->channel == channel) {
+            sim_pin_set(pin, level);
+        }
+    }
+}
@@ -0,0 +1,223 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* The STM32Cube DMA HAL calls used by the drivers, reduced to the register
+ * writes the real HAL performs so sim_dma.c sees the same stream setup the
+ * silicon would.
+ */
+#include "sim_tim.h"
+
+#define DMA_FLAGS_ALL       (DMA_LISR_FEIF0 | DMA_LISR_DMEIF0 | DMA_LISR_TEIF0 | DMA_LISR_HTIF0 | DMA_LISR_TCIF0)
+
+/* Same bookkeeping as DMA_CalcBaseAndBitshift: StreamBaseAddress points at
+ * LISR or HISR, StreamIndex is the flag position within it */
+static void dma_calc_base(DMA_HandleTypeDef *hdma)
+{
+    static const uint8_t shift[4] = { 0U, 6U, 16U, 22U };
+    uint32_t stream = (((uint32_t)(uintptr_t)hdma->Instance & 0xFFU) - 16U) / 24U;
+    uint32_t base = (uint32_t)(uintptr_t)hdma->Instance & ~0x3FFU;
+
+    hdma->StreamIndex = shift[stream & 3U];
+    hdma->StreamBaseAddress = (stream > 3U) ? base + 4U : base;
+}
+
+static void dma_clear_flags(DMA_HandleTypeDef *hdma, uint32_t flags)
+{
+    // xIFCR sits 8 bytes after xISR
+    *(__IO uint32_t *)(uintptr_t)(hdma->StreamBaseAddress + 8U) = flags << hdma->StreamIndex;
+    sim_dma_sync();
+}
+
+static void dma_set_config(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+    hdma->Instance->CR &= ~DMA_SxCR_DBM;
+    hdma->Instance->NDTR = DataLength;
+
+    if (hdma->Init.Direction == DMA_MEMORY_TO_PERIPH) {
+        hdma->Instance->PAR = DstAddress;
+        hdma->Instance->M0AR = SrcAddress;
+    } else {
+        hdma->Instance->PAR = SrcAddress;
+        hdma->Instance->M0AR = DstAddress;
+    }
+}
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma)
+{
+    uint32_t tmp;
+
+    if (hdma == NULL) {
+        return HAL_ERROR;
+    }
+
+    __HAL_DMA_DISABLE(hdma);
+    sim_dma_sync();
+
+    tmp = hdma->Instance->CR;
+    tmp &= ~(DMA_SxCR_CHSEL | DMA_SxCR_PL | DMA_SxCR_MSIZE | DMA_SxCR_PSIZE | DMA_SxCR_MINC |
+             DMA_SxCR_PINC | DMA_SxCR_CIRC | DMA_SxCR_DIR | DMA_SxCR_CT | DMA_SxCR_DBM);
+    tmp |= hdma->Init.Channel | hdma->Init.Direction | hdma->Init.PeriphInc | hdma->Init.MemInc |
+           hdma->Init.PeriphDataAlignment | hdma->Init.MemDataAlignment | hdma->Init.Mode |
+           hdma->Init.Priority;
+    hdma->Instance->CR = tmp;
+    hdma->Instance->FCR = hdma->Init.FIFOMode | hdma->Init.FIFOThreshold;
+
+    dma_calc_base(hdma);
+    dma_clear_flags(hdma, DMA_FLAGS_ALL);
+
+    hdma->ErrorCode = 0;
+    hdma->State = HAL_DMA_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma)
+{
+    __HAL_DMA_DISABLE(hdma);
+    hdma->Instance->CR = 0;
+    hdma->Instance->NDTR = 0;
+    hdma->Instance->PAR = 0;
+    hdma->Instance->M0AR = 0;
+    hdma->Instance->M1AR = 0;
+    hdma->Instance->FCR = 0x21U;
+    dma_clear_flags(hdma, DMA_FLAGS_ALL);
+
+    hdma->State = HAL_DMA_STATE_RESET;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+    if (hdma->State != HAL_DMA_STATE_READY) {
+        return HAL_BUSY;
+    }
+    hdma->State = HAL_DMA_STATE_BUSY;
+
+    dma_set_config(hdma, SrcAddress, DstAddress, DataLength);
+    __HAL_DMA_ENABLE(hdma);
+    sim_dma_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength)
+{
+    if (hdma->State != HAL_DMA_STATE_READY) {
+        return HAL_BUSY;
+    }
+    hdma->State = HAL_DMA_STATE_BUSY;
+
+    dma_set_config(hdma, SrcAddress, DstAddress, DataLength);
+    dma_clear_flags(hdma, DMA_FLAGS_ALL);
+
+    hdma->Instance->CR |= DMA_IT_TC | DMA_IT_TE | DMA_IT_DME;
+    if (hdma->XferHalfCpltCallback != NULL) {
+        hdma->Instance->CR |= DMA_IT_HT;
+    }
+    __HAL_DMA_ENABLE(hdma);
+    sim_dma_sync();
+    return HAL_OK;
+}
+
+/* Double buffer mode: DstAddress (M0) and SecondMemAddress (M1) take turns,
+ * peripheral-to-memory only like the real HAL */
+HAL_StatusTypeDef HAL_DMAEx_MultiBufferStart(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t SecondMemAddress, uint32_t DataLength)
+{
+    if (hdma->State != HAL_DMA_STATE_READY) {
+        return HAL_BUSY;
+    }
+    hdma->State = HAL_DMA_STATE_BUSY;
+
+    dma_set_config(hdma, SrcAddress, DstAddress, DataLength);
+    hdma->Instance->CR |= DMA_SxCR_DBM;
+    hdma->Instance->M1AR = SecondMemAddress;
+    __HAL_DMA_ENABLE(hdma);
+    sim_dma_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMAEx_MultiBufferStart_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t SecondMemAddress, uint32_t DataLength)
+{
+    if (hdma->State != HAL_DMA_STATE_READY) {
+        return HAL_BUSY;
+    }
+    hdma->State = HAL_DMA_STATE_BUSY;
+
+    dma_set_config(hdma, SrcAddress, DstAddress, DataLength);
+    hdma->Instance->CR |= DMA_SxCR_DBM;
+    hdma->Instance->M1AR = SecondMemAddress;
+    dma_clear_flags(hdma, DMA_FLAGS_ALL);
+
+    hdma->Instance->CR |= DMA_IT_TC | DMA_IT_TE | DMA_IT_DME;
+    if (hdma->XferHalfCpltCallback != NULL) {
+        hdma->Instance->CR |= DMA_IT_HT;
+    }
+    __HAL_DMA_ENABLE(hdma);
+    sim_dma_sync();
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma)
+{
+    hdma->Instance->CR &= ~(DMA_IT_TC | DMA_IT_TE | DMA_IT_DME | DMA_IT_HT);
+    __HAL_DMA_DISABLE(hdma);
+    sim_dma_sync();
+    dma_clear_flags(hdma, DMA_FLAGS_ALL);
+
+    hdma->State = HAL_DMA_STATE_READY;
+    return HAL_OK;
+}
+
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma)
+{
+    uint32_t isr = *(__IO uint32_t *)(uintptr_t)hdma->StreamBaseAddress >> hdma->StreamIndex;
+    uint32_t cr = hdma->Instance->CR;
+
+    if ((isr & DMA_LISR_TEIF0) && (cr & DMA_IT_TE)) {
+        hdma->Instance->CR &= ~DMA_IT_TE;
+        dma_clear_flags(hdma, DMA_LISR_TEIF0);
+        hdma->ErrorCode |= 0x01U;
+    }
+    if ((isr & DMA_LISR_HTIF0) && (cr & DMA_IT_HT)) {
+        dma_clear_flags(hdma, DMA_LISR_HTIF0);
+        if (!(cr & (DMA_SxCR_CIRC | DMA_SxCR_DBM))) {
+            hdma->Instance->CR &= ~DMA_IT_HT;
+        }
+        if (hdma->XferHalfCpltCallback != NULL) {
+            hdma->XferHalfCpltCallback(hdma);
+        }
+    }
+    if ((isr & DMA_LISR_TCIF0) && (cr & DMA_IT_TC)) {
+        dma_clear_flags(hdma, DMA_LISR_TCIF0);
+        if (!(cr & (DMA_SxCR_CIRC | DMA_SxCR_DBM))) {
+            hdma->Instance->CR &= ~(DMA_IT_TC | DMA_IT_TE | DMA_IT_DME | DMA_IT_HT);
+            hdma->State = HAL_DMA_STATE_READY;
+        }
+        if (cr & DMA_SxCR_DBM) {
+            // CT has already moved on to the other buffer
+            if (cr & DMA_SxCR_CT) {
+                if (hdma->XferCpltCallback != NULL) {
+                    hdma->XferCpltCallback(hdma);
+                }
+            } else if (hdma->XferM1CpltCallback != NULL) {
+                hdma->XferM1CpltCallback(hdma);
+            }
+        } else if (hdma->XferCpltCallback != NULL) {
+            hdma->XferCpltCallback(hdma);
+        }
+    }
+    if (hdma->ErrorCode && hdma->XferErrorCallback != NULL) {
+        hdma->XferErrorCallback(hdma);
+    }
+}
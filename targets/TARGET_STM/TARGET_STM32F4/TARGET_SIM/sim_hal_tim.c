@@ -0,0 +1,496 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* The STM32Cube TIM and RCC HAL calls used by the drivers, reduced to the
+ * register writes the real HAL performs so sim_tim.c sees the same timer
+ * configuration the silicon would.
+ */
+#include "sim_tim.h"
+
+uint32_t SystemCoreClock = SIM_HCLK_HZ;
+
+/******************************************************************************/
+/*                          RCC                                               */
+/******************************************************************************/
+void HAL_RCC_GetClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t *pFLatency)
+{
+    RCC_ClkInitStruct->ClockType = 0xF;
+    RCC_ClkInitStruct->SYSCLKSource = 2;
+    RCC_ClkInitStruct->AHBCLKDivider = 0;
+    RCC_ClkInitStruct->APB1CLKDivider = RCC_HCLK_DIV4;
+    RCC_ClkInitStruct->APB2CLKDivider = RCC_HCLK_DIV2;
+    *pFLatency = 5;
+}
+
+uint32_t HAL_RCC_GetHCLKFreq(void)
+{
+    return SIM_HCLK_HZ;
+}
+
+uint32_t HAL_RCC_GetPCLK1Freq(void)
+{
+    return SIM_PCLK1_HZ;
+}
+
+uint32_t HAL_RCC_GetPCLK2Freq(void)
+{
+    return SIM_PCLK2_HZ;
+}
+
+/******************************************************************************/
+/*                          Configuration helpers                             */
+/******************************************************************************/
+static void tim_base_set_config(TIM_TypeDef *TIMx, TIM_Base_InitTypeDef *Structure)
+{
+    uint32_t tmpcr1 = TIMx->CR1;
+
+    tmpcr1 &= ~(TIM_CR1_DIR | TIM_CR1_CMS);
+    tmpcr1 |= Structure->CounterMode;
+    tmpcr1 &= ~TIM_CR1_CKD;
+    tmpcr1 |= Structure->ClockDivision;
+    TIMx->CR1 = tmpcr1;
+
+    TIMx->ARR = Structure->Period;
+    TIMx->PSC = Structure->Prescaler;
+    if (IS_TIM_ADVANCED_INSTANCE(TIMx)) {
+        TIMx->RCR = Structure->RepetitionCounter;
+    }
+
+    // Load PSC/ARR into the shadow registers
+    sim_tim_generate(TIMx, TIM_EGR_UG);
+}
+
+static void tim_ccx_channel_cmd(TIM_TypeDef *TIMx, uint32_t Channel, uint32_t ChannelState)
+{
+    uint32_t tmp = TIM_CCER_CC1E << Channel;
+
+    TIMx->CCER &= ~tmp;
+    TIMx->CCER |= (ChannelState << Channel);
+}
+
+static volatile uint32_t *tim_ccmr(TIM_TypeDef *TIMx, uint32_t Channel)
+{
+    return (Channel < TIM_CHANNEL_3) ? &TIMx->CCMR1 : &TIMx->CCMR2;
+}
+
+static uint32_t tim_ccmr_shift(uint32_t Channel)
+{
+    return (Channel == TIM_CHANNEL_2 || Channel == TIM_CHANNEL_4) ? 8U : 0U;
+}
+
+static void tim_oc_set_config(TIM_TypeDef *TIMx, TIM_OC_InitTypeDef *OC_Config, uint32_t Channel)
+{
+    volatile uint32_t *ccmr = tim_ccmr(TIMx, Channel);
+    uint32_t shift = tim_ccmr_shift(Channel);
+
+    TIMx->CCER &= ~(TIM_CCER_CC1E << Channel);
+
+    *ccmr &= ~((TIM_CCMR1_OC1M | TIM_CCMR1_CC1S) << shift);
+    *ccmr |= OC_Config->OCMode << shift;
+
+    TIMx->CCER &= ~(TIM_CCER_CC1P << Channel);
+    TIMx->CCER |= OC_Config->OCPolarity << Channel;
+
+    if (IS_TIM_ADVANCED_INSTANCE(TIMx) && Channel != TIM_CHANNEL_4) {
+        TIMx->CCER &= ~(TIM_CCER_CC1NP << Channel);
+        TIMx->CCER |= OC_Config->OCNPolarity << Channel;
+        TIMx->CCER &= ~(TIM_CCER_CC1NE << Channel);
+    }
+
+    (&TIMx->CCR1)[Channel >> 2U] = OC_Config->Pulse;
+}
+
+static void tim_ti_set_config(TIM_TypeDef *TIMx, uint32_t Channel, uint32_t ICPolarity,
+                              uint32_t ICSelection, uint32_t ICFilter)
+{
+    volatile uint32_t *ccmr = tim_ccmr(TIMx, Channel);
+    uint32_t shift = tim_ccmr_shift(Channel);
+
+    TIMx->CCER &= ~(TIM_CCER_CC1E << Channel);
+
+    *ccmr &= ~((TIM_CCMR1_CC1S | TIM_CCMR1_IC1F) << shift);
+    *ccmr |= (ICSelection | ((ICFilter << 4U) & TIM_CCMR1_IC1F)) << shift;
+
+    TIMx->CCER &= ~((TIM_CCER_CC1P | TIM_CCER_CC1NP) << Channel);
+    TIMx->CCER |= (ICPolarity & (TIM_CCER_CC1P | TIM_CCER_CC1NP)) << Channel;
+}
+
+/* Filter and polarity of TI1/TI2 when they are used as a trigger or clock */
+static void tim_ti_config_input_stage(TIM_TypeDef *TIMx, uint32_t Channel, uint32_t ICPolarity, uint32_t ICFilter)
+{
+    uint32_t shift = tim_ccmr_shift(Channel);
+    uint32_t ccer_e = TIMx->CCER & (TIM_CCER_CC1E << Channel);
+
+    TIMx->CCER &= ~(TIM_CCER_CC1E << Channel);
+
+    TIMx->CCMR1 &= ~(TIM_CCMR1_IC1F << shift);
+    TIMx->CCMR1 |= ((ICFilter << 4U) & TIM_CCMR1_IC1F) << shift;
+
+    TIMx->CCER &= ~((TIM_CCER_CC1P | TIM_CCER_CC1NP) << Channel);
+    TIMx->CCER |= (ICPolarity & (TIM_CCER_CC1P | TIM_CCER_CC1NP)) << Channel;
+    TIMx->CCER |= ccer_e;
+}
+
+static void tim_etr_set_config(TIM_TypeDef *TIMx, uint32_t TIM_ExtTRGPrescaler,
+                               uint32_t TIM_ExtTRGPolarity, uint32_t ExtTRGFilter)
+{
+    uint32_t tmpsmcr = TIMx->SMCR;
+
+    tmpsmcr &= ~(TIM_SMCR_ETF | TIM_SMCR_ETPS | TIM_SMCR_ECE | TIM_SMCR_ETP);
+    tmpsmcr |= TIM_ExtTRGPrescaler | TIM_ExtTRGPolarity | ((ExtTRGFilter << TIM_SMCR_ETF_Pos) & TIM_SMCR_ETF);
+    TIMx->SMCR = tmpsmcr;
+}
+
+static void tim_itr_config(TIM_TypeDef *TIMx, uint32_t InputTriggerSource)
+{
+    uint32_t tmpsmcr = TIMx->SMCR;
+
+    tmpsmcr &= ~(TIM_SMCR_TS | TIM_SMCR_SMS);
+    tmpsmcr |= InputTriggerSource | TIM_SLAVEMODE_EXTERNAL1;
+    TIMx->SMCR = tmpsmcr;
+}
+
+/******************************************************************************/
+/*                          Time base                                         */
+/******************************************************************************/
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim)
+{
+    if (htim == NULL) {
+        return HAL_ERROR;
+    }
+    htim->State = HAL_TIM_STATE_BUSY;
+    tim_base_set_config(htim->Instance, &htim->Init);
+    htim->State = HAL_TIM_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim)
+{
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef *htim)
+{
+    __HAL_TIM_DISABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim)
+{
+    __HAL_TIM_ENABLE_IT(htim, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim)
+{
+    __HAL_TIM_DISABLE_IT(htim, TIM_IT_UPDATE);
+    __HAL_TIM_DISABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OnePulse_Init(TIM_HandleTypeDef *htim, uint32_t OnePulseMode)
+{
+    if (htim == NULL) {
+        return HAL_ERROR;
+    }
+    tim_base_set_config(htim->Instance, &htim->Init);
+    htim->Instance->CR1 &= ~TIM_CR1_OPM;
+    htim->Instance->CR1 |= OnePulseMode;
+    htim->State = HAL_TIM_STATE_READY;
+    return HAL_OK;
+}
+
+/******************************************************************************/
+/*                          Output compare                                    */
+/******************************************************************************/
+HAL_StatusTypeDef HAL_TIM_OC_Init(TIM_HandleTypeDef *htim)
+{
+    return HAL_TIM_Base_Init(htim);
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel)
+{
+    if (Channel > TIM_CHANNEL_4) {
+        return HAL_ERROR;
+    }
+    tim_oc_set_config(htim->Instance, sConfig, Channel);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    tim_ccx_channel_cmd(htim->Instance, Channel, TIM_CCx_ENABLE);
+    if (IS_TIM_ADVANCED_INSTANCE(htim->Instance)) {
+        __HAL_TIM_MOE_ENABLE(htim);
+    }
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    tim_ccx_channel_cmd(htim->Instance, Channel, TIM_CCx_DISABLE);
+    __HAL_TIM_DISABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    __HAL_TIM_ENABLE_IT(htim, TIM_IT_CC1 << (Channel >> 2U));
+    return HAL_TIM_OC_Start(htim, Channel);
+}
+
+HAL_StatusTypeDef HAL_TIM_OC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    __HAL_TIM_DISABLE_IT(htim, TIM_IT_CC1 << (Channel >> 2U));
+    return HAL_TIM_OC_Stop(htim, Channel);
+}
+
+/******************************************************************************/
+/*                          Input capture                                     */
+/******************************************************************************/
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef *htim)
+{
+    return HAL_TIM_Base_Init(htim);
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef *htim, TIM_IC_InitTypeDef *sConfig, uint32_t Channel)
+{
+    volatile uint32_t *ccmr;
+    uint32_t shift;
+
+    if (Channel > TIM_CHANNEL_4) {
+        return HAL_ERROR;
+    }
+    ccmr = tim_ccmr(htim->Instance, Channel);
+    shift = tim_ccmr_shift(Channel);
+
+    tim_ti_set_config(htim->Instance, Channel, sConfig->ICPolarity, sConfig->ICSelection, sConfig->ICFilter);
+    *ccmr &= ~(TIM_CCMR1_IC1PSC << shift);
+    *ccmr |= sConfig->ICPrescaler << shift;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    tim_ccx_channel_cmd(htim->Instance, Channel, TIM_CCx_ENABLE);
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    tim_ccx_channel_cmd(htim->Instance, Channel, TIM_CCx_DISABLE);
+    __HAL_TIM_DISABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    __HAL_TIM_ENABLE_IT(htim, TIM_IT_CC1 << (Channel >> 2U));
+    return HAL_TIM_IC_Start(htim, Channel);
+}
+
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    __HAL_TIM_DISABLE_IT(htim, TIM_IT_CC1 << (Channel >> 2U));
+    return HAL_TIM_IC_Stop(htim, Channel);
+}
+
+/******************************************************************************/
+/*                          Encoder                                           */
+/******************************************************************************/
+HAL_StatusTypeDef HAL_TIM_Encoder_Init(TIM_HandleTypeDef *htim, TIM_Encoder_InitTypeDef *sConfig)
+{
+    TIM_TypeDef *TIMx;
+    uint32_t tmpsmcr;
+    uint32_t tmpccmr1;
+    uint32_t tmpccer;
+
+    if (htim == NULL) {
+        return HAL_ERROR;
+    }
+    TIMx = htim->Instance;
+    htim->State = HAL_TIM_STATE_BUSY;
+
+    TIMx->SMCR &= ~TIM_SMCR_SMS;
+    tim_base_set_config(TIMx, &htim->Init);
+
+    tmpsmcr = TIMx->SMCR;
+    tmpccmr1 = TIMx->CCMR1;
+    tmpccer = TIMx->CCER;
+
+    tmpsmcr |= sConfig->EncoderMode;
+
+    tmpccmr1 &= ~(TIM_CCMR1_CC1S | TIM_CCMR1_CC2S);
+    tmpccmr1 |= sConfig->IC1Selection | (sConfig->IC2Selection << 8U);
+    tmpccmr1 &= ~(TIM_CCMR1_IC1PSC | TIM_CCMR1_IC2PSC);
+    tmpccmr1 &= ~(TIM_CCMR1_IC1F | TIM_CCMR1_IC2F);
+    tmpccmr1 |= sConfig->IC1Prescaler | (sConfig->IC2Prescaler << 8U);
+    tmpccmr1 |= (sConfig->IC1Filter << 4U) | (sConfig->IC2Filter << 12U);
+
+    tmpccer &= ~(TIM_CCER_CC1P | TIM_CCER_CC2P);
+    tmpccer &= ~(TIM_CCER_CC1NP | TIM_CCER_CC2NP);
+    tmpccer |= sConfig->IC1Polarity | (sConfig->IC2Polarity << 4U);
+
+    TIMx->SMCR = tmpsmcr;
+    TIMx->CCMR1 = tmpccmr1;
+    TIMx->CCER = tmpccer;
+
+    htim->State = HAL_TIM_STATE_READY;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    switch (Channel) {
+        case TIM_CHANNEL_1:
+            tim_ccx_channel_cmd(htim->Instance, TIM_CHANNEL_1, TIM_CCx_ENABLE);
+            break;
+        case TIM_CHANNEL_2:
+            tim_ccx_channel_cmd(htim->Instance, TIM_CHANNEL_2, TIM_CCx_ENABLE);
+            break;
+        default:
+            tim_ccx_channel_cmd(htim->Instance, TIM_CHANNEL_1, TIM_CCx_ENABLE);
+            tim_ccx_channel_cmd(htim->Instance, TIM_CHANNEL_2, TIM_CCx_ENABLE);
+            break;
+    }
+    __HAL_TIM_ENABLE(htim);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Stop(TIM_HandleTypeDef *htim, uint32_t Channel)
+{
+    switch (Channel) {
+        case TIM_CHANNEL_1:
+            tim_ccx_channel_cmd(htim->Instance, TIM_CHANNEL_1, TIM_CCx_DISABLE);
+            break;
+        case TIM_CHANNEL_2:
+            tim_ccx_channel_cmd(htim->Instance, TIM_CHANNEL_2, TIM_CCx_DISABLE);
+            break;
+        default:
+            tim_ccx_channel_cmd(htim->Instance, TIM_CHANNEL_1, TIM_CCx_DISABLE);
+            tim_ccx_channel_cmd(htim->Instance, TIM_CHANNEL_2, TIM_CCx_DISABLE);
+            break;
+    }
+    __HAL_TIM_DISABLE(htim);
+    return HAL_OK;
+}
+
+/******************************************************************************/
+/*                          Clock source / synchronization                    */
+/******************************************************************************/
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *sClockSourceConfig)
+{
+    TIM_TypeDef *TIMx = htim->Instance;
+
+    TIMx->SMCR &= ~(TIM_SMCR_SMS | TIM_SMCR_TS);
+    TIMx->SMCR &= ~(TIM_SMCR_ETF | TIM_SMCR_ETPS | TIM_SMCR_ECE | TIM_SMCR_ETP);
+
+    switch (sClockSourceConfig->ClockSource) {
+        case TIM_CLOCKSOURCE_INTERNAL:
+            break;
+        case TIM_CLOCKSOURCE_ETRMODE1:
+            tim_etr_set_config(TIMx, sClockSourceConfig->ClockPrescaler,
+                               sClockSourceConfig->ClockPolarity, sClockSourceConfig->ClockFilter);
+            TIMx->SMCR |= TIM_SLAVEMODE_EXTERNAL1 | TIM_TS_ETRF;
+            break;
+        case TIM_CLOCKSOURCE_ETRMODE2:
+            tim_etr_set_config(TIMx, sClockSourceConfig->ClockPrescaler,
+                               sClockSourceConfig->ClockPolarity, sClockSourceConfig->ClockFilter);
+            TIMx->SMCR |= TIM_SMCR_ECE;
+            break;
+        case TIM_CLOCKSOURCE_TI1:
+            tim_ti_config_input_stage(TIMx, TIM_CHANNEL_1, sClockSourceConfig->ClockPolarity,
+                                      sClockSourceConfig->ClockFilter);
+            tim_itr_config(TIMx, TIM_CLOCKSOURCE_TI1);
+            break;
+        case TIM_CLOCKSOURCE_TI2:
+            tim_ti_config_input_stage(TIMx, TIM_CHANNEL_2, sClockSourceConfig->ClockPolarity,
+                                      sClockSourceConfig->ClockFilter);
+            tim_itr_config(TIMx, TIM_CLOCKSOURCE_TI2);
+            break;
+        case TIM_CLOCKSOURCE_TI1ED:
+            tim_ti_config_input_stage(TIMx, TIM_CHANNEL_1, sClockSourceConfig->ClockPolarity,
+                                      sClockSourceConfig->ClockFilter);
+            tim_itr_config(TIMx, TIM_CLOCKSOURCE_TI1ED);
+            break;
+        case TIM_CLOCKSOURCE_ITR0:
+        case TIM_CLOCKSOURCE_ITR1:
+        case TIM_CLOCKSOURCE_ITR2:
+        case TIM_CLOCKSOURCE_ITR3:
+            tim_itr_config(TIMx, sClockSourceConfig->ClockSource);
+            break;
+        default:
+            return HAL_ERROR;
+    }
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_SlaveConfigSynchronization(TIM_HandleTypeDef *htim, TIM_SlaveConfigTypeDef *sSlaveConfig)
+{
+    TIM_TypeDef *TIMx = htim->Instance;
+    uint32_t tmpsmcr = TIMx->SMCR;
+
+    tmpsmcr &= ~TIM_SMCR_TS;
+    tmpsmcr |= sSlaveConfig->InputTrigger;
+    tmpsmcr &= ~TIM_SMCR_SMS;
+    tmpsmcr |= sSlaveConfig->SlaveMode;
+    TIMx->SMCR = tmpsmcr;
+
+    switch (sSlaveConfig->InputTrigger) {
+        case TIM_TS_ETRF:
+            tim_etr_set_config(TIMx, sSlaveConfig->TriggerPrescaler,
+                               sSlaveConfig->TriggerPolarity, sSlaveConfig->TriggerFilter);
+            break;
+        case TIM_TS_TI1F_ED:
+            tim_ti_config_input_stage(TIMx, TIM_CHANNEL_1, TIM_ICPOLARITY_RISING, sSlaveConfig->TriggerFilter);
+            break;
+        case TIM_TS_TI1FP1:
+            tim_ti_config_input_stage(TIMx, TIM_CHANNEL_1, sSlaveConfig->TriggerPolarity,
+                                      sSlaveConfig->TriggerFilter);
+            break;
+        case TIM_TS_TI2FP2:
+            tim_ti_config_input_stage(TIMx, TIM_CHANNEL_2, sSlaveConfig->TriggerPolarity,
+                                      sSlaveConfig->TriggerFilter);
+            break;
+        default:
+            break;
+    }
+
+    __HAL_TIM_DISABLE_IT(htim, TIM_IT_TRIGGER);
+    __HAL_TIM_DISABLE_DMA(htim, TIM_DMA_TRIGGER);
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *sMasterConfig)
+{
+    TIM_TypeDef *TIMx = htim->Instance;
+
+    TIMx->CR2 &= ~TIM_CR2_MMS;
+    TIMx->CR2 |= sMasterConfig->MasterOutputTrigger;
+    TIMx->SMCR &= ~TIM_SMCR_MSM;
+    TIMx->SMCR |= sMasterConfig->MasterSlaveMode;
+    return HAL_OK;
+}
+
+HAL_StatusTypeDef HAL_TIM_GenerateEvent(TIM_HandleTypeDef *htim, uint32_t EventSource)
+{
+    sim_tim_generate(htim->Instance, EventSource);
+    return HAL_OK;
+}
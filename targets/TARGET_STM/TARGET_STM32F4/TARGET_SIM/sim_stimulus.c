@@ -0,0 +1,108 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "sim_stimulus.h"
+
+/* Quadrature states in forward order: (A,B) = 00, 10, 11, 01 */
+static const uint8_t quad_a[4] = { 0, 1, 1, 0 };
+static const uint8_t quad_b[4] = { 0, 0, 1, 1 };
+
+static sim_time_t stim_next(sim_source_t *src)
+{
+    sim_stimulus_t *stim = (sim_stimulus_t *)src;
+    uint64_t k = stim->index;
+
+    if (stim->kind == SIM_STIM_IDLE || (stim->edges && k >= stim->edges)) {
+        return SIM_TIME_NEVER;
+    }
+
+    if (stim->kind == SIM_STIM_PULSE) {
+        // Edge 2n rises at n periods, edge 2n+1 falls duty% later
+        uint64_t num = (k / 2) * 100 + ((k & 1) ? stim->duty : 0);
+        return stim->start + (num * SIM_HCLK_HZ) / (stim->rate * 100);
+    }
+    return stim->start + ((k + 1) * SIM_HCLK_HZ) / stim->rate;
+}
+
+static void stim_fire(sim_source_t *src)
+{
+    sim_stimulus_t *stim = (sim_stimulus_t *)src;
+
+    if (stim->kind == SIM_STIM_PULSE) {
+        sim_gpio_write(stim->pin_a, !(stim->index & 1));
+    } else {
+        stim->phase = (stim->phase + stim->direction) & 3;
+        sim_gpio_write(stim->pin_a, quad_a[stim->phase]);
+        sim_gpio_write(stim->pin_b, quad_b[stim->phase]);
+    }
+    stim->index++;
+}
+
+static void stim_start(sim_stimulus_t *stim)
+{
+    stim->source.next = stim_next;
+    stim->source.fire = stim_fire;
+    stim->start = sim_now();
+    stim->index = 0;
+    sim_source_add(&stim->source);
+}
+
+void sim_stimulus_pulse(sim_stimulus_t *stim, PinName pin, uint32_t hz, uint32_t duty, uint32_t pulses)
+{
+    stim->kind = SIM_STIM_PULSE;
+    stim->pin_a = pin;
+    stim->pin_b = NC;
+    stim->rate = hz;
+    stim->duty = (duty == 0 || duty >= 100) ? 50 : duty;
+    stim->edges = (uint64_t)pulses * 2;
+
+    // Start from low so the first edge is a rising one
+    sim_gpio_write(pin, 0);
+    stim_start(stim);
+}
+
+void sim_stimulus_quadrature(sim_stimulus_t *stim, PinName pin_a, PinName pin_b, uint32_t edge_hz, int64_t edges)
+{
+    uint8_t phase;
+    int a = sim_gpio_read(pin_a);
+    int b = sim_gpio_read(pin_b);
+
+    // Continue from whatever state the pins were left in
+    for (phase = 0; phase < 4; phase++) {
+        if (quad_a[phase] == a && quad_b[phase] == b) {
+            break;
+        }
+    }
+
+    stim->kind = SIM_STIM_QUADRATURE;
+    stim->pin_a = pin_a;
+    stim->pin_b = pin_b;
+    stim->rate = edge_hz;
+    stim->phase = phase;
+    stim->direction = (edges < 0) ? -1 : 1;
+    stim->edges = (edges < 0) ? (uint64_t)(-edges) : (uint64_t)edges;
+    stim_start(stim);
+}
+
+void sim_stimulus_stop(sim_stimulus_t *stim)
+{
+    sim_source_remove(&stim->source);
+    stim->kind = SIM_STIM_IDLE;
+}
+
+uint64_t sim_stimulus_edges(sim_stimulus_t *stim)
+{
+    return stim->index;
+}
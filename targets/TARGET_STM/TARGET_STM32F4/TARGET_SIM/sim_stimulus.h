@@ -0,0 +1,80 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SIM_STIMULUS_H
+#define SIM_STIMULUS_H
+
+#include "PinNames.h"
+#include "sim_tim.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+typedef enum {
+    SIM_STIM_IDLE,
+    SIM_STIM_PULSE,
+    SIM_STIM_QUADRATURE
+} sim_stim_kind;
+
+/** Edge generator driving one or two pins. Edge times are computed from the
+ * edge index, so long runs at odd rates do not drift.
+ */
+typedef struct {
+    sim_source_t source;
+    sim_stim_kind kind;
+    PinName pin_a;
+    PinName pin_b;
+    sim_time_t start;
+    uint64_t rate;          // edges per second (quadrature) or Hz (pulse)
+    uint32_t duty;          // high time in percent, pulse only
+    uint64_t index;         // edges emitted
+    uint64_t edges;         // edges to emit, 0 for no limit
+    int8_t direction;       // +1 A leads B, -1 B leads A
+    uint8_t phase;          // quadrature state 0-3
+} sim_stimulus_t;
+
+/** Square wave on a pin
+ *
+ * @param stim generator state
+ * @param pin pin to drive, left low when the train ends
+ * @param hz pulse frequency
+ * @param duty high time in percent (1-99)
+ * @param pulses number of pulses to send, 0 to run until stopped
+ */
+void sim_stimulus_pulse(sim_stimulus_t *stim, PinName pin, uint32_t hz, uint32_t duty, uint32_t pulses);
+
+/** Quadrature signal on two pins
+ *
+ * @param stim generator state
+ * @param pin_a channel A
+ * @param pin_b channel B
+ * @param edge_hz edges per second over both channels (4x the line rate)
+ * @param edges number of edges, positive for A leading B, negative for B
+ *        leading A, 0 to run forward until stopped
+ */
+void sim_stimulus_quadrature(sim_stimulus_t *stim, PinName pin_a, PinName pin_b, uint32_t edge_hz, int64_t edges);
+
+/** Stop a generator, leaving its pins at their current level */
+void sim_stimulus_stop(sim_stimulus_t *stim);
+
+/** Edges emitted so far */
+uint64_t sim_stimulus_edges(sim_stimulus_t *stim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,873 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Host-side stand-in for stm32f4xx.h / stm32f4xx_hal.h.
+ *
+ * Only the subset of the CMSIS device header and the STM32Cube TIM/RCC HAL that
+ * the drivers in this repository use is provided. Register layouts, bit
+ * positions, constants and macro semantics follow the STM32F429 reference
+ * manual (RM0090) and HAL so the hal/ implementations in TARGET_STM32F4 build
+ * and behave the same way against sim_tim.c as they do against silicon.
+ *
+ * The peripheral window is mapped at its real address by sim_tim.c, so
+ * TIMx_BASE values and the (TIM_TypeDef *) casts in the drivers are unchanged.
+ */
+#ifndef SIM_STM32F4XX_H
+#define SIM_STM32F4XX_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#define __IO volatile
+
+/******************************************************************************/
+/*                          Interrupt numbers                                 */
+/******************************************************************************/
+typedef enum {
+    DMA1_Stream0_IRQn           = 11,
+    DMA1_Stream1_IRQn           = 12,
+    DMA1_Stream2_IRQn           = 13,
+    DMA1_Stream3_IRQn           = 14,
+    DMA1_Stream4_IRQn           = 15,
+    DMA1_Stream5_IRQn           = 16,
+    DMA1_Stream6_IRQn           = 17,
+    TIM1_BRK_TIM9_IRQn          = 24,
+    TIM1_UP_TIM10_IRQn          = 25,
+    TIM1_TRG_COM_TIM11_IRQn     = 26,
+    TIM1_CC_IRQn                = 27,
+    TIM2_IRQn                   = 28,
+    TIM3_IRQn                   = 29,
+    TIM4_IRQn                   = 30,
+    TIM8_BRK_TIM12_IRQn         = 43,
+    TIM8_UP_TIM13_IRQn          = 44,
+    TIM8_TRG_COM_TIM14_IRQn     = 45,
+    TIM8_CC_IRQn                = 46,
+    DMA1_Stream7_IRQn           = 47,
+    TIM5_IRQn                   = 50,
+    DMA2_Stream0_IRQn           = 56,
+    DMA2_Stream1_IRQn           = 57,
+    DMA2_Stream2_IRQn           = 58,
+    DMA2_Stream3_IRQn           = 59,
+    DMA2_Stream4_IRQn           = 60,
+    DMA2_Stream5_IRQn           = 68,
+    DMA2_Stream6_IRQn           = 69,
+    DMA2_Stream7_IRQn           = 70,
+    SIM_IRQn_COUNT              = 91
+} IRQn_Type;
+
+/******************************************************************************/
+/*                          Peripheral registers                              */
+/******************************************************************************/
+typedef struct {
+    __IO uint32_t CR1;
+    __IO uint32_t CR2;
+    __IO uint32_t SMCR;
+    __IO uint32_t DIER;
+    __IO uint32_t SR;
+    __IO uint32_t EGR;
+    __IO uint32_t CCMR1;
+    __IO uint32_t CCMR2;
+    __IO uint32_t CCER;
+    __IO uint32_t CNT;
+    __IO uint32_t PSC;
+    __IO uint32_t ARR;
+    __IO uint32_t RCR;
+    __IO uint32_t CCR1;
+    __IO uint32_t CCR2;
+    __IO uint32_t CCR3;
+    __IO uint32_t CCR4;
+    __IO uint32_t BDTR;
+    __IO uint32_t DCR;
+    __IO uint32_t DMAR;
+    __IO uint32_t OR;
+} TIM_TypeDef;
+
+typedef struct {
+    __IO uint32_t CR;
+    __IO uint32_t NDTR;
+    __IO uint32_t PAR;
+    __IO uint32_t M0AR;
+    __IO uint32_t M1AR;
+    __IO uint32_t FCR;
+} DMA_Stream_TypeDef;
+
+typedef struct {
+    __IO uint32_t LISR;
+    __IO uint32_t HISR;
+    __IO uint32_t LIFCR;
+    __IO uint32_t HIFCR;
+} DMA_TypeDef;
+
+#define PERIPH_BASE             0x40000000UL
+#define APB1PERIPH_BASE         PERIPH_BASE
+#define APB2PERIPH_BASE         (PERIPH_BASE + 0x00010000UL)
+#define AHB1PERIPH_BASE         (PERIPH_BASE + 0x00020000UL)
+#define SIM_PERIPH_SIZE         0x00030000UL
+
+#define TIM2_BASE               (APB1PERIPH_BASE + 0x0000UL)
+#define TIM3_BASE               (APB1PERIPH_BASE + 0x0400UL)
+#define TIM4_BASE               (APB1PERIPH_BASE + 0x0800UL)
+#define TIM5_BASE               (APB1PERIPH_BASE + 0x0C00UL)
+#define TIM1_BASE               (APB2PERIPH_BASE + 0x0000UL)
+#define TIM8_BASE               (APB2PERIPH_BASE + 0x0400UL)
+
+#define DMA1_BASE               (AHB1PERIPH_BASE + 0x6000UL)
+#define DMA2_BASE               (AHB1PERIPH_BASE + 0x6400UL)
+#define DMA1_Stream0_BASE       (DMA1_BASE + 0x010UL)
+#define DMA1_Stream1_BASE       (DMA1_BASE + 0x028UL)
+#define DMA1_Stream2_BASE       (DMA1_BASE + 0x040UL)
+#define DMA1_Stream3_BASE       (DMA1_BASE + 0x058UL)
+#define DMA1_Stream4_BASE       (DMA1_BASE + 0x070UL)
+#define DMA1_Stream5_BASE       (DMA1_BASE + 0x088UL)
+#define DMA1_Stream6_BASE       (DMA1_BASE + 0x0A0UL)
+#define DMA1_Stream7_BASE       (DMA1_BASE + 0x0B8UL)
+#define DMA2_Stream0_BASE       (DMA2_BASE + 0x010UL)
+#define DMA2_Stream1_BASE       (DMA2_BASE + 0x028UL)
+#define DMA2_Stream2_BASE       (DMA2_BASE + 0x040UL)
+#define DMA2_Stream3_BASE       (DMA2_BASE + 0x058UL)
+#define DMA2_Stream4_BASE       (DMA2_BASE + 0x070UL)
+#define DMA2_Stream5_BASE       (DMA2_BASE + 0x088UL)
+#define DMA2_Stream6_BASE       (DMA2_BASE + 0x0A0UL)
+#define DMA2_Stream7_BASE       (DMA2_BASE + 0x0B8UL)
+
+#define DMA1                    ((DMA_TypeDef *) DMA1_BASE)
+#define DMA2                    ((DMA_TypeDef *) DMA2_BASE)
+#define DMA1_Stream0            ((DMA_Stream_TypeDef *) DMA1_Stream0_BASE)
+#define DMA1_Stream1            ((DMA_Stream_TypeDef *) DMA1_Stream1_BASE)
+#define DMA1_Stream2            ((DMA_Stream_TypeDef *) DMA1_Stream2_BASE)
+#define DMA1_Stream3            ((DMA_Stream_TypeDef *) DMA1_Stream3_BASE)
+#define DMA1_Stream4            ((DMA_Stream_TypeDef *) DMA1_Stream4_BASE)
+#define DMA1_Stream5            ((DMA_Stream_TypeDef *) DMA1_Stream5_BASE)
+#define DMA1_Stream6            ((DMA_Stream_TypeDef *) DMA1_Stream6_BASE)
+#define DMA1_Stream7            ((DMA_Stream_TypeDef *) DMA1_Stream7_BASE)
+#define DMA2_Stream0            ((DMA_Stream_TypeDef *) DMA2_Stream0_BASE)
+#define DMA2_Stream1            ((DMA_Stream_TypeDef *) DMA2_Stream1_BASE)
+#define DMA2_Stream2            ((DMA_Stream_TypeDef *) DMA2_Stream2_BASE)
+#define DMA2_Stream3            ((DMA_Stream_TypeDef *) DMA2_Stream3_BASE)
+#define DMA2_Stream4            ((DMA_Stream_TypeDef *) DMA2_Stream4_BASE)
+#define DMA2_Stream5            ((DMA_Stream_TypeDef *) DMA2_Stream5_BASE)
+#define DMA2_Stream6            ((DMA_Stream_TypeDef *) DMA2_Stream6_BASE)
+#define DMA2_Stream7            ((DMA_Stream_TypeDef *) DMA2_Stream7_BASE)
+
+#define TIM1                    ((TIM_TypeDef *) TIM1_BASE)
+#define TIM2                    ((TIM_TypeDef *) TIM2_BASE)
+#define TIM3                    ((TIM_TypeDef *) TIM3_BASE)
+#define TIM4                    ((TIM_TypeDef *) TIM4_BASE)
+#define TIM5                    ((TIM_TypeDef *) TIM5_BASE)
+#define TIM8                    ((TIM_TypeDef *) TIM8_BASE)
+
+#define IS_TIM_ADVANCED_INSTANCE(INSTANCE) (((INSTANCE) == TIM1) || ((INSTANCE) == TIM8))
+#define IS_TIM_32B_COUNTER_INSTANCE(INSTANCE) (((INSTANCE) == TIM2) || ((INSTANCE) == TIM5))
+
+/*******************  Bit definition for TIM registers  ***********************/
+#define TIM_CR1_CEN             0x0001U
+#define TIM_CR1_UDIS            0x0002U
+#define TIM_CR1_URS             0x0004U
+#define TIM_CR1_OPM             0x0008U
+#define TIM_CR1_DIR             0x0010U
+#define TIM_CR1_CMS             0x0060U
+#define TIM_CR1_ARPE            0x0080U
+#define TIM_CR1_CKD             0x0300U
+
+#define TIM_CR2_CCDS            0x0008U
+#define TIM_CR2_MMS             0x0070U
+#define TIM_CR2_MMS_Pos         4U
+#define TIM_CR2_TI1S            0x0080U
+
+#define TIM_SMCR_SMS            0x0007U
+#define TIM_SMCR_SMS_0          0x0001U
+#define TIM_SMCR_SMS_1          0x0002U
+#define TIM_SMCR_SMS_2          0x0004U
+#define TIM_SMCR_TS             0x0070U
+#define TIM_SMCR_TS_Pos         4U
+#define TIM_SMCR_MSM            0x0080U
+#define TIM_SMCR_ETF            0x0F00U
+#define TIM_SMCR_ETF_Pos        8U
+#define TIM_SMCR_ETPS           0x3000U
+#define TIM_SMCR_ETPS_Pos       12U
+#define TIM_SMCR_ETPS_0         0x1000U
+#define TIM_SMCR_ETPS_1         0x2000U
+#define TIM_SMCR_ECE            0x4000U
+#define TIM_SMCR_ETP            0x8000U
+
+#define TIM_DIER_UIE            0x0001U
+#define TIM_DIER_CC1IE          0x0002U
+#define TIM_DIER_CC2IE          0x0004U
+#define TIM_DIER_CC3IE          0x0008U
+#define TIM_DIER_CC4IE          0x0010U
+#define TIM_DIER_COMIE          0x0020U
+#define TIM_DIER_TIE            0x0040U
+#define TIM_DIER_BIE            0x0080U
+#define TIM_DIER_UDE            0x0100U
+#define TIM_DIER_CC1DE          0x0200U
+#define TIM_DIER_CC2DE          0x0400U
+#define TIM_DIER_CC3DE          0x0800U
+#define TIM_DIER_CC4DE          0x1000U
+#define TIM_DIER_COMDE          0x2000U
+#define TIM_DIER_TDE            0x4000U
+
+#define TIM_SR_UIF              0x0001U
+#define TIM_SR_CC1IF            0x0002U
+#define TIM_SR_CC2IF            0x0004U
+#define TIM_SR_CC3IF            0x0008U
+#define TIM_SR_CC4IF            0x0010U
+#define TIM_SR_COMIF            0x0020U
+#define TIM_SR_TIF              0x0040U
+#define TIM_SR_BIF              0x0080U
+#define TIM_SR_CC1OF            0x0200U
+#define TIM_SR_CC2OF            0x0400U
+#define TIM_SR_CC3OF            0x0800U
+#define TIM_SR_CC4OF            0x1000U
+
+#define TIM_EGR_UG              0x0001U
+#define TIM_EGR_CC1G            0x0002U
+#define TIM_EGR_CC2G            0x0004U
+#define TIM_EGR_CC3G            0x0008U
+#define TIM_EGR_CC4G            0x0010U
+#define TIM_EGR_COMG            0x0020U
+#define TIM_EGR_TG              0x0040U
+#define TIM_EGR_BG              0x0080U
+
+#define TIM_CCMR1_CC1S          0x0003U
+#define TIM_CCMR1_OC1FE         0x0004U
+#define TIM_CCMR1_OC1PE         0x0008U
+#define TIM_CCMR1_OC1M          0x0070U
+#define TIM_CCMR1_OC1CE         0x0080U
+#define TIM_CCMR1_CC2S          0x0300U
+#define TIM_CCMR1_OC2FE         0x0400U
+#define TIM_CCMR1_OC2PE         0x0800U
+#define TIM_CCMR1_OC2M          0x7000U
+#define TIM_CCMR1_OC2CE         0x8000U
+#define TIM_CCMR1_IC1PSC        0x000CU
+#define TIM_CCMR1_IC1F          0x00F0U
+#define TIM_CCMR1_IC1F_Pos      4U
+#define TIM_CCMR1_IC2PSC        0x0C00U
+#define TIM_CCMR1_IC2F          0xF000U
+
+#define TIM_CCMR2_CC3S          0x0003U
+#define TIM_CCMR2_OC3FE         0x0004U
+#define TIM_CCMR2_OC3PE         0x0008U
+#define TIM_CCMR2_OC3M          0x0070U
+#define TIM_CCMR2_OC3CE         0x0080U
+#define TIM_CCMR2_CC4S          0x0300U
+#define TIM_CCMR2_OC4FE         0x0400U
+#define TIM_CCMR2_OC4PE         0x0800U
+#define TIM_CCMR2_OC4M          0x7000U
+#define TIM_CCMR2_OC4CE         0x8000U
+#define TIM_CCMR2_IC3PSC        0x000CU
+#define TIM_CCMR2_IC3F          0x00F0U
+#define TIM_CCMR2_IC4PSC        0x0C00U
+#define TIM_CCMR2_IC4F          0xF000U
+
+#define TIM_CCER_CC1E           0x0001U
+#define TIM_CCER_CC1P           0x0002U
+#define TIM_CCER_CC1NE          0x0004U
+#define TIM_CCER_CC1NP          0x0008U
+#define TIM_CCER_CC2E           0x0010U
+#define TIM_CCER_CC2P           0x0020U
+#define TIM_CCER_CC2NE          0x0040U
+#define TIM_CCER_CC2NP          0x0080U
+#define TIM_CCER_CC3E           0x0100U
+#define TIM_CCER_CC3P           0x0200U
+#define TIM_CCER_CC3NE          0x0400U
+#define TIM_CCER_CC3NP          0x0800U
+#define TIM_CCER_CC4E           0x1000U
+#define TIM_CCER_CC4P           0x2000U
+#define TIM_CCER_CC4NP          0x8000U
+
+#define TIM_BDTR_MOE            0x8000U
+
+/*******************  Bit definition for DMA registers  ***********************/
+#define DMA_SxCR_EN             0x00000001U
+#define DMA_SxCR_DMEIE          0x00000002U
+#define DMA_SxCR_TEIE           0x00000004U
+#define DMA_SxCR_HTIE           0x00000008U
+#define DMA_SxCR_TCIE           0x00000010U
+#define DMA_SxCR_PFCTRL         0x00000020U
+#define DMA_SxCR_DIR            0x000000C0U
+#define DMA_SxCR_DIR_0          0x00000040U
+#define DMA_SxCR_DIR_1          0x00000080U
+#define DMA_SxCR_CIRC           0x00000100U
+#define DMA_SxCR_PINC           0x00000200U
+#define DMA_SxCR_MINC           0x00000400U
+#define DMA_SxCR_PSIZE          0x00001800U
+#define DMA_SxCR_PSIZE_Pos      11U
+#define DMA_SxCR_MSIZE          0x00006000U
+#define DMA_SxCR_MSIZE_Pos      13U
+#define DMA_SxCR_PL             0x00030000U
+#define DMA_SxCR_DBM            0x00040000U
+#define DMA_SxCR_CT             0x00080000U
+#define DMA_SxCR_CHSEL          0x0E000000U
+#define DMA_SxCR_CHSEL_Pos      25U
+
+#define DMA_SxFCR_DMDIS         0x00000004U
+
+/* Flags of stream 0 in LISR; streams 1-3 at bits 6, 16, 22, 4-7 in HISR */
+#define DMA_LISR_FEIF0          0x00000001U
+#define DMA_LISR_DMEIF0         0x00000004U
+#define DMA_LISR_TEIF0          0x00000008U
+#define DMA_LISR_HTIF0          0x00000010U
+#define DMA_LISR_TCIF0          0x00000020U
+
+/******************************************************************************/
+/*                          HAL common                                        */
+/******************************************************************************/
+typedef enum {
+    HAL_OK       = 0x00U,
+    HAL_ERROR    = 0x01U,
+    HAL_BUSY     = 0x02U,
+    HAL_TIMEOUT  = 0x03U
+} HAL_StatusTypeDef;
+
+typedef enum {
+    RESET = 0U,
+    SET = !RESET
+} FlagStatus, ITStatus;
+
+typedef enum {
+    HAL_UNLOCKED = 0x00U,
+    HAL_LOCKED   = 0x01U
+} HAL_LockTypeDef;
+
+/******************************************************************************/
+/*                          GPIO / RCC                                        */
+/******************************************************************************/
+#define GPIO_NOPULL             0x00000000U
+#define GPIO_PULLUP             0x00000001U
+#define GPIO_PULLDOWN           0x00000002U
+
+#define GPIO_AF1_TIM1           ((uint8_t)0x01)
+#define GPIO_AF1_TIM2           ((uint8_t)0x01)
+#define GPIO_AF2_TIM3           ((uint8_t)0x02)
+#define GPIO_AF2_TIM4           ((uint8_t)0x02)
+#define GPIO_AF2_TIM5           ((uint8_t)0x02)
+#define GPIO_AF3_TIM8           ((uint8_t)0x03)
+
+#define RCC_HCLK_DIV1           0x00000000U
+#define RCC_HCLK_DIV2           0x00001000U
+#define RCC_HCLK_DIV4           0x00001400U
+
+typedef struct {
+    uint32_t ClockType;
+    uint32_t SYSCLKSource;
+    uint32_t AHBCLKDivider;
+    uint32_t APB1CLKDivider;
+    uint32_t APB2CLKDivider;
+} RCC_ClkInitTypeDef;
+
+void HAL_RCC_GetClockConfig(RCC_ClkInitTypeDef *RCC_ClkInitStruct, uint32_t *pFLatency);
+uint32_t HAL_RCC_GetHCLKFreq(void);
+uint32_t HAL_RCC_GetPCLK1Freq(void);
+uint32_t HAL_RCC_GetPCLK2Freq(void);
+
+extern uint32_t SystemCoreClock;
+
+#define __HAL_RCC_TIM1_CLK_ENABLE()     sim_rcc_clk_enable(TIM1)
+#define __HAL_RCC_TIM2_CLK_ENABLE()     sim_rcc_clk_enable(TIM2)
+#define __HAL_RCC_TIM3_CLK_ENABLE()     sim_rcc_clk_enable(TIM3)
+#define __HAL_RCC_TIM4_CLK_ENABLE()     sim_rcc_clk_enable(TIM4)
+#define __HAL_RCC_TIM5_CLK_ENABLE()     sim_rcc_clk_enable(TIM5)
+#define __HAL_RCC_TIM8_CLK_ENABLE()     sim_rcc_clk_enable(TIM8)
+#define __HAL_RCC_DMA1_CLK_ENABLE()     do { } while (0)
+#define __HAL_RCC_DMA2_CLK_ENABLE()     do { } while (0)
+
+/******************************************************************************/
+/*                          DMA HAL                                           */
+/******************************************************************************/
+typedef struct {
+    uint32_t Channel;
+    uint32_t Direction;
+    uint32_t PeriphInc;
+    uint32_t MemInc;
+    uint32_t PeriphDataAlignment;
+    uint32_t MemDataAlignment;
+    uint32_t Mode;
+    uint32_t Priority;
+    uint32_t FIFOMode;
+    uint32_t FIFOThreshold;
+    uint32_t MemBurst;
+    uint32_t PeriphBurst;
+} DMA_InitTypeDef;
+
+typedef enum {
+    HAL_DMA_STATE_RESET = 0x00U,
+    HAL_DMA_STATE_READY = 0x01U,
+    HAL_DMA_STATE_BUSY  = 0x02U
+} HAL_DMA_StateTypeDef;
+
+typedef struct __DMA_HandleTypeDef {
+    DMA_Stream_TypeDef   *Instance;
+    DMA_InitTypeDef      Init;
+    HAL_LockTypeDef      Lock;
+    __IO HAL_DMA_StateTypeDef State;
+    void                 *Parent;
+    void (*XferCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferHalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferM1CpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferM1HalfCpltCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferErrorCallback)(struct __DMA_HandleTypeDef *hdma);
+    void (*XferAbortCallback)(struct __DMA_HandleTypeDef *hdma);
+    __IO uint32_t        ErrorCode;
+    uint32_t             StreamBaseAddress;
+    uint32_t             StreamIndex;
+} DMA_HandleTypeDef;
+
+#define DMA_CHANNEL_0                   0x00000000U
+#define DMA_CHANNEL_1                   0x02000000U
+#define DMA_CHANNEL_2                   0x04000000U
+#define DMA_CHANNEL_3                   0x06000000U
+#define DMA_CHANNEL_4                   0x08000000U
+#define DMA_CHANNEL_5                   0x0A000000U
+#define DMA_CHANNEL_6                   0x0C000000U
+#define DMA_CHANNEL_7                   0x0E000000U
+
+#define DMA_PERIPH_TO_MEMORY            0x00000000U
+#define DMA_MEMORY_TO_PERIPH            DMA_SxCR_DIR_0
+#define DMA_MEMORY_TO_MEMORY            DMA_SxCR_DIR_1
+
+#define DMA_PINC_ENABLE                 DMA_SxCR_PINC
+#define DMA_PINC_DISABLE                0x00000000U
+#define DMA_MINC_ENABLE                 DMA_SxCR_MINC
+#define DMA_MINC_DISABLE                0x00000000U
+
+#define DMA_PDATAALIGN_BYTE             0x00000000U
+#define DMA_PDATAALIGN_HALFWORD         0x00000800U
+#define DMA_PDATAALIGN_WORD             0x00001000U
+#define DMA_MDATAALIGN_BYTE             0x00000000U
+#define DMA_MDATAALIGN_HALFWORD         0x00002000U
+#define DMA_MDATAALIGN_WORD             0x00004000U
+
+#define DMA_NORMAL                      0x00000000U
+#define DMA_CIRCULAR                    DMA_SxCR_CIRC
+#define DMA_PFCTRL                      DMA_SxCR_PFCTRL
+
+#define DMA_PRIORITY_LOW                0x00000000U
+#define DMA_PRIORITY_MEDIUM             0x00010000U
+#define DMA_PRIORITY_HIGH               0x00020000U
+#define DMA_PRIORITY_VERY_HIGH          0x00030000U
+
+#define DMA_FIFOMODE_DISABLE            0x00000000U
+#define DMA_FIFOMODE_ENABLE             DMA_SxFCR_DMDIS
+
+#define DMA_IT_TC                       DMA_SxCR_TCIE
+#define DMA_IT_HT                       DMA_SxCR_HTIE
+#define DMA_IT_TE                       DMA_SxCR_TEIE
+#define DMA_IT_DME                      DMA_SxCR_DMEIE
+
+#define __HAL_DMA_ENABLE(__HANDLE__)                ((__HANDLE__)->Instance->CR |= DMA_SxCR_EN)
+#define __HAL_DMA_DISABLE(__HANDLE__)               ((__HANDLE__)->Instance->CR &= ~DMA_SxCR_EN)
+#define __HAL_DMA_ENABLE_IT(__HANDLE__, __INTERRUPT__)  ((__HANDLE__)->Instance->CR |= (__INTERRUPT__))
+#define __HAL_DMA_DISABLE_IT(__HANDLE__, __INTERRUPT__) ((__HANDLE__)->Instance->CR &= ~(__INTERRUPT__))
+#define __HAL_DMA_GET_COUNTER(__HANDLE__)           ((__HANDLE__)->Instance->NDTR)
+#define __HAL_DMA_SET_COUNTER(__HANDLE__, __COUNTER__) ((__HANDLE__)->Instance->NDTR = (uint16_t)(__COUNTER__))
+
+#define __HAL_LINKDMA(__HANDLE__, __PPP_DMA_FIELD__, __DMA_HANDLE__) \
+    do { \
+        (__HANDLE__)->__PPP_DMA_FIELD__ = &(__DMA_HANDLE__); \
+        (__DMA_HANDLE__).Parent = (__HANDLE__); \
+    } while (0)
+
+HAL_StatusTypeDef HAL_DMA_Init(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_DeInit(DMA_HandleTypeDef *hdma);
+HAL_StatusTypeDef HAL_DMA_Start(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Start_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMA_Abort(DMA_HandleTypeDef *hdma);
+void HAL_DMA_IRQHandler(DMA_HandleTypeDef *hdma);
+
+HAL_StatusTypeDef HAL_DMAEx_MultiBufferStart(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t SecondMemAddress, uint32_t DataLength);
+HAL_StatusTypeDef HAL_DMAEx_MultiBufferStart_IT(DMA_HandleTypeDef *hdma, uint32_t SrcAddress, uint32_t DstAddress, uint32_t SecondMemAddress, uint32_t DataLength);
+
+/******************************************************************************/
+/*                          TIM HAL                                           */
+/******************************************************************************/
+typedef struct {
+    uint32_t Prescaler;
+    uint32_t CounterMode;
+    uint32_t Period;
+    uint32_t ClockDivision;
+    uint32_t RepetitionCounter;
+} TIM_Base_InitTypeDef;
+
+typedef struct {
+    uint32_t OCMode;
+    uint32_t Pulse;
+    uint32_t OCPolarity;
+    uint32_t OCNPolarity;
+    uint32_t OCFastMode;
+    uint32_t OCIdleState;
+    uint32_t OCNIdleState;
+} TIM_OC_InitTypeDef;
+
+typedef struct {
+    uint32_t ICPolarity;
+    uint32_t ICSelection;
+    uint32_t ICPrescaler;
+    uint32_t ICFilter;
+} TIM_IC_InitTypeDef;
+
+typedef struct {
+    uint32_t OCMode;
+    uint32_t Pulse;
+    uint32_t OCPolarity;
+    uint32_t OCNPolarity;
+    uint32_t OCIdleState;
+    uint32_t OCNIdleState;
+    uint32_t ICPolarity;
+    uint32_t ICSelection;
+    uint32_t ICFilter;
+} TIM_OnePulse_InitTypeDef;
+
+typedef struct {
+    uint32_t EncoderMode;
+    uint32_t IC1Polarity;
+    uint32_t IC1Selection;
+    uint32_t IC1Prescaler;
+    uint32_t IC1Filter;
+    uint32_t IC2Polarity;
+    uint32_t IC2Selection;
+    uint32_t IC2Prescaler;
+    uint32_t IC2Filter;
+} TIM_Encoder_InitTypeDef;
+
+typedef struct {
+    uint32_t ClockSource;
+    uint32_t ClockPolarity;
+    uint32_t ClockPrescaler;
+    uint32_t ClockFilter;
+} TIM_ClockConfigTypeDef;
+
+typedef struct {
+    uint32_t SlaveMode;
+    uint32_t InputTrigger;
+    uint32_t TriggerPolarity;
+    uint32_t TriggerPrescaler;
+    uint32_t TriggerFilter;
+} TIM_SlaveConfigTypeDef;
+
+typedef struct {
+    uint32_t MasterOutputTrigger;
+    uint32_t MasterSlaveMode;
+} TIM_MasterConfigTypeDef;
+
+typedef enum {
+    HAL_TIM_STATE_RESET   = 0x00U,
+    HAL_TIM_STATE_READY   = 0x01U,
+    HAL_TIM_STATE_BUSY    = 0x02U
+} HAL_TIM_StateTypeDef;
+
+#define TIM_DMA_ID_UPDATE               ((uint16_t)0x0000U)
+#define TIM_DMA_ID_CC1                  ((uint16_t)0x0001U)
+#define TIM_DMA_ID_CC2                  ((uint16_t)0x0002U)
+#define TIM_DMA_ID_CC3                  ((uint16_t)0x0003U)
+#define TIM_DMA_ID_CC4                  ((uint16_t)0x0004U)
+#define TIM_DMA_ID_COMMUTATION          ((uint16_t)0x0005U)
+#define TIM_DMA_ID_TRIGGER              ((uint16_t)0x0006U)
+
+typedef struct {
+    TIM_TypeDef          *Instance;
+    TIM_Base_InitTypeDef Init;
+    uint32_t             Channel;
+    DMA_HandleTypeDef    *hdma[7];
+    HAL_LockTypeDef      Lock;
+    __IO HAL_TIM_StateTypeDef State;
+} TIM_HandleTypeDef;
+
+#define TIM_COUNTERMODE_UP              0x00000000U
+#define TIM_COUNTERMODE_DOWN            TIM_CR1_DIR
+
+#define TIM_CLOCKDIVISION_DIV1          0x00000000U
+#define TIM_CLOCKDIVISION_DIV2          0x00000100U
+#define TIM_CLOCKDIVISION_DIV4          0x00000200U
+
+#define TIM_OCMODE_TIMING               0x00000000U
+#define TIM_OCMODE_ACTIVE               0x00000010U
+#define TIM_OCMODE_INACTIVE             0x00000020U
+#define TIM_OCMODE_TOGGLE               0x00000030U
+#define TIM_OCMODE_FORCED_INACTIVE      0x00000040U
+#define TIM_OCMODE_FORCED_ACTIVE        0x00000050U
+#define TIM_OCMODE_PWM1                 0x00000060U
+#define TIM_OCMODE_PWM2                 0x00000070U
+
+#define TIM_OCPOLARITY_HIGH             0x00000000U
+#define TIM_OCPOLARITY_LOW              TIM_CCER_CC1P
+#define TIM_OCNPOLARITY_HIGH            0x00000000U
+#define TIM_OCNPOLARITY_LOW             TIM_CCER_CC1NP
+#define TIM_OCFAST_DISABLE              0x00000000U
+#define TIM_OCFAST_ENABLE               TIM_CCMR1_OC1FE
+#define TIM_OCIDLESTATE_SET             0x00000100U
+#define TIM_OCIDLESTATE_RESET           0x00000000U
+#define TIM_OCNIDLESTATE_SET            0x00000200U
+#define TIM_OCNIDLESTATE_RESET          0x00000000U
+
+#define TIM_CHANNEL_1                   0x00000000U
+#define TIM_CHANNEL_2                   0x00000004U
+#define TIM_CHANNEL_3                   0x00000008U
+#define TIM_CHANNEL_4                   0x0000000CU
+#define TIM_CHANNEL_ALL                 0x00000018U
+
+#define TIM_ICPOLARITY_RISING           0x00000000U
+#define TIM_ICPOLARITY_FALLING          TIM_CCER_CC1P
+#define TIM_ICPOLARITY_BOTHEDGE         (TIM_CCER_CC1P | TIM_CCER_CC1NP)
+
+#define TIM_ICSELECTION_DIRECTTI        0x00000001U
+#define TIM_ICSELECTION_INDIRECTTI      0x00000002U
+#define TIM_ICSELECTION_TRC             0x00000003U
+
+#define TIM_ICPSC_DIV1                  0x00000000U
+#define TIM_ICPSC_DIV2                  0x00000004U
+#define TIM_ICPSC_DIV4                  0x00000008U
+#define TIM_ICPSC_DIV8                  0x0000000CU
+
+#define TIM_OPMODE_SINGLE               TIM_CR1_OPM
+#define TIM_OPMODE_REPETITIVE           0x00000000U
+
+#define TIM_ENCODERMODE_TI1             TIM_SMCR_SMS_0
+#define TIM_ENCODERMODE_TI2             TIM_SMCR_SMS_1
+#define TIM_ENCODERMODE_TI12            (TIM_SMCR_SMS_1 | TIM_SMCR_SMS_0)
+
+#define TIM_IT_UPDATE                   TIM_DIER_UIE
+#define TIM_IT_CC1                      TIM_DIER_CC1IE
+#define TIM_IT_CC2                      TIM_DIER_CC2IE
+#define TIM_IT_CC3                      TIM_DIER_CC3IE
+#define TIM_IT_CC4                      TIM_DIER_CC4IE
+#define TIM_IT_COM                      TIM_DIER_COMIE
+#define TIM_IT_TRIGGER                  TIM_DIER_TIE
+#define TIM_IT_BREAK                    TIM_DIER_BIE
+
+#define TIM_DMA_UPDATE                  TIM_DIER_UDE
+#define TIM_DMA_CC1                     TIM_DIER_CC1DE
+#define TIM_DMA_CC2                     TIM_DIER_CC2DE
+#define TIM_DMA_CC3                     TIM_DIER_CC3DE
+#define TIM_DMA_CC4                     TIM_DIER_CC4DE
+#define TIM_DMA_TRIGGER                 TIM_DIER_TDE
+
+#define TIM_FLAG_UPDATE                 TIM_SR_UIF
+#define TIM_FLAG_CC1                    TIM_SR_CC1IF
+#define TIM_FLAG_CC2                    TIM_SR_CC2IF
+#define TIM_FLAG_CC3                    TIM_SR_CC3IF
+#define TIM_FLAG_CC4                    TIM_SR_CC4IF
+#define TIM_FLAG_COM                    TIM_SR_COMIF
+#define TIM_FLAG_TRIGGER                TIM_SR_TIF
+#define TIM_FLAG_BREAK                  TIM_SR_BIF
+#define TIM_FLAG_CC1OF                  TIM_SR_CC1OF
+#define TIM_FLAG_CC2OF                  TIM_SR_CC2OF
+#define TIM_FLAG_CC3OF                  TIM_SR_CC3OF
+#define TIM_FLAG_CC4OF                  TIM_SR_CC4OF
+
+#define TIM_EVENTSOURCE_UPDATE          TIM_EGR_UG
+#define TIM_EVENTSOURCE_CC1             TIM_EGR_CC1G
+#define TIM_EVENTSOURCE_CC2             TIM_EGR_CC2G
+#define TIM_EVENTSOURCE_CC3             TIM_EGR_CC3G
+#define TIM_EVENTSOURCE_CC4             TIM_EGR_CC4G
+#define TIM_EVENTSOURCE_TRIGGER         TIM_EGR_TG
+
+#define TIM_CLOCKSOURCE_ETRMODE2        TIM_SMCR_ETPS_1
+#define TIM_CLOCKSOURCE_INTERNAL        TIM_SMCR_ETPS_0
+#define TIM_CLOCKSOURCE_ITR0            0x00000000U
+#define TIM_CLOCKSOURCE_ITR1            0x00000010U
+#define TIM_CLOCKSOURCE_ITR2            0x00000020U
+#define TIM_CLOCKSOURCE_ITR3            0x00000030U
+#define TIM_CLOCKSOURCE_TI1ED           0x00000040U
+#define TIM_CLOCKSOURCE_TI1             0x00000050U
+#define TIM_CLOCKSOURCE_TI2             0x00000060U
+#define TIM_CLOCKSOURCE_ETRMODE1        0x00000070U
+
+#define TIM_CLOCKPOLARITY_INVERTED      TIM_SMCR_ETP
+#define TIM_CLOCKPOLARITY_NONINVERTED   0x00000000U
+#define TIM_CLOCKPOLARITY_RISING        TIM_INPUTCHANNELPOLARITY_RISING
+#define TIM_CLOCKPOLARITY_FALLING       TIM_INPUTCHANNELPOLARITY_FALLING
+#define TIM_CLOCKPOLARITY_BOTHEDGE      TIM_INPUTCHANNELPOLARITY_BOTHEDGE
+
+#define TIM_CLOCKPRESCALER_DIV1         TIM_ETRPRESCALER_DIV1
+#define TIM_CLOCKPRESCALER_DIV2         TIM_ETRPRESCALER_DIV2
+#define TIM_CLOCKPRESCALER_DIV4         TIM_ETRPRESCALER_DIV4
+#define TIM_CLOCKPRESCALER_DIV8         TIM_ETRPRESCALER_DIV8
+
+#define TIM_ETRPRESCALER_DIV1           0x00000000U
+#define TIM_ETRPRESCALER_DIV2           0x00001000U
+#define TIM_ETRPRESCALER_DIV4           0x00002000U
+#define TIM_ETRPRESCALER_DIV8           0x00003000U
+
+#define TIM_INPUTCHANNELPOLARITY_RISING     0x00000000U
+#define TIM_INPUTCHANNELPOLARITY_FALLING    TIM_CCER_CC1P
+#define TIM_INPUTCHANNELPOLARITY_BOTHEDGE   (TIM_CCER_CC1P | TIM_CCER_CC1NP)
+
+#define TIM_SLAVEMODE_DISABLE           0x00000000U
+#define TIM_SLAVEMODE_RESET             0x00000004U
+#define TIM_SLAVEMODE_GATED             0x00000005U
+#define TIM_SLAVEMODE_TRIGGER           0x00000006U
+#define TIM_SLAVEMODE_EXTERNAL1         0x00000007U
+
+#define TIM_TS_ITR0                     0x00000000U
+#define TIM_TS_ITR1                     0x00000010U
+#define TIM_TS_ITR2                     0x00000020U
+#define TIM_TS_ITR3                     0x00000030U
+#define TIM_TS_TI1F_ED                  0x00000040U
+#define TIM_TS_TI1FP1                   0x00000050U
+#define TIM_TS_TI2FP2                   0x00000060U
+#define TIM_TS_ETRF                     0x00000070U
+#define TIM_TS_NONE                     0x0000FFFFU
+
+#define TIM_TRIGGERPOLARITY_INVERTED    TIM_ETRPOLARITY_INVERTED
+#define TIM_TRIGGERPOLARITY_NONINVERTED TIM_ETRPOLARITY_NONINVERTED
+#define TIM_TRIGGERPOLARITY_RISING      TIM_INPUTCHANNELPOLARITY_RISING
+#define TIM_TRIGGERPOLARITY_FALLING     TIM_INPUTCHANNELPOLARITY_FALLING
+#define TIM_TRIGGERPOLARITY_BOTHEDGE    TIM_INPUTCHANNELPOLARITY_BOTHEDGE
+#define TIM_ETRPOLARITY_INVERTED        TIM_SMCR_ETP
+#define TIM_ETRPOLARITY_NONINVERTED     0x00000000U
+
+#define TIM_TRIGGERPRESCALER_DIV1       TIM_ETRPRESCALER_DIV1
+#define TIM_TRIGGERPRESCALER_DIV2       TIM_ETRPRESCALER_DIV2
+#define TIM_TRIGGERPRESCALER_DIV4       TIM_ETRPRESCALER_DIV4
+#define TIM_TRIGGERPRESCALER_DIV8       TIM_ETRPRESCALER_DIV8
+
+#define TIM_TRGO_RESET                  0x00000000U
+#define TIM_TRGO_ENABLE                 0x00000010U
+#define TIM_TRGO_UPDATE                 0x00000020U
+#define TIM_TRGO_OC1                    0x00000030U
+#define TIM_TRGO_OC1REF                 0x00000040U
+#define TIM_TRGO_OC2REF                 0x00000050U
+#define TIM_TRGO_OC3REF                 0x00000060U
+#define TIM_TRGO_OC4REF                 0x00000070U
+
+#define TIM_MASTERSLAVEMODE_ENABLE      0x00000080U
+#define TIM_MASTERSLAVEMODE_DISABLE     0x00000000U
+
+#define TIM_CCx_ENABLE                  0x00000001U
+#define TIM_CCx_DISABLE                 0x00000000U
+
+#define TIM_CCER_CCxE_MASK  ((uint32_t)(TIM_CCER_CC1E | TIM_CCER_CC2E | TIM_CCER_CC3E | TIM_CCER_CC4E))
+#define TIM_CCER_CCxNE_MASK ((uint32_t)(TIM_CCER_CC1NE | TIM_CCER_CC2NE | TIM_CCER_CC3NE))
+
+/* Register side effects the simulator has to see as they happen. Everything
+ * else is plain memory and is picked up lazily by the timer model */
+void sim_rcc_clk_enable(TIM_TypeDef *tim);
+void sim_tim_clear_sr(TIM_TypeDef *tim, uint32_t flags);
+void sim_tim_generate(TIM_TypeDef *tim, uint32_t events);
+
+#define __HAL_TIM_ENABLE(__HANDLE__)                 ((__HANDLE__)->Instance->CR1 |= (TIM_CR1_CEN))
+#define __HAL_TIM_DISABLE(__HANDLE__) \
+    do { \
+        if (((__HANDLE__)->Instance->CCER & TIM_CCER_CCxE_MASK) == 0U) { \
+            if (((__HANDLE__)->Instance->CCER & TIM_CCER_CCxNE_MASK) == 0U) { \
+                (__HANDLE__)->Instance->CR1 &= ~(TIM_CR1_CEN); \
+            } \
+        } \
+    } while (0)
+#define __HAL_TIM_MOE_ENABLE(__HANDLE__)             ((__HANDLE__)->Instance->BDTR |= (TIM_BDTR_MOE))
+#define __HAL_TIM_ENABLE_IT(__HANDLE__, __INTERRUPT__)   ((__HANDLE__)->Instance->DIER |= (__INTERRUPT__))
+#define __HAL_TIM_DISABLE_IT(__HANDLE__, __INTERRUPT__)  ((__HANDLE__)->Instance->DIER &= ~(__INTERRUPT__))
+#define __HAL_TIM_ENABLE_DMA(__HANDLE__, __DMA__)        ((__HANDLE__)->Instance->DIER |= (__DMA__))
+#define __HAL_TIM_DISABLE_DMA(__HANDLE__, __DMA__)       ((__HANDLE__)->Instance->DIER &= ~(__DMA__))
+#define __HAL_TIM_GET_FLAG(__HANDLE__, __FLAG__)         (((__HANDLE__)->Instance->SR &(__FLAG__)) == (__FLAG__))
+#define __HAL_TIM_CLEAR_FLAG(__HANDLE__, __FLAG__)       sim_tim_clear_sr((__HANDLE__)->Instance, (__FLAG__))
+#define __HAL_TIM_GET_IT_SOURCE(__HANDLE__, __INTERRUPT__) ((((__HANDLE__)->Instance->DIER & (__INTERRUPT__)) == (__INTERRUPT__)) ? SET : RESET)
+#define __HAL_TIM_CLEAR_IT(__HANDLE__, __INTERRUPT__)    sim_tim_clear_sr((__HANDLE__)->Instance, (__INTERRUPT__))
+#define __HAL_TIM_SET_COUNTER(__HANDLE__, __COUNTER__)   ((__HANDLE__)->Instance->CNT = (__COUNTER__))
+#define __HAL_TIM_GET_COUNTER(__HANDLE__)                ((__HANDLE__)->Instance->CNT)
+#define __HAL_TIM_SET_AUTORELOAD(__HANDLE__, __AUTORELOAD__) \
+    do { \
+        (__HANDLE__)->Instance->ARR = (__AUTORELOAD__); \
+        (__HANDLE__)->Init.Period = (__AUTORELOAD__); \
+    } while (0)
+#define __HAL_TIM_GET_AUTORELOAD(__HANDLE__)             ((__HANDLE__)->Instance->ARR)
+#define __HAL_TIM_SET_PRESCALER(__HANDLE__, __PRESC__)   ((__HANDLE__)->Instance->PSC = (__PRESC__))
+#define __HAL_TIM_SET_COMPARE(__HANDLE__, __CHANNEL__, __COMPARE__) \
+    (*(__IO uint32_t *)(&((__HANDLE__)->Instance->CCR1) + ((__CHANNEL__) >> 2U)) = (__COMPARE__))
+#define __HAL_TIM_GET_COMPARE(__HANDLE__, __CHANNEL__) \
+    (*(__IO uint32_t *)(&((__HANDLE__)->Instance->CCR1) + ((__CHANNEL__) >> 2U)))
+
+HAL_StatusTypeDef HAL_TIM_Base_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Start_IT(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_Base_Stop_IT(TIM_HandleTypeDef *htim);
+
+HAL_StatusTypeDef HAL_TIM_OC_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_OC_ConfigChannel(TIM_HandleTypeDef *htim, TIM_OC_InitTypeDef *sConfig, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_OC_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_OC_Stop(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_OC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_OC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+HAL_StatusTypeDef HAL_TIM_IC_Init(TIM_HandleTypeDef *htim);
+HAL_StatusTypeDef HAL_TIM_IC_ConfigChannel(TIM_HandleTypeDef *htim, TIM_IC_InitTypeDef *sConfig, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Stop(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Start_IT(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_IC_Stop_IT(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+HAL_StatusTypeDef HAL_TIM_OnePulse_Init(TIM_HandleTypeDef *htim, uint32_t OnePulseMode);
+
+HAL_StatusTypeDef HAL_TIM_Encoder_Init(TIM_HandleTypeDef *htim, TIM_Encoder_InitTypeDef *sConfig);
+HAL_StatusTypeDef HAL_TIM_Encoder_Start(TIM_HandleTypeDef *htim, uint32_t Channel);
+HAL_StatusTypeDef HAL_TIM_Encoder_Stop(TIM_HandleTypeDef *htim, uint32_t Channel);
+
+HAL_StatusTypeDef HAL_TIM_ConfigClockSource(TIM_HandleTypeDef *htim, TIM_ClockConfigTypeDef *sClockSourceConfig);
+HAL_StatusTypeDef HAL_TIM_SlaveConfigSynchronization(TIM_HandleTypeDef *htim, TIM_SlaveConfigTypeDef *sSlaveConfig);
+HAL_StatusTypeDef HAL_TIMEx_MasterConfigSynchronization(TIM_HandleTypeDef *htim, TIM_MasterConfigTypeDef *sMasterConfig);
+HAL_StatusTypeDef HAL_TIM_GenerateEvent(TIM_HandleTypeDef *htim, uint32_t EventSource);
+
+/******************************************************************************/
+/*                          Core / NVIC                                       */
+/******************************************************************************/
+/* Vectors are whole function addresses here, which on a 64-bit host do not
+ * fit the uint32_t of the CMSIS prototype; on the target the two agree */
+void NVIC_SetVector(IRQn_Type IRQn, uintptr_t vector);
+uintptr_t NVIC_GetVector(IRQn_Type IRQn);
+void NVIC_EnableIRQ(IRQn_Type IRQn);
+void NVIC_DisableIRQ(IRQn_Type IRQn);
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPendingIRQ(IRQn_Type IRQn);
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn);
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority);
+
+/* The cycle counter reads the simulated HCLK cycles while it is enabled.
+ * Writes to CYCCNT are not modelled. */
+typedef struct {
+    volatile uint32_t CTRL;
+    volatile uint32_t CYCCNT;
+} DWT_Type;
+
+typedef struct {
+    volatile uint32_t DEMCR;
+} CoreDebug_Type;
+
+#define DWT_CTRL_CYCCNTENA_Msk          0x00000001U
+#define CoreDebug_DEMCR_TRCENA_Msk      0x01000000U
+
+DWT_Type *sim_dwt(void);
+extern CoreDebug_Type sim_core_debug;
+#define DWT                             (sim_dwt())
+#define CoreDebug                       (&sim_core_debug)
+
+void __enable_irq(void);
+void __disable_irq(void);
+uint32_t __get_PRIMASK(void);
+void __set_PRIMASK(uint32_t priMask);
+#define __DMB() __sync_synchronize()
+#define __DSB() __sync_synchronize()
+#define __ISB() __sync_synchronize()
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -0,0 +1,1099 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Event driven model of the STM32F4 general purpose and advanced timers.
+ *
+ * Registers live at their real addresses (see sim_map_peripherals) and are
+ * read lazily: whatever the drivers wrote is what the model acts on the next
+ * time simulated time moves. Only SR and EGR have write side effects that go
+ * through sim_tim_clear_sr / sim_tim_generate, which the HAL macros use.
+ *
+ * Modelled: up/down counting with PSC (shadowed) and ARR, repetition counter,
+ * one-pulse mode, output compare (frozen/active/inactive/toggle/forced/PWM),
+ * input capture (TIx or TRC) with IC prescaler and overcapture, the input filters
+ * (ICxF/ETF), slave modes (encoder 1-3, reset, gated, trigger, external clock
+ * 1), external clock mode 2 with ETR prescaler, master mode TRGO and the ITR
+ * links between TIM1/2/3/4/5/8, DMA requests (UDE/CCxDE/TDE/COMDE, with
+ * CCDS, served by sim_dma.c) and the NVIC lines of each timer.
+ *
+ * Not modelled: centre-aligned counting, preload of CCRx/ARR, break and dead
+ * time, the XOR input (TI1S) and interrupt priorities/preemption.
+ */
+#include <stddef.h>
+#include <string.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <sys/mman.h>
+
+#include "sim_tim.h"
+
+#define SIM_TIM_COUNT       6
+#define SIM_NVIC_STORM      100000
+
+typedef struct {
+    TIM_TypeDef *regs;
+    uint8_t clk_div;        // HCLK cycles per timer kernel clock
+    uint8_t advanced;
+    uint8_t bits32;
+    IRQn_Type irq_up;
+    IRQn_Type irq_cc;
+    IRQn_Type irq_trg;
+    TIM_TypeDef *itr[4];
+
+    uint8_t clk_on;
+    uint32_t sr;
+    uint32_t psc;           // active (shadow) prescaler
+    uint32_t psc_cnt;
+    uint32_t rcr_cnt;
+    sim_time_t last;
+
+    uint8_t in_raw[SIM_TIM_LINES];
+    uint8_t in_filt[SIM_TIM_LINES];
+    sim_time_t in_commit[SIM_TIM_LINES];
+    uint8_t ic_psc_cnt[4];
+    uint8_t etr_psc_cnt;
+
+    uint8_t trgi;
+    uint8_t trgo;
+    uint8_t ocref[4];
+    uint8_t out[4];
+} sim_tim_t;
+
+static sim_tim_t sim_tims[SIM_TIM_COUNT];
+
+static sim_time_t sim_time;
+static sim_time_t sim_step_to;
+static sim_source_t *sim_sources;
+
+static uintptr_t nvic_vector[SIM_IRQn_COUNT];
+static uint8_t nvic_enabled[SIM_IRQn_COUNT];
+static uint8_t nvic_pending[SIM_IRQn_COUNT];
+static uint8_t nvic_pending_any;
+static uint32_t nvic_count[SIM_IRQn_COUNT];
+static uint8_t nvic_priority[SIM_IRQn_COUNT];
+static uint32_t nvic_primask;
+static uint8_t nvic_active;
+static int nvic_current;
+
+static void tim_advance(sim_tim_t *t, sim_time_t to);
+static void tim_trgi(sim_tim_t *t, int level);
+static void tim_outputs(sim_tim_t *t);
+
+/******************************************************************************/
+/*                          Setup                                             */
+/******************************************************************************/
+static void sim_map_peripherals(void)
+{
+    static int mapped = 0;
+    if (mapped) {
+        return;
+    }
+
+    // The drivers cast TIMx_BASE straight to pointers, so the peripheral
+    // window has to exist at the addresses the silicon uses
+    void *base = mmap((void *)PERIPH_BASE, SIM_PERIPH_SIZE, PROT_READ | PROT_WRITE,
+                      MAP_PRIVATE | MAP_ANONYMOUS | MAP_FIXED_NOREPLACE, -1, 0);
+    if (base != (void *)PERIPH_BASE) {
+        fprintf(stderr, "sim: cannot map peripherals at 0x%08lx\n", (unsigned long)PERIPH_BASE);
+        abort();
+    }
+    mapped = 1;
+}
+
+static void sim_tim_setup(sim_tim_t *t, TIM_TypeDef *regs, uint8_t clk_div, uint8_t advanced, uint8_t bits32,
+                          IRQn_Type irq_up, IRQn_Type irq_cc, IRQn_Type irq_trg,
+                          TIM_TypeDef *itr0, TIM_TypeDef *itr1, TIM_TypeDef *itr2, TIM_TypeDef *itr3)
+{
+    memset(t, 0, sizeof(*t));
+    memset((void *)regs, 0, sizeof(*regs));
+
+    t->regs = regs;
+    t->clk_div = clk_div;
+    t->advanced = advanced;
+    t->bits32 = bits32;
+    t->irq_up = irq_up;
+    t->irq_cc = irq_cc;
+    t->irq_trg = irq_trg;
+    t->itr[0] = itr0;
+    t->itr[1] = itr1;
+    t->itr[2] = itr2;
+    t->itr[3] = itr3;
+
+    for (int line = 0; line < SIM_TIM_LINES; line++) {
+        t->in_commit[line] = SIM_TIME_NEVER;
+    }
+    regs->ARR = bits32 ? 0xFFFFFFFFU : 0xFFFFU;
+}
+
+static DWT_Type sim_dwt_regs;
+CoreDebug_Type sim_core_debug;
+
+void sim_reset(void)
+{
+    sim_map_peripherals();
+
+    // ITR wiring from the "TIMx internal trigger connection" tables of RM0090
+    sim_tim_setup(&sim_tims[0], TIM1, 1, 1, 0, TIM1_UP_TIM10_IRQn, TIM1_CC_IRQn, TIM1_TRG_COM_TIM11_IRQn,
+                  TIM5, TIM2, TIM3, TIM4);
+    sim_tim_setup(&sim_tims[1], TIM2, 2, 0, 1, TIM2_IRQn, TIM2_IRQn, TIM2_IRQn,
+                  TIM1, TIM8, TIM3, TIM4);
+    sim_tim_setup(&sim_tims[2], TIM3, 2, 0, 0, TIM3_IRQn, TIM3_IRQn, TIM3_IRQn,
+                  TIM1, TIM2, TIM5, TIM4);
+    sim_tim_setup(&sim_tims[3], TIM4, 2, 0, 0, TIM4_IRQn, TIM4_IRQn, TIM4_IRQn,
+                  TIM1, TIM2, TIM3, TIM8);
+    sim_tim_setup(&sim_tims[4], TIM5, 2, 0, 1, TIM5_IRQn, TIM5_IRQn, TIM5_IRQn,
+                  TIM2, TIM3, TIM4, TIM8);
+    sim_tim_setup(&sim_tims[5], TIM8, 1, 1, 0, TIM8_UP_TIM13_IRQn, TIM8_CC_IRQn, TIM8_TRG_COM_TIM14_IRQn,
+                  TIM1, TIM2, TIM4, TIM5);
+
+    memset(nvic_vector, 0, sizeof(nvic_vector));
+    memset(nvic_enabled, 0, sizeof(nvic_enabled));
+    memset(nvic_pending, 0, sizeof(nvic_pending));
+    nvic_pending_any = 0;
+    memset(nvic_count, 0, sizeof(nvic_count));
+    memset(nvic_priority, 0xFF, sizeof(nvic_priority));
+    nvic_primask = 0;
+    nvic_active = 0;
+    nvic_current = -1;
+
+    memset(&sim_dwt_regs, 0, sizeof(sim_dwt_regs));
+    memset(&sim_core_debug, 0, sizeof(sim_core_debug));
+
+    sim_time = 0;
+    sim_step_to = 0;
+    sim_sources = NULL;
+
+    sim_gpio_reset();
+    sim_dma_reset();
+}
+
+/* Peripherals have to be in place before any static driver object runs its
+ * constructor */
+__attribute__((constructor(101))) static void sim_startup(void)
+{
+    sim_reset();
+}
+
+static sim_tim_t *sim_tim_find(TIM_TypeDef *regs)
+{
+    for (int i = 0; i < SIM_TIM_COUNT; i++) {
+        if (sim_tims[i].regs == regs) {
+            return &sim_tims[i];
+        }
+    }
+    fprintf(stderr, "sim: access to unmodelled timer %p\n", (void *)regs);
+    abort();
+}
+
+sim_time_t sim_now(void)
+{
+    return sim_time;
+}
+
+DWT_Type *sim_dwt(void)
+{
+    if ((sim_core_debug.DEMCR & CoreDebug_DEMCR_TRCENA_Msk) && (sim_dwt_regs.CTRL & DWT_CTRL_CYCCNTENA_Msk)) {
+        sim_dwt_regs.CYCCNT = (uint32_t)sim_time;
+    }
+    return &sim_dwt_regs;
+}
+
+void sim_source_add(sim_source_t *src)
+{
+    sim_source_remove(src);
+    src->link = sim_sources;
+    sim_sources = src;
+}
+
+void sim_source_remove(sim_source_t *src)
+{
+    for (sim_source_t **p = &sim_sources; *p; p = &(*p)->link) {
+        if (*p == src) {
+            *p = src->link;
+            break;
+        }
+    }
+    src->link = NULL;
+}
+
+void sim_rcc_clk_enable(TIM_TypeDef *tim)
+{
+    sim_tim_find(tim)->clk_on = 1;
+}
+
+/******************************************************************************/
+/*                          NVIC                                              */
+/******************************************************************************/
+#define TIM_SR_CCxIF (TIM_SR_CC1IF | TIM_SR_CC2IF | TIM_SR_CC3IF | TIM_SR_CC4IF)
+
+static int nvic_line(IRQn_Type irq)
+{
+    for (int i = 0; i < SIM_TIM_COUNT; i++) {
+        sim_tim_t *t = &sim_tims[i];
+        uint32_t active = t->sr & t->regs->DIER;
+        if (irq == t->irq_up && (active & TIM_SR_UIF)) {
+            return 1;
+        }
+        if (irq == t->irq_cc && (active & TIM_SR_CCxIF)) {
+            return 1;
+        }
+        if (irq == t->irq_trg && (active & (TIM_SR_TIF | TIM_SR_COMIF))) {
+            return 1;
+        }
+    }
+    for (uint32_t lines = sim_dma_lines(); lines; lines &= lines - 1) {
+        if (irq == sim_dma_irq(__builtin_ctz(lines))) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void nvic_consider(int *best, IRQn_Type irq)
+{
+    if (nvic_enabled[irq] && (int)irq < *best) {
+        *best = irq;
+    }
+}
+
+/* Lowest numbered enabled IRQ that is pending or has its line asserted */
+static int nvic_next(void)
+{
+    int best = SIM_IRQn_COUNT;
+
+    for (int i = 0; i < SIM_TIM_COUNT; i++) {
+        sim_tim_t *t = &sim_tims[i];
+        uint32_t active = t->sr & t->regs->DIER;
+        if (active == 0) {
+            continue;
+        }
+        if (active & TIM_SR_UIF) {
+            nvic_consider(&best, t->irq_up);
+        }
+        if (active & TIM_SR_CCxIF) {
+            nvic_consider(&best, t->irq_cc);
+        }
+        if (active & (TIM_SR_TIF | TIM_SR_COMIF)) {
+            nvic_consider(&best, t->irq_trg);
+        }
+    }
+    for (uint32_t lines = sim_dma_lines(); lines; lines &= lines - 1) {
+        nvic_consider(&best, sim_dma_irq(__builtin_ctz(lines)));
+    }
+    if (nvic_pending_any) {
+        nvic_pending_any = 0;
+        for (int irq = 0; irq < SIM_IRQn_COUNT; irq++) {
+            if (nvic_pending[irq]) {
+                nvic_pending_any = 1;
+                nvic_consider(&best, (IRQn_Type)irq);
+            }
+        }
+    }
+    return best;
+}
+
+static void tim_sync(sim_tim_t *t);
+
+static void nvic_dispatch(void)
+{
+    uint32_t storm = 0;
+
+    if (nvic_active || nvic_primask) {
+        return;
+    }
+
+    for (;;) {
+        int irq;
+        for (int i = 0; i < SIM_TIM_COUNT; i++) {
+            tim_sync(&sim_tims[i]);
+        }
+        sim_dma_sync();
+        irq = nvic_next();
+        if (irq == SIM_IRQn_COUNT) {
+            return;
+        }
+        if (nvic_vector[irq] == 0) {
+            fprintf(stderr, "sim: IRQ %d enabled without a vector\n", irq);
+            abort();
+        }
+        if (++storm > SIM_NVIC_STORM) {
+            fprintf(stderr, "sim: IRQ %d never clears its source\n", irq);
+            abort();
+        }
+
+        nvic_pending[irq] = 0;
+        nvic_count[irq]++;
+        nvic_active = 1;
+        nvic_current = irq;
+        ((void (*)(void))nvic_vector[irq])();
+        nvic_current = -1;
+        nvic_active = 0;
+
+        if (nvic_primask) {
+            return;
+        }
+    }
+}
+
+void NVIC_SetVector(IRQn_Type IRQn, uintptr_t vector)
+{
+    nvic_vector[IRQn] = vector;
+}
+
+uintptr_t NVIC_GetVector(IRQn_Type IRQn)
+{
+    return nvic_vector[IRQn];
+}
+
+void NVIC_EnableIRQ(IRQn_Type IRQn)
+{
+    nvic_enabled[IRQn] = 1;
+    nvic_dispatch();
+}
+
+void NVIC_DisableIRQ(IRQn_Type IRQn)
+{
+    nvic_enabled[IRQn] = 0;
+}
+
+uint32_t NVIC_GetPendingIRQ(IRQn_Type IRQn)
+{
+    return nvic_pending[IRQn] || nvic_line(IRQn);
+}
+
+void NVIC_SetPendingIRQ(IRQn_Type IRQn)
+{
+    nvic_pending[IRQn] = 1;
+    nvic_pending_any = 1;
+    nvic_dispatch();
+}
+
+void NVIC_ClearPendingIRQ(IRQn_Type IRQn)
+{
+    nvic_pending[IRQn] = 0;
+}
+
+// Recorded for the tests only, every vector still runs to completion
+void NVIC_SetPriority(IRQn_Type IRQn, uint32_t priority)
+{
+    nvic_priority[IRQn] = priority;
+}
+
+void __enable_irq(void)
+{
+    nvic_primask = 0;
+    nvic_dispatch();
+}
+
+void __disable_irq(void)
+{
+    nvic_primask = 1;
+}
+
+uint32_t __get_PRIMASK(void)
+{
+    return nvic_primask;
+}
+
+void __set_PRIMASK(uint32_t priMask)
+{
+    nvic_primask = priMask & 1;
+    nvic_dispatch();
+}
+
+uint32_t sim_nvic_count(IRQn_Type irq)
+{
+    return nvic_count[irq];
+}
+
+uint32_t sim_nvic_priority(IRQn_Type irq)
+{
+    return nvic_priority[irq];
+}
+
+int sim_nvic_current(void)
+{
+    return nvic_current;
+}
+
+/******************************************************************************/
+/*                          Counter                                           */
+/******************************************************************************/
+static uint32_t tim_max(sim_tim_t *t)
+{
+    return t->bits32 ? 0xFFFFFFFFU : 0xFFFFU;
+}
+
+static uint32_t tim_ccr(sim_tim_t *t, int ch)
+{
+    return (&t->regs->CCR1)[ch];
+}
+
+static uint32_t tim_ccmr(sim_tim_t *t, int ch)
+{
+    uint32_t ccmr = (ch < 2) ? t->regs->CCMR1 : t->regs->CCMR2;
+    return (ch & 1) ? (ccmr >> 8) & 0xFF : ccmr & 0xFF;
+}
+
+static int tim_is_output(sim_tim_t *t, int ch)
+{
+    return (tim_ccmr(t, ch) & TIM_CCMR1_CC1S) == 0;
+}
+
+static void tim_set_sr(sim_tim_t *t, uint32_t flags)
+{
+    uint32_t de = t->regs->DIER >> 8;
+    uint32_t requests = flags & de & (TIM_SR_UIF | TIM_SR_COMIF | TIM_SR_TIF);
+
+    // With CCDS the CCx requests go out on the update event instead
+    if (t->regs->CR2 & TIM_CR2_CCDS) {
+        requests |= (flags & TIM_SR_UIF) ? de & TIM_SR_CCxIF : 0;
+    } else {
+        requests |= flags & de & TIM_SR_CCxIF;
+    }
+
+    t->sr |= flags;
+    t->regs->SR = t->sr;
+    if (requests) {
+        sim_dma_request(t->regs, requests);
+    }
+}
+
+/* Reading a capture register clears its flag, and the DMA does exactly that
+ * when it serves a CCx request */
+void sim_tim_bus_read(uint32_t addr)
+{
+    for (int i = 0; i < SIM_TIM_COUNT; i++) {
+        sim_tim_t *t = &sim_tims[i];
+        uint32_t base = (uint32_t)(uintptr_t)t->regs;
+
+        for (int ch = 0; ch < 4; ch++) {
+            if (addr == base + offsetof(TIM_TypeDef, CCR1) + 4 * ch && !tim_is_output(t, ch)) {
+                t->sr &= ~(TIM_SR_CC1IF << ch);
+                t->regs->SR = t->sr;
+            }
+        }
+    }
+}
+
+static void tim_trgo(sim_tim_t *t, int level)
+{
+    if (t->trgo == level) {
+        return;
+    }
+    t->trgo = level;
+
+    for (int i = 0; i < SIM_TIM_COUNT; i++) {
+        sim_tim_t *s = &sim_tims[i];
+        uint32_t ts = (s->regs->SMCR & TIM_SMCR_TS) >> TIM_SMCR_TS_Pos;
+        if (s != t && ts < 4 && s->itr[ts] == t->regs) {
+            tim_advance(s, sim_step_to);
+            tim_trgi(s, level);
+        }
+    }
+}
+
+static void tim_trgo_pulse(sim_tim_t *t)
+{
+    tim_trgo(t, 1);
+    tim_trgo(t, 0);
+}
+
+static void tim_update_event(sim_tim_t *t, int software)
+{
+    TIM_TypeDef *regs = t->regs;
+
+    if (regs->CR1 & TIM_CR1_UDIS) {
+        return;
+    }
+
+    if (t->advanced && !software) {
+        if (t->rcr_cnt > 0) {
+            t->rcr_cnt--;
+            return;
+        }
+    }
+    t->rcr_cnt = regs->RCR & 0xFF;
+    t->psc = regs->PSC & 0xFFFF;
+
+    if (!(software && (regs->CR1 & TIM_CR1_URS))) {
+        tim_set_sr(t, TIM_SR_UIF);
+    }
+    if ((regs->CR2 & TIM_CR2_MMS) == TIM_TRGO_UPDATE) {
+        tim_trgo_pulse(t);
+    }
+    if ((regs->CR1 & TIM_CR1_OPM) && !software) {
+        regs->CR1 &= ~TIM_CR1_CEN;
+    }
+}
+
+static void tim_compare_match(sim_tim_t *t, int ch)
+{
+    uint32_t mode = tim_ccmr(t, ch) & TIM_CCMR1_OC1M;
+
+    tim_set_sr(t, TIM_SR_CC1IF << ch);
+
+    if (mode == TIM_OCMODE_ACTIVE) {
+        t->ocref[ch] = 1;
+    } else if (mode == TIM_OCMODE_INACTIVE) {
+        t->ocref[ch] = 0;
+    } else if (mode == TIM_OCMODE_TOGGLE) {
+        t->ocref[ch] ^= 1;
+    }
+
+    if (ch == 0 && (t->regs->CR2 & TIM_CR2_MMS) == TIM_TRGO_OC1) {
+        tim_trgo_pulse(t);
+    }
+}
+
+static void tim_counter_tick(sim_tim_t *t, int down)
+{
+    TIM_TypeDef *regs = t->regs;
+    uint32_t cnt = regs->CNT;
+    int update = 0;
+
+    if (!down) {
+        if (cnt == regs->ARR) {
+            cnt = 0;
+            update = 1;
+        } else {
+            cnt = (cnt + 1) & tim_max(t);
+        }
+    } else {
+        if (cnt == 0) {
+            cnt = regs->ARR;
+            update = 1;
+        } else {
+            cnt--;
+        }
+    }
+    regs->CNT = cnt;
+
+    for (int ch = 0; ch < 4; ch++) {
+        if (tim_is_output(t, ch) && cnt == tim_ccr(t, ch)) {
+            tim_compare_match(t, ch);
+        }
+    }
+    if (update) {
+        tim_update_event(t, 0);
+    }
+    tim_outputs(t);
+}
+
+/* One pulse on CK_PSC, from an external clock or the encoder interface */
+static void tim_clock_pulse(sim_tim_t *t, int down)
+{
+    if (!(t->regs->CR1 & TIM_CR1_CEN)) {
+        return;
+    }
+    if (++t->psc_cnt > t->psc) {
+        t->psc_cnt = 0;
+        tim_counter_tick(t, down);
+    }
+}
+
+static int tim_internal_clock(sim_tim_t *t)
+{
+    TIM_TypeDef *regs = t->regs;
+    uint32_t sms = regs->SMCR & TIM_SMCR_SMS;
+
+    if (!t->clk_on || !(regs->CR1 & TIM_CR1_CEN) || (regs->SMCR & TIM_SMCR_ECE)) {
+        return 0;
+    }
+    switch (sms) {
+        case TIM_SLAVEMODE_DISABLE:
+        case TIM_SLAVEMODE_RESET:
+        case TIM_SLAVEMODE_TRIGGER:
+            return 1;
+        case TIM_SLAVEMODE_GATED:
+            return t->trgi;
+        default:
+            return 0;
+    }
+}
+
+/* Counter ticks until the next compare match or over/underflow */
+static uint64_t tim_ticks_to_event(sim_tim_t *t)
+{
+    TIM_TypeDef *regs = t->regs;
+    uint32_t cnt = regs->CNT;
+    uint64_t ticks;
+
+    if (regs->CR1 & TIM_CR1_DIR) {
+        ticks = (uint64_t)cnt + 1;
+        for (int ch = 0; ch < 4; ch++) {
+            uint32_t ccr = tim_ccr(t, ch);
+            if (tim_is_output(t, ch) && ccr < cnt && cnt - ccr < ticks) {
+                ticks = cnt - ccr;
+            }
+        }
+    } else {
+        ticks = (cnt <= regs->ARR) ? (uint64_t)regs->ARR - cnt + 1 : (uint64_t)tim_max(t) - cnt + 1;
+        for (int ch = 0; ch < 4; ch++) {
+            uint32_t ccr = tim_ccr(t, ch);
+            if (tim_is_output(t, ch) && ccr > cnt && ccr - cnt < ticks) {
+                ticks = ccr - cnt;
+            }
+        }
+    }
+    return ticks;
+}
+
+static sim_time_t tim_next_event(sim_tim_t *t)
+{
+    sim_time_t next = SIM_TIME_NEVER;
+
+    for (int line = 0; line < SIM_TIM_LINES; line++) {
+        if (t->in_commit[line] < next) {
+            next = t->in_commit[line];
+        }
+    }
+
+    if (tim_internal_clock(t)) {
+        uint64_t clocks = tim_ticks_to_event(t) * ((uint64_t)t->psc + 1) - t->psc_cnt;
+        sim_time_t when = (t->last / t->clk_div + clocks) * t->clk_div;
+        if (when < next) {
+            next = when;
+        }
+    }
+    return next;
+}
+
+/* Run the internal clock up to 'to'. The scheduler never steps past the next
+ * event of any timer, so at most the final tick can hit one */
+static void tim_advance(sim_tim_t *t, sim_time_t to)
+{
+    if (to <= t->last) {
+        return;
+    }
+
+    if (tim_internal_clock(t)) {
+        uint64_t clocks = to / t->clk_div - t->last / t->clk_div;
+        uint64_t total = t->psc_cnt + clocks;
+        uint64_t ticks = total / ((uint64_t)t->psc + 1);
+
+        t->psc_cnt = (uint32_t)(total % ((uint64_t)t->psc + 1));
+        if (ticks > 0) {
+            int down = (t->regs->CR1 & TIM_CR1_DIR) != 0;
+            uint32_t cnt = t->regs->CNT;
+            cnt = down ? cnt - (uint32_t)(ticks - 1) : cnt + (uint32_t)(ticks - 1);
+            t->regs->CNT = cnt & tim_max(t);
+            t->last = to;
+            tim_counter_tick(t, down);
+            return;
+        }
+    }
+    t->last = to;
+}
+
+/* Software event generation (EGR) */
+void sim_tim_generate(TIM_TypeDef *tim, uint32_t events)
+{
+    sim_tim_t *t = sim_tim_find(tim);
+    TIM_TypeDef *regs = t->regs;
+
+    if (events & TIM_EGR_UG) {
+        regs->CNT = (regs->CR1 & TIM_CR1_DIR) ? regs->ARR : 0;
+        t->psc_cnt = 0;
+        tim_update_event(t, 1);
+        if ((regs->CR2 & TIM_CR2_MMS) == TIM_TRGO_RESET) {
+            tim_trgo_pulse(t);
+        }
+    }
+    for (int ch = 0; ch < 4; ch++) {
+        if (events & (TIM_EGR_CC1G << ch)) {
+            if (!tim_is_output(t, ch)) {
+                (&regs->CCR1)[ch] = regs->CNT;
+            }
+            tim_set_sr(t, TIM_SR_CC1IF << ch);
+            if (ch == 0 && (regs->CR2 & TIM_CR2_MMS) == TIM_TRGO_OC1) {
+                tim_trgo_pulse(t);
+            }
+        }
+    }
+    if (events & TIM_EGR_TG) {
+        tim_set_sr(t, TIM_SR_TIF);
+    }
+    regs->EGR = 0;
+    tim_outputs(t);
+    nvic_dispatch();
+}
+
+void sim_tim_clear_sr(TIM_TypeDef *tim, uint32_t flags)
+{
+    sim_tim_t *t = sim_tim_find(tim);
+
+    t->sr &= ~flags;
+    t->regs->SR = t->sr;
+}
+
+/* Pick up register writes made since the last step */
+static void tim_sync(sim_tim_t *t)
+{
+    // SR is rc_w0: a direct write can clear flags but never set them
+    t->sr &= t->regs->SR;
+    t->regs->SR = t->sr;
+
+    if (t->regs->EGR) {
+        uint32_t events = t->regs->EGR;
+        t->regs->EGR = 0;
+        sim_tim_generate(t->regs, events);
+    }
+    tim_outputs(t);
+}
+
+/******************************************************************************/
+/*                          Outputs                                           */
+/******************************************************************************/
+static void tim_outputs(sim_tim_t *t)
+{
+    TIM_TypeDef *regs = t->regs;
+    uint32_t mms = regs->CR2 & TIM_CR2_MMS;
+
+    for (int ch = 0; ch < 4; ch++) {
+        uint32_t mode = tim_ccmr(t, ch) & TIM_CCMR1_OC1M;
+        uint32_t ccr = tim_ccr(t, ch);
+        uint32_t cnt = regs->CNT;
+        int down = (regs->CR1 & TIM_CR1_DIR) != 0;
+        int level;
+
+        if (!tim_is_output(t, ch)) {
+            continue;
+        }
+
+        switch (mode) {
+            case TIM_OCMODE_FORCED_INACTIVE:
+                t->ocref[ch] = 0;
+                break;
+            case TIM_OCMODE_FORCED_ACTIVE:
+                t->ocref[ch] = 1;
+                break;
+            case TIM_OCMODE_PWM1:
+                t->ocref[ch] = down ? (cnt <= ccr) : (cnt < ccr);
+                break;
+            case TIM_OCMODE_PWM2:
+                t->ocref[ch] = down ? !(cnt <= ccr) : !(cnt < ccr);
+                break;
+            default:
+                break;
+        }
+
+        level = 0;
+        if ((regs->CCER & (TIM_CCER_CC1E << (4 * ch))) && (!t->advanced || (regs->BDTR & TIM_BDTR_MOE))) {
+            level = t->ocref[ch] ^ ((regs->CCER & (TIM_CCER_CC1P << (4 * ch))) != 0);
+        }
+        if (level != t->out[ch]) {
+            t->out[ch] = level;
+            sim_gpio_tim_output(regs, ch + 1, level);
+        }
+    }
+
+    if (mms == TIM_TRGO_ENABLE) {
+        tim_trgo(t, (regs->CR1 & TIM_CR1_CEN) != 0);
+    } else if (mms >= TIM_TRGO_OC1REF) {
+        tim_trgo(t, t->ocref[(mms - TIM_TRGO_OC1REF) >> TIM_CR2_MMS_Pos]);
+    }
+}
+
+int sim_tim_output(TIM_TypeDef *tim, int channel)
+{
+    return sim_tim_find(tim)->out[channel - 1];
+}
+
+/******************************************************************************/
+/*                          Inputs                                            */
+/******************************************************************************/
+
+/* Samples (N) and sampling divider for each ICxF/ETF setting, RM0090 17.4.7 */
+static const uint8_t filter_n[16] = { 1, 2, 4, 8, 6, 8, 6, 8, 6, 8, 5, 6, 8, 5, 6, 8 };
+static const uint8_t filter_div[16] = { 1, 1, 1, 1, 2, 2, 4, 4, 8, 8, 16, 16, 16, 32, 32, 32 };
+
+static sim_time_t tim_filter_delay(sim_tim_t *t, sim_tim_line line)
+{
+    uint32_t f;
+    uint32_t ckd = 1U << ((t->regs->CR1 & TIM_CR1_CKD) >> 8);
+
+    if (line == SIM_TIM_ETR) {
+        f = (t->regs->SMCR & TIM_SMCR_ETF) >> TIM_SMCR_ETF_Pos;
+    } else {
+        f = (tim_ccmr(t, line) >> 4) & 0xF;
+    }
+    // fCK_INT for settings 1-3, fDTS divided down for the rest
+    if (f < 4) {
+        ckd = 1;
+    }
+    return (sim_time_t)filter_n[f] * filter_div[f] * ckd * t->clk_div;
+}
+
+static uint32_t tim_ccer_pol(sim_tim_t *t, int ch)
+{
+    return (t->regs->CCER >> (4 * ch)) & (TIM_CCER_CC1P | TIM_CCER_CC1NP);
+}
+
+static int tim_edge_active(uint32_t pol, int level)
+{
+    if (pol == TIM_ICPOLARITY_BOTHEDGE) {
+        return 1;
+    }
+    return pol == TIM_ICPOLARITY_FALLING ? !level : level;
+}
+
+static void tim_capture(sim_tim_t *t, int ch)
+{
+    static const uint8_t ic_div[4] = { 1, 2, 4, 8 };
+    uint32_t psc = (tim_ccmr(t, ch) & TIM_CCMR1_IC1PSC) >> 2;
+
+    if (++t->ic_psc_cnt[ch] < ic_div[psc]) {
+        return;
+    }
+    t->ic_psc_cnt[ch] = 0;
+
+    (&t->regs->CCR1)[ch] = t->regs->CNT;
+    if (t->sr & (TIM_SR_CC1IF << ch)) {
+        tim_set_sr(t, TIM_SR_CC1OF << ch);
+    }
+    tim_set_sr(t, TIM_SR_CC1IF << ch);
+
+    if (ch == 0 && (t->regs->CR2 & TIM_CR2_MMS) == TIM_TRGO_OC1) {
+        tim_trgo_pulse(t);
+    }
+}
+
+static void tim_trgi(sim_tim_t *t, int level)
+{
+    TIM_TypeDef *regs = t->regs;
+    uint32_t sms = regs->SMCR & TIM_SMCR_SMS;
+    int rising = level && !t->trgi;
+
+    if (level == t->trgi) {
+        return;
+    }
+    t->trgi = level;
+
+    // Channels mapped on TRC capture on the rising edge of TRGI
+    for (int ch = 0; ch < 4 && rising; ch++) {
+        if ((tim_ccmr(t, ch) & TIM_CCMR1_CC1S) == TIM_ICSELECTION_TRC &&
+            (regs->CCER & (TIM_CCER_CC1E << (4 * ch)))) {
+            tim_capture(t, ch);
+        }
+    }
+
+    switch (sms) {
+        case TIM_SLAVEMODE_RESET:
+            if (rising) {
+                regs->CNT = (regs->CR1 & TIM_CR1_DIR) ? regs->ARR : 0;
+                t->psc_cnt = 0;
+                tim_update_event(t, 1);
+                if ((regs->CR2 & TIM_CR2_MMS) == TIM_TRGO_RESET) {
+                    tim_trgo_pulse(t);
+                }
+                tim_set_sr(t, TIM_SR_TIF);
+            }
+            break;
+        case TIM_SLAVEMODE_GATED:
+            tim_set_sr(t, TIM_SR_TIF);
+            break;
+        case TIM_SLAVEMODE_TRIGGER:
+            if (rising) {
+                regs->CR1 |= TIM_CR1_CEN;
+                tim_set_sr(t, TIM_SR_TIF);
+            }
+            break;
+        case TIM_SLAVEMODE_EXTERNAL1:
+            if (rising) {
+                tim_set_sr(t, TIM_SR_TIF);
+                tim_clock_pulse(t, (regs->CR1 & TIM_CR1_DIR) != 0);
+            }
+            break;
+        default:
+            break;
+    }
+    tim_outputs(t);
+}
+
+static void tim_encoder_edge(sim_tim_t *t, sim_tim_line line)
+{
+    TIM_TypeDef *regs = t->regs;
+    uint32_t sms = regs->SMCR & TIM_SMCR_SMS;
+    int a = t->in_filt[SIM_TIM_TI1] ^ ((regs->CCER & TIM_CCER_CC1P) != 0);
+    int b = t->in_filt[SIM_TIM_TI2] ^ ((regs->CCER & TIM_CCER_CC2P) != 0);
+    int up;
+
+    if (line == SIM_TIM_TI1 && (sms & TIM_ENCODERMODE_TI1)) {
+        up = (a != b);
+    } else if (line == SIM_TIM_TI2 && (sms & TIM_ENCODERMODE_TI2)) {
+        up = (a == b);
+    } else {
+        return;
+    }
+
+    if (up) {
+        regs->CR1 &= ~TIM_CR1_DIR;
+    } else {
+        regs->CR1 |= TIM_CR1_DIR;
+    }
+    tim_clock_pulse(t, !up);
+}
+
+static void tim_input_edge(sim_tim_t *t, sim_tim_line line, int level)
+{
+    TIM_TypeDef *regs = t->regs;
+    uint32_t sms = regs->SMCR & TIM_SMCR_SMS;
+    uint32_t ts = regs->SMCR & TIM_SMCR_TS;
+
+    if (line == SIM_TIM_ETR) {
+        static const uint8_t etps_div[4] = { 1, 2, 4, 8 };
+        int etrf = level ^ ((regs->SMCR & TIM_SMCR_ETP) != 0);
+
+        if (ts == TIM_TS_ETRF) {
+            tim_trgi(t, etrf);
+        }
+        if (etrf && (regs->SMCR & TIM_SMCR_ECE)) {
+            if (++t->etr_psc_cnt >= etps_div[(regs->SMCR & TIM_SMCR_ETPS) >> TIM_SMCR_ETPS_Pos]) {
+                t->etr_psc_cnt = 0;
+                tim_clock_pulse(t, (regs->CR1 & TIM_CR1_DIR) != 0);
+            }
+        }
+        return;
+    }
+
+    // Capture on any channel fed by this line, directly or from its neighbour
+    for (int ch = 0; ch < 4; ch++) {
+        uint32_t cc_s = tim_ccmr(t, ch) & TIM_CCMR1_CC1S;
+        int src;
+
+        if (cc_s == TIM_ICSELECTION_DIRECTTI) {
+            src = ch;
+        } else if (cc_s == TIM_ICSELECTION_INDIRECTTI) {
+            src = ch ^ 1;
+        } else {
+            continue;
+        }
+        if (src == (int)line && (regs->CCER & (TIM_CCER_CC1E << (4 * ch))) &&
+            tim_edge_active(tim_ccer_pol(t, ch), level)) {
+            tim_capture(t, ch);
+        }
+    }
+
+    if (sms >= TIM_ENCODERMODE_TI1 && sms <= TIM_ENCODERMODE_TI12) {
+        tim_encoder_edge(t, line);
+        return;
+    }
+
+    if (line == SIM_TIM_TI1 && ts == TIM_TS_TI1F_ED) {
+        tim_trgi(t, 1);
+        tim_trgi(t, 0);
+    } else if ((line == SIM_TIM_TI1 && ts == TIM_TS_TI1FP1) || (line == SIM_TIM_TI2 && ts == TIM_TS_TI2FP2)) {
+        uint32_t pol = tim_ccer_pol(t, line);
+        if (pol == TIM_ICPOLARITY_BOTHEDGE) {
+            // Both edges: every transition is a trigger pulse, as for TI1F_ED
+            tim_trgi(t, 1);
+            tim_trgi(t, 0);
+        } else {
+            tim_trgi(t, level ^ (pol != 0));
+        }
+    }
+}
+
+void sim_tim_input(TIM_TypeDef *tim, sim_tim_line line, int level)
+{
+    sim_tim_t *t = sim_tim_find(tim);
+
+    level = level != 0;
+    if (level == t->in_raw[line]) {
+        return;
+    }
+    t->in_raw[line] = level;
+
+    // A level only gets through the filter once it has been stable for N
+    // samples; anything shorter is a glitch and is dropped
+    if (level == t->in_filt[line]) {
+        t->in_commit[line] = SIM_TIME_NEVER;
+    } else {
+        t->in_commit[line] = sim_time + tim_filter_delay(t, line);
+    }
+}
+
+static void tim_inputs_commit(sim_tim_t *t)
+{
+    for (int line = 0; line < SIM_TIM_LINES; line++) {
+        if (t->in_commit[line] <= sim_time) {
+            t->in_commit[line] = SIM_TIME_NEVER;
+            t->in_filt[line] = t->in_raw[line];
+            tim_input_edge(t, (sim_tim_line)line, t->in_filt[line]);
+        }
+    }
+}
+
+/******************************************************************************/
+/*                          Scheduler                                         */
+/******************************************************************************/
+void sim_run_until(sim_time_t when)
+{
+    for (;;) {
+        sim_time_t next = when;
+
+        for (int i = 0; i < SIM_TIM_COUNT; i++) {
+            tim_sync(&sim_tims[i]);
+        }
+        nvic_dispatch();
+
+        for (int i = 0; i < SIM_TIM_COUNT; i++) {
+            sim_time_t t = tim_next_event(&sim_tims[i]);
+            if (t < next) {
+                next = t;
+            }
+        }
+        for (sim_source_t *src = sim_sources; src; src = src->link) {
+            sim_time_t t = src->next(src);
+            if (t < next) {
+                next = t;
+            }
+        }
+        if (next < sim_time) {
+            next = sim_time;
+        }
+
+        // Time moves first, so output edges and anything they drive are
+        // stamped with the tick that caused them
+        sim_dma_sync();
+        sim_step_to = next;
+        sim_time = next;
+        for (int i = 0; i < SIM_TIM_COUNT; i++) {
+            tim_advance(&sim_tims[i], next);
+        }
+
+        for (int i = 0; i < SIM_TIM_COUNT; i++) {
+            tim_inputs_commit(&sim_tims[i]);
+        }
+        for (sim_source_t *src = sim_sources, *link; src; src = link) {
+            link = src->link;
+            if (src->next(src) <= sim_time) {
+                src->fire(src);
+            }
+        }
+        nvic_dispatch();
+
+        if (sim_time >= when) {
+            break;
+        }
+    }
+}
+
+void sim_run(sim_time_t cycles)
+{
+    sim_run_until(sim_time + cycles);
+}
@@ -0,0 +1,123 @@
+/* mbed Microcontroller Library
+ * Copyright (c) 2006-2013 ARM Limited
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef SIM_TIM_H
+#define SIM_TIM_H
+
+#include <stdint.h>
+#include "sim_stm32f4xx.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Clock tree of a STM32F429 at 180MHz: APB1 /4, APB2 /2, so the APB1 timers
+ * (TIM2-5) run at 90MHz and the APB2 timers (TIM1/8) at 180MHz */
+#define SIM_HCLK_HZ         180000000U
+#define SIM_PCLK1_HZ        (SIM_HCLK_HZ / 4)
+#define SIM_PCLK2_HZ        (SIM_HCLK_HZ / 2)
+
+/** Simulated time, in HCLK cycles since sim_reset() */
+typedef uint64_t sim_time_t;
+
+#define SIM_TIME_NEVER      UINT64_MAX
+#define SIM_NS(x)           (((sim_time_t)(x) * (SIM_HCLK_HZ / 1000000U)) / 1000U)
+#define SIM_US(x)           ((sim_time_t)(x) * (SIM_HCLK_HZ / 1000000U))
+#define SIM_MS(x)           ((sim_time_t)(x) * (SIM_HCLK_HZ / 1000U))
+
+/** Timer input lines, TI1..TI4 then the external trigger input */
+typedef enum {
+    SIM_TIM_TI1 = 0,
+    SIM_TIM_TI2,
+    SIM_TIM_TI3,
+    SIM_TIM_TI4,
+    SIM_TIM_ETR,
+    SIM_TIM_LINES
+} sim_tim_line;
+
+/** Anything that wants to act at a point in simulated time (stimulus
+ * generators, test probes). next() returns the absolute time of the next
+ * action or SIM_TIME_NEVER, fire() is called once that time is reached.
+ */
+typedef struct sim_source_s {
+    sim_time_t (*next)(struct sim_source_s *src);
+    void (*fire)(struct sim_source_s *src);
+    struct sim_source_s *link;
+} sim_source_t;
+
+/** Put every timer and the NVIC back into reset state and rewind time to 0 */
+void sim_reset(void);
+
+/** Current simulated time */
+sim_time_t sim_now(void);
+
+/** Advance simulated time, running timers, stimulus and interrupt handlers */
+void sim_run(sim_time_t cycles);
+
+/** Advance simulated time up to an absolute point */
+void sim_run_until(sim_time_t when);
+
+void sim_source_add(sim_source_t *src);
+
+void sim_source_remove(sim_source_t *src);
+
+/** Drive a timer input line (called by the GPIO model on pin edges) */
+void sim_tim_input(TIM_TypeDef *tim, sim_tim_line line, int level);
+
+/** Level of a timer channel output (OCx after polarity and enable) */
+int sim_tim_output(TIM_TypeDef *tim, int channel);
+
+/** Number of times an interrupt vector has been entered since sim_reset() */
+uint32_t sim_nvic_count(IRQn_Type irq);
+
+/** Priority given with NVIC_SetPriority, 0xFF if left at the default */
+uint32_t sim_nvic_priority(IRQn_Type irq);
+
+/** The interrupt whose vector is running, -1 outside of one */
+int sim_nvic_current(void);
+
+/* GPIO model, see sim_gpio.c */
+typedef void (*sim_gpio_watch_t)(void *ctx, int pin, int level, sim_time_t when);
+
+void sim_gpio_reset(void);
+
+void sim_gpio_write(int pin, int level);
+
+int sim_gpio_read(int pin);
+
+void sim_gpio_watch(int pin, sim_gpio_watch_t watch, void *ctx);
+
+void sim_gpio_tim_output(TIM_TypeDef *tim, int channel, int level);
+
+/* DMA model, see sim_dma.c */
+void sim_dma_reset(void);
+
+void sim_dma_sync(void);
+
+/** Serve the DMA requests a timer raises for 'events' (TIM_SR flag bits) */
+void sim_dma_request(TIM_TypeDef *tim, uint32_t events);
+
+uint32_t sim_dma_lines(void);
+
+IRQn_Type sim_dma_irq(int stream);
+
+/** Side effects of a bus read of a timer register by the DMA */
+void sim_tim_bus_read(uint32_t addr);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
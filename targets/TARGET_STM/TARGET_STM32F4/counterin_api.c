@@ -1,26 +1,284 @@
 #include "counterin_api.h"
+#include "capturein_api.h"
 
 #if DEVICE_COUNTERIN
 
+#include <stddef.h>
 #include "cmsis.h"
 #include "pinmap.h"
 #include "mbed_error.h"
 #include "PeripheralPins.h"
+#include "dma_streams.h"
+#include "timers.h"
 
-static TIM_HandleTypeDef TimHandle;
+#define CHANNEL_NUMBER      9
 
-void counterin_init(counterin_t* obj, PinName pin)
+/* Polls of CNT that cover the couple of timer clocks a carry takes through
+ * the ITR resynchronisation to the high half */
+#define CASCADE_SETTLE      2
+
+static counterin_t *counterin_objs[CHANNEL_NUMBER];
+
+static void counterin_alarm_service( counterin_t* obj );
+
+static uint8_t counterin_get_irq_index( counterin_t* obj )
+{
+    uint8_t irq_index = 0;
+
+    switch( obj->cnt )
+    {
+        case CNT_2:
+            irq_index = 2;
+            break;
+        case CNT_3:
+            irq_index = 3;
+            break;
+        case CNT_8:
+            irq_index = 8;
+            break;
+    }
+
+    return irq_index;
+}
+
+/* The timer whose wraps go into the software count, the high half when
+ * cascaded */
+static TIM_HandleTypeDef* counterin_carry( counterin_t* obj )
+{
+    return obj->high.Instance ? &obj->high : &obj->handle;
+}
+
+/* Counts in one wrap of the hardware count */
+static uint64_t counterin_range( counterin_t* obj )
+{
+    uint64_t range = (uint64_t)obj->handle.Init.Period + 1;
+
+    if (obj->high.Instance)
+        range *= (uint64_t)obj->high.Init.Period + 1;
+    return range;
+}
+
+/* The overflow slot readers take at a given seq: an odd seq already points
+ * at the slot the next even one will */
+static inline uint8_t counterin_slot( uint32_t seq )
+{
+    return ((seq + 1) >> 1) & 1;
+}
+
+/* Overflow event, nonzero if there was one. A reader can interrupt this
+ * anywhere, so every step leaves something counterin_read64 can use. */
+static uint8_t counterin_update_isr( counterin_t* obj )
+{
+    TIM_HandleTypeDef* htim = counterin_carry( obj );
+
+    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) != RESET)
+    {
+        if(__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_UPDATE) !=RESET)
+        {
+            uint32_t seq = obj->seq;
+
+            obj->overflow[counterin_slot(seq + 2)] = obj->overflow[counterin_slot(seq)] + counterin_range( obj );
+            obj->seq = seq + 1;     // counted, flag still up
+            __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
+            obj->seq = seq + 2;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+static void handle_interrupt( counterin_t* obj )
+{
+  /* Overflow event */
+    if (counterin_update_isr( obj ))
+        counterin_alarm_service( obj );
+  /* Compare 3 event, the nearest alarm */
+    if(__HAL_TIM_GET_FLAG(&obj->handle, TIM_FLAG_CC3) != RESET)
+    {
+        if(__HAL_TIM_GET_IT_SOURCE(&obj->handle, TIM_IT_CC3) !=RESET)
+        {
+            __HAL_TIM_CLEAR_IT(&obj->handle, TIM_IT_CC3);
+            counterin_alarm_service( obj );
+        }
+    }
+}
+
+/* High halves of cascaded counters */
+static void timer1_irq( void )
+{
+    handle_interrupt( counterin_objs[1] );
+}
+
+static void timer4_irq( void )
+{
+    handle_interrupt( counterin_objs[4] );
+}
+
+static void timer2_irq( void )
+{
+    handle_interrupt( counterin_objs[2] );
+}
+
+static void timer3_irq( void )
+{
+    handle_interrupt( counterin_objs[3] );
+}
+
+/* TIM8 has vectors of its own for the update, which runs above everything
+ * else, and the compare. The alarms run from the compare one, so a wrap
+ * pends that rather than call into them. */
+static void timer8_up_irq( void )
+{
+    if (counterin_update_isr( counterin_objs[8] ) && counterin_objs[8]->alarms)
+        NVIC_SetPendingIRQ( TIM8_CC_IRQn );
+}
+
+static void timer8_cc_irq( void )
+{
+    __HAL_TIM_CLEAR_IT(&counterin_objs[8]->handle, TIM_IT_CC3);
+    counterin_alarm_service( counterin_objs[8] );
+}
+
+static uintptr_t counterin_get_vector( counterin_t* obj )
+{
+    uintptr_t vector = (uintptr_t)0;
+
+    switch( obj->cnt )
+    {
+        case CNT_2:
+            vector = (uintptr_t)&timer2_irq;
+            break;
+
+        case CNT_3:
+            vector = (uintptr_t)&timer3_irq;
+            break;
+
+        case CNT_8:
+            vector = (uintptr_t)&timer8_up_irq;
+            break;
+
+        default:
+            break;
+    }
+
+    return vector;
+}
+
+static uintptr_t counterin_get_cc_vector( counterin_t* obj )
+{
+    uintptr_t vector = (uintptr_t)0;
+
+    switch( obj->cnt )
+    {
+        case CNT_8:
+            vector = (uintptr_t)&timer8_cc_irq;
+            break;
+
+        default:
+            vector = counterin_get_vector( obj );
+            break;
+    }
+
+    return vector;
+}
+
+static IRQn_Type counterin_get_irq_n( counterin_t* obj )
+{
+    IRQn_Type irq_n = (IRQn_Type)0;
+
+    switch( obj->cnt )
+    {
+        case CNT_2:
+            irq_n = TIM2_IRQn;
+            break;
+
+        case CNT_3:
+            irq_n = TIM3_IRQn;
+            break;
+
+        case CNT_8:
+            irq_n = TIM8_UP_TIM13_IRQn;
+            break;
+
+        default:
+            break;
+    }
+
+   return irq_n;
+}
+
+static IRQn_Type counterin_get_cc_irq_n( counterin_t* obj )
+{
+    IRQn_Type irq_n = (IRQn_Type)0;
+
+    switch( obj->cnt )
+    {
+        case CNT_8:
+            irq_n = TIM8_CC_IRQn;
+            break;
+
+        default:
+            irq_n = counterin_get_irq_n( obj );
+            break;
+    }
+
+    return irq_n;
+}
+
+static uint32_t counterin_get_clock( counterin_t* obj )
+{
+    RCC_ClkInitTypeDef RCC_ClkInitStruct;
+    uint32_t PclkFreq;
+    uint32_t APBxCLKDivider;
+
+    // Get clock configuration
+    // Note: PclkFreq contains here the Latency (not used after)
+    HAL_RCC_GetClockConfig(&RCC_ClkInitStruct, &PclkFreq);
+
+    // Get the PCLK and APBCLK divider related to the timer
+    switch (obj->cnt) {
+
+        // APB1 clock
+        case CNT_2:
+        case CNT_3:
+            PclkFreq = HAL_RCC_GetPCLK1Freq();
+            APBxCLKDivider = RCC_ClkInitStruct.APB1CLKDivider;
+            break;
+
+        // APB2 clock
+        case CNT_8:
+            PclkFreq = HAL_RCC_GetPCLK2Freq();
+            APBxCLKDivider = RCC_ClkInitStruct.APB2CLKDivider;
+            break;
+
+        default:
+            return 0;
+    }
+
+    // TIMxCLK = PCLKx when the APB prescaler = 1 else TIMxCLK = 2 * PCLKx
+    if (APBxCLKDivider == RCC_HCLK_DIV1)
+        return PclkFreq;
+    else
+        return PclkFreq * 2;
+}
+
+/* Pin, clocks, time base and the overflow interrupt, everything but the
+ * clock source of the timer, which is claimed for owner */
+static void counterin_timer_init(counterin_t* obj, PinName pin, const PinMap* map, const char* owner)
 {
-    TIM_SlaveConfigTypeDef sSlaveConfig;
     TIM_MasterConfigTypeDef sMasterConfig;
+    TIM_OC_InitTypeDef sConfigOC;
 
-    obj->cnt = (CNTName)pinmap_peripheral(pin, PinMap_CNT);
+    obj->cnt = (CNTName)pinmap_peripheral(pin, map);
     MBED_ASSERT(obj->cnt != (CNTName)NC);
 
-    uint32_t function = pinmap_function(pin, PinMap_CNT);
+    uint32_t function = pinmap_function(pin, map);
     MBED_ASSERT(function != (uint32_t)NC);
     obj->channel = STM_PIN_CHANNEL(function);
     obj->inverted = STM_PIN_INVERTED(function);
+    obj->prescaler = 1;
+    obj->high.Instance = NULL;
+    timer_claim(&obj->handle, (TIM_TypeDef *)(obj->cnt), owner);
 
 #if defined(TIM2_BASE)
     if (obj->cnt == CNT_2) __HAL_RCC_TIM2_CLK_ENABLE();
@@ -35,21 +293,113 @@ void counterin_init(counterin_t* obj, PinName pin)
 #endif
 
     // Configure GPIO
-    pinmap_pinout(pin, PinMap_CNT);
+    pinmap_pinout(pin, map);
     obj->pin = pin;
 
     // Configure Timer
-    TimHandle.Instance = (TIM_TypeDef *)(obj->cnt);
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    TimHandle->Instance = (TIM_TypeDef *)(obj->cnt);
 
-    TimHandle.Init.Prescaler = 0;
-    TimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
-    TimHandle.Init.Period = 0xFFFF;
-    TimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
-    if (HAL_TIM_Base_Init(&TimHandle) != HAL_OK)
+    TimHandle->Init.Prescaler = 0;
+    TimHandle->Init.CounterMode = TIM_COUNTERMODE_UP;
+    // Use the whole counter, fewer wraps for the update IRQ to carry
+    TimHandle->Init.Period = IS_TIM_32B_COUNTER_INSTANCE(TimHandle->Instance) ? 0xFFFFFFFF : 0xFFFF;
+    TimHandle->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    if (HAL_TIM_Base_Init(TimHandle) != HAL_OK)
     {
         error("Cannot initialize Time Base\n");
     }
 
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(TimHandle, &sMasterConfig) != HAL_OK)
+    {
+        error("Cannot initialize Counter Master\n");
+    }
+
+  /* Configure Channel 3 OC, the nearest alarm */
+    sConfigOC.OCMode = TIM_OCMODE_TIMING;
+    sConfigOC.Pulse = 0;
+    sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
+    sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+    sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+    sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
+    sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+    if (HAL_TIM_OC_ConfigChannel(TimHandle, &sConfigOC, TIM_CHANNEL_3) != HAL_OK)
+    {
+        error("Failed to initialize Output Compare\n");
+    }
+    obj->alarms = NULL;
+    obj->alarm_busy = 0;
+
+  /* Extend the count in software on every wrap */
+    obj->overflow[0] = 0;
+    obj->overflow[1] = 0;
+    obj->seq = 0;
+    uint8_t irq_index = counterin_get_irq_index( obj );
+    counterin_objs[irq_index] = obj;
+
+    __HAL_TIM_CLEAR_IT(TimHandle, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE_IT(TimHandle, TIM_IT_UPDATE);
+
+    IRQn_Type irq_n = counterin_get_irq_n( obj );
+    uintptr_t vector = counterin_get_vector( obj );
+    NVIC_SetVector(irq_n, vector);
+    NVIC_EnableIRQ(irq_n);
+
+  /* Compare events for the alarms, a separate vector on TIM8 */
+    irq_n = counterin_get_cc_irq_n( obj );
+    NVIC_SetVector(irq_n, counterin_get_cc_vector( obj ));
+    NVIC_EnableIRQ(irq_n);
+}
+
+void counterin_init(counterin_t* obj, PinName pin)
+{
+    const counterin_config_t config = COUNTERIN_CONFIG_DEFAULT;
+
+    counterin_init_config(obj, pin, &config);
+}
+
+void counterin_init_config(counterin_t* obj, PinName pin, const counterin_config_t* config)
+{
+    static const uint32_t etr_prescalers[4] = {
+        TIM_CLOCKPRESCALER_DIV1, TIM_CLOCKPRESCALER_DIV2, TIM_CLOCKPRESCALER_DIV4, TIM_CLOCKPRESCALER_DIV8
+    };
+    TIM_SlaveConfigTypeDef sSlaveConfig;
+    TIM_ClockConfigTypeDef sClockConfig;
+    CNTEdge edge = config->edge;
+
+    MBED_ASSERT(config->filter <= 15);
+
+    counterin_timer_init(obj, pin, (config->clock == CNT_CLOCK_ETR) ? PinMap_CNT_ETR : PinMap_CNT, "a counter");
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+
+    if (edge == CNT_EDGE_PIN)
+    {
+        edge = obj->inverted ? CNT_EDGE_FALLING : CNT_EDGE_RISING;
+    }
+
+    if (config->clock == CNT_CLOCK_ETR)
+    {
+      /* External clock mode 2: ETR, its prescaler, then the filter */
+        if (edge == CNT_EDGE_BOTH)
+        {
+            error("ETR counts on one edge only\n");
+        }
+        sClockConfig.ClockSource = TIM_CLOCKSOURCE_ETRMODE2;
+        sClockConfig.ClockPolarity = (edge == CNT_EDGE_FALLING) ? TIM_CLOCKPOLARITY_INVERTED : TIM_CLOCKPOLARITY_NONINVERTED;
+        sClockConfig.ClockPrescaler = etr_prescalers[config->prescaler];
+        sClockConfig.ClockFilter = config->filter;
+        if (HAL_TIM_ConfigClockSource(TimHandle, &sClockConfig) != HAL_OK)
+        {
+            error("Cannot initialize Counter Clock\n");
+        }
+        obj->prescaler = 1 << config->prescaler;
+        return;
+    }
+
+  /* External clock mode 1: the channel's filtered input as trigger */
+    MBED_ASSERT(config->prescaler == CNT_ETR_DIV1);
     sSlaveConfig.SlaveMode = TIM_SLAVEMODE_EXTERNAL1;
     if(obj->channel == 1)
     {
@@ -60,56 +410,562 @@ void counterin_init(counterin_t* obj, PinName pin)
         sSlaveConfig.InputTrigger = TIM_TS_TI2FP2; 
     }
 
-    if(obj->inverted == 0)
+    if(edge == CNT_EDGE_RISING)
     {
         sSlaveConfig.TriggerPolarity = TIM_TRIGGERPOLARITY_RISING;
     }
-    else
+    else if(edge == CNT_EDGE_FALLING)
     {
         sSlaveConfig.TriggerPolarity = TIM_TRIGGERPOLARITY_FALLING;
     }
+    else
+    {
+        sSlaveConfig.TriggerPolarity = TIM_TRIGGERPOLARITY_BOTHEDGE;
+    }
 
-    sSlaveConfig.TriggerFilter = 15;
-    if (HAL_TIM_SlaveConfigSynchronization(&TimHandle, &sSlaveConfig) != HAL_OK)
+    sSlaveConfig.TriggerPrescaler = TIM_TRIGGERPRESCALER_DIV1;
+    sSlaveConfig.TriggerFilter = config->filter;
+    if (HAL_TIM_SlaveConfigSynchronization(TimHandle, &sSlaveConfig) != HAL_OK)
     {
         error("Cannot initialize Counter Slave\n");
     }
-    
+}
 
-    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+/* ITR of the high timer that carries the counter's TRGO, from the "TIMx
+ * internal trigger connection" tables of RM0090 */
+static uint32_t counterin_cascade_itr( counterin_t* obj, CNTCascade high )
+{
+    switch (high) {
+        case CNT_CASCADE_1:
+            if (obj->cnt == CNT_3) return TIM_TS_ITR2;
+            break;
+
+        case CNT_CASCADE_4:
+            if (obj->cnt == CNT_3) return TIM_TS_ITR2;
+            if (obj->cnt == CNT_8) return TIM_TS_ITR3;
+            break;
+
+        default:
+            break;
+    }
+    return TIM_TS_NONE;
+}
+
+void counterin_init_cascade(counterin_t* obj, PinName pin, CNTCascade high, const counterin_config_t* config)
+{
+    TIM_SlaveConfigTypeDef sSlaveConfig;
+    TIM_MasterConfigTypeDef sMasterConfig;
+    IRQn_Type irq_n;
+    uintptr_t vector;
+
+    if (config)
+        counterin_init_config(obj, pin, config);
+    else
+        counterin_init(obj, pin);
+
+    uint32_t itr = counterin_cascade_itr(obj, high);
+    if (itr == TIM_TS_NONE)
+    {
+        error("Counter cannot be cascaded into this timer\n");
+    }
+
+    timer_claim(&obj->high, (TIM_TypeDef *)(high), "the high half of a cascaded counter");
+
+#if defined(TIM1_BASE)
+    if (high == CNT_CASCADE_1) __HAL_RCC_TIM1_CLK_ENABLE();
+#endif
+#if defined(TIM4_BASE)
+    if (high == CNT_CASCADE_4) __HAL_RCC_TIM4_CLK_ENABLE();
+#endif
+
+  /* The low half sends its wraps out and no longer interrupts */
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_UPDATE);
+
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_UPDATE;
     sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
-    if (HAL_TIMEx_MasterConfigSynchronization(&TimHandle, &sMasterConfig) != HAL_OK)
+    if (HAL_TIMEx_MasterConfigSynchronization(TimHandle, &sMasterConfig) != HAL_OK)
     {
         error("Cannot initialize Counter Master\n");
     }
+
+  /* The high half counts them */
+    TIM_HandleTypeDef *HighHandle = &obj->high;
+    HighHandle->Instance = (TIM_TypeDef *)(high);
+    HighHandle->Init.Prescaler = 0;
+    HighHandle->Init.CounterMode = TIM_COUNTERMODE_UP;
+    HighHandle->Init.Period = 0xFFFF;
+    HighHandle->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+    HighHandle->Init.RepetitionCounter = 0;
+    if (HAL_TIM_Base_Init(HighHandle) != HAL_OK)
+    {
+        error("Cannot initialize Cascade Time Base\n");
+    }
+
+    sSlaveConfig.SlaveMode = TIM_SLAVEMODE_EXTERNAL1;
+    sSlaveConfig.InputTrigger = itr;
+    sSlaveConfig.TriggerPolarity = TIM_TRIGGERPOLARITY_RISING;
+    sSlaveConfig.TriggerPrescaler = TIM_TRIGGERPRESCALER_DIV1;
+    sSlaveConfig.TriggerFilter = 0;
+    if (HAL_TIM_SlaveConfigSynchronization(HighHandle, &sSlaveConfig) != HAL_OK)
+    {
+        error("Cannot initialize Cascade Slave\n");
+    }
+
+  /* Extend the count in software on every wrap of the high half */
+    if (high == CNT_CASCADE_1) {
+        counterin_objs[1] = obj;
+        irq_n = TIM1_UP_TIM10_IRQn;
+        vector = (uintptr_t)&timer1_irq;
+    } else {
+        counterin_objs[4] = obj;
+        irq_n = TIM4_IRQn;
+        vector = (uintptr_t)&timer4_irq;
+    }
+
+    __HAL_TIM_CLEAR_IT(HighHandle, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE_IT(HighHandle, TIM_IT_UPDATE);
+
+    NVIC_SetVector(irq_n, vector);
+    NVIC_EnableIRQ(irq_n);
 }
 
 void counterin_start( counterin_t* obj )
 {
-    TimHandle.Instance = (TIM_TypeDef *)(obj->cnt);
-
-    __HAL_TIM_ENABLE(&TimHandle);
+    if (obj->high.Instance)
+        __HAL_TIM_ENABLE(&obj->high);
+    __HAL_TIM_ENABLE(&obj->handle);
 }
 
 void counterin_reset( counterin_t* obj )
 {
-    TimHandle.Instance = (TIM_TypeDef *)(obj->cnt);
-
-    __HAL_TIM_SET_COUNTER(&TimHandle, 0x0000);
+    __HAL_TIM_SET_COUNTER(&obj->handle, 0x0000);
+    if (obj->high.Instance)
+        __HAL_TIM_SET_COUNTER(&obj->high, 0x0000);
+    __HAL_TIM_CLEAR_IT(counterin_carry(obj), TIM_IT_UPDATE);
+    uint32_t seq = obj->seq;
+    obj->overflow[counterin_slot(seq + 2)] = 0;
+    obj->seq = seq + 2;
+    // Alarms are counts, so they are that much further away again
+    counterin_alarm_service(obj);
 }
 
 void counterin_stop(counterin_t* obj)
 {
-    TimHandle.Instance = (TIM_TypeDef *)(obj->cnt);
-
-    __HAL_TIM_DISABLE(&TimHandle); 
+    __HAL_TIM_DISABLE(&obj->handle);
+    if (obj->high.Instance)
+        __HAL_TIM_DISABLE(&obj->high);
 }
 
 uint32_t counterin_read(counterin_t* obj)
 {
-    TimHandle.Instance = (TIM_TypeDef *)(obj->cnt);
+    uint32_t high, low;
+
+    if (obj->high.Instance == NULL)
+        return (uint32_t) __HAL_TIM_GET_COUNTER(&obj->handle);
+
+    // The high half before and after the low one, so both are from between
+    // the same two carries. A low half that has just wrapped may still have
+    // its carry on the way, give it time to land before the second look.
+    do {
+        high = __HAL_TIM_GET_COUNTER(&obj->high);
+        low = __HAL_TIM_GET_COUNTER(&obj->handle);
+        for (int settle = 0; low < CASCADE_SETTLE && settle < CASCADE_SETTLE; settle++) {
+            (void)__HAL_TIM_GET_COUNTER(&obj->handle);
+        }
+    } while (__HAL_TIM_GET_COUNTER(&obj->high) != high);
+
+    return (high << 16) | low;
+}
+
+uint64_t counterin_read64(counterin_t* obj)
+{
+    TIM_HandleTypeDef *TimHandle = counterin_carry(obj);
+    uint64_t overflow;
+    uint32_t count;
+    uint32_t seq;
+
+    // Seqlock against the update ISR: if it ran while we were in here,
+    // go round again. If we are interrupting it, it stays put until we
+    // are done, and seq says which of its steps it is at.
+    do {
+        seq = obj->seq;
+        overflow = obj->overflow[counterin_slot(seq)];
+        count = counterin_read(obj);
+
+        // The counter may have wrapped after the ISR last ran, or between
+        // the two reads above. Either way the flag is still up, and once it
+        // is seen a fresh CNT is guaranteed to be past the wrap. With an
+        // odd seq the ISR has already counted the wrap behind the flag.
+        if (!(seq & 1) && __HAL_TIM_GET_FLAG(TimHandle, TIM_FLAG_UPDATE) != RESET)
+        {
+            count = counterin_read(obj);
+            overflow += counterin_range(obj);
+        }
+    } while (seq != obj->seq);
+
+    return overflow + count;
+}
+
+/* Put an alarm into the list, after any others at the same count */
+static void counterin_link_alarm( counterin_t* obj, counterin_alarm_t* alarm )
+{
+    counterin_alarm_t **link = &obj->alarms;
+
+    while (*link && (*link)->count <= alarm->count)
+        link = &(*link)->next;
+    alarm->next = *link;
+    *link = alarm;
+}
+
+/* Take an alarm out of the list, returning 0 if it wasn't in it */
+static int counterin_unlink_alarm( counterin_t* obj, counterin_alarm_t* alarm )
+{
+    for (counterin_alarm_t **link = &obj->alarms; *link; link = &(*link)->next) {
+        if (*link == alarm) {
+            *link = alarm->next;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Call every alarm the count has reached, lowest first, then point CC3 at
+ * the next one if it is within the timer's current wrap. The update
+ * interrupt calls this again after each wrap. The list head is looked at
+ * afresh after each call, so a handler is free to insert or remove alarms;
+ * from inside a handler those only change the list and leave the rest to
+ * the loop here. */
+static void counterin_alarm_service( counterin_t* obj )
+{
+    TIM_HandleTypeDef* TimHandle = &obj->handle;
+
+    if (obj->alarm_busy)
+        return;
+
+    for (;;) {
+        counterin_alarm_t *alarm = obj->alarms;
+
+        if (alarm == NULL) {
+            __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_CC3);
+            return;
+        }
+
+        uint64_t count = counterin_read64(obj);
+        uint64_t range = counterin_range(obj);
+        uint64_t base = count & ~(range - 1);     // range is a power of two
+
+        if (count < alarm->count) {
+            if (alarm->count - base >= range) {
+                __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_CC3);
+                return;
+            }
+            // Write CCR before clearing the flag, so a match on the old
+            // value cannot slip in after the clear. A match on the new
+            // value that has already been passed is caught by the count
+            // check below.
+            __HAL_TIM_SET_COMPARE(TimHandle, TIM_CHANNEL_3, (uint32_t)(alarm->count - base));
+            __HAL_TIM_CLEAR_IT(TimHandle, TIM_IT_CC3);
+            __HAL_TIM_ENABLE_IT(TimHandle, TIM_IT_CC3);
+            if (counterin_read64(obj) < alarm->count)
+                return;
+        }
+
+      /* Reached: next period on, or out of the list */
+        counterin_unlink_alarm(obj, alarm);
+        if (alarm->period) {
+            alarm->count += alarm->period;
+            // More than a period behind, e.g. first set in the past or
+            // held off for long: skip the calls missed rather than storm
+            // through them, keeping to the same multiples of the period
+            if (alarm->count <= count)
+                alarm->count += ((count - alarm->count) / alarm->period + 1) * alarm->period;
+            counterin_link_alarm(obj, alarm);
+        }
+        obj->alarm_busy = 1;
+        alarm->handler(alarm->id);
+        obj->alarm_busy = 0;
+    }
+}
+
+void counterin_insert_alarm(counterin_t* obj, counterin_alarm_t* alarm, uint64_t count, uint32_t period, cnt_irq_handler handler, uintptr_t id)
+{
+    if (obj->high.Instance)
+    {
+        error("Counter alarms are not available on a cascaded counter\n");
+    }
+
+    counterin_unlink_alarm(obj, alarm);
+    alarm->count = count;
+    alarm->period = period;
+    alarm->handler = handler;
+    alarm->id = id;
+    counterin_link_alarm(obj, alarm);
+    counterin_alarm_service(obj);
+}
+
+void counterin_remove_alarm(counterin_t* obj, counterin_alarm_t* alarm)
+{
+    if (counterin_unlink_alarm(obj, alarm))
+        counterin_alarm_service(obj);
+}
+
+#if DEVICE_CAPTUREIN
+
+/******************************************************************************/
+/*                          Edge timestamps                                   */
+/******************************************************************************/
+static capturein_t *capturein_objs[CHANNEL_NUMBER];
+
+/* DMA requests of the capture channels in PinMap_CNT (TIM2_CH1, TIM3_CH1
+ * and TIM8_CH2), from the request mapping tables of RM0090 */
+static DMA_Stream_TypeDef* capturein_get_dma_stream( capturein_t* obj )
+{
+    DMA_Stream_TypeDef* stream = NULL;
+
+    switch( obj->counter.cnt )
+    {
+        case CNT_2:
+            stream = DMA1_Stream5;
+            break;
+
+        case CNT_3:
+            stream = DMA1_Stream4;
+            break;
+
+        case CNT_8:
+            stream = DMA2_Stream3;
+            break;
+
+        default:
+            break;
+    }
+
+    return stream;
+}
+
+static uint32_t capturein_get_dma_channel( capturein_t* obj )
+{
+    uint32_t channel = 0;
+
+    switch( obj->counter.cnt )
+    {
+        case CNT_2:
+            channel = DMA_CHANNEL_3;
+            break;
+
+        case CNT_3:
+            channel = DMA_CHANNEL_5;
+            break;
+
+        case CNT_8:
+            channel = DMA_CHANNEL_7;
+            break;
+
+        default:
+            break;
+    }
+
+    return channel;
+}
+
+static IRQn_Type capturein_get_irq_n( capturein_t* obj )
+{
+    IRQn_Type irq_n = (IRQn_Type)0;
+
+    switch( obj->counter.cnt )
+    {
+        case CNT_2:
+            irq_n = DMA1_Stream5_IRQn;
+            break;
+
+        case CNT_3:
+            irq_n = DMA1_Stream4_IRQn;
+            break;
+
+        case CNT_8:
+            irq_n = DMA2_Stream3_IRQn;
+            break;
+
+        default:
+            break;
+    }
+
+    return irq_n;
+}
+
+static void capturein_half_complete( DMA_HandleTypeDef* hdma )
+{
+    capturein_t* obj = (capturein_t*)((char*)hdma - offsetof(capturein_t, dma));
+
+    if (obj->handler)
+        obj->handler(obj->id, CAP_HALF);
+}
+
+static void capturein_complete( DMA_HandleTypeDef* hdma )
+{
+    capturein_t* obj = (capturein_t*)((char*)hdma - offsetof(capturein_t, dma));
+
+    if (obj->handler)
+        obj->handler(obj->id, CAP_FULL);
+}
+
+static void dma1_stream5_irq( void )
+{
+    HAL_DMA_IRQHandler( &capturein_objs[2]->dma );
+}
+
+static void dma1_stream4_irq( void )
+{
+    HAL_DMA_IRQHandler( &capturein_objs[3]->dma );
+}
 
-    return (uint32_t) __HAL_TIM_GET_COUNTER(&TimHandle);
+static void dma2_stream3_irq( void )
+{
+    HAL_DMA_IRQHandler( &capturein_objs[8]->dma );
 }
 
+static uintptr_t capturein_get_vector( capturein_t* obj )
+{
+    uintptr_t vector = (uintptr_t)0;
+
+    switch( obj->counter.cnt )
+    {
+        case CNT_2:
+            vector = (uintptr_t)&dma1_stream5_irq;
+            break;
+
+        case CNT_3:
+            vector = (uintptr_t)&dma1_stream4_irq;
+            break;
+
+        case CNT_8:
+            vector = (uintptr_t)&dma2_stream3_irq;
+            break;
+
+        default:
+            break;
+    }
+
+    return vector;
+}
+
+void capturein_init(capturein_t* obj, PinName pin, uint32_t* buffer, uint32_t length)
+{
+    TIM_IC_InitTypeDef sConfig;
+    counterin_t* counter = &obj->counter;
+
+    MBED_ASSERT(length >= 2 && length <= 0xFFFF);
+
+    // Free running on the internal clock, no slave mode
+    counterin_timer_init(counter, pin, PinMap_CNT, "a capture input");
+    TIM_HandleTypeDef *TimHandle = &counter->handle;
+
+    obj->buffer = buffer;
+    obj->length = length;
+    obj->handler = NULL;
+    obj->id = 0;
+    obj->clock = counterin_get_clock(counter);
+    if (obj->clock == 0)
+        error("CAP: unknown timer clock\n");
+
+    // A light filter (8 samples at fCK_INT, under 100ns) keeps the
+    // timestamps tight and still allows edges at several MHz
+    sConfig.ICPolarity = counter->inverted ? TIM_ICPOLARITY_FALLING : TIM_ICPOLARITY_RISING;
+    sConfig.ICSelection = TIM_ICSELECTION_DIRECTTI;
+    sConfig.ICPrescaler = TIM_ICPSC_DIV1;
+    sConfig.ICFilter = 3;
+    if (HAL_TIM_IC_ConfigChannel(TimHandle, &sConfig, (counter->channel - 1) * 4) != HAL_OK)
+    {
+        error("Cannot initialize Capture Channel\n");
+    }
+
+  /* One CCRx word per edge, round the buffer forever */
+    if (counter->cnt == CNT_8)
+        __HAL_RCC_DMA2_CLK_ENABLE();
+    else
+        __HAL_RCC_DMA1_CLK_ENABLE();
+
+    // Nothing frees a capture, so its stream stays taken from here on
+    DMA_HandleTypeDef *hdma = &obj->dma;
+    dma_stream_claim(hdma, capturein_get_dma_stream(obj), "a capture input");
+    hdma->Instance = capturein_get_dma_stream(obj);
+    hdma->Init.Channel = capturein_get_dma_channel(obj);
+    hdma->Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma->Init.MemInc = DMA_MINC_ENABLE;
+    hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    hdma->Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    hdma->Init.Mode = DMA_CIRCULAR;
+    hdma->Init.Priority = DMA_PRIORITY_HIGH;
+    hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    hdma->Init.FIFOThreshold = 0;
+    hdma->Init.MemBurst = 0;
+    hdma->Init.PeriphBurst = 0;
+    if (HAL_DMA_Init(hdma) != HAL_OK)
+    {
+        error("Cannot initialize Capture DMA\n");
+    }
+    __HAL_LINKDMA(TimHandle, hdma[TIM_DMA_ID_CC1 + counter->channel - 1], obj->dma);
+    hdma->XferHalfCpltCallback = capturein_half_complete;
+    hdma->XferCpltCallback = capturein_complete;
+    hdma->XferErrorCallback = NULL;
+
+    uint8_t irq_index = counterin_get_irq_index( counter );
+    capturein_objs[irq_index] = obj;
+
+    IRQn_Type irq_n = capturein_get_irq_n( obj );
+    uintptr_t vector = capturein_get_vector( obj );
+    NVIC_SetVector(irq_n, vector);
+    NVIC_EnableIRQ(irq_n);
+}
+
+void capturein_set_irq(capturein_t* obj, cap_irq_handler handler, uintptr_t id)
+{
+    obj->handler = handler;
+    obj->id = id;
+}
+
+void capturein_start(capturein_t* obj)
+{
+    counterin_t* counter = &obj->counter;
+    TIM_HandleTypeDef *TimHandle = &counter->handle;
+    uint32_t ccr = (uint32_t)(uintptr_t)(&TimHandle->Instance->CCR1 + (counter->channel - 1));
+
+    // Drop a capture left over from before, it would be the first timestamp
+    __HAL_TIM_CLEAR_FLAG(TimHandle, TIM_FLAG_CC1 << (counter->channel - 1));
+
+    if (HAL_DMA_Start_IT(&obj->dma, ccr, (uint32_t)(uintptr_t)obj->buffer, obj->length) != HAL_OK)
+    {
+        error("Cannot start Capture DMA\n");
+    }
+    __HAL_TIM_ENABLE_DMA(TimHandle, TIM_DMA_CC1 << (counter->channel - 1));
+    HAL_TIM_IC_Start(TimHandle, (counter->channel - 1) * 4);
+}
+
+void capturein_stop(capturein_t* obj)
+{
+    counterin_t* counter = &obj->counter;
+    TIM_HandleTypeDef *TimHandle = &counter->handle;
+
+    __HAL_TIM_DISABLE_DMA(TimHandle, TIM_DMA_CC1 << (counter->channel - 1));
+    HAL_TIM_IC_Stop(TimHandle, (counter->channel - 1) * 4);
+    HAL_DMA_Abort(&obj->dma);
+}
+
+uint32_t capturein_index(capturein_t* obj)
+{
+    uint32_t remaining = __HAL_DMA_GET_COUNTER(&obj->dma);
+
+    // NDTR reads back the full length again as soon as it wraps
+    return (obj->length - remaining) % obj->length;
+}
+
+uint64_t capturein_read64(capturein_t* obj)
+{
+    return counterin_read64(&obj->counter);
+}
+
+#endif //DEVICE_CAPTUREIN
+
 #endif //DEVICE_COUNTERIN
@@ -0,0 +1,182 @@
+#include "countlatch_api.h"
+
+#if DEVICE_COUNTLATCH
+
+#include "cmsis.h"
+#include "pinmap.h"
+#include "mbed_error.h"
+
+/* Polls of a slave's CC1IF before its capture is taken as done. The ITR
+ * resynchronisation only takes a couple of timer clocks, so this is
+ * generous. */
+#define LATCH_SPIN          16
+
+/* Where each encoder timer's ITR0-3 come from, the "TIMx internal trigger
+ * connection" tables of RM0090 */
+typedef struct {
+    uint32_t slave;
+    uint32_t itr[4];
+} latch_itr_t;
+
+static const latch_itr_t latch_itrs[] = {
+    {TIM1_BASE, {TIM5_BASE, TIM2_BASE, TIM3_BASE, TIM4_BASE}},
+    {TIM2_BASE, {TIM1_BASE, TIM8_BASE, TIM3_BASE, TIM4_BASE}},
+    {TIM3_BASE, {TIM1_BASE, TIM2_BASE, TIM5_BASE, TIM4_BASE}},
+    {TIM4_BASE, {TIM1_BASE, TIM2_BASE, TIM3_BASE, TIM8_BASE}},
+    {TIM5_BASE, {TIM2_BASE, TIM3_BASE, TIM4_BASE, TIM8_BASE}}
+};
+
+static const uint32_t latch_ts[4] = {TIM_TS_ITR0, TIM_TS_ITR1, TIM_TS_ITR2, TIM_TS_ITR3};
+
+/* TIM_TS_ITRx for the slave to follow the master, TIM_TS_NONE if no link */
+static uint32_t countlatch_get_itr( TIM_TypeDef* slave, TIM_TypeDef* master )
+{
+    for (uint32_t i = 0; i < sizeof(latch_itrs) / sizeof(latch_itrs[0]); i++) {
+        if (latch_itrs[i].slave != (uint32_t)(uintptr_t)slave) {
+            continue;
+        }
+        for (uint32_t itr = 0; itr < 4; itr++) {
+            if (latch_itrs[i].itr[itr] == (uint32_t)(uintptr_t)master) {
+                return latch_ts[itr];
+            }
+        }
+    }
+    return TIM_TS_NONE;
+}
+
+/* CC1 as a capture on IC1 mapped to 'selection', every edge. CC1S can only
+ * be written with the channel off. The polarity and filter are left as the
+ * owning driver set them, they are shared with the input it counts. */
+static void countlatch_capture( TIM_TypeDef* tim, uint32_t selection )
+{
+    tim->CCER &= ~TIM_CCER_CC1E;
+    tim->CCMR1 = (tim->CCMR1 & ~(TIM_CCMR1_CC1S | TIM_CCMR1_IC1PSC)) | selection;
+    tim->SR = ~(TIM_SR_CC1IF | TIM_SR_CC1OF);
+    tim->CCER |= TIM_CCER_CC1E;
+}
+
+/* Every CC1 event, software, pin or TRC, pulses TRGO for the slaves */
+static void countlatch_master( countlatch_t* obj, TIM_HandleTypeDef* handle, uint8_t channel )
+{
+    TIM_TypeDef *tim = handle->Instance;
+
+    if (obj->pin != NC) {
+        uint32_t function = pinmap_function(obj->pin, PinMap_LATCH);
+        if ((TIM_TypeDef *)(uintptr_t)pinmap_peripheral(obj->pin, PinMap_LATCH) != tim ||
+            (channel == 0) != (STM_PIN_CHANNEL(function) == 0) ||
+            (channel != 0 && STM_PIN_CHANNEL(function) == channel))
+        {
+            error("Latch trigger pin is not free on the first member's timer\n");
+        }
+        pinmap_pinout(obj->pin, PinMap_LATCH);
+    }
+
+    if (channel == 0) {
+      /* Encoder: the trigger pin on ETR, through TRC into CC1. Without a
+       * pin ETR stays low and only software latches. */
+        tim->SMCR = (tim->SMCR & ~(TIM_SMCR_TS | TIM_SMCR_ETF | TIM_SMCR_ETPS | TIM_SMCR_ETP | TIM_SMCR_ECE)) | TIM_TS_ETRF;
+        countlatch_capture(tim, TIM_ICSELECTION_TRC);
+    } else {
+      /* Counter: CC1 from the pin of the other channel */
+        countlatch_capture(tim, (channel == 1) ? TIM_ICSELECTION_INDIRECTTI : TIM_ICSELECTION_DIRECTTI);
+    }
+
+    tim->CR2 = (tim->CR2 & ~TIM_CR2_MMS) | TIM_TRGO_OC1;
+}
+
+void countlatch_init(countlatch_t* obj, PinName trigger)
+{
+    obj->pin = trigger;
+    obj->members = 0;
+
+    if (trigger != NC) {
+        MBED_ASSERT(pinmap_peripheral(trigger, PinMap_LATCH) != (uint32_t)NC);
+    }
+}
+
+int countlatch_add_encoder(countlatch_t* obj, TIM_HandleTypeDef* handle)
+{
+    if (obj->members == LATCH_MEMBERS) {
+        return -1;
+    }
+    if (__HAL_TIM_GET_IT_SOURCE(handle, TIM_IT_CC1) != RESET) {
+        error("The encoder's CC1 is taken by its index\n");
+    }
+    if ((handle->Instance->CR2 & TIM_CR2_MMS) == TIM_TRGO_OC1) {
+        error("The encoder's CC1 is taken by a velocity meter or a count latch\n");
+    }
+
+    if (obj->members == 0) {
+        countlatch_master(obj, handle, 0);
+    } else {
+        TIM_TypeDef *tim = handle->Instance;
+        uint32_t itr = countlatch_get_itr(tim, obj->member[0]->Instance);
+
+        if (itr == TIM_TS_NONE) {
+            error("No internal trigger from the first member to this encoder\n");
+        }
+        // The encoder mode does not use TRGI, so it is free to carry the latch
+        tim->SMCR = (tim->SMCR & ~TIM_SMCR_TS) | itr;
+        countlatch_capture(tim, TIM_ICSELECTION_TRC);
+    }
+
+    obj->member[obj->members] = handle;
+    return obj->members++;
+}
+
+int countlatch_add_counter(countlatch_t* obj, TIM_HandleTypeDef* handle, uint8_t channel)
+{
+    if (obj->members == LATCH_MEMBERS) {
+        return -1;
+    }
+    if (obj->members != 0) {
+        error("A counter can only be the first member of a latch\n");
+    }
+    if (channel == 0) {
+        error("A counter clocked from ETR cannot be a latch member\n");
+    }
+
+    countlatch_master(obj, handle, channel);
+
+    obj->member[obj->members] = handle;
+    return obj->members++;
+}
+
+void countlatch_trigger(countlatch_t* obj)
+{
+    if (obj->members) {
+        HAL_TIM_GenerateEvent(obj->member[0], TIM_EVENTSOURCE_CC1);
+    }
+}
+
+int countlatch_read(countlatch_t* obj, uint32_t* counts)
+{
+    TIM_HandleTypeDef *master = obj->member[0];
+
+    if (obj->members == 0) {
+        return 0;
+    }
+
+    // A trigger that lands while the slaves are read leaves the master's
+    // flag set again: read that one instead, so the counts stay coherent
+    do {
+        if (__HAL_TIM_GET_FLAG(master, TIM_FLAG_CC1) == RESET) {
+            return 0;
+        }
+        __HAL_TIM_CLEAR_FLAG(master, TIM_FLAG_CC1 | TIM_FLAG_CC1OF);
+        counts[0] = master->Instance->CCR1;
+
+        for (uint8_t i = 1; i < obj->members; i++) {
+            TIM_HandleTypeDef *slave = obj->member[i];
+
+            for (int spin = 0; spin < LATCH_SPIN && __HAL_TIM_GET_FLAG(slave, TIM_FLAG_CC1) == RESET; spin++) {
+            }
+            __HAL_TIM_CLEAR_FLAG(slave, TIM_FLAG_CC1 | TIM_FLAG_CC1OF);
+            counts[i] = slave->Instance->CCR1;
+        }
+    } while (__HAL_TIM_GET_FLAG(master, TIM_FLAG_CC1) != RESET);
+
+    return 1;
+}
+
+#endif
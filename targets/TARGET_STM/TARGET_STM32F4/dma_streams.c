@@ -0,0 +1,44 @@
+#include "dma_streams.h"
+
+#include <stddef.h>
+#include "mbed_error.h"
+
+#define STREAM_NUMBER 16
+
+/* Who holds each stream, DMA1 0-7 then DMA2 0-7 */
+static DMA_HandleTypeDef *dma_stream_hdma[STREAM_NUMBER];
+static const char *dma_stream_owner[STREAM_NUMBER];
+
+/* Streams are 0x18 apart from 0x10 into their controller */
+static uint8_t dma_stream_get_index( DMA_Stream_TypeDef* stream )
+{
+    uint32_t address = (uint32_t)(uintptr_t)stream;
+
+    if (address >= DMA2_BASE)
+        return 8 + (address - DMA2_BASE - 0x10) / 0x18;
+    return (address - DMA1_BASE - 0x10) / 0x18;
+}
+
+void dma_stream_claim(DMA_HandleTypeDef *hdma, DMA_Stream_TypeDef *stream, const char *owner)
+{
+    uint8_t index = dma_stream_get_index(stream);
+
+    if (dma_stream_hdma[index] && dma_stream_hdma[index] != hdma) {
+        error("DMA%d stream %d is taken by %s\n", 1 + index / 8, index % 8, dma_stream_owner[index]);
+    }
+    dma_stream_hdma[index] = hdma;
+    dma_stream_owner[index] = owner;
+}
+
+void dma_stream_release(DMA_HandleTypeDef *hdma)
+{
+    if (hdma->Instance == NULL)
+        return;
+
+    uint8_t index = dma_stream_get_index(hdma->Instance);
+
+    if (dma_stream_hdma[index] == hdma) {
+        dma_stream_hdma[index] = NULL;
+        dma_stream_owner[index] = NULL;
+    }
+}
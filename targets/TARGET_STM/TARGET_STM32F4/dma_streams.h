@@ -0,0 +1,23 @@
+#ifndef MERE_DMA_STREAMS_H
+#define MERE_DMA_STREAMS_H
+
+#include "cmsis.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The timer DMA requests are hard-wired to streams (the request mapping
+ * tables of RM0090), and several drivers can end up wanting the same one.
+ * A driver claims a stream for its DMA handle before HAL_DMA_Init and
+ * releases it once the transfer is aborted; claiming a stream another
+ * handle holds is an error() naming what holds it. Claiming again with
+ * the same handle is fine, and so is releasing a stream that is not held. */
+void dma_stream_claim(DMA_HandleTypeDef *hdma, DMA_Stream_TypeDef *stream, const char *owner);
+void dma_stream_release(DMA_HandleTypeDef *hdma);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -2,17 +2,23 @@
 
 #if DEVICE_ENCODERIN
 
+#include <stddef.h>
 #include "cmsis.h"
 #include "pinmap.h"
 #include "mbed_error.h"
 #include "PeripheralPins.h"
+#include "dma_streams.h"
+#include "timers.h"
 
-#define CHANNEL_NUMBER      5
+#define CHANNEL_NUMBER      6
 
-static TIM_HandleTypeDef TimHandle;
-static enc_irq_handler irq_handler;
+static encoderin_t *encoderin_objs[CHANNEL_NUMBER];
 
-static uint32_t encoderin_index[CHANNEL_NUMBER];
+static uintptr_t encoderin_get_vector( encoderin_t* obj );
+static IRQn_Type encoderin_get_irq_n( encoderin_t* obj );
+static IRQn_Type encoderin_get_update_irq_n( encoderin_t* obj );
+static uintptr_t encoderin_get_update_vector( encoderin_t* obj );
+static void encoderin_alarm_service( encoderin_t* obj );
 
 static uint8_t encoderin_get_irq_index( encoderin_t* obj )
 {
@@ -23,37 +29,61 @@ static uint8_t encoderin_get_irq_index( encoderin_t* obj )
         case ENC_1:
             irq_index = 1;
             break;
+        case ENC_2:
+            irq_index = 2;
+            break;
         case ENC_3:
             irq_index = 3;
             break;
         case ENC_4:
             irq_index = 4;
             break;
+        case ENC_5:
+            irq_index = 5;
+            break;
     }
 
     return irq_index;
 }
 
-void encoderin_init( encoderin_t* obj, PinName pinA, PinName pinB, enc_irq_handler handler, uint32_t id )
+void encoderin_init( encoderin_t* obj, PinName pinA, PinName pinB )
+{
+    const encoderin_config_t config = ENCODERIN_CONFIG_DEFAULT;
+
+    encoderin_init_config(obj, pinA, pinB, &config);
+}
+
+void encoderin_init_config( encoderin_t* obj, PinName pinA, PinName pinB, const encoderin_config_t* config )
 {
 	TIM_Encoder_InitTypeDef sSlaveConfig;
     TIM_MasterConfigTypeDef sMasterConfig;
 
+    MBED_ASSERT(config->filter <= 15);
+    MBED_ASSERT(config->decoding == ENC_X2 || config->decoding == ENC_X4);
+
 	obj->enc = (ENCName)pinmap_peripheral(pinA, PinMap_ENC_CHA);
     MBED_ASSERT(obj->enc != (ENCName)NC);
 
 	uint32_t function = pinmap_function(pinA, PinMap_ENC_CHA);
     MBED_ASSERT(function != (uint32_t)NC);
+    MBED_ASSERT(pinmap_peripheral(pinB, PinMap_ENC_CHB) == (uint32_t)obj->enc);
+    timer_claim(&obj->handle, (TIM_TypeDef *)(obj->enc), "an encoder");
 
 #if defined(TIM1_BASE)
     if (obj->enc == ENC_1) __HAL_RCC_TIM1_CLK_ENABLE();
 #endif
+#if defined(TIM2_BASE)
+    if (obj->enc == ENC_2) __HAL_RCC_TIM2_CLK_ENABLE();
+#endif
 #if defined(TIM3_BASE)
     if (obj->enc == ENC_3) __HAL_RCC_TIM3_CLK_ENABLE();
 #endif
 #if defined(TIM4_BASE)
     if (obj->enc == ENC_4) __HAL_RCC_TIM4_CLK_ENABLE();
 #endif
+#if defined(TIM5_BASE)
+    if (obj->enc == ENC_5) __HAL_RCC_TIM5_CLK_ENABLE();
+#endif
 
   /* Configure GPIO */
 	pinmap_pinout(pinA, PinMap_ENC_CHA);
@@ -61,23 +91,26 @@ void encoderin_init( encoderin_t* obj, PinName pinA, PinName pinB, enc_irq_handl
 	pinmap_pinout(pinB, PinMap_ENC_CHB);
 	obj->pinB = pinB;
 
-  /* Configure CH1 & CH2 as Encoder Inputs */
-	TimHandle.Instance = (TIM_TypeDef *)(obj->enc);
-	TimHandle.Init.Prescaler = 2;
-	TimHandle.Init.CounterMode = TIM_COUNTERMODE_UP;
-	TimHandle.Init.Period = 0xFFFF;
-	TimHandle.Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
-	TimHandle.Init.RepetitionCounter = 0;
-	sSlaveConfig.EncoderMode = TIM_ENCODERMODE_TI1;
+  /* Configure CH1 & CH2 as Encoder Inputs. The counter takes every edge
+     the mode decodes: a prescaler would count its own input whichever way
+     the encoder moves, so jitter on an edge would walk the position. */
+	TIM_HandleTypeDef *TimHandle = &obj->handle;
+	TimHandle->Instance = (TIM_TypeDef *)(obj->enc);
+	TimHandle->Init.Prescaler = 0;
+	TimHandle->Init.CounterMode = TIM_COUNTERMODE_UP;
+	TimHandle->Init.Period = IS_TIM_32B_COUNTER_INSTANCE(TimHandle->Instance) ? 0xFFFFFFFF : 0xFFFF;
+	TimHandle->Init.ClockDivision = TIM_CLOCKDIVISION_DIV1;
+	TimHandle->Init.RepetitionCounter = 0;
+	sSlaveConfig.EncoderMode = config->decoding;
 	sSlaveConfig.IC1Polarity = TIM_ICPOLARITY_RISING;
 	sSlaveConfig.IC1Selection = TIM_ICSELECTION_DIRECTTI;
-	sSlaveConfig.IC1Prescaler = TIM_ICPSC_DIV2;
-	sSlaveConfig.IC1Filter = 0xF;
+	sSlaveConfig.IC1Prescaler = TIM_ICPSC_DIV1;
+	sSlaveConfig.IC1Filter = config->filter;
 	sSlaveConfig.IC2Polarity = TIM_ICPOLARITY_RISING;
 	sSlaveConfig.IC2Selection = TIM_ICSELECTION_DIRECTTI;
-	sSlaveConfig.IC2Prescaler = TIM_ICPSC_DIV2;
-	sSlaveConfig.IC2Filter = 0xF;
-	if (HAL_TIM_Encoder_Init(&TimHandle, &sSlaveConfig) != HAL_OK)
+	sSlaveConfig.IC2Prescaler = TIM_ICPSC_DIV1;
+	sSlaveConfig.IC2Filter = config->filter;
+	if (HAL_TIM_Encoder_Init(TimHandle, &sSlaveConfig) != HAL_OK)
 	{
 		error("Cannot initialize the Encoder\n");
 	}
@@ -85,129 +118,366 @@ void encoderin_init( encoderin_t* obj, PinName pinA, PinName pinB, enc_irq_handl
   /* Configure Timer Master Mode */
 	sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
 	sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
-	if (HAL_TIMEx_MasterConfigSynchronization(&TimHandle, &sMasterConfig) != HAL_OK)
+	if (HAL_TIMEx_MasterConfigSynchronization(TimHandle, &sMasterConfig) != HAL_OK)
 	{
 		error("Cannot intialize Encoder Master Mode\n");
 	}	
 
     TIM_OC_InitTypeDef sConfigOC;
 
-  /* Configure Channel 3 OC */
-    sConfigOC.OCMode = TIM_OCMODE_ACTIVE;
+  /* Configure Channel 3 OC, the nearest alarm ahead */
+    sConfigOC.OCMode = TIM_OCMODE_TIMING;
     sConfigOC.Pulse = 0;
     sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
     sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
     sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
     sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
     sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
-    if (HAL_TIM_OC_ConfigChannel(&TimHandle, &sConfigOC, TIM_CHANNEL_3) != HAL_OK)
+    if (HAL_TIM_OC_ConfigChannel(TimHandle, &sConfigOC, TIM_CHANNEL_3) != HAL_OK)
     {
         error( "Failed to initialize Output Compare\n" );
     }
 
-  /* Configure Channel 4 OC */
-    if (HAL_TIM_OC_ConfigChannel(&TimHandle, &sConfigOC, TIM_CHANNEL_4) != HAL_OK)
+  /* Configure Channel 4 OC, the nearest alarm behind */
+    if (HAL_TIM_OC_ConfigChannel(TimHandle, &sConfigOC, TIM_CHANNEL_4) != HAL_OK)
     {
         error( "Failed to initialize Output Compare\n" );
     }
 
   /* Save for later */
+    obj->alarms = NULL;
+    obj->alarm_position = 0;
+    obj->alarm_pass = 0;
+    obj->alarm_masked = 0;
+    obj->alarm_busy = 0;
+    obj->outputs = 0;
+
     uint8_t irq_index = encoderin_get_irq_index( obj );
-    encoderin_index[irq_index] = id;
+    encoderin_objs[irq_index] = obj;
+
+  /* Extend the position in software on every wrap */
+    obj->overflow[0] = 0;
+    obj->overflow[1] = 0;
+    obj->seq = 0;
+    obj->index_seq = 0;
+    obj->pinZ = NC;
+    obj->turn = 0;
+    obj->index_home = 0;
+    obj->homed = 0;
+    obj->index_slips = 0;
+    __HAL_TIM_CLEAR_IT(TimHandle, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE_IT(TimHandle, TIM_IT_UPDATE);
 
-    irq_handler = handler;
+  /* Entry stamp of the vectors, if configured */
+    obj->irq_cycles = 0;
+
+    IRQn_Type irq_n = encoderin_get_update_irq_n( obj );
+    NVIC_SetVector(irq_n, encoderin_get_update_vector( obj ));
+    NVIC_EnableIRQ(irq_n);
+
+  /* Compare events for the alarms, a separate vector on TIM1 */
+    irq_n = encoderin_get_irq_n( obj );
+    NVIC_SetVector(irq_n, encoderin_get_vector( obj ));
+    NVIC_EnableIRQ(irq_n);
 }
 
 void encoderin_start( encoderin_t* obj )
 {
-	TimHandle.Instance = (TIM_TypeDef *)(obj->enc);
+    HAL_TIM_Encoder_Start( &obj->handle, TIM_CHANNEL_1 );
+}
 
-    HAL_TIM_Encoder_Start( &TimHandle, TIM_CHANNEL_1 );
+/* The overflow slot readers take at a given seq: an odd seq already points
+ * at the slot the next even one will */
+static inline uint8_t encoderin_slot( uint32_t seq )
+{
+    return ((seq + 1) >> 1) & 1;
 }
 
 void encoderin_reset( encoderin_t* obj )
 {
-	TimHandle.Instance = (TIM_TypeDef *)(obj->enc);
+    __HAL_TIM_SET_COUNTER(&obj->handle, 0x0000);
+    __HAL_TIM_CLEAR_IT(&obj->handle, TIM_IT_UPDATE);
+    uint32_t seq = obj->seq;
+    obj->overflow[encoderin_slot(seq + 2)] = 0;
+    obj->seq = seq + 2;
+    // Home is a read64 position, meaningless from here on
+    obj->index_home = 0;
+    obj->homed = 0;
+    obj->index_seq++;
 
-    __HAL_TIM_SET_COUNTER(&TimHandle, 0x0000);
+    // A jump, not movement, so nothing fires
+    obj->alarm_position = 0;
+    encoderin_alarm_service(obj);
 }
 
 void encoderin_stop( encoderin_t* obj )
 {
-	TimHandle.Instance = (TIM_TypeDef *)(obj->enc);
-
-    __HAL_TIM_DISABLE(&TimHandle);
+    __HAL_TIM_DISABLE(&obj->handle);
 }
 
 uint32_t encoderin_read( encoderin_t* obj )
 {
-	TimHandle.Instance = (TIM_TypeDef *)(obj->enc);
+    return (uint32_t) __HAL_TIM_GET_COUNTER(&obj->handle);
+}
+
+/* An update event is either an overflow (ARR -> 0) or an underflow
+ * (0 -> ARR). The counter cannot have travelled half its range since, so
+ * which half it is in now tells the two apart. */
+static int64_t encoderin_wrap( TIM_HandleTypeDef* htim, uint32_t count )
+{
+    int64_t range = (int64_t)htim->Init.Period + 1;
+
+    return (count < range / 2) ? range : -range;
+}
+
+int64_t encoderin_read64( encoderin_t* obj )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    int64_t overflow;
+    uint32_t count;
+    uint32_t seq;
+
+    // Seqlock against the update ISR: if it ran while we were in here,
+    // go round again. If we are interrupting it, it stays put until we
+    // are done, and seq says which of its steps it is at.
+    do {
+        seq = obj->seq;
+        overflow = obj->overflow[encoderin_slot(seq)];
+        count = __HAL_TIM_GET_COUNTER(TimHandle);
+
+        // A wrap the ISR has not accounted for yet, possibly between the
+        // two reads above. Re-read CNT so it is on the same side of the wrap.
+        // With an odd seq the ISR has already counted the wrap behind the flag.
+        if (!(seq & 1) && __HAL_TIM_GET_FLAG(TimHandle, TIM_FLAG_UPDATE) != RESET)
+        {
+            count = __HAL_TIM_GET_COUNTER(TimHandle);
+            overflow += encoderin_wrap(TimHandle, count);
+        }
+    } while (seq != obj->seq);
+
+    return overflow + count;
+}
+
+void encoderin_index( encoderin_t* obj, PinName pinZ, uint32_t counts_per_turn )
+{
+    TIM_TypeDef *tim = obj->handle.Instance;
+
+    if ((TIM_TypeDef *)(uintptr_t)pinmap_peripheral(pinZ, PinMap_ENC_IDX) != tim) {
+        error("Index pin is not on the encoder's timer\n");
+    }
+    if ((tim->CCMR1 & TIM_CCMR1_CC1S) == TIM_ICSELECTION_TRC) {
+        error("The encoder's CC1 is already latching\n");
+    }
+    if ((tim->CR2 & TIM_CR2_MMS) == TIM_TRGO_OC1) {
+        error("The encoder's CC1 is taken by a velocity meter or a count latch\n");
+    }
+
+  /* Configure GPIO */
+    pinmap_pinout(pinZ, PinMap_ENC_IDX);
+    obj->pinZ = pinZ;
+    obj->turn = counts_per_turn;
+    obj->index_home = 0;
+    obj->homed = 0;
+    obj->index_slips = 0;
+    obj->index_seq++;
+
+  /* Rising edges on ETR, through the same filter as the channels, as TRGI.
+     The encoder mode does not use TRGI. */
+    uint32_t filter = (tim->CCMR1 & TIM_CCMR1_IC1F) >> TIM_CCMR1_IC1F_Pos;
+    tim->SMCR = (tim->SMCR & ~(TIM_SMCR_TS | TIM_SMCR_ETF | TIM_SMCR_ETPS | TIM_SMCR_ETP | TIM_SMCR_ECE)) |
+                TIM_TS_ETRF | (filter << TIM_SMCR_ETF_Pos);
+
+  /* CC1 captures on TRC, the encoder keeps counting TI1FP1. CC1S can only
+     be written with the channel off. */
+    tim->CCER &= ~TIM_CCER_CC1E;
+    tim->CCMR1 = (tim->CCMR1 & ~(TIM_CCMR1_CC1S | TIM_CCMR1_IC1PSC)) | TIM_ICSELECTION_TRC;
+    tim->CCER |= TIM_CCER_CC1E;
+    __HAL_TIM_CLEAR_FLAG(&obj->handle, TIM_FLAG_CC1 | TIM_FLAG_CC1OF);
+    __HAL_TIM_ENABLE_IT(&obj->handle, TIM_IT_CC1);
+}
+
+int64_t encoderin_read_absolute( encoderin_t* obj )
+{
+    int64_t home;
+    int64_t position;
+    uint32_t seq;
+
+    do {
+        seq = obj->index_seq;
+        home = obj->index_home;
+        position = encoderin_read64(obj);
+    } while (seq != obj->index_seq);
+
+    return position - home;
+}
+
+/* The index captured CNT into CCR1 a moment ago. Extend it against the
+ * position now, which is less than half a wrap on, and home on it. */
+static void encoderin_index_service( encoderin_t* obj )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    uint32_t period = TimHandle->Init.Period;
+    uint32_t captured = TimHandle->Instance->CCR1;
+    uint8_t down = (TimHandle->Instance->CR1 & TIM_CR1_DIR) != 0;
+    int64_t now = encoderin_read64(obj);
+    int64_t delta = (captured - (uint32_t)now) & period;
+
+    if (delta > period / 2) {
+        delta -= (int64_t)period + 1;
+    }
+    int64_t at = now + delta;
+
+    if (obj->homed && obj->turn) {
+        int64_t off = (at - obj->index_home) % obj->turn;
+
+        if (off > (int64_t)obj->turn / 2) {
+            off -= obj->turn;
+        } else if (off < -(int64_t)obj->turn / 2) {
+            off += obj->turn;
+        }
+        // Crossed the way home was, the same edge comes back to within a
+        // count. Crossed the other way it is the index's other edge, up to
+        // a cycle further along the direction home was crossed in
+        int64_t lo = -1, hi = 1;
+        if (down != obj->index_down) {
+            int64_t cycle = ((TimHandle->Instance->SMCR & TIM_SMCR_SMS) == TIM_ENCODERMODE_TI12) ? 4 : 2;
 
-    return (uint32_t) __HAL_TIM_GET_COUNTER(&TimHandle);
+            if (obj->index_down)
+                lo = -cycle;
+            else
+                hi = cycle;
+        }
+        if (off >= lo && off <= hi) {
+            return;
+        }
+        obj->index_slips++;
+        at = obj->index_home + off;
+    }
+    obj->index_home = at;
+    obj->index_down = down;
+    obj->homed = 1;
+    obj->index_seq++;
 }
 
-static void handle_interrupt( TIM_HandleTypeDef* htim, uint8_t index )
+/* The vectors below are one per timer and hard-wired to their slot in
+ * encoderin_objs, so an event costs one load to find its encoder and one
+ * call into the alarm's handler. With MBED_CONF_ENCODERIN_IRQ_TIMESTAMP
+ * they also stamp the cycle counter as they start, for measuring dispatch
+ * latency; otherwise the stamp is compiled out. */
+static inline void encoderin_stamp( encoderin_t* obj )
 {
-  /* Capture compare 3 event */
-    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC3) != RESET)
+#if MBED_CONF_ENCODERIN_IRQ_TIMESTAMP
+    obj->irq_cycles = DWT->CYCCNT;
+#endif
+}
+
+static inline void encoderin_update_isr( encoderin_t* obj )
+{
+    TIM_HandleTypeDef* htim = &obj->handle;
+
+  /* Overflow/underflow event */
+    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) != RESET)
     {
-        if(__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_CC3) !=RESET)
+        if(__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_UPDATE) !=RESET)
         {
-            __HAL_TIM_CLEAR_IT(htim, TIM_IT_CC3);
-            irq_handler( (uint32_t)encoderin_index[index], IRQ_ALARM1 ); 
+            uint32_t seq = obj->seq;
+
+            obj->overflow[encoderin_slot(seq + 2)] = obj->overflow[encoderin_slot(seq)] +
+                                                     encoderin_wrap(htim, __HAL_TIM_GET_COUNTER(htim));
+            obj->seq = seq + 1;     // counted, flag still up
+            __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
+            obj->seq = seq + 2;
         }
     }
-  /* Capture compare 4 event */
-    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC4) != RESET)
+}
+
+static inline void encoderin_compare_isr( encoderin_t* obj )
+{
+    TIM_HandleTypeDef* htim = &obj->handle;
+
+  /* Capture 1 event, the index */
+    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC1) != RESET)
     {
-        if(__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_CC4) !=RESET)
+        if(__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_CC1) !=RESET)
         {
-            __HAL_TIM_CLEAR_IT(htim, TIM_IT_CC4);
-            irq_handler( (uint32_t)encoderin_index[index], IRQ_ALARM2 );
+            __HAL_TIM_CLEAR_IT(htim, TIM_IT_CC1);
+            encoderin_index_service( obj );
         }
     }
+  /* Capture compare 3/4 events, the alarms ahead and behind */
+    if((__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC3) != RESET && __HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_CC3) != RESET) ||
+       (__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC4) != RESET && __HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_CC4) != RESET))
+    {
+        __HAL_TIM_CLEAR_IT(htim, TIM_IT_CC3 | TIM_IT_CC4);
+        encoderin_alarm_service( obj );
+    }
 }
 
-static void timer1_irq( void )
+/* TIM1 has its own update vector; it leaves the stamp alone so a wrap
+ * preempting a compare doesn't skew that one's figure */
+static void timer1_up_irq( void )
 {
-    TIM_HandleTypeDef htim1;
-    htim1.Instance = TIM1;
+    encoderin_update_isr( encoderin_objs[1] );
+}
 
-    handle_interrupt( &htim1, 1 );    
+static void timer1_cc_irq( void )
+{
+    encoderin_stamp( encoderin_objs[1] );
+    encoderin_compare_isr( encoderin_objs[1] );
 }
 
-static void timer3_irq( void )
+static void timer2_irq( void )
 {
-    TIM_HandleTypeDef htim3;
-    htim3.Instance = TIM3;
+    encoderin_stamp( encoderin_objs[2] );
+    encoderin_update_isr( encoderin_objs[2] );
+    encoderin_compare_isr( encoderin_objs[2] );
+}
 
-    handle_interrupt( &htim3, 3 );
+static void timer3_irq( void )
+{
+    encoderin_stamp( encoderin_objs[3] );
+    encoderin_update_isr( encoderin_objs[3] );
+    encoderin_compare_isr( encoderin_objs[3] );
 }
 
 static void timer4_irq( void )
 {
-    TIM_HandleTypeDef htim4;
-    htim4.Instance = TIM4;
+    encoderin_stamp( encoderin_objs[4] );
+    encoderin_update_isr( encoderin_objs[4] );
+    encoderin_compare_isr( encoderin_objs[4] );
+}
 
-    handle_interrupt( &htim4, 4 );
+static void timer5_irq( void )
+{
+    encoderin_stamp( encoderin_objs[5] );
+    encoderin_update_isr( encoderin_objs[5] );
+    encoderin_compare_isr( encoderin_objs[5] );
 }
 
-static uint32_t encoderin_get_vector( encoderin_t* obj )
+static uintptr_t encoderin_get_vector( encoderin_t* obj )
 {
-    uint32_t vector = (uint32_t)0;
+    uintptr_t vector = (uintptr_t)0;
 
     switch( obj->enc )
     {
         case ENC_1:
-            vector = (uint32_t)&timer1_irq;
+            vector = (uintptr_t)&timer1_cc_irq;
+            break;
+
+        case ENC_2:
+            vector = (uintptr_t)&timer2_irq;
             break;
 
         case ENC_3:
-            vector = (uint32_t)&timer3_irq;
+            vector = (uintptr_t)&timer3_irq;
             break;
 
         case ENC_4:
-            vector = (uint32_t)&timer4_irq;
+            vector = (uintptr_t)&timer4_irq;
+            break;
+
+        case ENC_5:
+            vector = (uintptr_t)&timer5_irq;
             break;
 
         default:
@@ -227,6 +497,10 @@ static IRQn_Type encoderin_get_irq_n( encoderin_t* obj )
             irq_n = TIM1_CC_IRQn;
             break;
  
+        case ENC_2:
+            irq_n = TIM2_IRQn;
+            break;
+
         case ENC_3:
             irq_n = TIM3_IRQn;
             break;
@@ -234,6 +508,10 @@ static IRQn_Type encoderin_get_irq_n( encoderin_t* obj )
         case ENC_4:
             irq_n = TIM4_IRQn;
             break;
+
+        case ENC_5:
+            irq_n = TIM5_IRQn;
+            break;
         
         default:
             break;
@@ -242,66 +520,698 @@ static IRQn_Type encoderin_get_irq_n( encoderin_t* obj )
    return irq_n; 
 }
 
-void encoderin_set_irq( encoderin_t* obj, enc_irq_event alarm, uint32_t interval )
+static uintptr_t encoderin_get_update_vector( encoderin_t* obj )
 {
-    TimHandle.Instance = (TIM_TypeDef *)(obj->enc);
+    uintptr_t vector = (uintptr_t)0;
 
-    TIM_OC_InitTypeDef sConfigOC;
-    
-    sConfigOC.OCMode = TIM_OCMODE_ACTIVE;
-    sConfigOC.Pulse = interval;
-    sConfigOC.OCPolarity = TIM_OCPOLARITY_HIGH;
-    sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
-    sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
-    sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
-    sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+    switch( obj->enc )
+    {
+        case ENC_1:
+            vector = (uintptr_t)&timer1_up_irq;
+            break;
+
+        default:
+            vector = encoderin_get_vector( obj );
+            break;
+    }
+
+    return vector;
+}
 
-    if( alarm == IRQ_ALARM1 )
+static IRQn_Type encoderin_get_update_irq_n( encoderin_t* obj )
+{
+    IRQn_Type irq_n = (IRQn_Type)0;
+
+    switch( obj->enc )
     {
-        if ( HAL_TIM_OC_ConfigChannel(&TimHandle, &sConfigOC, TIM_CHANNEL_3) != HAL_OK )
-        {
-            error( "Failed to initialize Output Compare\n" );
+        case ENC_1:
+            irq_n = TIM1_UP_TIM10_IRQn;
+            break;
+
+        default:
+            irq_n = encoderin_get_irq_n( obj );
+            break;
+    }
+
+    return irq_n;
+}
+
+/* The low bits of a read64 position, as CNT will be there */
+static uint32_t encoderin_ccr( TIM_HandleTypeDef* htim, int64_t target )
+{
+    uint32_t period = htim->Init.Period;
+
+    if ((period & (period + 1)) == 0) {
+        // Power of two range, skip the 64-bit division
+        return (uint32_t)target & period;
+    }
+
+    int64_t range = (int64_t)period + 1;
+    int64_t rem = target % range;
+    return (uint32_t)(rem < 0 ? rem + range : rem);
+}
+
+/* Re-arm one of the compare channels. Only the low bits of the position
+ * fit in CCR, so a target more than a wrap away matches early as well;
+ * encoderin_alarm_service() sees nothing was crossed and arms it again.
+ *
+ * This is the whole cost of moving an alarm in hardware: one CCR store,
+ * one SR store and, only if the channel was idle, one DIER write. The
+ * channel mode, vector and NVIC line are set up once in init. */
+static void encoderin_set_compare( TIM_HandleTypeDef* htim, uint32_t channel, uint32_t it, int64_t target, int armed )
+{
+    if (!armed) {
+        __HAL_TIM_DISABLE_IT(htim, it);
+        return;
+    }
+
+    uint32_t ccr = encoderin_ccr(htim, target);
+
+    // Write CCR before clearing the flag, so a match on the old value
+    // cannot slip in after the clear. A match on the new value that has
+    // already been passed is caught by the position check afterwards.
+    __HAL_TIM_SET_COMPARE(htim, channel, ccr);
+    __HAL_TIM_CLEAR_IT(htim, it);
+    if (__HAL_TIM_GET_IT_SOURCE(htim, it) == RESET) {
+        __HAL_TIM_ENABLE_IT(htim, it);
+    }
+}
+
+/* Half-width of the band an alarm has to leave before it can fire again */
+static int64_t encoderin_alarm_band( encoderin_alarm_t* alarm )
+{
+    return alarm->hysteresis ? (int64_t)alarm->hysteresis : 1;
+}
+
+/* Call every armed alarm between the last position checked and the current
+ * one, in the order the encoder passed them, if it was passed in the
+ * direction the alarm cares about. The list is searched again after each
+ * call, so a handler is free to insert, remove or hold alarms. */
+static void encoderin_fire_alarms( encoderin_t* obj, int64_t from, int64_t to )
+{
+    uint32_t pass = ++obj->alarm_pass;
+    enc_alarm_direction direction = (to > from) ? ENC_ALARM_UP : ENC_ALARM_DOWN;
+
+    for (;;) {
+        encoderin_alarm_t *fire = NULL;
+
+        for (encoderin_alarm_t *alarm = obj->alarms; alarm; alarm = alarm->next) {
+            if (alarm->pass == pass || !alarm->armed || alarm->held) {
+                continue;
+            }
+            if (alarm->direction != ENC_ALARM_BOTH && alarm->direction != direction) {
+                continue;
+            }
+            if (to > from) {
+                if (alarm->position > from && alarm->position <= to) {
+                    fire = alarm;
+                    break;
+                }
+            } else if (alarm->position >= to && alarm->position < from) {
+                fire = alarm;       // keep going, the highest fires first
+            }
+        }
+        if (fire == NULL) {
+            break;
         }
 
-        if ( HAL_TIM_OC_Start_IT(&TimHandle, TIM_CHANNEL_3) != HAL_OK )
-        {
-            error( "Failed to start CC Interrupt\n" );
+        fire->pass = pass;
+        fire->armed = 0;
+        fire->handler(fire->id);
+    }
+}
+
+/* Fire whatever was passed and point CC3 at the nearest position ahead and
+ * CC4 at the nearest one behind where something can happen: an armed alarm,
+ * or the edge of the hysteresis band around one that has fired. Held alarms
+ * are left out entirely, so however much the shaft dithers, an alarm costs
+ * at most one interrupt per band crossing and none while it is held. */
+static void encoderin_alarm_service( encoderin_t* obj )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+
+    if (obj->alarm_masked) {
+        __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_CC3 | TIM_IT_CC4);
+        return;
+    }
+    // Called back from a handler that changed the list: the loop below
+    // rearms once the handlers are done
+    if (obj->alarm_busy) {
+        return;
+    }
+
+    for (;;) {
+        int64_t from = obj->alarm_position;
+        int64_t pos = encoderin_read64(obj);
+
+        obj->alarm_position = pos;
+        if (pos != from) {
+            obj->alarm_busy = 1;
+            encoderin_fire_alarms(obj, from, pos);
+            obj->alarm_busy = 0;
+        }
+        if (obj->alarm_masked) {
+            __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_CC3 | TIM_IT_CC4);
+            return;
+        }
+
+        int64_t ahead = 0, behind = 0;
+        int has_ahead = 0, has_behind = 0;
+
+        for (encoderin_alarm_t *alarm = obj->alarms; alarm; alarm = alarm->next) {
+            int64_t up, down;
+
+            if (alarm->held) {
+                continue;
+            }
+
+            int64_t band = encoderin_alarm_band(alarm);
+            if (!alarm->armed && (pos >= alarm->position + band || pos <= alarm->position - band)) {
+                alarm->armed = 1;
+            }
+
+            if (alarm->armed && alarm->position != pos) {
+                up = down = alarm->position;
+            } else if (alarm->armed) {
+                // Sitting on it, catch it being left
+                up = pos + 1;
+                down = pos - 1;
+            } else {
+                up = alarm->position + band;
+                down = alarm->position - band;
+            }
+
+            if (up > pos && (!has_ahead || up < ahead)) {
+                ahead = up;
+                has_ahead = 1;
+            }
+            if (down < pos && (!has_behind || down > behind)) {
+                behind = down;
+                has_behind = 1;
+            }
+        }
+
+        encoderin_set_compare(TimHandle, TIM_CHANNEL_3, TIM_IT_CC3, ahead, has_ahead);
+        encoderin_set_compare(TimHandle, TIM_CHANNEL_4, TIM_IT_CC4, behind, has_behind);
+
+        // The encoder may have gone past a target while it was being armed
+        int64_t now = encoderin_read64(obj);
+        if (!(has_ahead && now >= ahead) && !(has_behind && now <= behind)) {
+            break;
         }
-        __HAL_TIM_CLEAR_IT(&TimHandle, TIM_IT_CC3);
     }
-    else
-    {
-        if (HAL_TIM_OC_ConfigChannel(&TimHandle, &sConfigOC, TIM_CHANNEL_4) != HAL_OK)
-        {
-            error( "Failed to initialize Output Compare\n" );
+}
+
+/* The position the alarms were last checked at only moves when the
+ * service runs, and with no alarm near the encoder nothing makes it run.
+ * Bring it up to the encoder before a new position is judged against it,
+ * or an alarm set behind the encoder would fire for a crossing from
+ * before it existed. Not past an armed alarm that has been crossed the
+ * way it fires, e.g. while masked: that one still has to fire. */
+static void encoderin_alarm_catch_up( encoderin_t* obj, encoderin_alarm_t* except )
+{
+    // The dispatch loop has just read the position
+    if (obj->alarm_busy) {
+        return;
+    }
+
+    int64_t from = obj->alarm_position;
+    int64_t pos = encoderin_read64(obj);
+    enc_alarm_direction direction = (pos > from) ? ENC_ALARM_UP : ENC_ALARM_DOWN;
+
+    for (encoderin_alarm_t *alarm = obj->alarms; alarm; alarm = alarm->next) {
+        if (alarm == except || !alarm->armed || alarm->held) {
+            continue;
+        }
+        if (alarm->direction != ENC_ALARM_BOTH && alarm->direction != direction) {
+            continue;
         }
+        if ((pos > from && alarm->position > from && alarm->position <= pos) ||
+            (pos < from && alarm->position >= pos && alarm->position < from)) {
+            return;
+        }
+    }
+    obj->alarm_position = pos;
+}
 
-        if ( HAL_TIM_OC_Start_IT(&TimHandle, TIM_CHANNEL_4) != HAL_OK )
-        {
-            error( "Failed to start CC Interrupt\n" );
+static int encoderin_unlink_alarm( encoderin_t* obj, encoderin_alarm_t* alarm )
+{
+    encoderin_alarm_t **prev;
+
+    for (prev = &obj->alarms; *prev; prev = &(*prev)->next) {
+        if (*prev == alarm) {
+            *prev = alarm->next;
+            alarm->next = NULL;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+void encoderin_insert_alarm( encoderin_t* obj, encoderin_alarm_t* alarm, int64_t position, enc_alarm_direction direction, uint32_t hysteresis, enc_alarm_handler handler, uintptr_t id )
+{
+    encoderin_alarm_t **prev;
+
+    if (obj->outputs) {
+        error("The encoder's CC3 and CC4 are taken by a position output\n");
+    }
+
+    encoderin_unlink_alarm(obj, alarm);
+    encoderin_alarm_catch_up(obj, NULL);
+
+    alarm->position = position;
+    alarm->direction = direction;
+    alarm->hysteresis = hysteresis;
+    alarm->handler = handler;
+    alarm->id = id;
+    alarm->held = 0;
+    // Being on it already does not count as moving onto it
+    alarm->armed = (position != obj->alarm_position);
+    // Not part of a dispatch already under way
+    alarm->pass = obj->alarm_pass;
+
+    // After any alarms at the same position, so they fire in the order added
+    for (prev = &obj->alarms; *prev && (*prev)->position <= position; prev = &(*prev)->next);
+    alarm->next = *prev;
+    *prev = alarm;
+
+    encoderin_alarm_service(obj);
+}
+
+void encoderin_move_alarm( encoderin_t* obj, encoderin_alarm_t* alarm, int64_t position )
+{
+    encoderin_alarm_t *before = NULL;
+    encoderin_alarm_t *cur;
+    encoderin_alarm_t **prev;
+
+    for (cur = obj->alarms; cur && cur != alarm; cur = cur->next) {
+        before = cur;
+    }
+    if (cur == NULL) {
+        return;
+    }
+    encoderin_alarm_catch_up(obj, alarm);
+
+    // Only re-link when the new position is out of order with the
+    // neighbours; moving a threshold a little at a time usually is not
+    if ((before && before->position > position) || (alarm->next && alarm->next->position < position)) {
+        if (before) {
+            before->next = alarm->next;
+        } else {
+            obj->alarms = alarm->next;
         }
-        __HAL_TIM_CLEAR_IT(&TimHandle, TIM_IT_CC4);
+        for (prev = &obj->alarms; *prev && (*prev)->position <= position; prev = &(*prev)->next);
+        alarm->next = *prev;
+        *prev = alarm;
+    }
+
+    alarm->position = position;
+    alarm->armed = (position != obj->alarm_position);
+    alarm->pass = obj->alarm_pass;
+
+    // From inside a handler this returns straight away and the dispatch
+    // loop arms the channels once all handlers have run
+    encoderin_alarm_service(obj);
+}
+
+void encoderin_remove_alarm( encoderin_t* obj, encoderin_alarm_t* alarm )
+{
+    if (encoderin_unlink_alarm(obj, alarm)) {
+        encoderin_alarm_service(obj);
+    }
+}
+
+void encoderin_hold_alarm( encoderin_t* obj, encoderin_alarm_t* alarm )
+{
+    alarm->held = 1;
+    encoderin_alarm_service(obj);
+}
+
+void encoderin_release_alarm( encoderin_t* obj, encoderin_alarm_t* alarm )
+{
+    alarm->held = 0;
+    encoderin_alarm_service(obj);
+}
+
+/******************************************************************************/
+/*                          Position outputs                                  */
+/******************************************************************************/
+/* DMA requests of CC3 and CC4, from the request mapping tables of RM0090.
+ * TIM2 CC4, TIM3 CC3 and TIM4 CC3 all go through DMA1 stream 7, and TIM2
+ * CC3 and TIM5 CC4 through DMA1 stream 1, so only one of each group can
+ * run a table at a time; TIM4 CC4 has no request. */
+typedef struct {
+    ENCName enc;
+    uint8_t channel;
+    DMA_Stream_TypeDef *stream;
+    uint32_t dma_channel;
+} encoderin_out_route_t;
+
+static const encoderin_out_route_t encoderin_out_routes[] = {
+    {ENC_1, 3, DMA2_Stream6, DMA_CHANNEL_6},
+    {ENC_1, 4, DMA2_Stream4, DMA_CHANNEL_6},
+    {ENC_2, 3, DMA1_Stream1, DMA_CHANNEL_3},
+    {ENC_2, 4, DMA1_Stream7, DMA_CHANNEL_3},
+    {ENC_3, 3, DMA1_Stream7, DMA_CHANNEL_5},
+    {ENC_3, 4, DMA1_Stream2, DMA_CHANNEL_5},
+    {ENC_4, 3, DMA1_Stream7, DMA_CHANNEL_2},
+    {ENC_5, 3, DMA1_Stream0, DMA_CHANNEL_6},
+    {ENC_5, 4, DMA1_Stream1, DMA_CHANNEL_6},
+};
+
+/* The table running on each stream, for its vector. dma_stream_claim
+ * keeps a second encoder off a stream while a table holds it */
+static DMA_HandleTypeDef *encoderin_out_dma[6];
+
+static void dma2_stream6_irq( void )
+{
+    HAL_DMA_IRQHandler( encoderin_out_dma[0] );
+}
+
+static void dma2_stream4_irq( void )
+{
+    HAL_DMA_IRQHandler( encoderin_out_dma[1] );
+}
+
+static void dma1_stream1_irq( void )
+{
+    HAL_DMA_IRQHandler( encoderin_out_dma[2] );
+}
+
+static void dma1_stream7_irq( void )
+{
+    HAL_DMA_IRQHandler( encoderin_out_dma[3] );
+}
+
+static void dma1_stream2_irq( void )
+{
+    HAL_DMA_IRQHandler( encoderin_out_dma[4] );
+}
+
+static void dma1_stream0_irq( void )
+{
+    HAL_DMA_IRQHandler( encoderin_out_dma[5] );
+}
+
+static uint8_t encoderin_out_get_index( DMA_Stream_TypeDef* stream )
+{
+    uint8_t index = 0;
+
+    if (stream == DMA2_Stream6)
+        index = 0;
+    else if (stream == DMA2_Stream4)
+        index = 1;
+    else if (stream == DMA1_Stream1)
+        index = 2;
+    else if (stream == DMA1_Stream7)
+        index = 3;
+    else if (stream == DMA1_Stream2)
+        index = 4;
+    else if (stream == DMA1_Stream0)
+        index = 5;
+
+    return index;
+}
+
+static IRQn_Type encoderin_out_get_irq_n( DMA_Stream_TypeDef* stream )
+{
+    IRQn_Type irq_n = (IRQn_Type)0;
+
+    switch( encoderin_out_get_index( stream ) )
+    {
+        case 0:
+            irq_n = DMA2_Stream6_IRQn;
+            break;
+
+        case 1:
+            irq_n = DMA2_Stream4_IRQn;
+            break;
+
+        case 2:
+            irq_n = DMA1_Stream1_IRQn;
+            break;
+
+        case 3:
+            irq_n = DMA1_Stream7_IRQn;
+            break;
+
+        case 4:
+            irq_n = DMA1_Stream2_IRQn;
+            break;
+
+        case 5:
+            irq_n = DMA1_Stream0_IRQn;
+            break;
     }
 
-  /* Determine and Set Irq */
-    IRQn_Type irq_n = encoderin_get_irq_n( obj );
-    uint32_t vector = encoderin_get_vector( obj );
-    NVIC_SetVector(irq_n, (uint32_t)vector); 
+    return irq_n;
+}
+
+static uintptr_t encoderin_out_get_vector( DMA_Stream_TypeDef* stream )
+{
+    uintptr_t vector = (uintptr_t)0;
+
+    switch( encoderin_out_get_index( stream ) )
+    {
+        case 0:
+            vector = (uintptr_t)&dma2_stream6_irq;
+            break;
+
+        case 1:
+            vector = (uintptr_t)&dma2_stream4_irq;
+            break;
+
+        case 2:
+            vector = (uintptr_t)&dma1_stream1_irq;
+            break;
+
+        case 3:
+            vector = (uintptr_t)&dma1_stream7_irq;
+            break;
+
+        case 4:
+            vector = (uintptr_t)&dma1_stream2_irq;
+            break;
+
+        case 5:
+            vector = (uintptr_t)&dma1_stream0_irq;
+            break;
+    }
+
+    return vector;
+}
+
+static const encoderin_out_route_t *encoderin_out_find_route( encoderin_t* obj, uint8_t channel )
+{
+    for (unsigned i = 0; i < sizeof(encoderin_out_routes) / sizeof(encoderin_out_routes[0]); i++) {
+        if (encoderin_out_routes[i].enc == obj->enc && encoderin_out_routes[i].channel == channel)
+            return &encoderin_out_routes[i];
+    }
+    error("The encoder's CC4 has no DMA request for a position table\n");
+    return NULL;
+}
+
+/* Find pin's entry in PinMap_ENC_OUT; TIM2 and TIM5 share pins, so the
+ * peripheral has to match too */
+static const PinMap *encoderin_out_find_pin( encoderin_t* obj, PinName pin )
+{
+    const PinMap *map;
+
+    for (map = PinMap_ENC_OUT; map->pin != NC; map++) {
+        if (map->pin == pin && map->peripheral == (int)obj->enc)
+            return map;
+    }
+    error("Output pin is not on the encoder's timer\n");
+    return NULL;
+}
+
+static void encoderin_out_set_ocmode( encoderin_t* obj, uint8_t channel, uint32_t ocmode )
+{
+    TIM_TypeDef *tim = obj->handle.Instance;
+    uint32_t shift = (channel & 1) ? 0 : 8;
+
+    tim->CCMR2 = (tim->CCMR2 & ~(TIM_CCMR1_OC1M << shift)) | (ocmode << shift);
+}
+
+/* Stop a table and comparing, the output keeps its level */
+static void encoderin_out_stop( encoderin_t* obj, uint8_t channel )
+{
+    DMA_HandleTypeDef *hdma = &obj->out_dma[channel - 3];
+
+    __HAL_TIM_DISABLE_DMA(&obj->handle, TIM_DMA_CC1 << (channel - 1));
+    if (hdma->Instance && hdma->State == HAL_DMA_STATE_BUSY)
+        HAL_DMA_Abort(hdma);
+    dma_stream_release(hdma);
+    encoderin_out_set_ocmode(obj, channel, TIM_OCMODE_TIMING);
+}
+
+/* The last entry has just gone into CCR. Without repeat that is the end,
+ * and freezing the channel keeps it from acting on the end marker. */
+static void encoderin_out_complete( DMA_HandleTypeDef* hdma )
+{
+    encoderin_t *obj = (encoderin_t*)((char*)hdma->Parent - offsetof(encoderin_t, handle));
+    uint8_t index = hdma - obj->out_dma;
+
+    if (hdma->Init.Mode != DMA_CIRCULAR) {
+        __HAL_TIM_DISABLE_DMA(&obj->handle, TIM_DMA_CC3 << index);
+        encoderin_out_set_ocmode(obj, index + 3, TIM_OCMODE_TIMING);
+    }
+    if (obj->out_handler[index])
+        obj->out_handler[index](obj->out_id[index]);
+}
+
+uint8_t encoderin_output_init( encoderin_t* obj, PinName pin, uint8_t active_low )
+{
+    TIM_OC_InitTypeDef sConfigOC;
+    const PinMap *map = encoderin_out_find_pin(obj, pin);
+    uint8_t channel = STM_PIN_CHANNEL(map->function);
+
+    if (obj->alarms) {
+        error("The encoder's CC3 and CC4 are taken by its alarms\n");
+    }
+    if (obj->outputs & (1 << channel)) {
+        error("The encoder's CC%d already drives a pin\n", channel);
+    }
+    obj->outputs |= 1 << channel;
+
+  /* Configure the channel, forced inactive, without preload so a new CCR
+     is compared from the next count on */
+    sConfigOC.OCMode = TIM_OCMODE_FORCED_INACTIVE;
+    sConfigOC.Pulse = 0;
+    sConfigOC.OCPolarity = active_low ? TIM_OCPOLARITY_LOW : TIM_OCPOLARITY_HIGH;
+    sConfigOC.OCNPolarity = TIM_OCNPOLARITY_HIGH;
+    sConfigOC.OCFastMode = TIM_OCFAST_DISABLE;
+    sConfigOC.OCIdleState = TIM_OCIDLESTATE_RESET;
+    sConfigOC.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+    if (HAL_TIM_OC_ConfigChannel(&obj->handle, &sConfigOC, (channel - 1) * 4) != HAL_OK)
+    {
+        error( "Failed to initialize Output Compare\n" );
+    }
+    obj->handle.Instance->CCER |= TIM_CCER_CC1E << ((channel - 1) * 4);
+    if (IS_TIM_ADVANCED_INSTANCE(obj->handle.Instance))
+        __HAL_TIM_MOE_ENABLE(&obj->handle);
+
+    obj->out_dma[channel - 3].Instance = NULL;
+    obj->out_handler[channel - 3] = NULL;
+
+  /* Configure GPIO */
+    pin_function(pin, map->function);
+    pin_mode(pin, PullNone);
+
+    return channel;
+}
+
+void encoderin_output_free( encoderin_t* obj, uint8_t channel )
+{
+    encoderin_output_write(obj, channel, 0);
+    obj->handle.Instance->CCER &= ~(TIM_CCER_CC1E << ((channel - 1) * 4));
+    obj->outputs &= ~(1 << channel);
+}
+
+void encoderin_output_write( encoderin_t* obj, uint8_t channel, int value )
+{
+    encoderin_out_stop(obj, channel);
+    encoderin_out_set_ocmode(obj, channel, value ? TIM_OCMODE_FORCED_ACTIVE : TIM_OCMODE_FORCED_INACTIVE);
+}
+
+void encoderin_output_compare( encoderin_t* obj, uint8_t channel, int64_t position, enc_out_mode mode )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+
+    encoderin_out_stop(obj, channel);
+    __HAL_TIM_SET_COMPARE(TimHandle, (channel - 1) * 4, encoderin_ccr(TimHandle, position));
+    encoderin_out_set_ocmode(obj, channel, mode);
+}
+
+void encoderin_output_table( encoderin_t* obj, uint8_t channel, const uint32_t* positions, uint16_t length, enc_out_mode mode, uint8_t repeat, enc_alarm_handler handler, uintptr_t id )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    DMA_HandleTypeDef *hdma = &obj->out_dma[channel - 3];
+    const encoderin_out_route_t *route = encoderin_out_find_route(obj, channel);
+
+    MBED_ASSERT(length >= (repeat ? 1 : 2));
+
+    encoderin_out_stop(obj, channel);
+    obj->out_handler[channel - 3] = handler;
+    obj->out_id[channel - 3] = id;
+
+    if (route->stream == DMA2_Stream6 || route->stream == DMA2_Stream4)
+        __HAL_RCC_DMA2_CLK_ENABLE();
+    else
+        __HAL_RCC_DMA1_CLK_ENABLE();
+
+  /* The next entry into CCR on every match */
+    dma_stream_claim(hdma, route->stream, "a position table");
+    hdma->Instance = route->stream;
+    hdma->Init.Channel = route->dma_channel;
+    hdma->Init.Direction = DMA_MEMORY_TO_PERIPH;
+    hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma->Init.MemInc = DMA_MINC_ENABLE;
+    hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    hdma->Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    hdma->Init.Mode = repeat ? DMA_CIRCULAR : DMA_NORMAL;
+    hdma->Init.Priority = DMA_PRIORITY_VERY_HIGH;
+    hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    hdma->Init.FIFOThreshold = 0;
+    hdma->Init.MemBurst = 0;
+    hdma->Init.PeriphBurst = 0;
+    if (HAL_DMA_Init(hdma) != HAL_OK)
+    {
+        error("Cannot initialize Encoder DMA\n");
+    }
+    hdma->Parent = TimHandle;
+    hdma->XferCpltCallback = &encoderin_out_complete;
+    hdma->XferHalfCpltCallback = NULL;
+    hdma->XferErrorCallback = NULL;
+    encoderin_out_dma[encoderin_out_get_index(route->stream)] = hdma;
+
+    IRQn_Type irq_n = encoderin_out_get_irq_n(route->stream);
+    NVIC_SetVector(irq_n, encoderin_out_get_vector(route->stream));
     NVIC_EnableIRQ(irq_n);
+
+    volatile uint32_t *ccr = &TimHandle->Instance->CCR1 + (channel - 1);
+    if (HAL_DMA_Start_IT(hdma, (uint32_t)(uintptr_t)positions, (uint32_t)(uintptr_t)ccr, length) != HAL_OK)
+    {
+        error("Cannot start Encoder DMA\n");
+    }
+
+  /* A software compare event has the DMA load the first entry, then the
+     channel starts acting on it */
+    __HAL_TIM_ENABLE_DMA(TimHandle, TIM_DMA_CC1 << (channel - 1));
+    HAL_TIM_GenerateEvent(TimHandle, TIM_EVENTSOURCE_CC1 << (channel - 1));
+    __HAL_TIM_CLEAR_FLAG(TimHandle, TIM_FLAG_CC1 << (channel - 1));
+    encoderin_out_set_ocmode(obj, channel, mode);
 }
 
-void encoderin_irq_enable( encoderin_t* obj )
+void encoderin_output_pulse( encoderin_t* obj, uint8_t channel, int64_t position, int32_t width, enc_alarm_handler handler, uintptr_t id )
 {
-    IRQn_Type irq_n = encoderin_get_irq_n( obj ); 
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    uint32_t *table = obj->out_pulse[channel - 3];
+
+    MBED_ASSERT(width != 0);
 
-    NVIC_EnableIRQ( irq_n );
+    // From inactive: on at the start, off at the end, then the end again
+    // as the marker that stops the table
+    encoderin_output_write(obj, channel, 0);
+    table[0] = encoderin_ccr(TimHandle, position);
+    table[1] = encoderin_ccr(TimHandle, position + width);
+    table[2] = table[1];
+    encoderin_output_table(obj, channel, table, 3, ENC_OUT_TOGGLE, 0, handler, id);
 }
 
-void encoderin_irq_disable( encoderin_t* obj )
+/* The alarms share their vector with the update event that extends the
+ * position, so mask them at the timer rather than in the NVIC. Alarms
+ * passed while masked fire when they are unmasked. */
+void encoderin_irq_enable( encoderin_t* obj )
 {
-    IRQn_Type irq_n = encoderin_get_irq_n( obj );
+    obj->alarm_masked = 0;
+    encoderin_alarm_service(obj);
+}
 
-    NVIC_DisableIRQ( irq_n );
+void encoderin_irq_disable( encoderin_t* obj )
+{
+    obj->alarm_masked = 1;
+    __HAL_TIM_DISABLE_IT(&obj->handle, TIM_IT_CC3 | TIM_IT_CC4);
 }
 
 #endif //DEVICE_ENCODERIN
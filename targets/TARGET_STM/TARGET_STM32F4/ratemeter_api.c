@@ -0,0 +1,436 @@
+#include "ratemeter_api.h"
+
+#if DEVICE_RATEMETER
+
+#include <stddef.h>
+#include "cmsis.h"
+#include "mbed_error.h"
+#include "dma_streams.h"
+#include "timers.h"
+
+#define CHANNEL_NUMBER 6
+
+static ratemeter_t *rate_objs[CHANNEL_NUMBER];
+
+/* Where the reference timers' ITR0-3 come from, the "TIMx internal trigger
+ * connection" tables of RM0090 */
+static const uint32_t rate_itrs_4[4] = {TIM1_BASE, TIM2_BASE, TIM3_BASE, TIM8_BASE};
+static const uint32_t rate_itrs_5[4] = {TIM2_BASE, TIM3_BASE, TIM4_BASE, TIM8_BASE};
+
+static const uint32_t rate_ts[4] = {TIM_TS_ITR0, TIM_TS_ITR1, TIM_TS_ITR2, TIM_TS_ITR3};
+
+static uint8_t rate_get_irq_index( ratemeter_t* obj )
+{
+    uint8_t irq_index = 0;
+
+    switch( obj->rate )
+    {
+        case RATE_4:
+            irq_index = 4;
+            break;
+        case RATE_5:
+            irq_index = 5;
+            break;
+    }
+
+    return irq_index;
+}
+
+/* TIM_TS_ITRx carrying the counter's TRGO, TIM_TS_NONE if no link */
+static uint32_t rate_get_itr( ratemeter_t* obj )
+{
+    const uint32_t *itrs = (obj->rate == RATE_4) ? rate_itrs_4 : rate_itrs_5;
+
+    for (uint32_t itr = 0; itr < 4; itr++) {
+        if (itrs[itr] == (uint32_t)(uintptr_t)obj->counter) {
+            return rate_ts[itr];
+        }
+    }
+    return TIM_TS_NONE;
+}
+
+/* TIMx_UP requests, DMA1 stream 6 for both */
+static uint32_t rate_get_dma_channel( ratemeter_t* obj )
+{
+    return (obj->rate == RATE_4) ? DMA_CHANNEL_2 : DMA_CHANNEL_6;
+}
+
+/* Clock feeding the timer's prescaler, read once at init */
+static uint32_t rate_get_clock( ratemeter_t* obj )
+{
+    RCC_ClkInitTypeDef RCC_ClkInitStruct;
+    uint32_t PclkFreq;
+    uint32_t APBxCLKDivider;
+
+    // Get clock configuration
+    // Note: PclkFreq contains here the Latency (not used after)
+    HAL_RCC_GetClockConfig(&RCC_ClkInitStruct, &PclkFreq);
+
+    // Get the PCLK and APBCLK divider related to the timer
+    switch (obj->rate) {
+
+        // APB1 clock
+        case RATE_4:
+        case RATE_5:
+            PclkFreq = HAL_RCC_GetPCLK1Freq();
+            APBxCLKDivider = RCC_ClkInitStruct.APB1CLKDivider;
+            break;
+
+        default:
+            return 0;
+    }
+
+    // TIMxCLK = PCLKx when the APB prescaler = 1 else TIMxCLK = 2 * PCLKx
+    if (APBxCLKDivider == RCC_HCLK_DIV1)
+        return PclkFreq;
+    else
+        return PclkFreq * 2;
+}
+
+/* Time every edge from now on, the first one only sets the reference.
+ * Until then the time without an edge counts from this window's end. */
+static void rate_period_mode( ratemeter_t* obj )
+{
+    obj->mode = RATE_PERIOD;
+    obj->ref_valid = 0;
+    obj->ref_time = obj->windows * obj->window;
+    obj->idle = 0;
+    __HAL_TIM_CLEAR_FLAG(&obj->handle, TIM_FLAG_CC3 | TIM_FLAG_CC3OF);
+    __HAL_TIM_ENABLE_IT(&obj->handle, TIM_IT_CC3);
+}
+
+static void rate_count_mode( ratemeter_t* obj )
+{
+    obj->mode = RATE_COUNT;
+    __HAL_TIM_DISABLE_IT(&obj->handle, TIM_IT_CC3);
+}
+
+/* The counter's CCR1 and our CCR3 latch on the same edge, a couple of
+ * clocks apart; read them again if a newer edge came in between */
+static void rate_edge( ratemeter_t* obj )
+{
+    TIM_HandleTypeDef *htim = &obj->handle;
+    uint32_t captured;
+    uint32_t edge;
+    uint64_t time;
+
+    do {
+        __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_CC3 | TIM_FLAG_CC3OF);
+        captured = htim->Instance->CCR3;
+        edge = obj->counter->CCR1;
+    } while (__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC3) != RESET);
+
+    // A capture early in a window whose update is still pending is after it
+    time = obj->windows * obj->window + captured;
+    if (__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) != RESET && captured < obj->window / 2)
+        time += obj->window;
+
+    if (!obj->ref_valid) {
+        obj->ref_time = time;
+        obj->ref_edge = edge;
+        obj->ref_valid = 1;
+    }
+    obj->edge_time = time;
+    obj->edge = edge;
+}
+
+static void rate_window( ratemeter_t* obj )
+{
+    float tick_hz = (float)obj->clock / (float)obj->prescaler;
+    uint32_t sample = obj->latched;
+    uint32_t count = ((sample - obj->last_cnt) & obj->counter_period) * obj->divider;
+
+    obj->last_cnt = sample;
+    obj->windows++;
+
+    // The first window started before the counter was sampled
+    if (obj->windows == 1)
+        return;
+
+    if (obj->mode == RATE_COUNT) {
+        obj->hz = (float)count * tick_hz / (float)obj->window;
+        if (count < obj->down)
+            rate_period_mode(obj);
+    } else {
+        uint32_t edges = ((obj->edge - obj->ref_edge) & obj->counter_period) * obj->divider;
+
+        if (obj->ref_valid && edges) {
+            obj->hz = (float)edges * tick_hz / (float)(obj->edge_time - obj->ref_time);
+            obj->ref_time = obj->edge_time;
+            obj->ref_edge = obj->edge;
+            obj->idle = 0;
+        } else if (++obj->idle >= obj->timeout) {
+            obj->hz = 0.0f;
+        } else {
+            // The next edge is no sooner than now, so the rate is at most
+            // one edge over the time since the last
+            float bound = tick_hz / (float)(obj->windows * obj->window - obj->ref_time);
+            if (bound < obj->hz)
+                obj->hz = bound;
+        }
+
+        if (count > obj->up) {
+            rate_count_mode(obj);
+            obj->hz = (float)count * tick_hz / (float)obj->window;
+        }
+    }
+
+    if (obj->handler)
+        obj->handler(obj->id);
+}
+
+static void handle_interrupt( ratemeter_t* obj )
+{
+    TIM_HandleTypeDef *htim = &obj->handle;
+
+  /* Edge timestamp, before the update that may follow it */
+    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC3) != RESET)
+    {
+        if(__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_CC3) != RESET)
+        {
+            rate_edge(obj);
+        }
+    }
+
+  /* End of a window */
+    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
+        rate_window(obj);
+    }
+}
+
+static void timer4_irq( void )
+{
+    handle_interrupt( rate_objs[4] );
+}
+
+static void timer5_irq( void )
+{
+    handle_interrupt( rate_objs[5] );
+}
+
+static uintptr_t rate_get_vector( ratemeter_t* obj )
+{
+    uintptr_t vector = (uintptr_t)0;
+
+    switch( obj->rate )
+    {
+        case RATE_4:
+            vector = (uintptr_t)&timer4_irq;
+            break;
+
+        case RATE_5:
+            vector = (uintptr_t)&timer5_irq;
+            break;
+
+        default:
+            break;
+    }
+
+    return vector;
+}
+
+static IRQn_Type rate_get_irq_n( ratemeter_t* obj )
+{
+    return (obj->rate == RATE_4) ? TIM4_IRQn : TIM5_IRQn;
+}
+
+void ratemeter_init(ratemeter_t* obj, RATEName rate, TIM_HandleTypeDef* counter, uint8_t channel)
+{
+    MBED_ASSERT(channel <= 2);
+
+    obj->rate = rate;
+    obj->counter = counter->Instance;
+    obj->counter_period = counter->Init.Period;
+    obj->divider = 1;
+    obj->running = 0;
+    obj->mode = RATE_COUNT;
+    obj->hz = 0.0f;
+    obj->handler = NULL;
+    obj->id = 0;
+
+    uint32_t itr = rate_get_itr(obj);
+    if (itr == TIM_TS_NONE)
+        error("No internal trigger from this counter to the rate timer\n");
+    // A cascaded counter already sends its wraps out on TRGO
+    if ((obj->counter->CR2 & TIM_CR2_MMS) == TIM_TRGO_UPDATE)
+        error("Cannot measure the rate of a cascaded counter\n");
+    timer_claim(&obj->handle, (TIM_TypeDef *)(obj->rate), "a rate meter");
+
+#if defined(TIM4_BASE)
+    if (obj->rate == RATE_4) __HAL_RCC_TIM4_CLK_ENABLE();
+#endif
+
+#if defined(TIM5_BASE)
+    if (obj->rate == RATE_5) __HAL_RCC_TIM5_CLK_ENABLE();
+#endif
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    obj->clock = rate_get_clock(obj);
+    if (obj->clock == 0)
+        error("Rate: unknown timer clock\n");
+
+    // Configure Timer, the windows are only set by ratemeter_start
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    TimHandle->Instance = (TIM_TypeDef *)(obj->rate);
+    TimHandle->Init.Prescaler     = 0;
+    TimHandle->Init.Period        = IS_TIM_32B_COUNTER_INSTANCE(TimHandle->Instance) ? 0xFFFFFFFF : 0xFFFF;
+    TimHandle->Init.ClockDivision = 0;
+    TimHandle->Init.CounterMode   = TIM_COUNTERMODE_UP;
+    if (HAL_TIM_Base_Init(TimHandle) != HAL_OK)
+    {
+        error("Cannot initialize Time Base\n");
+    }
+    obj->prescaler = 1;
+    obj->window = 1;
+
+  /* Counter: CC1 captures every counted edge and pulses TRGO. On a
+   * channel 2 counter IC1 takes TI2, at the polarity the counter uses; on
+   * an ETR one TRC takes ETRF, which is past the ETR prescaler like CNT. */
+    TIM_TypeDef *cnt = obj->counter;
+    cnt->CCER &= ~TIM_CCER_CC1E;
+    if (channel == 0) {
+        cnt->SMCR = (cnt->SMCR & ~TIM_SMCR_TS) | TIM_TS_ETRF;
+        cnt->CCMR1 = (cnt->CCMR1 & ~(TIM_CCMR1_CC1S | TIM_CCMR1_IC1PSC)) | TIM_ICSELECTION_TRC;
+        obj->divider = 1 << ((cnt->SMCR & TIM_SMCR_ETPS) >> TIM_SMCR_ETPS_Pos);
+    } else if (channel == 1) {
+        cnt->CCMR1 = (cnt->CCMR1 & ~(TIM_CCMR1_CC1S | TIM_CCMR1_IC1PSC)) | TIM_ICSELECTION_DIRECTTI;
+    } else {
+        cnt->CCMR1 = (cnt->CCMR1 & ~(TIM_CCMR1_CC1S | TIM_CCMR1_IC1PSC)) | TIM_ICSELECTION_INDIRECTTI;
+        cnt->CCER = (cnt->CCER & ~(TIM_CCER_CC1P | TIM_CCER_CC1NP)) |
+                    ((cnt->CCER & (TIM_CCER_CC2P | TIM_CCER_CC2NP)) >> 4);
+    }
+    cnt->CCER |= TIM_CCER_CC1E;
+    cnt->CR2 = (cnt->CR2 & ~TIM_CR2_MMS) | TIM_TRGO_OC1;
+
+  /* Reference: CC3 captures the time on TRC, unfiltered */
+    TIM_TypeDef *tim = TimHandle->Instance;
+    tim->SMCR = (tim->SMCR & ~(TIM_SMCR_TS | TIM_SMCR_SMS)) | itr;
+    tim->CCER &= ~TIM_CCER_CC3E;
+    tim->CCMR2 = (tim->CCMR2 & ~(TIM_CCMR2_CC3S | TIM_CCMR2_IC3PSC | TIM_CCMR2_IC3F)) | TIM_ICSELECTION_TRC;
+    tim->CCER |= TIM_CCER_CC3E;
+
+    uint8_t irq_index = rate_get_irq_index( obj );
+    rate_objs[irq_index] = obj;
+}
+
+void ratemeter_set_irq(ratemeter_t* obj, rate_irq_handler handler, uintptr_t id)
+{
+    obj->handler = handler;
+    obj->id = id;
+}
+
+/* Prescaler and period nearest to 'ticks' timer clocks */
+static void rate_solve( ratemeter_t* obj, uint64_t ticks )
+{
+    uint64_t max = (uint64_t)obj->handle.Init.Period + 1;
+    uint64_t psc = (ticks + max - 1) / max;
+    uint64_t arr;
+
+    if (psc == 0)
+        psc = 1;
+    if (psc > 0x10000)
+        error("Rate: out of range window\n");
+
+    arr = (ticks + psc / 2) / psc;
+    if (arr < 2)
+        arr = 2;
+    if (arr > max)
+        arr = max;
+
+    obj->prescaler = (uint32_t)psc;
+    obj->window = (uint32_t)arr;
+}
+
+void ratemeter_start(ratemeter_t* obj, uint32_t hz, uint32_t up_hz, uint32_t down_hz, float min_hz)
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    TIM_TypeDef *tim = TimHandle->Instance;
+    DMA_HandleTypeDef *hdma = &obj->dma;
+
+    MBED_ASSERT(hz > 0 && down_hz < up_hz && min_hz > 0.0f);
+    ratemeter_stop(obj);
+
+  /* Windows and thresholds in edges per window */
+    rate_solve(obj, ((uint64_t)obj->clock + hz / 2) / hz);
+    tim->PSC = obj->prescaler - 1;
+    tim->ARR = obj->window - 1;
+    tim->CNT = 0;
+    // Load PSC now, before the DMA request is enabled
+    HAL_TIM_GenerateEvent(TimHandle, TIM_EVENTSOURCE_UPDATE);
+    __HAL_TIM_CLEAR_FLAG(TimHandle, TIM_FLAG_UPDATE | TIM_FLAG_CC3 | TIM_FLAG_CC3OF);
+
+    uint64_t window_ns = ratemeter_get_window_ns(obj);
+    obj->up = (uint32_t)(((uint64_t)up_hz * window_ns + 500000000ULL) / 1000000000ULL);
+    obj->down = (uint32_t)(((uint64_t)down_hz * window_ns + 500000000ULL) / 1000000000ULL);
+    obj->timeout = (uint32_t)(1e9f / (min_hz * (float)window_ns)) + 1;
+
+    obj->mode = RATE_COUNT;
+    obj->ref_valid = 0;
+    obj->windows = 0;
+    obj->idle = 0;
+    obj->hz = 0.0f;
+    obj->latched = obj->counter->CNT;
+    obj->last_cnt = obj->latched;
+
+  /* The counter's CNT into 'latched' on every update. TIM4_UP and TIM5_UP
+     both have stream 6, so only one rate meter runs at a time */
+    dma_stream_claim(hdma, DMA1_Stream6, "a rate meter");
+    hdma->Instance = DMA1_Stream6;
+    hdma->Init.Channel = rate_get_dma_channel(obj);
+    hdma->Init.Direction = DMA_PERIPH_TO_MEMORY;
+    hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+    hdma->Init.MemInc = DMA_MINC_DISABLE;
+    hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+    hdma->Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+    hdma->Init.Mode = DMA_CIRCULAR;
+    hdma->Init.Priority = DMA_PRIORITY_HIGH;
+    hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+    hdma->Init.FIFOThreshold = 0;
+    hdma->Init.MemBurst = 0;
+    hdma->Init.PeriphBurst = 0;
+    if (HAL_DMA_Init(hdma) != HAL_OK)
+    {
+        error("Cannot initialize Rate DMA\n");
+    }
+    hdma->Parent = TimHandle;
+    if (HAL_DMA_Start(hdma, (uint32_t)(uintptr_t)&obj->counter->CNT, (uint32_t)(uintptr_t)&obj->latched, 1) != HAL_OK)
+    {
+        error("Cannot start Rate DMA\n");
+    }
+
+    IRQn_Type irq_n = rate_get_irq_n(obj);
+    NVIC_SetVector(irq_n, rate_get_vector(obj));
+    NVIC_EnableIRQ(irq_n);
+
+    obj->running = 1;
+    __HAL_TIM_ENABLE_DMA(TimHandle, TIM_DMA_UPDATE);
+    __HAL_TIM_ENABLE_IT(TimHandle, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE(TimHandle);
+}
+
+void ratemeter_stop(ratemeter_t* obj)
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+
+    if (!obj->running)
+        return;
+    obj->running = 0;
+
+    __HAL_TIM_DISABLE(TimHandle);
+    __HAL_TIM_DISABLE_DMA(TimHandle, TIM_DMA_UPDATE);
+    __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_UPDATE | TIM_IT_CC3);
+    HAL_DMA_Abort(&obj->dma);
+    dma_stream_release(&obj->dma);
+}
+
+uint64_t ratemeter_get_window_ns(ratemeter_t* obj)
+{
+    uint64_t ticks = (uint64_t)obj->prescaler * obj->window;
+
+    return (ticks * 1000000000ULL + obj->clock / 2) / obj->clock;
+}
+
+#endif //DEVICE_RATEMETER
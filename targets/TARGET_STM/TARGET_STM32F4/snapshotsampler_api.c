@@ -0,0 +1,365 @@
+#include "snapshotsampler_api.h"
+
+#if DEVICE_SNAPSHOTSAMPLER
+
+#include <stddef.h>
+#include "cmsis.h"
+#include "mbed_error.h"
+#include "dma_streams.h"
+#include "timers.h"
+
+#define CHANNEL_NUMBER 6
+
+static snapshotsampler_t *smp_objs[CHANNEL_NUMBER];
+
+/* The DMA requests one update of the sampling timer raises: the update
+ * itself plus compare channels with CCR = 0, which match on the same clock.
+ * Each on a stream of its own, in stream order, from the DMA1 request
+ * mapping table of RM0090. TIM5_UP also drives stream 0 (with CH3), so
+ * that one is left out. */
+typedef struct {
+    uint32_t dma_source;        // TIM_DMA_x
+    uint8_t channel;            // compare channel, 0 for the update
+    DMA_Stream_TypeDef *stream;
+    IRQn_Type irq_n;
+} smp_route_t;
+
+static const smp_route_t smp_routes_4[SMP_SOURCES] = {
+    {TIM_DMA_CC1,    1, DMA1_Stream0, DMA1_Stream0_IRQn},
+    {TIM_DMA_CC2,    2, DMA1_Stream3, DMA1_Stream3_IRQn},
+    {TIM_DMA_UPDATE, 0, DMA1_Stream6, DMA1_Stream6_IRQn},
+    {TIM_DMA_CC3,    3, DMA1_Stream7, DMA1_Stream7_IRQn}
+};
+
+static const smp_route_t smp_routes_5[SMP_SOURCES] = {
+    {TIM_DMA_CC4,    4, DMA1_Stream1, DMA1_Stream1_IRQn},
+    {TIM_DMA_CC1,    1, DMA1_Stream2, DMA1_Stream2_IRQn},
+    {TIM_DMA_CC2,    2, DMA1_Stream4, DMA1_Stream4_IRQn},
+    {TIM_DMA_UPDATE, 0, DMA1_Stream6, DMA1_Stream6_IRQn}
+};
+
+static uint8_t smp_get_irq_index( snapshotsampler_t* obj )
+{
+    uint8_t irq_index = 0;
+
+    switch( obj->smp )
+    {
+        case SMP_4:
+            irq_index = 4;
+            break;
+        case SMP_5:
+            irq_index = 5;
+            break;
+    }
+
+    return irq_index;
+}
+
+static const smp_route_t* smp_get_routes( snapshotsampler_t* obj )
+{
+    return (obj->smp == SMP_4) ? smp_routes_4 : smp_routes_5;
+}
+
+static uint32_t smp_get_dma_channel( snapshotsampler_t* obj )
+{
+    return (obj->smp == SMP_4) ? DMA_CHANNEL_2 : DMA_CHANNEL_6;
+}
+
+/* Clock feeding the timer's prescaler, read once at init */
+static uint32_t smp_get_clock( snapshotsampler_t* obj )
+{
+    RCC_ClkInitTypeDef RCC_ClkInitStruct;
+    uint32_t PclkFreq;
+    uint32_t APBxCLKDivider;
+
+    // Get clock configuration
+    // Note: PclkFreq contains here the Latency (not used after)
+    HAL_RCC_GetClockConfig(&RCC_ClkInitStruct, &PclkFreq);
+
+    // Get the PCLK and APBCLK divider related to the timer
+    switch (obj->smp) {
+
+        // APB1 clock
+        case SMP_4:
+        case SMP_5:
+            PclkFreq = HAL_RCC_GetPCLK1Freq();
+            APBxCLKDivider = RCC_ClkInitStruct.APB1CLKDivider;
+            break;
+
+        default:
+            return 0;
+    }
+
+    // TIMxCLK = PCLKx when the APB prescaler = 1 else TIMxCLK = 2 * PCLKx
+    if (APBxCLKDivider == RCC_HCLK_DIV1)
+        return PclkFreq;
+    else
+        return PclkFreq * 2;
+}
+
+/* The streams fill their buffers on the same request, the last one (highest
+ * stream, lowest arbitration priority) completing last. Only that one
+ * interrupts, so every register's half of a block is in place by then. */
+static snapshotsampler_t* smp_from_dma( DMA_HandleTypeDef* hdma )
+{
+    return (snapshotsampler_t*)((char*)hdma->Parent - offsetof(snapshotsampler_t, handle));
+}
+
+static void smp_block_m0( DMA_HandleTypeDef* hdma )
+{
+    snapshotsampler_t* obj = smp_from_dma(hdma);
+
+    if (obj->handler)
+        obj->handler(obj->id, obj->buffer);
+}
+
+static void smp_block_m1( DMA_HandleTypeDef* hdma )
+{
+    snapshotsampler_t* obj = smp_from_dma(hdma);
+
+    if (obj->handler)
+        obj->handler(obj->id, obj->buffer + obj->sources * obj->length);
+}
+
+static void handle_interrupt( snapshotsampler_t* obj )
+{
+    HAL_DMA_IRQHandler(&obj->dma[obj->sources - 1]);
+}
+
+static void smp4_dma_irq( void )
+{
+    handle_interrupt( smp_objs[4] );
+}
+
+static void smp5_dma_irq( void )
+{
+    handle_interrupt( smp_objs[5] );
+}
+
+static uintptr_t smp_get_vector( snapshotsampler_t* obj )
+{
+    uintptr_t vector = (uintptr_t)0;
+
+    switch( obj->smp )
+    {
+        case SMP_4:
+            vector = (uintptr_t)&smp4_dma_irq;
+            break;
+
+        case SMP_5:
+            vector = (uintptr_t)&smp5_dma_irq;
+            break;
+
+        default:
+            break;
+    }
+
+    return vector;
+}
+
+void snapshotsampler_init(snapshotsampler_t* obj, SMPName smp, uint32_t* buffer, uint32_t length)
+{
+    MBED_ASSERT(length >= 1 && length <= 0xFFFF);
+
+    obj->smp = smp;
+    obj->sources = 0;
+    obj->running = 0;
+    obj->buffer = buffer;
+    obj->length = length;
+    obj->handler = NULL;
+    obj->id = 0;
+    timer_claim(&obj->handle, (TIM_TypeDef *)(obj->smp), "a snapshot sampler");
+
+#if defined(TIM4_BASE)
+    if (obj->smp == SMP_4) __HAL_RCC_TIM4_CLK_ENABLE();
+#endif
+
+#if defined(TIM5_BASE)
+    if (obj->smp == SMP_5) __HAL_RCC_TIM5_CLK_ENABLE();
+#endif
+
+    __HAL_RCC_DMA1_CLK_ENABLE();
+
+    obj->clock = smp_get_clock(obj);
+    if (obj->clock == 0)
+        error("SMP: unknown timer clock\n");
+
+    // Configure Timer, the rate is only set by snapshotsampler_start
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    TimHandle->Instance = (TIM_TypeDef *)(obj->smp);
+    TimHandle->Init.Prescaler     = 0;
+    TimHandle->Init.Period        = IS_TIM_32B_COUNTER_INSTANCE(TimHandle->Instance) ? 0xFFFFFFFF : 0xFFFF;
+    TimHandle->Init.ClockDivision = 0;
+    TimHandle->Init.CounterMode   = TIM_COUNTERMODE_UP;
+    if (HAL_TIM_Base_Init(TimHandle) != HAL_OK)
+    {
+        error("Cannot initialize Time Base\n");
+    }
+    obj->prescaler = 1;
+    obj->period = TimHandle->Init.Period;
+
+    uint8_t irq_index = smp_get_irq_index( obj );
+    smp_objs[irq_index] = obj;
+}
+
+int snapshotsampler_add(snapshotsampler_t* obj, volatile uint32_t* reg)
+{
+    if (obj->sources == SMP_SOURCES || obj->running)
+        return -1;
+
+    obj->source[obj->sources] = (uint32_t)(uintptr_t)reg;
+    return obj->sources++;
+}
+
+void snapshotsampler_set_irq(snapshotsampler_t* obj, smp_irq_handler handler, uintptr_t id)
+{
+    obj->handler = handler;
+    obj->id = id;
+}
+
+/* Prescaler and period nearest to 'ticks' timer clocks */
+static void smp_solve( snapshotsampler_t* obj, uint64_t ticks, uint32_t *prescaler, uint32_t *period )
+{
+    uint64_t max = (uint64_t)obj->handle.Init.Period + 1;
+    uint64_t psc = (ticks + max - 1) / max;
+    uint64_t arr;
+
+    if (psc == 0)
+        psc = 1;
+    if (psc > 0x10000)
+        error("SMP: out of range rate\n");
+
+    arr = (ticks + psc / 2) / psc;
+    if (arr < 2)
+        arr = 2;
+    if (arr > max)
+        arr = max;
+
+    *prescaler = (uint32_t)psc;
+    *period = (uint32_t)(arr - 1);
+}
+
+void snapshotsampler_start(snapshotsampler_t* obj, uint32_t hz)
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    const smp_route_t *routes = smp_get_routes(obj);
+    TIM_OC_InitTypeDef sConfig;
+    uint32_t requests = 0;
+
+    MBED_ASSERT(obj->sources > 0 && hz > 0);
+    snapshotsampler_stop(obj);
+
+  /* Sample rate */
+    smp_solve(obj, ((uint64_t)obj->clock + hz / 2) / hz, &obj->prescaler, &obj->period);
+    TimHandle->Instance->PSC = obj->prescaler - 1;
+    TimHandle->Instance->ARR = obj->period;
+    TimHandle->Instance->CNT = 0;
+    // Load PSC now, before any DMA request is enabled
+    HAL_TIM_GenerateEvent(TimHandle, TIM_EVENTSOURCE_UPDATE);
+    __HAL_TIM_CLEAR_FLAG(TimHandle, TIM_FLAG_UPDATE);
+
+    sConfig.OCMode       = TIM_OCMODE_TIMING;
+    sConfig.Pulse        = 0;
+    sConfig.OCPolarity   = TIM_OCPOLARITY_HIGH;
+    sConfig.OCNPolarity  = TIM_OCNPOLARITY_HIGH;
+    sConfig.OCFastMode   = TIM_OCFAST_DISABLE;
+    sConfig.OCIdleState  = TIM_OCIDLESTATE_RESET;
+    sConfig.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+
+  /* One stream per register, both halves of the buffer in double buffer mode */
+    for (uint8_t i = 0; i < obj->sources; i++) {
+        const smp_route_t *route = &routes[i];
+        DMA_HandleTypeDef *hdma = &obj->dma[i];
+        uint32_t m0 = (uint32_t)(uintptr_t)(obj->buffer + i * obj->length);
+        uint32_t m1 = (uint32_t)(uintptr_t)(obj->buffer + (obj->sources + i) * obj->length);
+        uint8_t last = (i == obj->sources - 1);
+
+        if (route->channel) {
+            if (HAL_TIM_OC_ConfigChannel(TimHandle, &sConfig, (route->channel - 1) * 4) != HAL_OK)
+            {
+                error("Cannot initialize Output Compare\n");
+            }
+        }
+
+        dma_stream_claim(hdma, route->stream, "a snapshot sampler");
+        hdma->Instance = route->stream;
+        hdma->Init.Channel = smp_get_dma_channel(obj);
+        hdma->Init.Direction = DMA_PERIPH_TO_MEMORY;
+        hdma->Init.PeriphInc = DMA_PINC_DISABLE;
+        hdma->Init.MemInc = DMA_MINC_ENABLE;
+        hdma->Init.PeriphDataAlignment = DMA_PDATAALIGN_WORD;
+        hdma->Init.MemDataAlignment = DMA_MDATAALIGN_WORD;
+        hdma->Init.Mode = DMA_CIRCULAR;
+        hdma->Init.Priority = DMA_PRIORITY_HIGH;
+        hdma->Init.FIFOMode = DMA_FIFOMODE_DISABLE;
+        hdma->Init.FIFOThreshold = 0;
+        hdma->Init.MemBurst = 0;
+        hdma->Init.PeriphBurst = 0;
+        if (HAL_DMA_Init(hdma) != HAL_OK)
+        {
+            error("Cannot initialize Sampler DMA\n");
+        }
+        hdma->Parent = TimHandle;
+        hdma->XferHalfCpltCallback = NULL;
+        hdma->XferErrorCallback = NULL;
+        hdma->XferCpltCallback = last ? smp_block_m0 : NULL;
+        hdma->XferM1CpltCallback = last ? smp_block_m1 : NULL;
+
+        HAL_StatusTypeDef status;
+        if (last) {
+            status = HAL_DMAEx_MultiBufferStart_IT(hdma, obj->source[i], m0, m1, obj->length);
+        } else {
+            status = HAL_DMAEx_MultiBufferStart(hdma, obj->source[i], m0, m1, obj->length);
+        }
+        if (status != HAL_OK)
+        {
+            error("Cannot start Sampler DMA\n");
+        }
+        requests |= route->dma_source;
+    }
+
+    IRQn_Type irq_n = routes[obj->sources - 1].irq_n;
+    NVIC_SetVector(irq_n, smp_get_vector(obj));
+    NVIC_EnableIRQ(irq_n);
+
+    obj->running = 1;
+    __HAL_TIM_ENABLE_DMA(TimHandle, requests);
+    __HAL_TIM_ENABLE(TimHandle);
+}
+
+void snapshotsampler_stop(snapshotsampler_t* obj)
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+
+    if (!obj->running)
+        return;
+    obj->running = 0;
+
+    __HAL_TIM_DISABLE(TimHandle);
+    __HAL_TIM_DISABLE_DMA(TimHandle, TIM_DMA_UPDATE | TIM_DMA_CC1 | TIM_DMA_CC2 | TIM_DMA_CC3 | TIM_DMA_CC4);
+
+    for (uint8_t i = 0; i < obj->sources; i++) {
+        HAL_DMA_Abort(&obj->dma[i]);
+        dma_stream_release(&obj->dma[i]);
+    }
+}
+
+void snapshotsampler_free(snapshotsampler_t* obj)
+{
+    snapshotsampler_stop(obj);
+    __HAL_TIM_DISABLE(&obj->handle);
+
+    uint8_t irq_index = smp_get_irq_index( obj );
+    if (smp_objs[irq_index] == obj)
+        smp_objs[irq_index] = NULL;
+    timer_release(&obj->handle);
+}
+
+uint64_t snapshotsampler_get_period_ns(snapshotsampler_t* obj)
+{
+    uint64_t ticks = (uint64_t)obj->prescaler * ((uint64_t)obj->period + 1);
+
+    return (ticks * 1000000000ULL + obj->clock / 2) / obj->clock;
+}
+
+#endif //DEVICE_SNAPSHOTSAMPLER
@@ -0,0 +1,68 @@
+#include "timers.h"
+
+#include <stddef.h>
+#include "mbed_error.h"
+
+#define TIMER_NUMBER 15
+
+/* Who holds each timer, by its number */
+static TIM_HandleTypeDef *timer_htim[TIMER_NUMBER];
+static const char *timer_owner[TIMER_NUMBER];
+
+static uint8_t timer_get_index( TIM_TypeDef* tim )
+{
+    switch ((uint32_t)(uintptr_t)tim)
+    {
+#if defined(TIM1_BASE)
+        case TIM1_BASE:
+            return 1;
+#endif
+#if defined(TIM2_BASE)
+        case TIM2_BASE:
+            return 2;
+#endif
+#if defined(TIM3_BASE)
+        case TIM3_BASE:
+            return 3;
+#endif
+#if defined(TIM4_BASE)
+        case TIM4_BASE:
+            return 4;
+#endif
+#if defined(TIM5_BASE)
+        case TIM5_BASE:
+            return 5;
+#endif
+#if defined(TIM8_BASE)
+        case TIM8_BASE:
+            return 8;
+#endif
+        default:
+            error("Unknown timer\n");
+    }
+    return 0;
+}
+
+void timer_claim(TIM_HandleTypeDef *htim, TIM_TypeDef *instance, const char *owner)
+{
+    uint8_t index = timer_get_index(instance);
+
+    if (timer_htim[index] && timer_htim[index] != htim) {
+        error("TIM%d is taken by %s\n", index, timer_owner[index]);
+    }
+    timer_htim[index] = htim;
+    timer_owner[index] = owner;
+}
+
+void timer_release(TIM_HandleTypeDef *htim)
+{
+    if (htim->Instance == NULL)
+        return;
+
+    uint8_t index = timer_get_index(htim->Instance);
+
+    if (timer_htim[index] == htim) {
+        timer_htim[index] = NULL;
+        timer_owner[index] = NULL;
+    }
+}
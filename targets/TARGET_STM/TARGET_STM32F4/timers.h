@@ -0,0 +1,24 @@
+#ifndef MERE_TIMERS_H
+#define MERE_TIMERS_H
+
+#include "cmsis.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* Most timers can be put to more than one use (TIM5 is a triggered
+ * timeout, an encoder or a reference timer), and two drivers on one timer
+ * would quietly reprogram each other. A driver claims the timer for its
+ * handle before it touches it and releases it once it has let go of it;
+ * claiming a timer another handle holds is an error() naming what holds
+ * it. Claiming again with the same handle is fine, and so is releasing a
+ * timer that is not held. */
+void timer_claim(TIM_HandleTypeDef *htim, TIM_TypeDef *instance, const char *owner);
+void timer_release(TIM_HandleTypeDef *htim);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -6,72 +6,195 @@
 #include "pinmap.h"
 #include "mbed_error.h"
 #include "PeripheralPins.h"
+#include "timers.h"
 
-#define CHANNEL_NUMBER 5
+#define CHANNEL_NUMBER 6
 
-static TIM_HandleTypeDef TimHandle;
-static trg_irq_handler irq_handler;
+static triggeredtimeout_t *trg_objs[CHANNEL_NUMBER];
 
-static uint32_t trg_index[CHANNEL_NUMBER];
+static uintptr_t trg_get_vector( triggeredtimeout_t* obj );
+static IRQn_Type trg_get_irq_n( triggeredtimeout_t* obj );
 
 static uint8_t trg_get_irq_index( triggeredtimeout_t* obj )
 {
     uint8_t irq_index = 0;
-    
+
     switch( obj->trg )
     {
         case TRG_2:
             irq_index = 2;
             break;
+        case TRG_5:
+            irq_index = 5;
+            break;
     }
 
     return irq_index;
 }
 
-void triggeredtimeout_init(triggeredtimeout_t* obj, PinName pin, trg_irq_handler handler, uint32_t id)
+/* Clock feeding the timer's prescaler, read once at init */
+static uint32_t trg_get_clock( triggeredtimeout_t* obj )
+{
+    RCC_ClkInitTypeDef RCC_ClkInitStruct;
+    uint32_t PclkFreq;
+    uint32_t APBxCLKDivider;
+
+    // Get clock configuration
+    // Note: PclkFreq contains here the Latency (not used after)
+    HAL_RCC_GetClockConfig(&RCC_ClkInitStruct, &PclkFreq);
+
+    // Get the PCLK and APBCLK divider related to the timer
+    switch (obj->trg) {
+
+        // APB1 clock
+        case TRG_2:
+        case TRG_5:
+            PclkFreq = HAL_RCC_GetPCLK1Freq();
+            APBxCLKDivider = RCC_ClkInitStruct.APB1CLKDivider;
+            break;
+
+        default:
+            return 0;
+    }
+
+    // TIMxCLK = PCLKx when the APB prescaler = 1 else TIMxCLK = 2 * PCLKx
+    if (APBxCLKDivider == RCC_HCLK_DIV1)
+        return PclkFreq;
+    else
+        return PclkFreq * 2;
+}
+
+void triggeredtimeout_init(triggeredtimeout_t* obj, PinName pin, trg_irq_handler handler, uintptr_t id)
 {
+    TIM_SlaveConfigTypeDef sSlaveConfig;
+    TIM_MasterConfigTypeDef sMasterConfig;
+
     obj->trg = (TRGName)pinmap_peripheral(pin, PinMap_TRG);
     MBED_ASSERT(obj->trg!= (TRGName)NC);
 
     uint32_t function = pinmap_function(pin, PinMap_TRG);
     MBED_ASSERT(function != (uint32_t)NC);
     obj->channel = STM_PIN_CHANNEL(function);
+    timer_claim(&obj->handle, (TIM_TypeDef *)(obj->trg), "a triggered timeout");
 
 #if defined(TIM2_BASE)
     if (obj->trg == TRG_2) {
         __HAL_RCC_TIM2_CLK_ENABLE();
     }
 #endif
+#if defined(TIM5_BASE)
+    if (obj->trg == TRG_5) {
+        __HAL_RCC_TIM5_CLK_ENABLE();
+    }
+#endif
 
     // Configure GPIO
     pinmap_pinout(pin, PinMap_TRG);
     obj->pin = pin;
 
+    obj->clock = trg_get_clock(obj);
+    if (obj->clock == 0)
+        error("TRG: unknown timer clock\n");
+
+    // Configure the timer once, attaching only rewrites PSC/ARR
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    TimHandle->Instance = (TIM_TypeDef *)(obj->trg);
+    TimHandle->Init.Prescaler     = 0;
+    TimHandle->Init.Period        = 0xFFFFFFFF;
+    TimHandle->Init.ClockDivision = 0;
+    TimHandle->Init.CounterMode   = TIM_COUNTERMODE_UP;
+    if (HAL_TIM_Base_Init(TimHandle) != HAL_OK)
+    {
+        error("Cannot initialize Time Base\n");
+    }
+
+    // Only overflows raise UIF, so UG can load a new prescaler quietly
+    TimHandle->Instance->CR1 |= TIM_CR1_URS;
+    __HAL_TIM_CLEAR_IT(TimHandle, TIM_IT_UPDATE);
+
+    sSlaveConfig.SlaveMode = TIM_SLAVEMODE_TRIGGER;
+    if(obj->channel == 1)
+    {
+        sSlaveConfig.InputTrigger = TIM_TS_TI1FP1;
+    }
+    else
+    {
+        sSlaveConfig.InputTrigger = TIM_TS_TI2FP2;
+    }
+
+    sSlaveConfig.TriggerFilter = 15;
+    sSlaveConfig.TriggerPolarity = TIM_TRIGGERPOLARITY_FALLING;
+    if (HAL_TIM_SlaveConfigSynchronization(TimHandle, &sSlaveConfig) != HAL_OK)
+    {
+        error("Cannot initialize Trigger Slave\n");
+    }
+
+    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
+    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
+    if (HAL_TIMEx_MasterConfigSynchronization(TimHandle, &sMasterConfig) != HAL_OK)
+    {
+        error("Cannot initialize Trigger Master\n");
+    }
+
+    obj->prescaler = 1;
+    obj->period = 0xFFFFFFFF;
+    obj->compare = 0;
+    obj->mode = TRG_MODE_IRQ;
+    obj->out_channel = 0;
+    obj->used = 1 << obj->channel;
+    obj->outputs = 0;
+    for (int i = 0; i < 4; i++) {
+        obj->event_ticks[i] = 0;
+        obj->event_handler[i] = NULL;
+        obj->event_id[i] = 0;
+    }
+
+    obj->handler = handler;
+    obj->id = id;
+
     uint8_t irq_index = trg_get_irq_index( obj );
-    trg_index[irq_index] = id;
+    trg_objs[irq_index] = obj;
 
-    irq_handler = handler;
+  /* Determine and Set Irq */
+    IRQn_Type irq_n = trg_get_irq_n( obj );
+    uintptr_t vector = trg_get_vector( obj );
+    NVIC_SetVector(irq_n, vector);
+    NVIC_EnableIRQ(irq_n);
 }
 
-void trigger_period(triggeredtimeout_t *obj, float seconds)
+static void handle_interrupt( triggeredtimeout_t* obj )
 {
-    trigger_period_us(obj, seconds * 1000000.0f);
-}
+    TIM_HandleTypeDef* htim = &obj->handle;
 
-void trigger_period_ms(triggeredtimeout_t *obj, int ms)
-{
-    trigger_period_us(obj, ms * 1000);
-}
+  /* Compare events, which come before the end of the period */
+    for (int ch = 1; ch <= 4; ch++)
+    {
+        if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC1 << (ch - 1)) != RESET)
+        {
+            if(__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_CC1 << (ch - 1)) !=RESET)
+            {
+                __HAL_TIM_CLEAR_IT(htim, TIM_IT_CC1 << (ch - 1));
+                obj->event_handler[ch - 1]( obj->event_id[ch - 1] );
+            }
+        }
+    }
 
-static void handle_interrupt( TIM_HandleTypeDef* htim, uint8_t index )
-{
   /* Overflow event */
     if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) != RESET)
     {
         if(__HAL_TIM_GET_IT_SOURCE(htim, TIM_IT_UPDATE) !=RESET)
         {
             __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
-            irq_handler( (uint32_t)trg_index[index] ); 
+            if (obj->mode == TRG_MODE_PULSE_ONCE)
+            {
+                // The pulse is over, ignore further edges until re-armed
+                htim->Instance->SMCR &= ~TIM_SMCR_SMS;
+                __HAL_TIM_DISABLE_IT(htim, TIM_IT_UPDATE);
+            }
+            else
+            {
+                obj->handler( obj->id );
+            }
         }
 
     }
@@ -79,20 +202,26 @@ static void handle_interrupt( TIM_HandleTypeDef* htim, uint8_t index )
 
 static void timer2_irq( void )
 {
-    TIM_HandleTypeDef htim2;
-    htim2.Instance = TIM2;
+    handle_interrupt( trg_objs[2] );
+}
 
-    handle_interrupt( &htim2, 2 );    
+static void timer5_irq( void )
+{
+    handle_interrupt( trg_objs[5] );
 }
 
-static uint32_t trg_get_vector( triggeredtimeout_t* obj )
+static uintptr_t trg_get_vector( triggeredtimeout_t* obj )
 {
-    uint32_t vector = (uint32_t)0;
+    uintptr_t vector = (uintptr_t)0;
 
     switch( obj->trg )
     {
         case TRG_2:
-            vector = (uint32_t)&timer2_irq;
+            vector = (uintptr_t)&timer2_irq;
+            break;
+
+        case TRG_5:
+            vector = (uintptr_t)&timer5_irq;
             break;
 
         default:
@@ -111,128 +240,338 @@ static IRQn_Type trg_get_irq_n( triggeredtimeout_t* obj )
         case TRG_2:
             irq_n = TIM2_IRQn;
             break;
- 
+
+        case TRG_5:
+            irq_n = TIM5_IRQn;
+            break;
+
         default:
             break;
-    } 
-    
-   return irq_n; 
+    }
+
+   return irq_n;
 }
 
-void trigger_period_us(triggeredtimeout_t *obj, int us)
+/* Split a delay of ticks timer clocks into PSC + 1 and ARR. The smallest
+ * prescaler that fits the 32-bit counter gives the finest resolution, and
+ * a count rounded to the nearest prescaled tick keeps the error under half
+ * of one. */
+static void trg_solve( uint64_t ticks, uint32_t *prescaler, uint32_t *period )
 {
-    TimHandle.Instance = (TIM_TypeDef *)(obj->trg);
-    TIM_SlaveConfigTypeDef sSlaveConfig;
-    TIM_MasterConfigTypeDef sMasterConfig;
-    RCC_ClkInitTypeDef RCC_ClkInitStruct;
-    uint32_t PclkFreq;
-    uint32_t APBxCLKDivider;
+    uint64_t psc = (ticks + 0xFFFFFFFFULL) / 0x100000000ULL;
+    uint64_t arr;
+
+    if (psc == 0)
+        psc = 1;
+    if (psc > 0x10000)
+        error("TRG: out of range delay\n");
+
+    arr = (ticks + psc / 2) / psc;
+    if (arr == 0)
+        arr = 1;
+    if (arr > 0x100000000ULL)
+        arr = 0x100000000ULL;
+
+    *prescaler = (uint32_t)psc;
+    *period = (uint32_t)(arr - 1);
+}
 
-    __HAL_TIM_DISABLE(&TimHandle);
+/* Nearest whole tick, in two parts so ns * clock cannot overflow */
+static uint64_t trg_ns_to_ticks( triggeredtimeout_t* obj, uint64_t ns )
+{
+    uint64_t ticks = (ns / 1000000000ULL) * obj->clock;
 
-    // Get clock configuration
-    // Note: PclkFreq contains here the Latency (not used after)
-    HAL_RCC_GetClockConfig(&RCC_ClkInitStruct, &PclkFreq);
+    return ticks + ((ns % 1000000000ULL) * obj->clock + 500000000ULL) / 1000000000ULL;
+}
 
-    // Get the PCLK and APBCLK divider related to the timer
-    switch (obj->trg) {
-      
-        // APB1 clock
-#if defined(TIM2_BASE)
-        case TRG_2:
-#endif
-            PclkFreq = HAL_RCC_GetPCLK1Freq();
-            APBxCLKDivider = RCC_ClkInitStruct.APB1CLKDivider;
-            break;
-        
-            break;
-        default:
-            return;
+/* Back again, split into whole seconds and the rest the same way: ticks
+ * times PSC goes up to 2^48 timer clocks, and times 1e9 that would
+ * overflow from about 205s on at 90MHz */
+static uint64_t trg_ticks_to_ns( triggeredtimeout_t* obj, uint64_t ticks )
+{
+    uint64_t clocks = ticks * obj->prescaler;
+    uint64_t ns = (clocks / obj->clock) * 1000000000ULL;
+
+    return ns + ((clocks % obj->clock) * 1000000000ULL + obj->clock / 2) / obj->clock;
+}
+
+static void trg_set_event_compare( triggeredtimeout_t* obj, uint8_t channel )
+{
+    uint64_t compare = (obj->event_ticks[channel - 1] + obj->prescaler / 2) / obj->prescaler;
+
+    // CNT rests at 0, so a match on 0 would only come at the end of the period
+    if (compare == 0)
+        compare = 1;
+    if (compare > 0xFFFFFFFFULL)
+        compare = 0xFFFFFFFFULL;
+    __HAL_TIM_SET_COMPARE(&obj->handle, (channel - 1) * 4, (uint32_t)compare);
+}
+
+/* Stop the counter and load a new reload value and prescaler. Leaves the
+ * update interrupt disabled. */
+static void trg_load( triggeredtimeout_t* obj, uint32_t prescaler, uint32_t period )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+
+    __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_UPDATE);
+    TimHandle->Instance->CR1 &= ~TIM_CR1_CEN;
+
+    TimHandle->Instance->ARR = period;
+    TimHandle->Instance->CNT = 0;
+    if (prescaler != obj->prescaler) {
+        // PSC is preloaded, UG loads it now without raising UIF
+        TimHandle->Instance->PSC = prescaler - 1;
+        TimHandle->Instance->EGR = TIM_EGR_UG;
     }
 
-    /* To make it simple, we use to possible prescaler values which lead to:
-     * trg unit = 1us, period/pulse can be from 1us to 65535us
-     * or
-     * trg unit = 500us, period/pulse can be from 500us to ~32.76sec
-     */
-    if (us >  0xFFFF) {
-        obj->prescaler = 500;
-    } else {
-        obj->prescaler = 1;
+    // Save for future use
+    obj->prescaler = prescaler;
+    obj->period = period;
+
+    // Events keep their delay in clocks, so follow a new prescaler
+    for (int ch = 1; ch <= 4; ch++) {
+        if (obj->event_ticks[ch - 1])
+            trg_set_event_compare(obj, ch);
     }
+}
 
-    // TIMxCLK = PCLKx when the APB prescaler = 1 else TIMxCLK = 2 * PCLKx
-    if (APBxCLKDivider == RCC_HCLK_DIV1)
-      TimHandle.Init.Prescaler   = (uint16_t)(((PclkFreq) / 1000000) * obj->prescaler) - 1; // 1 us tick
+static void trg_set_ocmode( triggeredtimeout_t* obj, uint8_t channel, uint32_t ocmode )
+{
+    TIM_TypeDef *tim = obj->handle.Instance;
+    volatile uint32_t *ccmr = (channel <= 2) ? &tim->CCMR1 : &tim->CCMR2;
+    uint32_t shift = (channel & 1) ? 0 : 8;
+
+    *ccmr = (*ccmr & ~(TIM_CCMR1_OC1M << shift)) | (ocmode << shift);
+}
+
+/* Select interrupt or one-pulse operation, and re-arm the trigger in case a
+ * one-shot pulse has disarmed it */
+static void trg_set_mode( triggeredtimeout_t* obj, trg_mode mode )
+{
+    TIM_TypeDef *tim = obj->handle.Instance;
+
+    if (mode == TRG_MODE_IRQ)
+        tim->CR1 &= ~TIM_CR1_OPM;
     else
-      TimHandle.Init.Prescaler   = (uint16_t)(((PclkFreq * 2) / 1000000) * obj->prescaler) - 1; // 1 us tick
+        tim->CR1 |= TIM_CR1_OPM;
+    tim->SMCR = (tim->SMCR & ~TIM_SMCR_SMS) | TIM_SLAVEMODE_TRIGGER;
+    obj->mode = mode;
+}
 
-    if (TimHandle.Init.Prescaler > 0xFFFF)
-        error("TRG: out of range prescaler");
+void trigger_set_irq_ns( triggeredtimeout_t* obj, uint64_t ns )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    uint32_t prescaler;
+    uint32_t period;
 
-    TimHandle.Init.Period        = (us - 1) / obj->prescaler;
-    if (TimHandle.Init.Period > 0xFFFF)
-        error("TRG: out of range period");
+    trg_solve(trg_ns_to_ticks(obj, ns), &prescaler, &period);
+    trg_load(obj, prescaler, period);
 
-    TimHandle.Init.ClockDivision = 0;
-    TimHandle.Init.CounterMode   = TIM_COUNTERMODE_UP;
+    if (obj->out_channel)
+        trg_set_ocmode(obj, obj->out_channel, TIM_OCMODE_FORCED_INACTIVE);
+    trg_set_mode(obj, TRG_MODE_IRQ);
 
-    if (HAL_TIM_Base_Init(&TimHandle) != HAL_OK)
-    {
-        error("Cannot initialize Time Base\n");
-    }
-    __HAL_TIM_CLEAR_IT(&TimHandle, TIM_IT_UPDATE); 
+    __HAL_TIM_CLEAR_IT(TimHandle, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE_IT(TimHandle, TIM_IT_UPDATE);
+}
 
-    sSlaveConfig.SlaveMode = TIM_SLAVEMODE_TRIGGER;
-    if(obj->channel == 1)
-    {
-        sSlaveConfig.InputTrigger = TIM_TS_TI1FP1;
-    }
-    else
-    {
-        sSlaveConfig.InputTrigger = TIM_TS_TI2FP2; 
-    }
+void trigger_set_irq( triggeredtimeout_t* obj, uint32_t interval )
+{
+    trigger_set_irq_ns( obj, (uint64_t)interval * 1000 );
+}
 
-    sSlaveConfig.TriggerFilter = 15;
-    sSlaveConfig.TriggerPolarity = TIM_TRIGGERPOLARITY_FALLING;
-    if (HAL_TIM_SlaveConfigSynchronization(&TimHandle, &sSlaveConfig) != HAL_OK)
-    {
-        error("Cannot initialize Trigger Slave\n");
+uint64_t trigger_get_delay_ns( triggeredtimeout_t* obj )
+{
+    if (obj->mode != TRG_MODE_IRQ)
+        return trg_ticks_to_ns(obj, obj->compare);
+    return trg_ticks_to_ns(obj, (uint64_t)obj->period + 1);
+}
+
+/* Find pin's entry in PinMap_TRG_OUT; the same pin can sit on both timers,
+ * so the peripheral has to match too */
+static const PinMap *trg_find_output( triggeredtimeout_t* obj, PinName pin )
+{
+    const PinMap *map;
+
+    for (map = PinMap_TRG_OUT; map->pin != NC; map++) {
+        if (map->pin == pin && map->peripheral == (int)obj->trg)
+            return map;
     }
+    error("TRG: pin has no output on this timer\n");
+    return NULL;
+}
 
-    sMasterConfig.MasterOutputTrigger = TIM_TRGO_RESET;
-    sMasterConfig.MasterSlaveMode = TIM_MASTERSLAVEMODE_DISABLE;
-    if (HAL_TIMEx_MasterConfigSynchronization(&TimHandle, &sMasterConfig) != HAL_OK)
+/* Set a channel up as a compare output, enabled but held inactive */
+static void trg_oc_init( triggeredtimeout_t* obj, uint8_t channel, uint8_t active_low )
+{
+    TIM_OC_InitTypeDef sConfig;
+
+    if (obj->used & (1 << channel))
+        error("TRG: channel already in use\n");
+    obj->used |= 1 << channel;
+
+    sConfig.OCMode       = TIM_OCMODE_FORCED_INACTIVE;
+    sConfig.Pulse        = 0;
+    sConfig.OCPolarity   = active_low ? TIM_OCPOLARITY_LOW : TIM_OCPOLARITY_HIGH;
+    sConfig.OCNPolarity  = TIM_OCNPOLARITY_HIGH;
+    sConfig.OCFastMode   = TIM_OCFAST_DISABLE;
+    sConfig.OCIdleState  = TIM_OCIDLESTATE_RESET;
+    sConfig.OCNIdleState = TIM_OCNIDLESTATE_RESET;
+    if (HAL_TIM_OC_ConfigChannel(&obj->handle, &sConfig, (channel - 1) * 4) != HAL_OK)
     {
-        error("Cannot initialize Trigger Master\n");
+        error("Cannot initialize Output Compare\n");
     }
+    // Not HAL_TIM_OC_Start, that would also start the counter
+    obj->handle.Instance->CCER |= TIM_CCER_CC1E << ((channel - 1) * 4);
+}
 
-    // Save for future use
-    obj->period = us;
+void trigger_pulse_init( triggeredtimeout_t* obj, PinName pin, uint8_t active_low )
+{
+    const PinMap *map = trg_find_output(obj, pin);
 
-  /* Determine and Set Irq */
-    IRQn_Type irq_n = trg_get_irq_n( obj );
-    uint32_t vector = trg_get_vector( obj );
-    NVIC_SetVector(irq_n, (uint32_t)vector); 
-    NVIC_EnableIRQ(irq_n);
+    obj->out_channel = STM_PIN_CHANNEL(map->function);
+    trg_oc_init(obj, obj->out_channel, active_low);
 
-/*
-    if (HAL_TIM_Base_Start_IT(&TimHandle) != HAL_OK)
-    {
-        error("Cannot Start Timer\n");
+    pin_function(pin, map->function);
+    pin_mode(pin, PullNone);
+}
+
+void trigger_set_pulse_ns( triggeredtimeout_t* obj, uint64_t delay_ns, uint64_t width_ns, trg_mode mode )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    uint64_t delay = trg_ns_to_ticks(obj, delay_ns);
+    uint64_t width = trg_ns_to_ticks(obj, width_ns);
+    uint32_t prescaler;
+    uint32_t period;
+    uint64_t compare;
+
+    MBED_ASSERT(mode != TRG_MODE_IRQ);
+    if (obj->out_channel == 0)
+        error("TRG: no pulse output\n");
+
+    // CNT rests at 0 between pulses, so CCR 0 would hold the output active
+    if (delay == 0)
+        delay = 1;
+    if (width == 0)
+        width = 1;
+
+    // The pulse runs from CNT == CCR to the overflow at CNT == ARR
+    trg_solve(delay + width, &prescaler, &period);
+    compare = (delay + prescaler / 2) / prescaler;
+    if (compare == 0)
+        compare = 1;
+    if (compare > period)
+        compare = period;
+
+    trg_load(obj, prescaler, period);
+    __HAL_TIM_SET_COMPARE(TimHandle, (obj->out_channel - 1) * 4, (uint32_t)compare);
+    obj->compare = (uint32_t)compare;
+
+    trg_set_ocmode(obj, obj->out_channel, TIM_OCMODE_PWM2);
+    trg_set_mode(obj, mode);
+
+    // Only a one-shot pulse needs the CPU, to disarm once it is over
+    __HAL_TIM_CLEAR_IT(TimHandle, TIM_IT_UPDATE);
+    if (mode == TRG_MODE_PULSE_ONCE)
+        __HAL_TIM_ENABLE_IT(TimHandle, TIM_IT_UPDATE);
+}
+
+uint64_t trigger_get_width_ns( triggeredtimeout_t* obj )
+{
+    if (obj->mode == TRG_MODE_IRQ)
+        return 0;
+    return trg_ticks_to_ns(obj, (uint64_t)obj->period + 1 - obj->compare);
+}
+
+uint8_t trigger_event_init( triggeredtimeout_t* obj, PinName pin, uint8_t active_low )
+{
+    const PinMap *map = NULL;
+    uint8_t channel;
+
+    if (pin != NC) {
+        map = trg_find_output(obj, pin);
+        channel = STM_PIN_CHANNEL(map->function);
+    } else {
+        for (channel = 1; channel <= 4; channel++) {
+            if (!(obj->used & (1 << channel)))
+                break;
+        }
+        if (channel > 4)
+            error("TRG: no free channel\n");
+    }
+    trg_oc_init(obj, channel, active_low);
+
+    obj->event_ticks[channel - 1] = 0;
+    obj->event_handler[channel - 1] = NULL;
+    if (map) {
+        obj->outputs |= 1 << channel;
+        pin_function(pin, map->function);
+        pin_mode(pin, PullNone);
     }
-*/
-    __HAL_TIM_ENABLE_IT(&TimHandle, TIM_IT_UPDATE);
+
+    return channel;
 }
 
-void trigger_set_irq( triggeredtimeout_t* obj, uint32_t interval )
+void trigger_event_free( triggeredtimeout_t* obj, uint8_t channel )
+{
+    MBED_ASSERT(channel != obj->channel && channel != obj->out_channel);
+
+    trigger_clear_event(obj, channel);
+    obj->handle.Instance->CCER &= ~(TIM_CCER_CC1E << ((channel - 1) * 4));
+    obj->used &= ~(1 << channel);
+    obj->outputs &= ~(1 << channel);
+}
+
+void trigger_set_event_ns( triggeredtimeout_t* obj, uint8_t channel, uint64_t ns, trg_irq_handler handler, uintptr_t id )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    uint64_t ticks = trg_ns_to_ticks(obj, ns);
+
+    MBED_ASSERT(channel >= 1 && channel <= 4);
+    MBED_ASSERT(channel != obj->channel && channel != obj->out_channel);
+    MBED_ASSERT(obj->used & (1 << channel));
+
+    __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_CC1 << (channel - 1));
+
+    obj->event_ticks[channel - 1] = ticks ? ticks : 1;
+    obj->event_handler[channel - 1] = handler;
+    obj->event_id[channel - 1] = id;
+    trg_set_event_compare(obj, channel);
+
+    // PWM mode 2 holds the output active from the match to the overflow
+    if (obj->outputs & (1 << channel))
+        trg_set_ocmode(obj, channel, TIM_OCMODE_PWM2);
+
+    __HAL_TIM_CLEAR_IT(TimHandle, TIM_IT_CC1 << (channel - 1));
+    if (handler)
+        __HAL_TIM_ENABLE_IT(TimHandle, TIM_IT_CC1 << (channel - 1));
+}
+
+void trigger_clear_event( triggeredtimeout_t* obj, uint8_t channel )
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+
+    MBED_ASSERT(channel >= 1 && channel <= 4);
+
+    __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_CC1 << (channel - 1));
+    __HAL_TIM_CLEAR_IT(TimHandle, TIM_IT_CC1 << (channel - 1));
+    trg_set_ocmode(obj, channel, TIM_OCMODE_FORCED_INACTIVE);
+    obj->event_ticks[channel - 1] = 0;
+    obj->event_handler[channel - 1] = NULL;
+}
+
+uint64_t trigger_get_event_ns( triggeredtimeout_t* obj, uint8_t channel )
 {
-    trigger_period_us( obj, interval );        
+    MBED_ASSERT(channel >= 1 && channel <= 4);
+
+    if (obj->event_ticks[channel - 1] == 0)
+        return 0;
+    return trg_ticks_to_ns(obj, __HAL_TIM_GET_COMPARE(&obj->handle, (channel - 1) * 4));
 }
 
 void trigger_irq_enable( triggeredtimeout_t* obj )
 {
-    IRQn_Type irq_n = trg_get_irq_n( obj ); 
+    IRQn_Type irq_n = trg_get_irq_n( obj );
 
     NVIC_EnableIRQ( irq_n );
 }
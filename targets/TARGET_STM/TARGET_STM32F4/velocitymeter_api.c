@@ -0,0 +1,341 @@
+#include "velocitymeter_api.h"
+
+#if DEVICE_VELOCITYMETER
+
+#include <stddef.h>
+#include "cmsis.h"
+#include "mbed_error.h"
+#include "timers.h"
+
+#define CHANNEL_NUMBER 6
+
+/* Tries at reading a coherent edge before taking what is there. Only an
+ * encoder edging every few clocks defeats it, and then the last two edges
+ * are a count or two apart out of thousands in the window. */
+#define VEL_SPIN        4
+
+static velocitymeter_t *vel_objs[CHANNEL_NUMBER];
+
+/* Where the reference timers' ITR0-3 come from, the "TIMx internal trigger
+ * connection" tables of RM0090 */
+static const uint32_t vel_itrs_4[4] = {TIM1_BASE, TIM2_BASE, TIM3_BASE, TIM8_BASE};
+static const uint32_t vel_itrs_5[4] = {TIM2_BASE, TIM3_BASE, TIM4_BASE, TIM8_BASE};
+
+static const uint32_t vel_ts[4] = {TIM_TS_ITR0, TIM_TS_ITR1, TIM_TS_ITR2, TIM_TS_ITR3};
+
+static uint8_t vel_get_irq_index( velocitymeter_t* obj )
+{
+    uint8_t irq_index = 0;
+
+    switch( obj->vel )
+    {
+        case VEL_4:
+            irq_index = 4;
+            break;
+        case VEL_5:
+            irq_index = 5;
+            break;
+    }
+
+    return irq_index;
+}
+
+/* TIM_TS_ITRx carrying the encoder's TRGO, TIM_TS_NONE if no link */
+static uint32_t vel_get_itr( velocitymeter_t* obj )
+{
+    const uint32_t *itrs = (obj->vel == VEL_4) ? vel_itrs_4 : vel_itrs_5;
+
+    for (uint32_t itr = 0; itr < 4; itr++) {
+        if (itrs[itr] == (uint32_t)(uintptr_t)obj->encoder) {
+            return vel_ts[itr];
+        }
+    }
+    return TIM_TS_NONE;
+}
+
+/* Clock feeding the timer's prescaler, read once at init */
+static uint32_t vel_get_clock( velocitymeter_t* obj )
+{
+    RCC_ClkInitTypeDef RCC_ClkInitStruct;
+    uint32_t PclkFreq;
+    uint32_t APBxCLKDivider;
+
+    // Get clock configuration
+    // Note: PclkFreq contains here the Latency (not used after)
+    HAL_RCC_GetClockConfig(&RCC_ClkInitStruct, &PclkFreq);
+
+    // Get the PCLK and APBCLK divider related to the timer
+    switch (obj->vel) {
+
+        // APB1 clock
+        case VEL_4:
+        case VEL_5:
+            PclkFreq = HAL_RCC_GetPCLK1Freq();
+            APBxCLKDivider = RCC_ClkInitStruct.APB1CLKDivider;
+            break;
+
+        default:
+            return 0;
+    }
+
+    // TIMxCLK = PCLKx when the APB prescaler = 1 else TIMxCLK = 2 * PCLKx
+    if (APBxCLKDivider == RCC_HCLK_DIV1)
+        return PclkFreq;
+    else
+        return PclkFreq * 2;
+}
+
+/* Counts from one edge to the next. Moving a cycle takes a rising edge on
+ * channel A, so two edges in a row are never half a wrap apart. */
+static int32_t vel_counts( velocitymeter_t* obj, uint32_t from, uint32_t to )
+{
+    uint32_t period = obj->encoder_period;
+    int64_t delta = (to - from) & period;
+
+    if (delta > period / 2)
+        delta -= (int64_t)period + 1;
+    return (int32_t)delta;
+}
+
+static void vel_window( velocitymeter_t* obj )
+{
+    TIM_HandleTypeDef *htim = &obj->handle;
+    float tick_hz = (float)obj->clock / (float)obj->prescaler;
+    uint64_t now = ++obj->windows * obj->window;
+
+    if (__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC3) != RESET) {
+      /* The encoder's CCR1 and our CCR3 latch on the same edge, a couple
+       * of clocks apart; read them again if a newer edge came in between */
+        uint32_t captured;
+        uint32_t edge;
+        int spin = 0;
+
+        do {
+            __HAL_TIM_CLEAR_FLAG(htim, TIM_FLAG_CC3 | TIM_FLAG_CC3OF);
+            captured = htim->Instance->CCR3;
+            edge = obj->encoder->CCR1;
+        } while (__HAL_TIM_GET_FLAG(htim, TIM_FLAG_CC3) != RESET && ++spin < VEL_SPIN);
+
+        // We are just past the update: a capture above the count now is
+        // from before it
+        uint64_t time = now + captured;
+        if (captured > htim->Instance->CNT)
+            time -= obj->window;
+
+        if (obj->ref_valid && time != obj->ref_time)
+            obj->speed = (float)vel_counts(obj, obj->ref_edge, edge) * tick_hz / (float)(time - obj->ref_time);
+        obj->ref_time = time;
+        obj->ref_edge = edge;
+        obj->ref_valid = 1;
+        obj->idle = 0;
+    } else if (obj->ref_valid) {
+        if (++obj->idle >= obj->timeout) {
+            obj->speed = 0.0f;
+        } else {
+            // The next edge is no sooner than now, so the speed is at most
+            // one cycle over the time since the last
+            float bound = (float)obj->cycle * tick_hz / (float)(now - obj->ref_time);
+            if (obj->speed > bound)
+                obj->speed = bound;
+            else if (obj->speed < -bound)
+                obj->speed = -bound;
+        }
+    }
+
+    if (obj->handler)
+        obj->handler(obj->id);
+}
+
+static void handle_interrupt( velocitymeter_t* obj )
+{
+    TIM_HandleTypeDef *htim = &obj->handle;
+
+  /* End of a window */
+    if(__HAL_TIM_GET_FLAG(htim, TIM_FLAG_UPDATE) != RESET)
+    {
+        __HAL_TIM_CLEAR_IT(htim, TIM_IT_UPDATE);
+        vel_window(obj);
+    }
+}
+
+static void timer4_irq( void )
+{
+    handle_interrupt( vel_objs[4] );
+}
+
+static void timer5_irq( void )
+{
+    handle_interrupt( vel_objs[5] );
+}
+
+static uintptr_t vel_get_vector( velocitymeter_t* obj )
+{
+    uintptr_t vector = (uintptr_t)0;
+
+    switch( obj->vel )
+    {
+        case VEL_4:
+            vector = (uintptr_t)&timer4_irq;
+            break;
+
+        case VEL_5:
+            vector = (uintptr_t)&timer5_irq;
+            break;
+
+        default:
+            break;
+    }
+
+    return vector;
+}
+
+static IRQn_Type vel_get_irq_n( velocitymeter_t* obj )
+{
+    return (obj->vel == VEL_4) ? TIM4_IRQn : TIM5_IRQn;
+}
+
+void velocitymeter_init(velocitymeter_t* obj, VELName vel, TIM_HandleTypeDef* encoder)
+{
+    obj->vel = vel;
+    obj->encoder = encoder->Instance;
+    obj->encoder_period = encoder->Init.Period;
+    obj->running = 0;
+    obj->speed = 0.0f;
+    obj->handler = NULL;
+    obj->id = 0;
+
+    TIM_TypeDef *enc = obj->encoder;
+
+    uint32_t itr = vel_get_itr(obj);
+    if (itr == TIM_TS_NONE)
+        error("No internal trigger from this encoder to the velocity timer\n");
+    if ((enc->CCMR1 & TIM_CCMR1_CC1S) == TIM_ICSELECTION_TRC)
+        error("The encoder's CC1 is taken by its index or a latch\n");
+    timer_claim(&obj->handle, (TIM_TypeDef *)(obj->vel), "a velocity meter");
+
+    // Channel A edges a cycle apart
+    obj->cycle = ((enc->SMCR & TIM_SMCR_SMS) == TIM_ENCODERMODE_TI12) ? 4 : 2;
+
+#if defined(TIM4_BASE)
+    if (obj->vel == VEL_4) __HAL_RCC_TIM4_CLK_ENABLE();
+#endif
+
+#if defined(TIM5_BASE)
+    if (obj->vel == VEL_5) __HAL_RCC_TIM5_CLK_ENABLE();
+#endif
+
+    obj->clock = vel_get_clock(obj);
+    if (obj->clock == 0)
+        error("Velocity: unknown timer clock\n");
+
+    // Configure Timer, the windows are only set by velocitymeter_start
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    TimHandle->Instance = (TIM_TypeDef *)(obj->vel);
+    TimHandle->Init.Prescaler     = 0;
+    TimHandle->Init.Period        = IS_TIM_32B_COUNTER_INSTANCE(TimHandle->Instance) ? 0xFFFFFFFF : 0xFFFF;
+    TimHandle->Init.ClockDivision = 0;
+    TimHandle->Init.CounterMode   = TIM_COUNTERMODE_UP;
+    if (HAL_TIM_Base_Init(TimHandle) != HAL_OK)
+    {
+        error("Cannot initialize Time Base\n");
+    }
+    obj->prescaler = 1;
+    obj->window = 1;
+
+  /* Encoder: CC1 is already IC1 on TI1 in encoder mode, so it captures the
+   * position on the rising edges of channel A, and pulses TRGO */
+    enc->CCER |= TIM_CCER_CC1E;
+    enc->CR2 = (enc->CR2 & ~TIM_CR2_MMS) | TIM_TRGO_OC1;
+
+  /* Reference: CC3 captures the time on TRC, unfiltered */
+    TIM_TypeDef *tim = TimHandle->Instance;
+    tim->SMCR = (tim->SMCR & ~(TIM_SMCR_TS | TIM_SMCR_SMS)) | itr;
+    tim->CCER &= ~TIM_CCER_CC3E;
+    tim->CCMR2 = (tim->CCMR2 & ~(TIM_CCMR2_CC3S | TIM_CCMR2_IC3PSC | TIM_CCMR2_IC3F)) | TIM_ICSELECTION_TRC;
+    tim->CCER |= TIM_CCER_CC3E;
+
+    uint8_t irq_index = vel_get_irq_index( obj );
+    vel_objs[irq_index] = obj;
+}
+
+void velocitymeter_set_irq(velocitymeter_t* obj, vel_irq_handler handler, uintptr_t id)
+{
+    obj->handler = handler;
+    obj->id = id;
+}
+
+/* Prescaler and period nearest to 'ticks' timer clocks */
+static void vel_solve( velocitymeter_t* obj, uint64_t ticks )
+{
+    uint64_t max = (uint64_t)obj->handle.Init.Period + 1;
+    uint64_t psc = (ticks + max - 1) / max;
+    uint64_t arr;
+
+    if (psc == 0)
+        psc = 1;
+    if (psc > 0x10000)
+        error("Velocity: out of range window\n");
+
+    arr = (ticks + psc / 2) / psc;
+    if (arr < 2)
+        arr = 2;
+    if (arr > max)
+        arr = max;
+
+    obj->prescaler = (uint32_t)psc;
+    obj->window = (uint32_t)arr;
+}
+
+void velocitymeter_start(velocitymeter_t* obj, uint32_t hz, float min_speed)
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+    TIM_TypeDef *tim = TimHandle->Instance;
+
+    MBED_ASSERT(hz > 0 && min_speed > 0.0f);
+    velocitymeter_stop(obj);
+
+    vel_solve(obj, ((uint64_t)obj->clock + hz / 2) / hz);
+    tim->PSC = obj->prescaler - 1;
+    tim->ARR = obj->window - 1;
+    tim->CNT = 0;
+    // Load PSC now, the update it raises is not a window
+    HAL_TIM_GenerateEvent(TimHandle, TIM_EVENTSOURCE_UPDATE);
+    __HAL_TIM_CLEAR_FLAG(TimHandle, TIM_FLAG_UPDATE | TIM_FLAG_CC3 | TIM_FLAG_CC3OF);
+
+    uint64_t window_ns = velocitymeter_get_window_ns(obj);
+    obj->timeout = (uint32_t)(1e9f * (float)obj->cycle / (min_speed * (float)window_ns)) + 1;
+
+    obj->ref_valid = 0;
+    obj->windows = 0;
+    obj->idle = 0;
+    obj->speed = 0.0f;
+
+    IRQn_Type irq_n = vel_get_irq_n(obj);
+    NVIC_SetVector(irq_n, vel_get_vector(obj));
+    NVIC_EnableIRQ(irq_n);
+
+    obj->running = 1;
+    __HAL_TIM_ENABLE_IT(TimHandle, TIM_IT_UPDATE);
+    __HAL_TIM_ENABLE(TimHandle);
+}
+
+void velocitymeter_stop(velocitymeter_t* obj)
+{
+    TIM_HandleTypeDef *TimHandle = &obj->handle;
+
+    if (!obj->running)
+        return;
+    obj->running = 0;
+
+    __HAL_TIM_DISABLE(TimHandle);
+    __HAL_TIM_DISABLE_IT(TimHandle, TIM_IT_UPDATE);
+}
+
+uint64_t velocitymeter_get_window_ns(velocitymeter_t* obj)
+{
+    uint64_t ticks = (uint64_t)obj->prescaler * obj->window;
+
+    return (ticks * 1000000000ULL + obj->clock / 2) / obj->clock;
+}
+
+#endif //DEVICE_VELOCITYMETER